@@ -700,11 +700,14 @@ def main():
     embed_db = os.path.join(project_root, "src", "embedDB")
     query_interface = os.path.join(project_root, "src", "query-interface")
     spline = os.path.join(project_root, "src", "spline")
+    fence_index = os.path.join(project_root, "src", "fence-index")
+    log_file = os.path.join(project_root, "src", "log-file")
+    lz_codec = os.path.join(project_root, "src", "lz-codec")
     utility = os.path.join(project_root, "lib", "EmbedDB-Utility")
     output_directory = os.path.join(project_root, "lib", "Distribution")
     # create standard embedDB amalgamation
     amalgamate(
-        [embed_db, query_interface, spline, utility],
+        [embed_db, query_interface, spline, fence_index, log_file, lz_codec, utility],
         aud_stand,
         "embedDB",
         False,
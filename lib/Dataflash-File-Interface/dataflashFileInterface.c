@@ -100,5 +100,9 @@ embedDBFileInterface *getDataflashInterface(void) {
   fileInterface->erase = DF_ERASE;
   fileInterface->open  = DF_OPEN;
   fileInterface->flush = DF_FLUSH;
+  fileInterface->writePages = NULL;
+  /* dfwrite only programs whole pages */
+  fileInterface->writeBytes = NULL;
+  fileInterface->readPages = NULL;
   return fileInterface;
 }
@@ -24,16 +24,34 @@ void tearDownFile(void *file) {
 
 static bool FILE_READ(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
   FILE_INFO *fileInfo = (FILE_INFO *)file;
-  fseek(fileInfo->file, pageSize * pageNum, SEEK_SET);
+  fseek(fileInfo->file, (long)pageSize * pageNum, SEEK_SET);
   return (1 == fread(buffer, pageSize, 1, fileInfo->file));
 }
 
+static bool FILE_READ_PAGES(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+  FILE_INFO *fileInfo = (FILE_INFO *)file;
+  fseek(fileInfo->file, (long)pageSize * pageNum, SEEK_SET);
+  return (numPages == fread(buffer, pageSize, numPages, fileInfo->file));
+}
+
 static bool FILE_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
   FILE_INFO *fileInfo = (FILE_INFO *)file;
-  fseek(fileInfo->file, pageNum * pageSize, SEEK_SET);
+  fseek(fileInfo->file, (long)pageNum * pageSize, SEEK_SET);
   return (1 == fwrite(buffer, pageSize, 1, fileInfo->file));
 }
 
+static bool FILE_WRITE_PAGES(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+  FILE_INFO *fileInfo = (FILE_INFO *)file;
+  fseek(fileInfo->file, (long)pageNum * pageSize, SEEK_SET);
+  return (numPages == fwrite(buffer, pageSize, numPages, fileInfo->file));
+}
+
+static bool FILE_WRITE_BYTES(void *buffer, uint32_t pageNum, uint32_t offset, uint32_t length, uint32_t pageSize, void *file) {
+  FILE_INFO *fileInfo = (FILE_INFO *)file;
+  fseek(fileInfo->file, (long)pageNum * pageSize + offset, SEEK_SET);
+  return (1 == fwrite(buffer, length, 1, fileInfo->file));
+}
+
 static bool FILE_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
     return true;
 }
@@ -41,7 +59,7 @@ static bool FILE_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize,
 static bool MOCK_FILE_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
   /* Seek to position in file */
   FILE_INFO *fileInfo = (FILE_INFO *)file;
-  int seekResult = fseek(fileInfo->file, startPage * pageSize, SEEK_SET);
+  int seekResult = fseek(fileInfo->file, (long)startPage * pageSize, SEEK_SET);
   
   if (seekResult != 0) {
 #ifdef PRINT_ERRORS
@@ -99,6 +117,9 @@ embedDBFileInterface *getFileInterface(void) {
     fileInterface->erase = FILE_ERASE;
     fileInterface->open  = FILE_OPEN;
     fileInterface->flush = FILE_FLUSH;
+    fileInterface->writePages = FILE_WRITE_PAGES;
+    fileInterface->writeBytes = FILE_WRITE_BYTES;
+    fileInterface->readPages = FILE_READ_PAGES;
     return fileInterface;
 }
 
@@ -110,5 +131,8 @@ embedDBFileInterface *getMockEraseFileInterface(void) {
     fileInterface->erase = MOCK_FILE_ERASE;
     fileInterface->open  = FILE_OPEN;
     fileInterface->flush = FILE_FLUSH;
+    fileInterface->writePages = FILE_WRITE_PAGES;
+    fileInterface->writeBytes = FILE_WRITE_BYTES;
+    fileInterface->readPages = FILE_READ_PAGES;
     return fileInterface;
 }
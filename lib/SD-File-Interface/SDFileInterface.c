@@ -63,6 +63,14 @@ static bool FILE_READ(void *buffer, uint32_t pageNum, uint32_t pageSize, void *f
   return (1 == sd_fread(buffer, pageSize, 1, fileInfo->sdFile));
 }
 
+static bool FILE_READ_PAGES(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+  SD_FILE_INFO *fileInfo = (SD_FILE_INFO *)file;
+  if (0 != sd_fseek(fileInfo->sdFile, pageSize * pageNum, SEEK_SET)) {
+    return false;
+  }
+  return (numPages == sd_fread(buffer, pageSize, numPages, fileInfo->sdFile));
+}
+
 static bool FILE_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
   bool retval = false;
   SD_FILE_INFO *fileInfo = (SD_FILE_INFO *)file;
@@ -88,6 +96,23 @@ static bool FILE_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *
   return retval;
 }
 
+static bool FILE_WRITE_PAGES(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+  SD_FILE_INFO *fileInfo = (SD_FILE_INFO *)file;
+  if (0 != sd_fseek(fileInfo->sdFile, pageNum * pageSize, SEEK_SET)) {
+    return false;
+  }
+  /* sd_fwrite returns 0 on a short write */
+  return (0 != sd_fwrite(buffer, (size_t)pageSize * numPages, 1, fileInfo->sdFile));
+}
+
+static bool FILE_WRITE_BYTES(void *buffer, uint32_t pageNum, uint32_t offset, uint32_t length, uint32_t pageSize, void *file) {
+  SD_FILE_INFO *fileInfo = (SD_FILE_INFO *)file;
+  if (0 != sd_fseek(fileInfo->sdFile, pageNum * pageSize + offset, SEEK_SET)) {
+    return false;
+  }
+  return (1 == sd_fwrite(buffer, length, 1, fileInfo->sdFile));
+}
+
 static bool FILE_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
   return true;
 }
@@ -124,5 +149,8 @@ embedDBFileInterface *getSDInterface(void) {
   fileInterface->erase = FILE_ERASE;
   fileInterface->open  = FILE_OPEN;
   fileInterface->flush = FILE_FLUSH;
+  fileInterface->writePages = FILE_WRITE_PAGES;
+  fileInterface->writeBytes = FILE_WRITE_BYTES;
+  fileInterface->readPages = FILE_READ_PAGES;
   return fileInterface;
 }
@@ -0,0 +1,168 @@
+/******************************************************************************/
+/**
+ * @file        pageIdBenchmark.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Measures the cost of the page id width on the insert,
+ *              query and iterator paths.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#ifndef PIO_UNIT_TESTING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+
+/* Number of records inserted for each search method. Run once with the
+   default build and once with -DEMBEDDB_64BIT_PAGE_IDS to compare. */
+#define PAGE_ID_BENCHMARK_RECORDS 50000
+#define PAGE_ID_BENCHMARK_QUERIES 10000
+
+#ifdef ARDUINO
+
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+
+#define clock millis
+#define PAGE_ID_DATA_FILE_PATH "dataFile.bin"
+
+#else
+
+#include "desktopFileInterface.h"
+#define PAGE_ID_DATA_FILE_PATH "build/artifacts/dataFile.bin"
+
+#endif
+
+/**
+ * Inserts PAGE_ID_BENCHMARK_RECORDS records, then queries random keys and
+ * iterates over every record, printing the time and page reads for each.
+ */
+int8_t runPageIdBenchmark(const char *name, uint32_t parameters) {
+    embedDBState *state = (embedDBState *)calloc(1, sizeof(embedDBState));
+    if (state == NULL) {
+        printf("Unable to allocate state.\n");
+        return -1;
+    }
+    state->keySize = 4;
+    state->dataSize = 8;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->buffer = calloc(state->bufferSizeInBlocks, state->pageSize);
+    state->numSplinePoints = 300;
+    state->numDataPages = 2000;
+    state->eraseSizeInPages = 4;
+    state->parameters = parameters | EMBEDDB_RESET_DATA;
+    state->compareKey = int32Comparator;
+    state->compareData = int64Comparator;
+    state->fileInterface = getFileInterface();
+    char dataPath[] = PAGE_ID_DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+
+    if (state->buffer == NULL || embedDBInit(state, 1) != 0) {
+        printf("Initialization error.\n");
+        return -1;
+    }
+
+    uint32_t start = clock();
+    for (uint32_t i = 0; i < PAGE_ID_BENCHMARK_RECORDS; i++) {
+        uint32_t key = i * 2;
+        uint64_t data = i % 100;
+        if (embedDBPut(state, &key, &data) != 0) {
+            printf("Insert failed for key %lu.\n", (unsigned long)key);
+            break;
+        }
+    }
+    embedDBFlush(state);
+    uint32_t insertTime = clock() - start;
+
+    state->numReads = 0;
+    state->bufferHits = 0;
+    uint32_t notFound = 0;
+    srand(1);
+    start = clock();
+    for (uint32_t i = 0; i < PAGE_ID_BENCHMARK_QUERIES; i++) {
+        uint32_t key = (uint32_t)(rand() % PAGE_ID_BENCHMARK_RECORDS) * 2;
+        uint64_t data = 0;
+        if (embedDBGet(state, &key, &data) != 0)
+            notFound++;
+    }
+    uint32_t queryTime = clock() - start;
+    uint32_t queryReads = state->numReads;
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    uint32_t key = 0, numIterated = 0;
+    uint64_t data = 0;
+    start = clock();
+    embedDBInitIterator(state, &it);
+    while (embedDBNext(state, &it, &key, &data))
+        numIterated++;
+    embedDBCloseIterator(&it);
+    uint32_t iterateTime = clock() - start;
+
+    printf("%-14s %8lu %8lu %8lu %8lu %8lu\n", name, (unsigned long)insertTime,
+           (unsigned long)queryTime, (unsigned long)queryReads, (unsigned long)iterateTime,
+           (unsigned long)(state->nextDataPageId - state->minDataPageId));
+    if (notFound > 0 || numIterated != PAGE_ID_BENCHMARK_RECORDS)
+        printf("Expected every record: %lu queries failed, %lu records iterated.\n",
+               (unsigned long)notFound, (unsigned long)numIterated);
+
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state->buffer);
+    free(state);
+    return 0;
+}
+
+/**
+ * Compares the hot paths of the 32-bit and 64-bit page id builds
+ */
+int pageIdBenchmark() {
+    printf("\nPage id benchmark: %d byte page ids, %d byte data page header (%d records, %d queries)\n",
+           (int)sizeof(pgid_t), (int)EMBEDDB_BITMAP_OFFSET, PAGE_ID_BENCHMARK_RECORDS, PAGE_ID_BENCHMARK_QUERIES);
+    printf("%-14s %8s %8s %8s %8s %8s\n", "Search", "Insert", "Query", "Reads", "Iterate", "Pages");
+
+    runPageIdBenchmark("Spline", 0);
+    runPageIdBenchmark("Binary search", EMBEDDB_USE_BINARY_SEARCH);
+    runPageIdBenchmark("Fence index", EMBEDDB_USE_FENCE_INDEX);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,173 @@
+/******************************************************************************/
+/**
+ * @file        recordLevelConsistencyBenchmark.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Measures insert throughput with record-level consistency
+ *              under each group commit policy.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#ifndef PIO_UNIT_TESTING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+
+/* Number of records inserted for each commit policy */
+#define RLC_BENCHMARK_RECORDS 10000
+
+#ifdef ARDUINO
+
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+
+#define clock millis
+#define RLC_DATA_FILE_PATH "dataFile.bin"
+
+uint32_t rlcBenchmarkTimeMs(void) {
+    return millis();
+}
+
+#else
+
+#include "desktopFileInterface.h"
+#define RLC_DATA_FILE_PATH "build/artifacts/dataFile.bin"
+
+uint32_t rlcBenchmarkTimeMs(void) {
+    return (uint32_t)((uint64_t)clock() * 1000 / CLOCKS_PER_SEC);
+}
+
+#endif
+
+/* Counts page writes and erases made through the wrapped file interface */
+embedDBFileInterface *rlcBenchmarkInterface;
+uint32_t rlcBenchmarkWrites, rlcBenchmarkErases;
+
+bool countingWrite(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    rlcBenchmarkWrites++;
+    return rlcBenchmarkInterface->write(buffer, pageNum, pageSize, file);
+}
+
+bool countingErase(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
+    rlcBenchmarkErases++;
+    return rlcBenchmarkInterface->erase(startPage, endPage, pageSize, file);
+}
+
+/**
+ * Inserts RLC_BENCHMARK_RECORDS records with the given commit policy and
+ * prints the time taken and the number of page writes and erases.
+ */
+int8_t runGroupCommitBenchmark(const char *name, uint32_t parameters, uint32_t commitRecords, uint32_t commitIntervalMs) {
+    embedDBState *state = (embedDBState *)calloc(1, sizeof(embedDBState));
+    if (state == NULL) {
+        printf("Unable to allocate state.\n");
+        return -1;
+    }
+    state->keySize = 4;
+    state->dataSize = 8;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->buffer = calloc(state->bufferSizeInBlocks, state->pageSize);
+    state->numSplinePoints = 32;
+    state->numDataPages = 2000;
+    state->eraseSizeInPages = 4;
+    state->parameters = parameters | EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RESET_DATA;
+    state->rlcCommitRecords = commitRecords;
+    state->rlcCommitIntervalMs = commitIntervalMs;
+    state->getTimeMs = rlcBenchmarkTimeMs;
+    state->compareKey = int32Comparator;
+    state->compareData = int64Comparator;
+
+    embedDBFileInterface countingInterface = *rlcBenchmarkInterface;
+    countingInterface.write = countingWrite;
+    countingInterface.erase = countingErase;
+    state->fileInterface = &countingInterface;
+    char dataPath[] = RLC_DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+
+    if (state->buffer == NULL || embedDBInit(state, 1) != 0) {
+        printf("Initialization error.\n");
+        return -1;
+    }
+
+    rlcBenchmarkWrites = 0;
+    rlcBenchmarkErases = 0;
+    uint32_t start = clock();
+    for (uint32_t i = 0; i < RLC_BENCHMARK_RECORDS; i++) {
+        uint64_t data = i % 100;
+        if (embedDBPut(state, &i, &data) != 0) {
+            printf("Insert failed for key %lu.\n", (unsigned long)i);
+            break;
+        }
+    }
+    embedDBCommit(state);
+    uint32_t elapsed = clock() - start;
+
+    printf("%-22s %10lu %10lu %10lu\n", name, (unsigned long)elapsed,
+           (unsigned long)rlcBenchmarkWrites, (unsigned long)rlcBenchmarkErases);
+
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->buffer);
+    free(state);
+    return 0;
+}
+
+/**
+ * Compares insert throughput for each record-level consistency commit policy
+ */
+int rlcGroupCommitBenchmark() {
+    printf("\nRecord-level consistency group commit benchmark (%d records)\n", RLC_BENCHMARK_RECORDS);
+    printf("%-22s %10s %10s %10s\n", "Policy", "Time", "Writes", "Erases");
+
+#ifdef ARDUINO
+    rlcBenchmarkInterface = getFileInterface();
+#else
+    rlcBenchmarkInterface = getMockEraseFileInterface();
+#endif
+
+    runGroupCommitBenchmark("Every record", 0, 0, 0);
+    runGroupCommitBenchmark("Every 4 records", EMBEDDB_RLC_GROUP_COMMIT, 4, 0);
+    runGroupCommitBenchmark("Every 16 records", EMBEDDB_RLC_GROUP_COMMIT, 16, 0);
+    runGroupCommitBenchmark("Every 64 records", EMBEDDB_RLC_GROUP_COMMIT, 64, 0);
+    runGroupCommitBenchmark("Every 10 ms", EMBEDDB_RLC_GROUP_COMMIT, 0, 10);
+    runGroupCommitBenchmark("Explicit commit only", EMBEDDB_RLC_GROUP_COMMIT, 0, 0);
+
+    free(rlcBenchmarkInterface);
+    return 0;
+}
+
+#endif
@@ -56,6 +56,12 @@
  */
 #define SEQUENTIAL_DATA 0
 
+/*
+ * 0: Insert records one at a time with embedDBPut
+ * 1: Load records with embedDBBulkLoad
+ */
+#define BULK_LOAD 0
+
 /**
  * 0 = SD Card
  * 1 = Dataflash
@@ -90,6 +96,46 @@
 
 #endif
 
+/* Input for embedDBBulkLoad: generated records or pages of a data set */
+typedef struct {
+    FILE_TYPE *infile;
+    char *pageBuffer;
+    int16_t pageCount;
+    int16_t pageRecord;
+    int32_t numRead;
+    int32_t numRecords;
+    uint16_t pageSize;
+    uint16_t recordSize;
+} benchmarkReader;
+
+int8_t readBenchmarkRecord(void *context, void *key, void *data) {
+    benchmarkReader *reader = (benchmarkReader *)context;
+    if (reader->numRead >= reader->numRecords) {
+        return 0;
+    }
+
+    if (SEQUENTIAL_DATA) {
+        int32_t value = reader->numRead % 100;
+        memcpy(key, &reader->numRead, sizeof(int32_t));
+        memset(data, 0, reader->recordSize - sizeof(int32_t));
+        memcpy(data, &value, sizeof(int32_t));
+    } else {
+        /* Move to the next page of the data set when this one is used up */
+        while (reader->pageRecord >= reader->pageCount) {
+            if (0 == fread(reader->pageBuffer, reader->pageSize, 1, reader->infile))
+                return 0;
+            reader->pageCount = *((int16_t *)(reader->pageBuffer + 4));
+            reader->pageRecord = 0;
+        }
+        char *record = reader->pageBuffer + 16 + reader->pageRecord * reader->recordSize;
+        memcpy(key, record, sizeof(int32_t));
+        memcpy(data, record + sizeof(int32_t), reader->recordSize - sizeof(int32_t));
+        reader->pageRecord++;
+    }
+    reader->numRead++;
+    return 1;
+}
+
 /**
  * Runs all tests and collects benchmarks
  */
@@ -268,7 +314,16 @@ int runalltests_embedDB() {
         /* Insert records into structure */
         start = clock();
 
-        if (SEQUENTIAL_DATA) {
+        if (BULK_LOAD) {
+            benchmarkReader reader = {infile, infileBuffer, 0, 0, 0, numRecords, state->pageSize, state->recordSize};
+            if (!SEQUENTIAL_DATA)
+                fseek(infile, 0, SEEK_SET);
+            if (embedDBBulkLoad(state, readBenchmarkRecord, &reader) != 0)
+                printf("ERROR: Bulk load stopped after %ld records\n", reader.numRead);
+            numRecords = reader.numRead;
+            if (!SEQUENTIAL_DATA)
+                embedDBGetLatest(state, &maxRange, recordBuffer);
+        } else if (SEQUENTIAL_DATA) {
             for (i = 0; i < numRecords; i++) {
                 // printf("Inserting record %lu\n", i);
                 memcpy(recordBuffer, &i, sizeof(int32_t));
@@ -3,6 +3,8 @@
 /**
  * 0 - 2 are for benchmarks
  * 3 is for the example program
+ * 4 is the record-level consistency group commit benchmark
+ * 5 is the page id width benchmark (build with and without EMBEDDB_64BIT_PAGE_IDS)
  *
  */
 #ifndef WHICH_PROGRAM
@@ -17,6 +19,10 @@
 #include "benchmarks/variableDataBenchmark.h"
 #elif WHICH_PROGRAM == 3
 #include "benchmarks/queryInterfaceBenchmark.h"
+#elif WHICH_PROGRAM == 4
+#include "benchmarks/recordLevelConsistencyBenchmark.h"
+#elif WHICH_PROGRAM == 5
+#include "benchmarks/pageIdBenchmark.h"
 #endif
 
 int main() {
@@ -28,6 +34,10 @@ int main() {
     return test_vardata();
 #elif WHICH_PROGRAM == 3
     return advancedQueryExample();
+#elif WHICH_PROGRAM == 4
+    return rlcGroupCommitBenchmark();
+#elif WHICH_PROGRAM == 5
+    return pageIdBenchmark();
 #endif
 }
 
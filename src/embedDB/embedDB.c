@@ -48,6 +48,39 @@
 #include "serial_c_iface.h"
 #endif
 
+/* Pointers and configuration saved to the superblock ring at each flush
+   (EMBEDDB_USE_SUPERBLOCK). The check covers every field before it. */
+typedef struct {
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t layoutFlags;
+  uint32_t numDataPages;
+  uint32_t numIndexPages;
+  uint32_t numVarPages;
+  uint32_t pageSize;
+  count_t  eraseSizeInPages;
+  uint16_t keySize;
+  uint16_t dataSize;
+  int8_t   bitmapSize;
+  pgid_t   nextDataPageId;
+  pgid_t   minDataPageId;
+  pgid_t   nextIdxPageId;
+  pgid_t   minIndexPageId;
+  pgid_t   nextVarPageId;
+  uint32_t numAvailVarPages;
+  uint64_t minVarRecordId;
+  int32_t  maxError;
+  uint16_t check;
+} embedDBSuperblock;
+
+/* Position of a byte by byte read of variable data, used to read the
+   stored lengths and contents of compressed blocks */
+typedef struct {
+  embedDBState *state;
+  varaddr_t     fileOffset; /* File offset of the next byte to read */
+  pgid_t        pageNum;    /* Page the reader loaded into the var read buffer */
+} varByteReader;
+
 /* Helper Functions */
 static int8_t   embedDBInitData(embedDBState *state);
 static int8_t   embedDBInitDataFromFile(embedDBState *state);
@@ -56,15 +89,49 @@ static int8_t   embedDBInitIndex(embedDBState *state);
 static int8_t   embedDBInitIndexFromFile(embedDBState *state);
 static int8_t   embedDBInitVarData(embedDBState *state);
 static int8_t   embedDBInitVarDataFromFile(embedDBState *state);
+static int8_t   resumeDataFile(embedDBState *state, pgid_t maxLogicalPageId);
+static void     resumeIndexFile(embedDBState *state, pgid_t maxLogicalIndexPageId);
+static int8_t   embedDBInitSuperblock(embedDBState *state);
+static int8_t   readSuperblock(embedDBState *state, void *buffer);
+static int8_t   initDataFromSuperblock(embedDBState *state);
+static int8_t   initIndexFromSuperblock(embedDBState *state);
+static int8_t   initVarDataFromSuperblock(embedDBState *state);
+static int8_t   writeSuperblock(embedDBState *state);
+static int8_t   flushBuffers(embedDBState *state);
+static uint16_t crc16(uint16_t crc, void *bytes, uint16_t length);
 static int8_t   shiftRecordLevelConsistencyBlocks(embedDBState *state);
-static void     embedDBInitSplineFromFile(embedDBState *state);
+static pgid_t   prepareDataPage(embedDBState *state, void *buffer);
+static int8_t   recoverTemporaryPage(embedDBState *state, pgid_t maxLogicalPageId, bool hasPermanentData);
+static int8_t   writeDataBatch(embedDBState *state);
+static int8_t   batchDataPage(embedDBState *state, void *buffer, pgid_t pageNum);
+static int8_t   recoverRecordLog(embedDBState *state, pgid_t pageId);
+static int8_t   appendRecordLog(embedDBState *state);
+static int8_t   advanceRecordLog(embedDBState *state);
+static uint16_t recordLogCheck(pgid_t pageId, count_t index, void *record, uint16_t length);
+static void     summarizeBulkRecords(embedDBState *state, count_t from, count_t to);
+static void     embedDBInitPageIndexFromFile(embedDBState *state);
 static int32_t  getMaxError(embedDBState *state, void *buffer);
 static void     updateMaxiumError(embedDBState *state, void *buffer);
 static int8_t   embedDBSetupVarDataStream(embedDBState *state, void *key,
 					  embedDBVarDataStream **varData, pgid_t recordNumber);
-static uint32_t cleanSpline(embedDBState *state, uint32_t minPageNumber);
+static int8_t   fillVarDataStream(embedDBState *state, void *key,
+				  embedDBVarDataStream *stream, pgid_t recordNumber);
+static uint32_t cleanSpline(embedDBState *state, pgid_t minPageNumber);
 static void     readToWriteBuf(embedDBState *state);
 static void     readToWriteBufVar(embedDBState *state);
+static int8_t   readVarStreamPage(embedDBState *state, pgid_t pageNum);
+static void     appendVarData(embedDBState *state, void *key, void *variableData, uint32_t length);
+static void     appendCompressedVarData(embedDBState *state, void *key, void *variableData, uint32_t length);
+static varaddr_t varDataOffsetAdd(embedDBState *state, varaddr_t fileOffset, uint32_t numBytes);
+static uint32_t readCompressedVarStream(embedDBState *state, embedDBVarDataStream *stream,
+					uint8_t *buffer, uint32_t length);
+static int32_t  readVarStreamDirect(embedDBState *state, embedDBVarDataStream *stream,
+				    int8_t *buffer, uint32_t amtRead, uint32_t length);
+static int8_t   flushVarSharingSlot(embedDBState *state);
+static int8_t   readVarPageAhead(embedDBState *state, pgid_t pageNum, void *buf);
+static int8_t   openVarData(embedDBState *state, varaddr_t varDataAddr, embedDBVarDataStream *stream);
+static bool     varPageStored(embedDBState *state, pgid_t pageId);
+static bool     readVarByte(void *source, uint8_t *byte);
 
 static void
 printBitmap(char *bm)
@@ -96,7 +163,7 @@ initBufferPage(embedDBState * state,
 	       int            pageNum)
 {
   /* Initialize page */
-  uint16_t i = 0;
+  uint32_t i = 0;
   void *buf = (char *)state->buffer + pageNum * state->pageSize;
   
   for (i = 0; i < state->pageSize; i++) {
@@ -118,6 +185,13 @@ initBufferPage(embedDBState * state,
     for (i = 0; i < state->dataSize; i++) {
       ((int8_t *)min)[i] = 1;
     }
+    
+    /* The min initialization may overlap a short header, so clear the
+       page model to mark the page as not fitted */
+    if (pageNum == EMBEDDB_DATA_WRITE_BUFFER &&
+	EMBEDDB_USING_PAGE_MODEL(state->parameters)) {
+      memset(EMBEDDB_GET_PAGE_MODEL(buf, state), 0, EMBEDDB_PAGE_MODEL_SIZE);
+    }
   }
 }
 
@@ -142,7 +216,7 @@ static void *
 embedDBGetMaxKey(embedDBState * state,
 		 void *         buffer)
 {
-  int16_t count = EMBEDDB_GET_COUNT(buffer);
+  count_t count = EMBEDDB_GET_COUNT(buffer);
   return (void *)((int8_t *)buffer + state->headerSize + (count - 1) * state->recordSize);
 }
 
@@ -177,38 +251,112 @@ embedDBInit(embedDBState * state,
     return -1;
   }
   
-  state->recordSize = state->keySize + state->dataSize;
+  if (EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters)) {
+    if (!EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) ||
+	(state->rlcCommitIntervalMs > 0 && state->getTimeMs == NULL)) {
+      EDB_PERRF("ERROR: Group commit requires record-level consistency "
+		"and a getTimeMs clock when rlcCommitIntervalMs is set.\n");
+      return -1;
+    }
+    state->rlcPendingRecords = 0;
+    state->rlcLastCommitMs = state->rlcCommitIntervalMs > 0 ? state->getTimeMs() : 0;
+  }
+  
+  /* Record-level consistency already keeps the tail page durable */
+  if (EMBEDDB_RESUMING_TAIL_PAGE(state->parameters) &&
+      EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+    EDB_PERRF("ERROR: Resuming the tail page cannot be used with "
+	      "record-level consistency.\n");
+    return -1;
+  }
+  state->dataTailWritten = 0;
+  state->indexTailWritten = 0;
+  state->superblockSequence = 0;
+  
+  /* Reopening from the superblock does not handle the record-level consistency blocks */
+  if (EMBEDDB_USING_SUPERBLOCK(state->parameters) &&
+      (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) ||
+       state->pageSize < sizeof(embedDBSuperblock))) {
+    EDB_PERRF("ERROR: The superblock cannot be used with record-level "
+	      "consistency and needs a page of at least %u bytes.\n",
+	      (unsigned int)sizeof(embedDBSuperblock));
+    return -1;
+  }
+  
+  /* Sizes are summed in 32 bits and checked against the page below, since
+     wide keys and data could overflow the 16-bit fields */
+  uint32_t recordSize = (uint32_t)state->keySize + state->dataSize;
   if (EMBEDDB_USING_VDATA(state->parameters)) {
     if (state->numVarPages % state->eraseSizeInPages != 0) {
       EDB_PERRF("ERROR: The number of allocated variable data pages must "
 		"be divisible by the erase size in pages.\n");
       return -1;
     }
-    state->recordSize += 4;
+#if !defined(EMBEDDB_64BIT_PAGE_IDS)
+    /* Records hold 4-byte offsets into the variable data file */
+    if ((uint64_t)state->numVarPages * state->pageSize > UINT32_MAX) {
+      EDB_PERRF("ERROR: The variable data file must be smaller than 4 GB.\n");
+      return -1;
+    }
+#endif
+    recordSize += sizeof(varaddr_t);
+  }
+  
+  if (EMBEDDB_USING_VAR_STREAM_POOL(state->parameters)) {
+    if (!EMBEDDB_USING_VDATA(state->parameters) || state->varStreamPool == NULL ||
+	state->varStreamPoolSize == 0 || state->varStreamPoolSize > 32) {
+      EDB_PERRF("ERROR: The variable data stream pool needs variable data "
+		"and between 1 and 32 pre-allocated streams.\n");
+      return -1;
+    }
+    state->varStreamPoolInUse = 0;
   }
   
   state->indexMaxError = indexMaxError;
   
   /* Calculate block header size */
   
-  /* Header size depends on bitmap size: 6 + X bytes: 4 byte id, 2 for record count, X for bitmap. */
-  state->headerSize = 6;
+  /* Header size depends on bitmap size: page id, 2 for record count, X for bitmap. */
+  uint32_t headerSize = EMBEDDB_BITMAP_OFFSET;
   if (EMBEDDB_USING_INDEX(state->parameters)) {
     if (state->numIndexPages % state->eraseSizeInPages != 0) {
       EDB_PERRF("ERROR: The number of allocated index pages must be "
 		"divisible by the erase size in pages.\n");
       return -1;
     }
-    state->headerSize += state->bitmapSize;
+    headerSize += state->bitmapSize;
   }
   
+  /* Max/min values are stored from EMBEDDB_MIN_OFFSET, past the space
+     for the largest bitmap, so records must start after them */
   if (EMBEDDB_USING_MAX_MIN(state->parameters))
-    state->headerSize += state->keySize * 2 + state->dataSize * 2;
+    headerSize = max(headerSize, EMBEDDB_MIN_OFFSET) +
+      (uint32_t)state->keySize * 2 + (uint32_t)state->dataSize * 2;
+  
+  /* The page model goes after every other header field */
+  if (EMBEDDB_USING_PAGE_MODEL(state->parameters)) {
+    headerSize += EMBEDDB_PAGE_MODEL_SIZE;
+  }
   
   /* Flags to show that these values have not been initalized with actual data yet */
   state->bufferedPageId = -1;
   state->bufferedIndexPageId = -1;
   state->bufferedVarPage = -1;
+  state->searchAnchorPageId = -1;
+  
+  if (state->pageSize > EMBEDDB_MAX_PAGE_SIZE || recordSize > UINT16_MAX || headerSize > UINT16_MAX ||
+      state->pageSize < headerSize + recordSize) {
+    EDB_PERRF("ERROR: The page size must be at most 64 KB and hold the header and a record.\n");
+    return -1;
+  }
+  state->recordSize = (uint16_t)recordSize;
+  state->headerSize = (uint16_t)headerSize;
+  
+  /* Record numbers on a page must fit in a count_t, leaving the largest one for iterators */
+  if ((state->pageSize - state->headerSize) / state->recordSize >= EMBEDDB_ITERATOR_PAGE_START) {
+    EDB_PERRF("ERROR: Too many records fit in a page. Use a smaller page size.\n");
+    return -1;
+  }
   
   /* Calculate number of records per page */
   state->maxRecordsPerPage = (state->pageSize - state->headerSize) / state->recordSize;
@@ -216,6 +364,20 @@ embedDBInit(embedDBState * state,
   /* Initialize max error to maximum records per page */
   state->maxError = state->maxRecordsPerPage;
   
+  /* A data page worth of log entries must fit in one erase block so the
+     log never erases entries it still needs */
+  if (EMBEDDB_USING_RLC_APPEND_LOG(state->parameters)) {
+    count_t entriesPerLogPage = (state->pageSize - EMBEDDB_RLC_LOG_HEADER_SIZE) /
+      (state->recordSize + EMBEDDB_RLC_LOG_CHECK_SIZE);
+    if (!EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) ||
+	state->fileInterface->writeBytes == NULL || entriesPerLogPage == 0 ||
+	(state->maxRecordsPerPage + entriesPerLogPage - 1) / entriesPerLogPage > state->eraseSizeInPages) {
+      EDB_PERRF("ERROR: The record log requires record-level consistency, a file "
+		"interface with writeBytes and an erase block that holds a data page of log entries.\n");
+      return -1;
+    }
+  }
+  
   /* Allocate first page of buffer as output page */
   initBufferPage(state, 0);
   
@@ -241,6 +403,103 @@ embedDBInit(embedDBState * state,
     }
   }
 
+  /* Initialize the fence index if being used */
+  if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    if (EDB_WITH_HEAP) {
+      state->fence = malloc(sizeof(fenceIndex));
+      if (state->fence == NULL ||
+	  fenceIndexInit(state->fence, state->numDataPages, state->keySize) != 0) {
+	EDB_PERRF("ERROR: Unable to allocate fence index.\n");
+	free(state->fence);
+	state->fence = NULL;
+	return -1;
+      }
+    }
+    else {
+      EDB_PERRF("ERROR: EDB_NO_HEAP: dynamically-allocated fence index not available.");
+      return -1;
+    }
+  }
+
+  /* Allocate the reorder buffer if being used */
+  if (EMBEDDB_USING_REORDER_BUFFER(state->parameters)) {
+    if (state->reorderWindow == 0 || EMBEDDB_USING_VDATA(state->parameters)) {
+      EDB_PERRF("ERROR: The reorder buffer needs a reorderWindow of at least "
+		"one record and cannot be used with variable data.\n");
+      return -1;
+    }
+    state->reorderBuffer = NULL;
+    if (EDB_WITH_HEAP) {
+      state->reorderBuffer = malloc((size_t)state->reorderWindow * state->recordSize);
+    }
+    if (state->reorderBuffer == NULL) {
+      EDB_PERRF("ERROR: Unable to allocate reorder buffer.\n");
+      return -1;
+    }
+    state->reorderCount = 0;
+  }
+  
+  /* Allocate the write batch if being used */
+  if (EMBEDDB_BATCHING_WRITES(state->parameters)) {
+    if (state->writeBatchPages == 0 || state->eraseSizeInPages % state->writeBatchPages != 0 ||
+	EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+      EDB_PERRF("ERROR: writeBatchPages must divide eraseSizeInPages, and write "
+		"batching cannot be used with record-level consistency.\n");
+      return -1;
+    }
+    state->writeBatch = NULL;
+    if (EDB_WITH_HEAP) {
+      state->writeBatch = malloc((size_t)state->writeBatchPages * state->pageSize);
+    }
+    if (state->writeBatch == NULL) {
+      EDB_PERRF("ERROR: Unable to allocate write batch.\n");
+      return -1;
+    }
+    state->writeBatchCount = 0;
+  }
+  
+  /* Allocate the variable data read-ahead window if being used */
+  if (EMBEDDB_USING_VAR_READ_AHEAD(state->parameters)) {
+    if (state->varReadAheadPages < 2 || !EMBEDDB_USING_VDATA(state->parameters)) {
+      EDB_PERRF("ERROR: The variable data read-ahead window needs variable data "
+		"and a varReadAheadPages of at least 2.\n");
+      return -1;
+    }
+    state->varReadAhead = NULL;
+    if (EDB_WITH_HEAP) {
+      state->varReadAhead = malloc((size_t)state->varReadAheadPages * state->pageSize);
+    }
+    if (state->varReadAhead == NULL) {
+      EDB_PERRF("ERROR: Unable to allocate variable data read-ahead window.\n");
+      return -1;
+    }
+    state->varReadAheadStart = 0;
+    state->varReadAheadCount = 0;
+    state->varReadAheadNext = -1;
+  }
+  
+  /* Allocate the variable data dedup table if being used */
+  if (EMBEDDB_DEDUPING_VDATA(state->parameters)) {
+    if (state->varDedupSlots == 0 || !EMBEDDB_USING_VDATA(state->parameters)) {
+      EDB_PERRF("ERROR: Variable data dedup needs variable data and at least "
+		"one varDedupSlots entry.\n");
+      return -1;
+    }
+    state->varDedupTable = NULL;
+    if (EDB_WITH_HEAP) {
+      state->varDedupTable = calloc(state->varDedupSlots, sizeof(embedDBVarDedupEntry));
+    }
+    if (state->varDedupTable == NULL) {
+      EDB_PERRF("ERROR: Unable to allocate variable data dedup table.\n");
+      return -1;
+    }
+  }
+  
+  /* Read the newest superblock before the files it describes */
+  if (EMBEDDB_USING_SUPERBLOCK(state->parameters) && embedDBInitSuperblock(state) != 0) {
+    return -1;
+  }
+  
   /* Allocate file for data*/
   int8_t dataInitResult = 0;
   dataInitResult = embedDBInitData(state);
@@ -274,8 +533,15 @@ embedDBInit(embedDBState * state,
       EDB_PERRF("ERROR: embedDB using variable records requires at least "
 		"4 page buffers if there is no index and 6 if there is.\n");
       return -1;
+    } else if (EMBEDDB_COMPRESSING_VDATA(state->parameters) &&
+	       state->bufferSizeInBlocks < EMBEDDB_VAR_CODEC_BUFFER(state->parameters) + 1) {
+      EDB_PERRF("ERROR: Compressing variable records requires one more page "
+		"buffer for the codec.\n");
+      return -1;
     } else {
+      state->varCodecBlock = EMBEDDB_NO_VAR_DATA;
       varDataInitResult = embedDBInitVarData(state);
+      state->varDedupStartPageId = state->nextVarPageId;
     }
     return varDataInitResult;
   } else {
@@ -304,6 +570,9 @@ embedDBInitData(embedDBState *state)
     state->numAvailDataPages -= (state->eraseSizeInPages * 2);
     state->nextRLCPhysicalPageLocation = state->eraseSizeInPages;
     state->rlcPhysicalStartingPage = state->eraseSizeInPages;
+    state->rlcLogPageId = 0;
+    state->rlcLoggedCount = 0;
+    state->rlcLogSlot = 0;
   }
   
   /* Setup data file. */
@@ -313,6 +582,8 @@ embedDBInitData(embedDBState *state)
     if (openStatus) {
       if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
 	return embedDBInitDataFromFileWithRecordLevelConsistency(state);
+      } else if (state->superblockSequence > 0 && initDataFromSuperblock(state) == 0) {
+	return 0;
       } else {
 	return embedDBInitDataFromFile(state);
       }
@@ -326,6 +597,15 @@ embedDBInitData(embedDBState *state)
     return -1;
   }
   
+  /* Log entries are only written to erased pages */
+  if (EMBEDDB_USING_RLC_APPEND_LOG(state->parameters) &&
+      !state->fileInterface->erase(state->rlcPhysicalStartingPage,
+				   state->rlcPhysicalStartingPage + state->eraseSizeInPages,
+				   state->pageSize, state->dataFile)) {
+    EDB_PERRF("Error: Unable to erase the record log!\n");
+    return -1;
+  }
+  
   return 0;
 }
 
@@ -348,7 +628,7 @@ embedDBInitDataFromFile(embedDBState *state)
      so has junk data and we actually need to start from the second
      page */
   uint32_t i = 0;
-  int8_t numRecords = 0;
+  count_t numRecords = 0;
   while (moreToRead && i < 2) {
     memcpy(&logicalPageId, buffer, sizeof(pgid_t));
     validData = logicalPageId % state->numDataPages == count;
@@ -422,13 +702,45 @@ embedDBInitDataFromFile(embedDBState *state)
   state->nextDataPageId = maxLogicalPageId + 1;
   readPage(state, physicalPageIDOfSmallestData);
   memcpy(&(state->minDataPageId), buffer, sizeof(pgid_t));
+  return resumeDataFile(state, maxLogicalPageId);
+}
+
+/**
+ * @brief	Finishes opening a data file once nextDataPageId and
+ *          minDataPageId are known. Resumes a partial last page, puts
+ *          the largest key back into the read buffer and rebuilds the
+ *          page index.
+ * @param	state	embedDB algorithm state structure
+ * @param	maxLogicalPageId	Id of the last data page on storage
+ * @return	0 if success, -1 if error.
+ */
+static int8_t
+resumeDataFile(embedDBState *state,
+	       pgid_t        maxLogicalPageId)
+{
+  void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
   state->numAvailDataPages = state->numDataPages + state->minDataPageId - maxLogicalPageId - 1;
   
+  /* A partial last page was written by a flush, so keep filling it */
+  if (EMBEDDB_RESUMING_TAIL_PAGE(state->parameters)) {
+    readPage(state, maxLogicalPageId % state->numDataPages);
+    if (EMBEDDB_GET_COUNT(buffer) < state->maxRecordsPerPage) {
+      void *writeBuffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_WRITE_BUFFER;
+      memcpy(writeBuffer, buffer, state->pageSize);
+      if (EMBEDDB_USING_PAGE_MODEL(state->parameters))
+	memset(EMBEDDB_GET_PAGE_MODEL(writeBuffer, state), 0, EMBEDDB_PAGE_MODEL_SIZE);
+      state->nextDataPageId = maxLogicalPageId;
+      state->dataTailWritten = 1;
+    }
+  }
+  
   /* Put largest key back into the buffer */
-  readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
+  if (state->nextDataPageId > state->minDataPageId)
+    readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
   
-  if (EMBEDDB_USING_SPLINE(state->parameters)) {
-    embedDBInitSplineFromFile(state);
+  if (EMBEDDB_USING_SPLINE(state->parameters) ||
+      EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    embedDBInitPageIndexFromFile(state);
   }
   
   return 0;
@@ -454,7 +766,7 @@ embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state)
    * for record-level consistency.
    */
   uint32_t i = 0;
-  int8_t numRecords = 0;
+  count_t numRecords = 0;
   while (moreToRead && i < 4) {
     memcpy(&logicalPageId, buffer, sizeof(pgid_t));
     validData = logicalPageId % state->numDataPages == count;
@@ -514,13 +826,79 @@ embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state)
   state->rlcPhysicalStartingPage = physicalPageId;
   state->nextRLCPhysicalPageLocation = physicalPageId;
   
-  /* record-level consistency recovery algorithm */
+  if (EMBEDDB_USING_RLC_APPEND_LOG(state->parameters)) {
+    if (recoverRecordLog(state, hasPermanentData ? maxLogicalPageId + 1 : 0) != 0) {
+      return -1;
+    }
+  } else if (recoverTemporaryPage(state, maxLogicalPageId, hasPermanentData) != 0) {
+    return -1;
+  }
+  
+  /* if we don't have any permanent data, we can just return now that
+     the record-level consistency records have been handled */
+  if (!hasPermanentData) {
+    return 0;
+  }
+  
+  /* Now check if we have wrapped after the record level consistency.
+   * The default case is we start at beginning of data file.
+   */
+  pgid_t physicalPageIDOfSmallestData = 0;
+  
+  physicalPageId = (state->rlcPhysicalStartingPage + 2 * blockSize) % state->numDataPages;
+  int8_t readSuccess = readPage(state, physicalPageId);
+  if (readSuccess == 0) {
+    memcpy(&logicalPageId, buffer, sizeof(pgid_t));
+    validData = logicalPageId % state->numDataPages == physicalPageId;
+    
+    /* this means we have wrapped and our start is actually here */
+    if (validData) {
+      physicalPageIDOfSmallestData = physicalPageId;
+    }
+  }
+  
+  state->nextDataPageId = maxLogicalPageId + 1;
+  readPage(state, physicalPageIDOfSmallestData);
+  memcpy(&(state->minDataPageId), buffer, sizeof(pgid_t));
+  state->numAvailDataPages =
+    state->numDataPages + state->minDataPageId - maxLogicalPageId - 1 - (2 * blockSize);
+  
+  /* Put largest key back into the buffer */
+  readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
+  if (EMBEDDB_USING_SPLINE(state->parameters) ||
+      EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    embedDBInitPageIndexFromFile(state);
+  }
+  
+  return 0;
+}
+
+/**
+ * @brief	Finds the newest record-level consistency page for the data
+ *          page after maxLogicalPageId, copies it into the data write
+ *          buffer and erases the record-level consistency blocks that
+ *          are no longer needed.
+ * @param	state				embedDB algorithm state structure
+ * @param	maxLogicalPageId	Largest logical page id on storage
+ * @param	hasPermanentData	If any data page has been written
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+static int8_t
+recoverTemporaryPage(embedDBState * state,
+		     pgid_t         maxLogicalPageId,
+		     bool           hasPermanentData)
+{
+  pgid_t   logicalPageId = 0;
+  pgid_t   physicalPageId = state->rlcPhysicalStartingPage;
+  count_t  blockSize = state->eraseSizeInPages;
+  void *   buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+  
   uint32_t numPagesRead = 0;
   uint32_t numPagesToRead = blockSize * 2;
-  uint32_t rlcMaxLogicialPageNumber = UINT32_MAX;
+  pgid_t   rlcMaxLogicialPageNumber = EDB_PGID_MAX;
   uint32_t rlcMaxRecordCount = UINT32_MAX;
   uint32_t rlcMaxPage = UINT32_MAX;
-  moreToRead = !(readPage(state, physicalPageId));
+  int8_t   moreToRead = !(readPage(state, physicalPageId));
   while (moreToRead && numPagesRead < numPagesToRead) {
     memcpy(&logicalPageId, buffer, sizeof(pgid_t));
     /* If the next logical page number is not the one after the max
@@ -548,7 +926,7 @@ embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state)
   uint32_t eraseStartingPage = 0;
   uint32_t eraseEndingPage = 0;
   uint32_t numBlocksToErase = 0;
-  if (rlcMaxLogicialPageNumber == UINT32_MAX) {
+  if (rlcMaxLogicialPageNumber == EDB_PGID_MAX) {
     eraseStartingPage = state->rlcPhysicalStartingPage % state->numDataPages;
     numBlocksToErase = 2;
   } else {
@@ -576,47 +954,101 @@ embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state)
     }
     eraseStartingPage = eraseEndingPage % state->numDataPages;
   }
-  
-  /* if we don't have any permanent data, we can just return now that
-     the record-level consistency records have been handled */
-  if (!hasPermanentData) {
-    return 0;
+  return 0;
+}
+
+/**
+ * @brief	Rebuilds the data write buffer by replaying the record log for
+ *          a data page, then moves the log to a fresh page.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageId	Logical id of the data page being logged
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+static int8_t
+recoverRecordLog(embedDBState * state,
+		 pgid_t         pageId)
+{
+  count_t  blockSize = state->eraseSizeInPages;
+  uint32_t numLogPages = 2 * blockSize;
+  uint32_t entrySize = state->recordSize + EMBEDDB_RLC_LOG_CHECK_SIZE;
+  count_t  entriesPerLogPage = (state->pageSize - EMBEDDB_RLC_LOG_HEADER_SIZE) / entrySize;
+  int8_t * buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+  int8_t * writeBuf = (int8_t *)state->buffer;
+  count_t  count = 0;
+  uint32_t lastLogPage = 0;
+  
+  /* Each log page holds a run of records. Keep extending the records
+     found from the start of the data page until no log page continues
+     them, stopping each run at its first torn or erased entry. */
+  initBufferPage(state, EMBEDDB_DATA_WRITE_BUFFER);
+  int8_t extended = 1;
+  while (extended) {
+    extended = 0;
+    for (uint32_t i = 0; i < numLogPages; i++) {
+      uint32_t physicalPageId = (state->rlcPhysicalStartingPage + i) % state->numDataPages;
+      if (readPage(state, physicalPageId) != 0) {
+	continue;
+      }
+      pgid_t logPageId = 0;
+      count_t start = 0;
+      uint16_t check = 0;
+      memcpy(&logPageId, buffer, sizeof(pgid_t));
+      memcpy(&start, buffer + sizeof(pgid_t), sizeof(count_t));
+      memcpy(&check, buffer + sizeof(pgid_t) + sizeof(count_t), EMBEDDB_RLC_LOG_CHECK_SIZE);
+      if (logPageId != pageId || check != recordLogCheck(pageId, start, NULL, 0) ||
+	  start > count) {
+	continue;
+      }
+      
+      for (count_t slot = 0; slot < entriesPerLogPage; slot++) {
+	count_t index = start + slot;
+	int8_t *entry = buffer + EMBEDDB_RLC_LOG_HEADER_SIZE + slot * entrySize;
+	memcpy(&check, entry + state->recordSize, EMBEDDB_RLC_LOG_CHECK_SIZE);
+	if (index >= state->maxRecordsPerPage ||
+	    check != recordLogCheck(pageId, index, entry, state->recordSize)) {
+	  break;
+	}
+	if (index == count) {
+	  memcpy(writeBuf + state->headerSize + index * state->recordSize, entry, state->recordSize);
+	  count++;
+	  lastLogPage = i;
+	  extended = 1;
+	}
+      }
+    }
   }
+  /* The read buffer was used for log pages */
+  state->bufferedPageId = -1;
   
-  /* Now check if we have wrapped after the record level consistency.
-   * The default case is we start at beginning of data file.
-   */
-  pgid_t physicalPageIDOfSmallestData = 0;
-  
-  physicalPageId = (state->rlcPhysicalStartingPage + 2 * blockSize) % state->numDataPages;
-  int8_t readSuccess = readPage(state, physicalPageId);
-  if (readSuccess == 0) {
-    memcpy(&logicalPageId, buffer, sizeof(pgid_t));
-    validData = logicalPageId % state->numDataPages == physicalPageId;
-    
-    /* this means we have wrapped and our start is actually here */
-    if (validData) {
-      physicalPageIDOfSmallestData = physicalPageId;
+  state->rlcLogPageId = pageId;
+  state->rlcLoggedCount = count;
+  if (count == 0) {
+    /* Nothing to replay, so start the log again on erased blocks */
+    uint32_t eraseStartingPage = state->rlcPhysicalStartingPage;
+    for (uint32_t i = 0; i < 2; i++) {
+      if (!state->fileInterface->erase(eraseStartingPage, eraseStartingPage + blockSize,
+				       state->pageSize, state->dataFile)) {
+	EDB_PERRF("Error: Unable to erase pages in data file!\n");
+	return -1;
+      }
+      eraseStartingPage = (eraseStartingPage + blockSize) % state->numDataPages;
     }
+    state->nextRLCPhysicalPageLocation = state->rlcPhysicalStartingPage;
+    state->rlcLogSlot = 0;
+    return 0;
   }
   
-  state->nextDataPageId = maxLogicalPageId + 1;
-  readPage(state, physicalPageIDOfSmallestData);
-  memcpy(&(state->minDataPageId), buffer, sizeof(pgid_t));
-  state->numAvailDataPages =
-    state->numDataPages + state->minDataPageId - maxLogicalPageId - 1 - (2 * blockSize);
-  
-  /* Put largest key back into the buffer */
-  readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
-  if (EMBEDDB_USING_SPLINE(state->parameters)) {
-    embedDBInitSplineFromFile(state);
-  }
+  memcpy(writeBuf, &pageId, sizeof(pgid_t));
+  *((count_t *)(writeBuf + EMBEDDB_COUNT_OFFSET)) = count;
+  summarizeBulkRecords(state, 0, count);
   
-  return 0;
+  /* The last log page may end in a torn entry, so continue on the next one */
+  state->nextRLCPhysicalPageLocation = (state->rlcPhysicalStartingPage + lastLogPage) % state->numDataPages;
+  return advanceRecordLog(state);
 }
 
 static void
-embedDBInitSplineFromFile(embedDBState *state)
+embedDBInitPageIndexFromFile(embedDBState *state)
 {
   pgid_t pageNumberToRead = state->minDataPageId;
   void * buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
@@ -624,7 +1056,11 @@ embedDBInitSplineFromFile(embedDBState *state)
   pgid_t numberOfPagesToRead = state->nextDataPageId - state->minDataPageId;
   while (pagesRead < numberOfPagesToRead) {
     readPage(state, pageNumberToRead % state->numDataPages);
-    splineAdd(state->spl, embedDBGetMinKey(state, buffer), pageNumberToRead++);
+    if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+      fenceIndexAdd(state->fence, embedDBGetMinKey(state, buffer), pageNumberToRead++);
+    } else {
+      splineAdd(state->spl, embedDBGetMinKey(state, buffer), pageNumberToRead++);
+    }
     pagesRead++;
   }
 }
@@ -634,15 +1070,15 @@ embedDBInitIndex(embedDBState *state)
 {
   /* Setup index file. */
   
-  /* 4 for id, 2 for count, 2 unused, 4 for minKey (pageId), 4 for maxKey (pageId) */
-  state->maxIdxRecordsPerPage = (state->pageSize - 16) / state->bitmapSize;
+  /* Page id, 2 for count, padding, page id of the first data page, unused page id */
+  state->maxIdxRecordsPerPage = (state->pageSize - EMBEDDB_IDX_HEADER_SIZE) / state->bitmapSize;
   
   /* Allocate third page of buffer as index output page */
   initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
   
   /* Add page id to minimum value spot in page */
   void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
-  pgid_t *ptr = ((pgid_t *)((int8_t *)buf + 8));
+  pgid_t *ptr = ((pgid_t *)((int8_t *)buf + EMBEDDB_IDX_FIRST_PAGE_OFFSET));
   *ptr = state->nextDataPageId;
   
   state->nextIdxPageId = 0;
@@ -667,6 +1103,9 @@ embedDBInitIndex(embedDBState *state)
   if (!EMBEDDB_RESETING_DATA(state->parameters)) {
     int8_t openStatus = state->fileInterface->open(state->indexFile, EMBEDDB_FILE_MODE_R_PLUS_B);
     if (openStatus) {
+      if (state->superblockSequence > 0 && initIndexFromSuperblock(state) == 0) {
+	return 0;
+      }
       return embedDBInitIndexFromFile(state);
     }
   }
@@ -717,9 +1156,37 @@ embedDBInitIndexFromFile(embedDBState *state)
   }
   readIndexPage(state, physicalPageIDOfSmallestData);
   memcpy(&(state->minIndexPageId), buffer, sizeof(pgid_t));
+  resumeIndexFile(state, maxLogicaIndexPageId);
+  return 0;
+}
+
+/**
+ * @brief	Finishes opening an index file once nextIdxPageId and
+ *          minIndexPageId are known, resuming a partial last index page.
+ * @param	state	embedDB algorithm state structure
+ * @param	maxLogicaIndexPageId	Id of the last index page on storage
+ */
+static void
+resumeIndexFile(embedDBState *state,
+		pgid_t        maxLogicaIndexPageId)
+{
+  void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
   state->numAvailIndexPages = state->numIndexPages + state->minIndexPageId - maxLogicaIndexPageId - 1;
   
-  return 0;
+  /* Keep filling a partial last index page if it ends right before the write buffer */
+  if (EMBEDDB_RESUMING_TAIL_PAGE(state->parameters)) {
+    readIndexPage(state, maxLogicaIndexPageId % state->numIndexPages);
+    pgid_t firstDataPageId;
+    memcpy(&firstDataPageId, (int8_t *)buffer + EMBEDDB_IDX_FIRST_PAGE_OFFSET, sizeof(pgid_t));
+    count_t idxCount = EMBEDDB_GET_COUNT(buffer);
+    if (idxCount < state->maxIdxRecordsPerPage &&
+	firstDataPageId + idxCount == state->nextDataPageId) {
+      memcpy((int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_WRITE_BUFFER,
+	     buffer, state->pageSize);
+      state->nextIdxPageId = maxLogicaIndexPageId;
+      state->indexTailWritten = 1;
+    }
+  }
 }
 
 static int8_t
@@ -738,6 +1205,9 @@ embedDBInitVarData(embedDBState *state)
       (state->nextDataPageId > 0 || EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters))) {
     int8_t openResult = state->fileInterface->open(state->varFile, EMBEDDB_FILE_MODE_R_PLUS_B);
     if (openResult) {
+      if (state->superblockSequence > 0 && initVarDataFromSuperblock(state) == 0) {
+	return 0;
+      }
       return embedDBInitVarDataFromFile(state);
     }
   }
@@ -884,6 +1354,7 @@ embedDBInitVarDataFromFile(embedDBState *state)
     state->minVarRecordId = minKey;
   } else {
     /* We lose some records, but know for sure we have all records larger than this*/
+    state->minVarRecordId = 0;
     memcpy(&(state->minVarRecordId), (int8_t *)buffer + sizeof(pgid_t), state->keySize);
     state->minVarRecordId++;
   }
@@ -896,49 +1367,343 @@ embedDBInitVarDataFromFile(embedDBState *state)
 }
 
 /**
- * @brief   Prints the initialization stats of the given embedDB state
- * @param   state   embedDB state structure
+ * @brief	Fills a superblock with the configuration and file pointers of the state.
+ * @param	state		embedDB algorithm state structure
+ * @param	superblock	Superblock to fill
  */
-void
-embedDBPrintInit(embedDBState *state)
+static void
+buildSuperblock(embedDBState *      state,
+		embedDBSuperblock * superblock)
 {
-  EDB_PRINTF("EmbedDB State Initialization Stats:\n");
-  EDB_PRINTF("Buffer size: %" PRId8 "  Page size: %" PRId16 "\n",
-	     state->bufferSizeInBlocks, state->pageSize);
-  EDB_PRINTF("Key size: %" PRId8 " Data size: %" PRId8 " %sRecord size: %" PRId8 "\n",
-	     state->keySize, state->dataSize,
-	     EMBEDDB_USING_VDATA(state->parameters) ? "Variable data pointer size: 4 " : "",
-	     state->recordSize);
-  EDB_PRINTF("Use index: %d  Max/min: %d Sum: %d Bmap: %d\n",
-	     EMBEDDB_USING_INDEX(state->parameters),
-	     EMBEDDB_USING_MAX_MIN(state->parameters),
-	     EMBEDDB_USING_SUM(state->parameters),
-	     EMBEDDB_USING_BMAP(state->parameters));
-  EDB_PRINTF("Header size: %" PRId8 "  Records per page: %" PRId16 "\n",
-	     state->headerSize,
-	     state->maxRecordsPerPage);
+  /* Padding is zeroed so the check is the same when the page is read back */
+  memset(superblock, 0, sizeof(embedDBSuperblock));
+  superblock->magic = EMBEDDB_SUPERBLOCK_MAGIC;
+  superblock->sequence = state->superblockSequence;
+  superblock->layoutFlags = state->parameters & EMBEDDB_SUPERBLOCK_LAYOUT_FLAGS;
+  superblock->numDataPages = state->numDataPages;
+  superblock->numIndexPages = EMBEDDB_USING_INDEX(state->parameters) ? state->numIndexPages : 0;
+  superblock->numVarPages = EMBEDDB_USING_VDATA(state->parameters) ? state->numVarPages : 0;
+  superblock->pageSize = state->pageSize;
+  superblock->eraseSizeInPages = state->eraseSizeInPages;
+  superblock->keySize = state->keySize;
+  superblock->dataSize = state->dataSize;
+  superblock->bitmapSize = EMBEDDB_USING_INDEX(state->parameters) ? state->bitmapSize : 0;
+  superblock->nextDataPageId = state->nextDataPageId;
+  superblock->minDataPageId = state->minDataPageId;
+  superblock->nextIdxPageId = state->nextIdxPageId;
+  superblock->minIndexPageId = state->minIndexPageId;
+  superblock->nextVarPageId = state->nextVarPageId;
+  superblock->numAvailVarPages = state->numAvailVarPages;
+  superblock->minVarRecordId = state->minVarRecordId;
+  superblock->maxError = state->maxError;
 }
 
 /**
- * @brief	Given a state, uses the first and last keys to estimate a slope of keys
+ * @brief	Opens the superblock file and finds the newest valid superblock
+ *          in its ring of two erase blocks. While one block is being
+ *          erased and rewritten, the other still holds a whole superblock.
  * @param	state	embedDB algorithm state structure
- * @param	buffer	Pointer to in-memory buffer holding node
- * @return	Returns slope estimate float
+ * @return	0 if success, -1 if the file could not be opened or the newest
+ *          superblock was written with a different configuration.
  */
-static float
-embedDBCalculateSlope(embedDBState * state,
-		      void *         buffer)
+static int8_t
+embedDBInitSuperblock(embedDBState *state)
 {
-  // simplistic slope calculation where the first two entries are used, should be improved
-  
-  uint32_t slopeX1, slopeX2;
-  slopeX1 = 0;
-  slopeX2 = EMBEDDB_GET_COUNT(buffer) - 1;
+  state->superblockSequence = 0;
+  state->superblockSlot = 0;
+  if (state->superblockFile == NULL) {
+    EDB_PERRF("ERROR: No superblock file provided!\n");
+    return -1;
+  }
   
-  if (state->keySize <= 4) {
-    uint32_t slopeY1 = 0, slopeY2 = 0;
-    
-    // check if both points are the same
+  uint32_t ringPages = 2 * state->eraseSizeInPages;
+  if (!EMBEDDB_RESETING_DATA(state->parameters) &&
+      state->fileInterface->open(state->superblockFile, EMBEDDB_FILE_MODE_R_PLUS_B)) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    embedDBSuperblock superblock, newest;
+    for (uint32_t slot = 0; slot < ringPages; slot++) {
+      if (!state->fileInterface->read(buffer, slot, state->pageSize, state->superblockFile))
+	break;
+      memcpy(&superblock, buffer, sizeof(embedDBSuperblock));
+      if (superblock.magic != EMBEDDB_SUPERBLOCK_MAGIC &&
+	  (superblock.magic == EMBEDDB_SUPERBLOCK_MAGIC_32 || superblock.magic == EMBEDDB_SUPERBLOCK_MAGIC_64)) {
+	EDB_PERRF("ERROR: The superblock was written with a different page id size. "
+		  "Rebuild with the same EMBEDDB_64BIT_PAGE_IDS setting.\n");
+	return -1;
+      }
+      if (superblock.magic != EMBEDDB_SUPERBLOCK_MAGIC ||
+	  superblock.check != crc16(0xFFFF, &superblock, offsetof(embedDBSuperblock, check)))
+	continue;
+      if (state->superblockSequence == 0 || superblock.sequence > state->superblockSequence) {
+	newest = superblock;
+	state->superblockSequence = superblock.sequence;
+	state->superblockSlot = (slot + 1) % ringPages;
+      }
+    }
+    state->bufferedPageId = -1;
+    if (state->superblockSequence == 0)
+      return 0;
+    
+    /* Pages written with another layout would be misread */
+    buildSuperblock(state, &superblock);
+    if (superblock.layoutFlags != newest.layoutFlags || superblock.numDataPages != newest.numDataPages ||
+	superblock.numIndexPages != newest.numIndexPages || superblock.numVarPages != newest.numVarPages ||
+	superblock.pageSize != newest.pageSize || superblock.eraseSizeInPages != newest.eraseSizeInPages ||
+	superblock.keySize != newest.keySize || superblock.dataSize != newest.dataSize ||
+	superblock.bitmapSize != newest.bitmapSize) {
+      EDB_PERRF("ERROR: The superblock was written with a different configuration. "
+		"Use EMBEDDB_RESET_DATA to start over with this one.\n");
+      return -1;
+    }
+    return 0;
+  }
+  
+  if (!state->fileInterface->open(state->superblockFile, EMBEDDB_FILE_MODE_W_PLUS_B) ||
+      !state->fileInterface->erase(0, ringPages, state->pageSize, state->superblockFile)) {
+    EDB_PERRF("Error: Can't open superblock file!\n");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief	Reads the newest superblock found by embedDBInitSuperblock.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Page buffer to read into
+ * @return	0 if success, -1 if error.
+ */
+static int8_t
+readSuperblock(embedDBState *state,
+	       void *        buffer)
+{
+  uint32_t ringPages = 2 * state->eraseSizeInPages;
+  uint32_t slot = (state->superblockSlot + ringPages - 1) % ringPages;
+  if (!state->fileInterface->read(buffer, slot, state->pageSize, state->superblockFile)) {
+    EDB_PERRF("Error: Unable to read the superblock!\n");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief	Opens the data file from the superblock. Only pages written
+ *          after the superblock are read to find the end of the file.
+ * @param	state	embedDB algorithm state structure
+ * @return	0 if success, -1 if the data file must be scanned instead.
+ */
+static int8_t
+initDataFromSuperblock(embedDBState *state)
+{
+  void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+  embedDBSuperblock superblock;
+  if (readSuperblock(state, buffer) != 0)
+    return -1;
+  memcpy(&superblock, buffer, sizeof(embedDBSuperblock));
+  state->bufferedPageId = -1;
+  if (state->maxError < superblock.maxError)
+    state->maxError = superblock.maxError;
+  
+  pgid_t nextPageId = superblock.nextDataPageId;
+  pgid_t minPageId = superblock.minDataPageId;
+  pgid_t logicalPageId = 0;
+  while (nextPageId - minPageId < state->numDataPages &&
+	 readPage(state, nextPageId % state->numDataPages) == 0) {
+    memcpy(&logicalPageId, buffer, sizeof(pgid_t));
+    count_t count = EMBEDDB_GET_COUNT(buffer);
+    if (logicalPageId != nextPageId || count == 0 || count > state->maxRecordsPerPage)
+      break;
+    updateMaxiumError(state, buffer);
+    nextPageId++;
+  }
+  
+  /* The file filled up and may have wrapped since the superblock */
+  if (nextPageId - minPageId >= state->numDataPages)
+    return -1;
+  if (nextPageId == 0)
+    return 0;
+  
+  /* The oldest block was erased since the superblock */
+  if (readPage(state, minPageId % state->numDataPages) != 0)
+    return -1;
+  memcpy(&logicalPageId, buffer, sizeof(pgid_t));
+  if (logicalPageId != minPageId)
+    return -1;
+  
+  state->nextDataPageId = nextPageId;
+  state->minDataPageId = minPageId;
+  return resumeDataFile(state, nextPageId - 1);
+}
+
+/**
+ * @brief	Opens the index file from the superblock. Only pages written
+ *          after the superblock are read to find the end of the file.
+ * @param	state	embedDB algorithm state structure
+ * @return	0 if success, -1 if the index file must be scanned instead.
+ */
+static int8_t
+initIndexFromSuperblock(embedDBState *state)
+{
+  void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
+  embedDBSuperblock superblock;
+  if (readSuperblock(state, buffer) != 0)
+    return -1;
+  memcpy(&superblock, buffer, sizeof(embedDBSuperblock));
+  state->bufferedIndexPageId = -1;
+  
+  pgid_t nextPageId = superblock.nextIdxPageId;
+  pgid_t minPageId = superblock.minIndexPageId;
+  pgid_t logicalPageId = 0;
+  while (nextPageId - minPageId < state->numIndexPages &&
+	 readIndexPage(state, nextPageId % state->numIndexPages) == 0) {
+    memcpy(&logicalPageId, buffer, sizeof(pgid_t));
+    if (logicalPageId != nextPageId)
+      break;
+    nextPageId++;
+  }
+  
+  if (nextPageId - minPageId >= state->numIndexPages)
+    return -1;
+  if (nextPageId == 0)
+    return 0;
+  
+  if (readIndexPage(state, minPageId % state->numIndexPages) != 0)
+    return -1;
+  memcpy(&logicalPageId, buffer, sizeof(pgid_t));
+  if (logicalPageId != minPageId)
+    return -1;
+  
+  state->nextIdxPageId = nextPageId;
+  state->minIndexPageId = minPageId;
+  resumeIndexFile(state, nextPageId - 1);
+  return 0;
+}
+
+/**
+ * @brief	Opens the variable data file from the superblock. Only pages
+ *          written after the superblock are read to find the end of the file.
+ * @param	state	embedDB algorithm state structure
+ * @return	0 if success, -1 if the variable data file must be scanned instead.
+ */
+static int8_t
+initVarDataFromSuperblock(embedDBState *state)
+{
+  void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+  embedDBSuperblock superblock;
+  if (readSuperblock(state, buffer) != 0)
+    return -1;
+  memcpy(&superblock, buffer, sizeof(embedDBSuperblock));
+  state->bufferedVarPage = -1;
+  
+  pgid_t nextPageId = superblock.nextVarPageId;
+  uint32_t numAvailPages = superblock.numAvailVarPages;
+  pgid_t logicalPageId = 0;
+  while (numAvailPages > 0 && readVariablePage(state, nextPageId % state->numVarPages) == 0) {
+    memcpy(&logicalPageId, buffer, sizeof(pgid_t));
+    if (logicalPageId != nextPageId)
+      break;
+    nextPageId++;
+    numAvailPages--;
+  }
+  
+  /* A block erased or overwritten since the superblock no longer holds the oldest page */
+  if (nextPageId > 0) {
+    pgid_t minPageId = nextPageId + numAvailPages - state->numVarPages;
+    if (readVariablePage(state, minPageId % state->numVarPages) != 0)
+      return -1;
+    memcpy(&logicalPageId, buffer, sizeof(pgid_t));
+    if (logicalPageId != minPageId)
+      return -1;
+  }
+  
+  state->nextVarPageId = nextPageId;
+  state->numAvailVarPages = numAvailPages;
+  state->minVarRecordId = superblock.minVarRecordId;
+  state->currentVarLoc = state->nextVarPageId % state->numVarPages * state->pageSize +
+    state->variableDataHeaderSize;
+  return 0;
+}
+
+/**
+ * @brief	Writes the configuration and file pointers to the next page of
+ *          the superblock ring, erasing each block of the ring on entering it.
+ * @param	state	embedDB algorithm state structure
+ * @return	0 if success, -1 if error.
+ */
+static int8_t
+writeSuperblock(embedDBState *state)
+{
+  uint32_t slot = state->superblockSlot;
+  if (slot % state->eraseSizeInPages == 0 &&
+      !state->fileInterface->erase(slot, slot + state->eraseSizeInPages,
+				   state->pageSize, state->superblockFile)) {
+    EDB_PERRF("Error: Unable to erase the superblock ring!\n");
+    return -1;
+  }
+  
+  embedDBSuperblock superblock;
+  buildSuperblock(state, &superblock);
+  superblock.sequence++;
+  superblock.check = crc16(0xFFFF, &superblock, offsetof(embedDBSuperblock, check));
+  
+  void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+  memset(buffer, 0, state->pageSize);
+  memcpy(buffer, &superblock, sizeof(embedDBSuperblock));
+  state->bufferedPageId = -1;
+  if (!state->fileInterface->write(buffer, slot, state->pageSize, state->superblockFile)) {
+    EDB_PERRF("Error: Unable to write the superblock!\n");
+    return -1;
+  }
+  state->fileInterface->flush(state->superblockFile);
+  
+  state->superblockSequence = superblock.sequence;
+  state->superblockSlot = (slot + 1) % (2 * state->eraseSizeInPages);
+  return 0;
+}
+
+/**
+ * @brief   Prints the initialization stats of the given embedDB state
+ * @param   state   embedDB state structure
+ */
+void
+embedDBPrintInit(embedDBState *state)
+{
+  EDB_PRINTF("EmbedDB State Initialization Stats:\n");
+  EDB_PRINTF("Buffer size: %" PRId8 "  Page size: %" PRIu32 "\n",
+	     state->bufferSizeInBlocks, state->pageSize);
+  EDB_PRINTF("Key size: %" PRIu16 " Data size: %" PRIu16 " %sRecord size: %" PRIu16 "\n",
+	     state->keySize, state->dataSize,
+	     EMBEDDB_USING_VDATA(state->parameters) ? "Variable data pointer size: 4 " : "",
+	     state->recordSize);
+  EDB_PRINTF("Use index: %d  Max/min: %d Sum: %d Bmap: %d\n",
+	     EMBEDDB_USING_INDEX(state->parameters),
+	     EMBEDDB_USING_MAX_MIN(state->parameters),
+	     EMBEDDB_USING_SUM(state->parameters),
+	     EMBEDDB_USING_BMAP(state->parameters));
+  EDB_PRINTF("Header size: %" PRIu16 "  Records per page: %" PRIu16 "\n",
+	     state->headerSize,
+	     state->maxRecordsPerPage);
+}
+
+/**
+ * @brief	Given a state, uses the first and last keys to estimate a slope of keys
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to in-memory buffer holding node
+ * @return	Returns slope estimate float
+ */
+static float
+embedDBCalculateSlope(embedDBState * state,
+		      void *         buffer)
+{
+  // simplistic slope calculation where the first two entries are used, should be improved
+  
+  uint32_t slopeX1, slopeX2;
+  slopeX1 = 0;
+  slopeX2 = EMBEDDB_GET_COUNT(buffer) - 1;
+  
+  if (state->keySize <= 4) {
+    uint32_t slopeY1 = 0, slopeY2 = 0;
+    
+    // check if both points are the same
     if (slopeX1 == slopeX2) {
       return 1;
     }
@@ -1012,7 +1777,7 @@ getMaxError(embedDBState * state,
     memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
     
     // get slope of keys within page
-    float slope = embedDBCalculateSlope(state, state->buffer);  // this is incorrect, should be buffer. TODO: fix
+    float slope = embedDBCalculateSlope(state, buffer);
     
     for (int i = 0; i < state->maxRecordsPerPage; i++) {
       // loop all keys in page
@@ -1040,35 +1805,215 @@ getMaxError(embedDBState * state,
   }
 }
 
+/**
+ * @brief	Estimates the position of a key on a page from the page model.
+ *          Uses the same arithmetic when fitting and searching so the
+ *          stored error bounds every estimate.
+ * @param	slope		Records per unit of key
+ * @param	intercept	Position of the smallest key
+ * @param	offset		Key minus the smallest key on the page
+ * @return	Returns the estimated record number
+ */
+static int32_t
+embedDBPageModelEstimate(float    slope,
+			 float    intercept,
+			 uint64_t offset)
+{
+  float estimate = slope * (float)offset + intercept;
+  /* Saturate so keys far past the page do not overflow the conversion */
+  if (!(estimate > 0)) {
+    return 0;
+  }
+  return estimate >= UINT16_MAX ? UINT16_MAX : (int32_t)estimate;
+}
+
+/**
+ * @brief	Fits a least squares line from key to record number over the
+ *          records on a page and stores its slope, intercept and maximum
+ *          error in the page header.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to in-memory buffer holding the page
+ */
+static void
+embedDBFitPageModel(embedDBState * state,
+		    void *         buffer)
+{
+  count_t count = EMBEDDB_GET_COUNT(buffer);
+  float slope = 0, intercept = 0;
+  uint16_t maxError = count;
+  uint64_t minKey = 0, currentKey = 0;
+  memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
+  
+  if (count > 1) {
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (count_t i = 0; i < count; i++) {
+      memcpy(&currentKey, (int8_t *)buffer + state->headerSize + state->recordSize * i, state->keySize);
+      double x = (double)(currentKey - minKey);
+      sumX += x;
+      sumY += i;
+      sumXX += x * x;
+      sumXY += x * i;
+    }
+    double denominator = count * sumXX - sumX * sumX;
+    if (denominator > 0) {
+      slope = (float)((count * sumXY - sumX * sumY) / denominator);
+      intercept = (float)((sumY - slope * sumX) / count);
+    }
+  }
+  
+  if (slope > 0) {
+    int32_t error = 0;
+    for (count_t i = 0; i < count; i++) {
+      memcpy(&currentKey, (int8_t *)buffer + state->headerSize + state->recordSize * i, state->keySize);
+      int32_t estimate = embedDBPageModelEstimate(slope, intercept, currentKey - minKey);
+      int32_t currentError = estimate > i ? estimate - i : i - estimate;
+      if (currentError > error) {
+	error = currentError;
+      }
+    }
+    maxError = (uint16_t)min(error, count);
+  } else {
+    /* Keys do not fit a line (or one record), so search the whole page */
+    slope = 0;
+  }
+  
+  int8_t *model = (int8_t *)EMBEDDB_GET_PAGE_MODEL(buffer, state);
+  memcpy(model, &slope, sizeof(float));
+  memcpy(model + sizeof(float), &intercept, sizeof(float));
+  memcpy(model + 2 * sizeof(float), &maxError, sizeof(uint16_t));
+}
+
 /**
  * @brief	Adds an entry for the current page into the search structure
  * @param	state	embedDB algorithm state structure
  */
 static void
 indexPage(embedDBState * state,
-	  uint32_t       pageNumber)
+	  pgid_t         pageNumber)
 {
   if (EMBEDDB_USING_SPLINE(state->parameters)) {
     splineAdd(state->spl, embedDBGetMinKey(state, state->buffer), pageNumber);
   }
+  else if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    fenceIndexAdd(state->fence, embedDBGetMinKey(state, state->buffer), pageNumber);
+  }
+}
+
+/**
+ * @brief	Adds the page in the data write buffer to the page index and its
+ *          bitmap to the index file, and reinitializes the write buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageNum	Logical page id the page was given
+ */
+static void
+indexFullPage(embedDBState * state,
+	      pgid_t         pageNum)
+{
+  indexPage(state, pageNum);
+  
+  /* Save record in index file */
+  if (state->indexFile != NULL) {
+    void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
+    count_t idxcount = EMBEDDB_GET_COUNT(buf);
+    if (idxcount >= state->maxIdxRecordsPerPage) {
+      /* Save index page */
+      writeIndexPage(state, buf);
+      
+      idxcount = 0;
+      initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
+      
+      /* Add page id to minimum value spot in page */
+      pgid_t *ptr = (pgid_t *)((int8_t *)buf + EMBEDDB_IDX_FIRST_PAGE_OFFSET);
+      *ptr = pageNum;
+    }
+    
+    EMBEDDB_INC_COUNT(buf);
+    
+    /* Copy record onto index page */
+    void *bm = EMBEDDB_GET_BITMAP(state->buffer);
+    memcpy((void *)((int8_t *)buf + EMBEDDB_IDX_HEADER_SIZE + state->bitmapSize * idxcount),
+	   bm, state->bitmapSize);
+  }
+  
+  updateMaxiumError(state, state->buffer);
+  
+  initBufferPage(state, 0);
+}
+
+/**
+ * @brief	Writes the full data write buffer, adds the page to the page
+ *          index and its bitmap to the index file, and reinitializes the
+ *          write buffer.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if the page was not written.
+ */
+static int8_t
+writeFullPage(embedDBState *state)
+{
+  // As the first buffer is the data write buffer, no manipulation is required
+  pgid_t pageNum = writePage(state, state->buffer);
+  indexFullPage(state, pageNum);
+  return pageNum == -1 ? -1 : 0;
+}
+
+/**
+ * @brief	Writes the data write buffer as a record-level consistency page,
+ *          or appends its new records to the record log, and restarts the
+ *          group commit count and interval.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+static int8_t
+commitTemporaryPage(embedDBState *state)
+{
+  int8_t result = EMBEDDB_USING_RLC_APPEND_LOG(state->parameters) ?
+    appendRecordLog(state) : writeTemporaryPage(state, state->buffer);
+  if (result == 0 && EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters)) {
+    state->rlcPendingRecords = 0;
+    if (state->rlcCommitIntervalMs > 0) {
+      state->rlcLastCommitMs = state->getTimeMs();
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief	Counts an inserted record towards the group commit policy.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 1 if the records inserted since the last commit should
+ *          be committed now.
+ */
+static int8_t
+groupCommitDue(embedDBState *state)
+{
+  if (!EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters)) {
+    return 1;
+  }
+  state->rlcPendingRecords++;
+  if (state->rlcCommitRecords > 0 && state->rlcPendingRecords >= state->rlcCommitRecords) {
+    return 1;
+  }
+  return state->rlcCommitIntervalMs > 0 &&
+    state->getTimeMs() - state->rlcLastCommitMs >= state->rlcCommitIntervalMs;
 }
 
 /**
- * @brief	Puts a given key, data pair into structure.
+ * @brief	Appends a key, data pair to the data write buffer, writing the
+ *          buffer out first if it is full.
  * @param	state	embedDB algorithm state structure
  * @param	key		Key for record
  * @param	data	Data for record
  * @return	Return 0 if success. Non-zero value if error.
  */
-int8_t
-embedDBPut(embedDBState * state,
-	   void *         key,
-	   void *         data)
+static int8_t
+appendRecord(embedDBState * state,
+	     void *         key,
+	     void *         data)
 {
   /* Copy record into block */
   
   count_t count = EMBEDDB_GET_COUNT(state->buffer);
-  if (state->nextDataPageId > 0 || count > 0) {
+  if (state->nextDataPageId > state->minDataPageId || count > 0) {
     void *previousKey = NULL;
     if (count == 0) {
       readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
@@ -1086,39 +2031,8 @@ embedDBPut(embedDBState * state,
   /* Write current page if full */
   bool wrotePage = false;
   if (count >= state->maxRecordsPerPage) {
-    // As the first buffer is the data write buffer, no manipulation is required
-    pgid_t pageNum = writePage(state, state->buffer);
-    
-    indexPage(state, pageNum);
-    
-    /* Save record in index file */
-    if (state->indexFile != NULL) {
-      void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
-      count_t idxcount = EMBEDDB_GET_COUNT(buf);
-      if (idxcount >= state->maxIdxRecordsPerPage) {
-	/* Save index page */
-	writeIndexPage(state, buf);
-	
-	idxcount = 0;
-	initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
-	
-	/* Add page id to minimum value spot in page */
-	pgid_t *ptr = (pgid_t *)((int8_t *)buf + 8);
-	*ptr = pageNum;
-      }
-      
-      EMBEDDB_INC_COUNT(buf);
-      
-      /* Copy record onto index page */
-      void *bm = EMBEDDB_GET_BITMAP(state->buffer);
-      memcpy((void *)((int8_t *)buf + EMBEDDB_IDX_HEADER_SIZE + state->bitmapSize * idxcount),
-	     bm, state->bitmapSize);
-    }
-    
-    updateMaxiumError(state, state->buffer);
-    
+    writeFullPage(state);
     count = 0;
-    initBufferPage(state, 0);
     wrotePage = true;
   }
   
@@ -1130,15 +2044,15 @@ embedDBPut(embedDBState * state,
   
   /* Copy variable data offset if using variable data*/
   if (EMBEDDB_USING_VDATA(state->parameters)) {
-    uint32_t dataLocation;
+    varaddr_t dataLocation;
     if (state->recordHasVarData) {
-      dataLocation = state->currentVarLoc % (state->numVarPages * state->pageSize);
+      dataLocation = state->currentVarLoc % EMBEDDB_VAR_FILE_SIZE(state);
     } else {
       dataLocation = EMBEDDB_NO_VAR_DATA;
     }
     memcpy((int8_t *)state->buffer + (state->recordSize * count) +
 	   state->headerSize + state->keySize + state->dataSize,
-	   &dataLocation, sizeof(uint32_t));
+	   &dataLocation, sizeof(varaddr_t));
   }
   
   /* Update count */
@@ -1187,14 +2101,405 @@ embedDBPut(embedDBState * state,
       /* move record-level consistency blocks */
       shiftRecordLevelConsistencyBlocks(state);
     }
-    return writeTemporaryPage(state, state->buffer);
+    if (!groupCommitDue(state)) {
+      return 0;
+    }
+    return commitTemporaryPage(state);
   }
   
   return 0;
 }
 
-static int8_t
-shiftRecordLevelConsistencyBlocks(embedDBState *state)
+/**
+ * @brief	Returns the position of the first record in the reorder buffer
+ *          with a key >= key.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ */
+static count_t
+reorderPosition(embedDBState * state,
+		void *         key)
+{
+  int8_t *window = (int8_t *)state->reorderBuffer;
+  count_t first = 0, last = state->reorderCount;
+  while (first < last) {
+    count_t middle = (first + last) / 2;
+    if (state->compareKey(window + middle * state->recordSize, key) < 0) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+  return first;
+}
+
+/**
+ * @brief	Checks if a key belongs in the reorder buffer. Every key in the
+ *          buffer is larger than every key already in the write buffer or
+ *          on storage.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to check
+ * @return	Return 1 if the key is at or above the smallest key held.
+ */
+static int8_t
+reorderHolds(embedDBState * state,
+	     void *         key)
+{
+  return EMBEDDB_USING_REORDER_BUFFER(state->parameters) &&
+    state->reorderCount > 0 &&
+    state->compareKey(key, state->reorderBuffer) >= 0;
+}
+
+/**
+ * @brief	Finds a record in the reorder buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @return	Pointer to the record, or NULL if it is not held.
+ */
+static void *
+reorderFind(embedDBState * state,
+	    void *         key)
+{
+  if (!reorderHolds(state, key)) {
+    return NULL;
+  }
+  count_t pos = reorderPosition(state, key);
+  int8_t *record = (int8_t *)state->reorderBuffer + pos * state->recordSize;
+  if (pos < state->reorderCount && state->compareKey(record, key) == 0) {
+    return record;
+  }
+  return NULL;
+}
+
+/**
+ * @brief	Returns the largest key that has left the reorder buffer, from
+ *          the write buffer or the last data page.
+ * @param	state	embedDB algorithm state structure
+ * @return	Pointer to the key, or NULL if there is none.
+ */
+static void *
+reorderLastAppendedKey(embedDBState *state)
+{
+  count_t count = EMBEDDB_GET_COUNT(state->buffer);
+  if (count > 0) {
+    return embedDBGetMaxKey(state, state->buffer);
+  }
+  if (state->nextDataPageId == state->minDataPageId) {
+    return NULL;
+  }
+  void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+  if (readPage(state, (state->nextDataPageId - 1) % state->numDataPages) != 0) {
+    return NULL;
+  }
+  return embedDBGetMaxKey(state, buf);
+}
+
+/**
+ * @brief	Adds a record to the reorder buffer. When the buffer is full, its
+ *          smallest record is appended to the data write buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for record
+ * @param	data	Data for record
+ * @return	Return 0 if success. 1 if the key is a duplicate or smaller than
+ *          a key that has already left the buffer. Other non-zero values
+ *          if the record could not be appended.
+ */
+static int8_t
+reorderPut(embedDBState * state,
+	   void *         key,
+	   void *         data)
+{
+  void *lastKey = reorderLastAppendedKey(state);
+  if (lastKey != NULL && state->compareKey(key, lastKey) != 1) {
+    EDB_PERRF("Key arrived after the reorder window passed it. Insert Failed.\n");
+    return 1;
+  }
+  
+  int8_t *window = (int8_t *)state->reorderBuffer;
+  count_t pos = reorderPosition(state, key);
+  if (pos < state->reorderCount &&
+      state->compareKey(window + pos * state->recordSize, key) == 0) {
+    EDB_PERRF("Key is already in the reorder window. Insert Failed.\n");
+    return 1;
+  }
+  
+  if (state->reorderCount >= state->reorderWindow) {
+    /* The smallest record leaves the window to make room */
+    if (pos == 0) {
+      return appendRecord(state, key, data);
+    }
+    int8_t result = appendRecord(state, window, window + state->keySize);
+    if (result != 0) {
+      return result;
+    }
+    pos--;
+    memmove(window, window + state->recordSize, pos * state->recordSize);
+  } else {
+    memmove(window + (pos + 1) * state->recordSize, window + pos * state->recordSize,
+	    (state->reorderCount - pos) * state->recordSize);
+    state->reorderCount++;
+  }
+  
+  memcpy(window + pos * state->recordSize, key, state->keySize);
+  memcpy(window + pos * state->recordSize + state->keySize, data, state->dataSize);
+  return 0;
+}
+
+/**
+ * @brief	Appends every record in the reorder buffer to the data write
+ *          buffer.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if a record could not be
+ *          appended, in which case it and the records after it are kept.
+ */
+static int8_t
+reorderDrain(embedDBState *state)
+{
+  if (!EMBEDDB_USING_REORDER_BUFFER(state->parameters)) {
+    return 0;
+  }
+  
+  int8_t *window = (int8_t *)state->reorderBuffer;
+  for (count_t i = 0; i < state->reorderCount; i++) {
+    int8_t *record = window + i * state->recordSize;
+    int8_t result = appendRecord(state, record, record + state->keySize);
+    if (result != 0) {
+      memmove(window, record, (state->reorderCount - i) * state->recordSize);
+      state->reorderCount -= i;
+      return result;
+    }
+  }
+  state->reorderCount = 0;
+  return 0;
+}
+
+/**
+ * @brief	Puts a given key, data pair into structure. With
+ *          EMBEDDB_USE_REORDER_BUFFER, keys may arrive out of order as
+ *          long as they are larger than every key that has left the
+ *          reorder buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for record
+ * @param	data	Data for record
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t
+embedDBPut(embedDBState * state,
+	   void *         key,
+	   void *         data)
+{
+  if (EMBEDDB_USING_REORDER_BUFFER(state->parameters)) {
+    return reorderPut(state, key, data);
+  }
+  return appendRecord(state, key, data);
+}
+
+/**
+ * @brief	Sets the min/max header fields and bitmap of the data write
+ *          buffer for records that were copied onto it directly.
+ * @param	state	embedDB algorithm state structure
+ * @param	from	First record to add to the header
+ * @param	to		One past the last record to add to the header
+ */
+static void
+summarizeBulkRecords(embedDBState * state,
+		     count_t        from,
+		     count_t        to)
+{
+  int8_t *buf = (int8_t *)state->buffer;
+  char *bm = (char *)EMBEDDB_GET_BITMAP(buf);
+  for (count_t i = from; i < to; i++) {
+    int8_t *key = buf + state->headerSize + i * state->recordSize;
+    int8_t *data = key + state->keySize;
+    
+    if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
+      void *minData = EMBEDDB_GET_MIN_DATA(buf, state);
+      void *maxData = EMBEDDB_GET_MAX_DATA(buf, state);
+      if (i == 0) {
+	memcpy(EMBEDDB_GET_MIN_KEY(buf), key, state->keySize);
+	memcpy(minData, data, state->dataSize);
+	memcpy(maxData, data, state->dataSize);
+      } else {
+	if (state->compareData(data, minData) < 0)
+	  memcpy(minData, data, state->dataSize);
+	if (state->compareData(data, maxData) > 0)
+	  memcpy(maxData, data, state->dataSize);
+      }
+    }
+    
+    if (EMBEDDB_USING_BMAP(state->parameters)) {
+      state->updateBitmap(data, bm);
+    }
+  }
+  
+  if (EMBEDDB_USING_MAX_MIN(state->parameters) && to > from) {
+    memcpy(EMBEDDB_GET_MAX_KEY(buf, state), buf + state->headerSize + (to - 1) * state->recordSize,
+	   state->keySize);
+  }
+}
+
+/**
+ * @brief	Writes pages collected by embedDBBulkLoad with one call.
+ * @param	state		embedDB algorithm state structure
+ * @param	batch		Consecutive pages to write
+ * @param	pageId		Logical page id of the first page
+ * @param	numPages	Number of pages in the batch
+ * @return	Return 0 if success, -1 if error.
+ */
+static int8_t
+writeBulkBatch(embedDBState * state,
+	       void *         batch,
+	       pgid_t         pageId,
+	       uint32_t       numPages)
+{
+  /* Batches end on an erase block boundary, so they never wrap past the end of the file */
+  pgid_t physicalPageNum = pageId % state->numDataPages;
+  if (!state->fileInterface->writePages(batch, physicalPageNum, numPages, state->pageSize,
+					state->dataFile)) {
+    EDB_PERRF("Failed to write data pages: %" PRIu32 " (%" PRIu32 ")\n",
+	      pageId, physicalPageNum);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief	Loads a stream of records in ascending key order. Records are
+ *          read straight onto the data write buffer, and the header,
+ *          bitmap and index entries are built once per page rather than
+ *          once per record. Records are loaded without variable data.
+ * @param	state	embedDB algorithm state structure
+ * @param	reader	Callback that copies the next key and data into the
+ *                  pointers it is given. Returns 1 if it copied a record,
+ *                  0 at the end of the stream and a negative value on error.
+ * @param	context	Passed to every call of reader
+ * @return	Return 0 if success. 1 if a key was not larger than the one
+ *          before it, and -1 if the reader or a page write failed. Records
+ *          before the failing one are kept.
+ */
+int8_t
+embedDBBulkLoad(embedDBState *         state,
+		embedDBBulkLoadReader  reader,
+		void *                 context)
+{
+  /* Held records are older than anything the reader supplies */
+  if (reorderDrain(state) != 0) {
+    return -1;
+  }
+  
+  int8_t *buf = (int8_t *)state->buffer;
+  count_t count = EMBEDDB_GET_COUNT(buf);
+  count_t pageStart = count;
+  
+  /* Largest key loaded so far, used when the write buffer is empty */
+  uint64_t previousKey = 0;
+  bool havePrevious = count > 0;
+  if (count == 0 && state->nextDataPageId > state->minDataPageId) {
+    void *readBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    if (readPage(state, (state->nextDataPageId - 1) % state->numDataPages) != 0) {
+      return -1;
+    }
+    memcpy(&previousKey, embedDBGetMaxKey(state, readBuf), state->keySize);
+    havePrevious = true;
+  }
+  
+  /* Full pages are collected up to the end of each erase block and
+     written with one call when the file interface supports it */
+  void *batch = NULL;
+  pgid_t batchPageId = 0;
+  uint32_t batchCount = 0;
+  if (EDB_WITH_HEAP && state->fileInterface->writePages != NULL &&
+      !EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) &&
+      !EMBEDDB_BATCHING_WRITES(state->parameters)) {
+    batch = malloc((size_t)state->eraseSizeInPages * state->pageSize);
+  }
+  
+  varaddr_t noVarData = EMBEDDB_NO_VAR_DATA;
+  int8_t retval = 0;
+  while (1) {
+    if (count >= state->maxRecordsPerPage) {
+      summarizeBulkRecords(state, pageStart, count);
+      memcpy(&previousKey, embedDBGetMaxKey(state, buf), state->keySize);
+      if (batch != NULL) {
+	pgid_t pageNum = prepareDataPage(state, buf);
+	if (pageNum == -1) {
+	  retval = -1;
+	  break;
+	}
+	if (batchCount == 0) {
+	  batchPageId = pageNum;
+	}
+	memcpy((int8_t *)batch + batchCount++ * state->pageSize, buf, state->pageSize);
+	if (!state->dataTailWritten)
+	  state->numAvailDataPages--;
+	state->dataTailWritten = 0;
+	state->numWrites++;
+	indexFullPage(state, pageNum);
+	
+	if ((pageNum + 1) % state->eraseSizeInPages == 0) {
+	  if (writeBulkBatch(state, batch, batchPageId, batchCount) != 0) {
+	    retval = -1;
+	    break;
+	  }
+	  batchCount = 0;
+	}
+      } else if (writeFullPage(state) != 0) {
+	return -1;
+      }
+      
+      /* Keep the record-level consistency blocks ahead of the data */
+      if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) &&
+	  state->nextDataPageId % state->eraseSizeInPages == 0) {
+	shiftRecordLevelConsistencyBlocks(state);
+      }
+      count = 0;
+      pageStart = 0;
+    }
+    
+    int8_t *record = buf + state->headerSize + count * state->recordSize;
+    int8_t readResult = reader(context, record, record + state->keySize);
+    if (readResult <= 0) {
+      retval = readResult < 0 ? -1 : 0;
+      break;
+    }
+    
+    void *lastKey = count > 0 ? (void *)(record - state->recordSize) : (void *)&previousKey;
+    if (havePrevious && state->compareKey(record, lastKey) != 1) {
+      EDB_PERRF("Keys must be strictly ascending order. Bulk load stopped.\n");
+      retval = 1;
+      break;
+    }
+    havePrevious = true;
+    
+    if (EMBEDDB_USING_VDATA(state->parameters)) {
+      memcpy(record + state->keySize + state->dataSize, &noVarData, sizeof(varaddr_t));
+    }
+    count++;
+    EMBEDDB_GET_COUNT(buf) = count;
+  }
+  
+  if (batch != NULL) {
+    if (batchCount > 0 && writeBulkBatch(state, batch, batchPageId, batchCount) != 0) {
+      retval = -1;
+    }
+    free(batch);
+    if (retval == -1) {
+      return -1;
+    }
+  }
+  
+  summarizeBulkRecords(state, pageStart, count);
+  
+  if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) && count > 0) {
+    if (commitTemporaryPage(state) != 0) {
+      return -1;
+    }
+  }
+  return retval;
+}
+
+static int8_t
+shiftRecordLevelConsistencyBlocks(embedDBState *state)
 {
   /* erase the record-level consistency blocks */
   
@@ -1230,15 +2535,20 @@ shiftRecordLevelConsistencyBlocks(embedDBState *state)
     state->minDataPageId += state->eraseSizeInPages;
     
     /* remove any spline points related to these pages */
-    if (!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
+    if (EMBEDDB_USING_SPLINE(state->parameters) &&
+	!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
       cleanSpline(state, state->minDataPageId);
     }
+    if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+      fenceIndexTrim(state->fence, state->minDataPageId);
+    }
   }
   
   /* shift record-level consistency blocks */
   state->rlcPhysicalStartingPage =
     (state->rlcPhysicalStartingPage + state->eraseSizeInPages) % state->numDataPages;
   state->nextRLCPhysicalPageLocation = state->rlcPhysicalStartingPage;
+  state->rlcLogSlot = 0;
   
   return 0;
 }
@@ -1247,13 +2557,172 @@ static void
 updateMaxiumError(embedDBState * state,
 		  void *         buffer)
 {
-  // Calculate error within the page
-  int32_t maxError = getMaxError(state, buffer);
+  // Calculate error within the page, or use the one stored with the page model
+  int32_t maxError = 0;
+  if (EMBEDDB_USING_PAGE_MODEL(state->parameters)) {
+    uint16_t pageError = 0;
+    memcpy(&pageError, (int8_t *)EMBEDDB_GET_PAGE_MODEL(buffer, state) + 2 * sizeof(float),
+	   sizeof(uint16_t));
+    maxError = pageError;
+  } else {
+    maxError = getMaxError(state, buffer);
+  }
   if (state->maxError < maxError) {
     state->maxError = maxError;
   }
 }
 
+/**
+ * @brief	Copies bytes of variable data into the variable data write buffer,
+ *          writing each page as it fills.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for the record, stored in the header of each new page
+ * @param	variableData	Bytes to copy
+ * @param	length	Number of bytes to copy
+ */
+static void
+appendVarData(embedDBState * state,
+	      void *         key,
+	      void *         variableData,
+	      uint32_t       length)
+{
+  void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+  int amtWritten = 0;
+  while (length > 0) {
+    // Copy data into the buffer. Write the min of the space left in
+    // this page and the remaining length of the data
+    uint32_t amtToWrite = min(state->pageSize - state->currentVarLoc % state->pageSize, length);
+    memcpy((uint8_t *)buf + (state->currentVarLoc % state->pageSize),
+	   (uint8_t *)variableData + amtWritten, amtToWrite);
+    length -= amtToWrite;
+    amtWritten += amtToWrite;
+    state->currentVarLoc += amtToWrite;
+    
+    // If we need to write the buffer to file
+    if (state->currentVarLoc % state->pageSize == 0) {
+      writeVariablePage(state, buf);
+      initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+      
+      // Update the header to include the maximum key value stored on
+      // this page and account for page number
+      memcpy((int8_t *)buf + sizeof(pgid_t), key, state->keySize);
+      state->currentVarLoc += state->variableDataHeaderSize;
+    }
+  }
+}
+
+/**
+ * @brief	Copies variable data into the variable data write buffer as
+ *          blocks of up to EMBEDDB_VAR_BLOCK_SIZE bytes compressed in the
+ *          codec buffer.
+ *          Each block is preceded by its 2 byte stored length. Blocks that
+ *          do not get smaller are copied as they are, so their stored length
+ *          is their full length.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for the record
+ * @param	variableData	Data to compress
+ * @param	length	Length of the data in bytes
+ */
+static void
+appendCompressedVarData(embedDBState * state,
+			void *         key,
+			void *         variableData,
+			uint32_t       length)
+{
+  uint8_t *codecBuf = (uint8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_CODEC_BUFFER(state->parameters);
+  // The codec buffer no longer holds a decompressed block
+  state->varCodecBlock = EMBEDDB_NO_VAR_DATA;
+  
+  uint8_t *block = (uint8_t *)variableData;
+  while (length > 0) {
+    uint16_t blockLength = min(EMBEDDB_VAR_BLOCK_SIZE(state), length);
+    uint16_t storedLength = lzCompress(block, blockLength, codecBuf, blockLength - 1);
+    appendVarData(state, key, storedLength > 0 ? &storedLength : &blockLength, sizeof(uint16_t));
+    if (storedLength > 0) {
+      appendVarData(state, key, codecBuf, storedLength);
+    } else {
+      appendVarData(state, key, block, blockLength);
+    }
+    block += blockLength;
+    length -= blockLength;
+  }
+}
+
+/**
+ * @brief	Returns the FNV-1a hash of variable data, which is never 0.
+ * @param	data	Variable data
+ * @param	length	Length of the data in bytes
+ * @return	Hash of the data
+ */
+static uint32_t
+hashVarData(void *   data,
+	    uint32_t length)
+{
+  uint32_t hash = 2166136261u;
+  for (uint32_t i = 0; i < length; i++) {
+    hash = (hash ^ ((uint8_t *)data)[i]) * 16777619u;
+  }
+  // The low bits of FNV-1a mix poorly, and they pick the table slot
+  hash ^= hash >> 16;
+  return hash == 0 ? 1 : hash;
+}
+
+/**
+ * @brief	Looks for an earlier copy of variable data about to be stored in
+ *          the dedup table. A copy is only used if its bytes match, so a
+ *          hash collision cannot return another record's data, and if it is
+ *          in the newest half of the file. Records pointing at a copy lose
+ *          their data when it is erased, and the entry keeps the newest of
+ *          their keys so eraseVarBlock can move minVarRecordId past them.
+ *          A slot is therefore not given to new data while its copy is
+ *          referenced and stored, and the new data is stored in full.
+ *          Otherwise the slot is given to the new data, which is stored at
+ *          currentVarLoc.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key of the record being inserted
+ * @param	data	Variable data to store
+ * @param	length	Length of the data in bytes
+ * @return	Table entry of the earlier copy, or NULL if there is none
+ */
+static embedDBVarDedupEntry *
+findVarDuplicate(embedDBState * state,
+		 void *         key,
+		 void *         data,
+		 uint32_t       length)
+{
+  uint32_t hash = hashVarData(data, length);
+  embedDBVarDedupEntry *entry = state->varDedupTable + hash % state->varDedupSlots;
+  if (entry->hash == hash && entry->length == length && varPageStored(state, entry->pageId) &&
+      entry->pageId + state->numVarPages / 2 > state->nextVarPageId) {
+    embedDBVarDataStream stream;
+    uint8_t chunk[32];
+    uint32_t offset = 0, amtRead = 0;
+    if (openVarData(state, entry->address, &stream) == 0 && stream.totalBytes == length) {
+      while ((amtRead = embedDBVarDataStreamRead(state, &stream, chunk, sizeof(chunk))) > 0 &&
+	     memcmp(chunk, (uint8_t *)data + offset, amtRead) == 0) {
+	offset += amtRead;
+      }
+    }
+    if (offset == length) {
+      entry->refKey = 0;
+      memcpy(&entry->refKey, key, state->keySize);
+      return entry;
+    }
+  }
+  
+  if (entry->hash != 0 && entry->refKey != 0 && varPageStored(state, entry->pageId)) {
+    return NULL;
+  }
+  
+  // The length is written at the next var location, on the page in the write buffer
+  entry->hash = hash;
+  entry->length = length;
+  entry->address = state->currentVarLoc % EMBEDDB_VAR_FILE_SIZE(state);
+  entry->pageId = state->nextVarPageId;
+  entry->refKey = 0;
+  return NULL;
+}
+
 /**
  * @brief	Puts the given key, data, and variable length data into the structure.
  * @param	state			embedDB algorithm state structure
@@ -1307,14 +2776,27 @@ embedDBPutVar(embedDBState * state,
   }
   
   if (state->minVarRecordId == UINT64_MAX) {
+    state->minVarRecordId = 0;
     memcpy(&state->minVarRecordId, key, state->keySize);
   }
   
   // Update the header to include the maximum key value stored on this page
   memcpy((int8_t *)buf + sizeof(pgid_t), key, state->keySize);
   
+  // Data already stored for a recent record is replaced by its address
+  embedDBVarDedupEntry *duplicate = NULL;
+  if (EMBEDDB_DEDUPING_VDATA(state->parameters) && length > sizeof(varaddr_t) + sizeof(pgid_t)) {
+    duplicate = findVarDuplicate(state, key, variableData, length);
+  }
+  
   // Write the length of the data item into the buffer
-  memcpy((uint8_t *)buf + state->currentVarLoc % state->pageSize, &length, sizeof(uint32_t));
+  uint32_t storedLength = length;
+  if (duplicate != NULL) {
+    storedLength |= EMBEDDB_VAR_REFERENCE;
+  } else if (EMBEDDB_COMPRESSING_VDATA(state->parameters)) {
+    storedLength |= EMBEDDB_VAR_COMPRESSED;
+  }
+  memcpy((uint8_t *)buf + state->currentVarLoc % state->pageSize, &storedLength, sizeof(uint32_t));
   state->currentVarLoc += 4;
   
   // Check if we need to write after doing that
@@ -1327,30 +2809,18 @@ embedDBPutVar(embedDBState * state,
     state->currentVarLoc += state->variableDataHeaderSize;
   }
   
-  int amtWritten = 0;
-  while (length > 0) {
-    // Copy data into the buffer. Write the min of the space left in
-    // this page and the remaining length of the data
-    uint16_t amtToWrite = min(state->pageSize - state->currentVarLoc % state->pageSize, length);
-    memcpy((uint8_t *)buf + (state->currentVarLoc % state->pageSize),
-	   (uint8_t *)variableData + amtWritten, amtToWrite);
-    length -= amtToWrite;
-    amtWritten += amtToWrite;
-    state->currentVarLoc += amtToWrite;
-    
-    // If we need to write the buffer to file
-    if (state->currentVarLoc % state->pageSize == 0) {
-      writeVariablePage(state, buf);
-      initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
-      
-      // Update the header to include the maximum key value stored on
-      // this page and account for page number
-      memcpy((int8_t *)buf + sizeof(pgid_t), key, state->keySize);
-      state->currentVarLoc += state->variableDataHeaderSize;
-    }
+  if (duplicate != NULL) {
+    appendVarData(state, key, &duplicate->address, sizeof(varaddr_t));
+    appendVarData(state, key, &duplicate->pageId, sizeof(pgid_t));
+  } else if (EMBEDDB_COMPRESSING_VDATA(state->parameters)) {
+    appendCompressedVarData(state, key, variableData, length);
+  } else {
+    appendVarData(state, key, variableData, length);
   }
   
-  if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+  /* With group commit, variable data is flushed when the records are committed */
+  if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) &&
+      (!EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters) || state->rlcPendingRecords == 0)) {
     embedDBFlushVar(state);
   }
   
@@ -1363,7 +2833,7 @@ embedDBPutVar(embedDBState * state,
  * @param	buffer	Pointer to in-memory buffer holding node
  * @param	key		Key for record
  */
-static int16_t
+static int32_t
 embedDBEstimateKeyLocation(embedDBState * state,
 			   void *         buffer,
 			   void *          key)
@@ -1379,6 +2849,97 @@ embedDBEstimateKeyLocation(embedDBState * state,
   return (thisKey - minKey) / slope;
 }
 
+/**
+ * @brief	Narrows the records that may hold a key using the page model.
+ *          Only records within the page's max error of the estimate are
+ *          considered, and they are probed outwards from the estimate
+ *          with an exponential search.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to in-memory buffer holding node
+ * @param	key		Key for record
+ * @param	first	Return variable for the first record to binary search
+ * @param	last	Return variable for the last record to binary search
+ * @param	found	Return variable for the record holding the key if the
+ *                  probe found it, or -1
+ * @return	Return 0 if the page has a model. Non-zero value otherwise.
+ */
+static int8_t
+embedDBPageModelBounds(embedDBState * state,
+		       void *         buffer,
+		       void *         key,
+		       int32_t *      first,
+		       int32_t *      last,
+		       int32_t *      found)
+{
+  int8_t *model = (int8_t *)EMBEDDB_GET_PAGE_MODEL(buffer, state);
+  float slope = 0, intercept = 0;
+  uint16_t maxError = 0;
+  memcpy(&slope, model, sizeof(float));
+  if (!(slope > 0)) {
+    return -1;
+  }
+  memcpy(&intercept, model + sizeof(float), sizeof(float));
+  memcpy(&maxError, model + 2 * sizeof(float), sizeof(uint16_t));
+  
+  int32_t count = EMBEDDB_GET_COUNT(buffer);
+  uint64_t minKey = 0, thisKey = 0;
+  memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
+  memcpy(&thisKey, key, state->keySize);
+  
+  /* A key between two records estimates between their estimates, so
+     it is within one record more than the max error */
+  int32_t estimate = 0;
+  if (thisKey > minKey) {
+    estimate = embedDBPageModelEstimate(slope, intercept, thisKey - minKey);
+  }
+  /* A model that does not match the records must not move the search past them */
+  int32_t low = min(max(estimate - maxError - 1, 0), count - 1);
+  int32_t high = min(estimate + maxError + 1, count - 1);
+  if (low > high || low < 0) {
+    return -1;
+  }
+  int32_t probe = max(min(estimate, high), low);
+  
+  *found = -1;
+  void *recordKey = (int8_t *)buffer + state->headerSize + state->recordSize * probe;
+  int8_t compare = state->compareKey(recordKey, key);
+  if (compare == 0) {
+    *found = probe;
+    return 0;
+  }
+  
+  int32_t step = 1;
+  if (compare < 0) {
+    /* Gallop up until a record larger than the key */
+    low = probe + 1;
+    while (probe + step <= high) {
+      recordKey = (int8_t *)buffer + state->headerSize + state->recordSize * (probe + step);
+      if (state->compareKey(recordKey, key) >= 0) {
+	high = probe + step;
+	break;
+      }
+      low = probe + step + 1;
+      step <<= 1;
+    }
+  } else {
+    /* Gallop down until a record smaller than the key */
+    high = probe - 1;
+    while (probe - step >= low) {
+      recordKey = (int8_t *)buffer + state->headerSize + state->recordSize * (probe - step);
+      if (state->compareKey(recordKey, key) <= 0) {
+	low = probe - step;
+	break;
+      }
+      high = probe - step - 1;
+      step <<= 1;
+    }
+  }
+  
+  *first = low;
+  *last = high;
+  return 0;
+}
+
 /**
  * @brief Given a key, searches the node for the key. If interior
  *        node, returns child record number containing next page id to
@@ -1387,9 +2948,9 @@ embedDBEstimateKeyLocation(embedDBState * state,
  * @param	state	embedDB algorithm state structure
  * @param	buffer	Pointer to in-memory buffer holding node
  * @param	key		Key for record 
- * @param range  1 if range query so return pointer to first record <=
- *               key, 0 if exact query so much return first exact
- *               match record
+ * @param range  1 if range query so return pointer to last record <=
+ *               key (-1 if there is none), 0 if exact query so much
+ *               return first exact match record
  */
 static pgid_t
 embedDBSearchNode(embedDBState * state,
@@ -1397,21 +2958,31 @@ embedDBSearchNode(embedDBState * state,
 		  void *         key,
 		  int8_t         range)
 {
-  int16_t first, last, middle, count;
+  int32_t first, last, middle, count;
   int8_t compare;
   void *mkey;
   
   count = EMBEDDB_GET_COUNT(buffer);
-  middle = embedDBEstimateKeyLocation(state, buffer, key);
   
-  // check that maxError was calculated and middle is valid (searches full node otherwise)
-  if (state->maxError == -1 || middle >= count || middle <= 0) {
-    first = 0;
-    last = count - 1;
+  if (EMBEDDB_USING_PAGE_MODEL(state->parameters) &&
+      embedDBPageModelBounds(state, buffer, key, &first, &last, &middle) == 0) {
+    /* The bounded probe may already have found the key */
+    if (middle != -1) {
+      return middle;
+    }
     middle = (first + last) / 2;
   } else {
-    first = 0;
-    last = count - 1;
+    middle = embedDBEstimateKeyLocation(state, buffer, key);
+    
+    // check that maxError was calculated and middle is valid (searches full node otherwise)
+    if (state->maxError == -1 || middle >= count || middle <= 0) {
+      first = 0;
+      last = count - 1;
+      middle = (first + last) / 2;
+    } else {
+      first = 0;
+      last = count - 1;
+    }
   }
   
   if (middle > last) {
@@ -1431,7 +3002,7 @@ embedDBSearchNode(embedDBState * state,
     middle = (first + last) / 2;
   }
   if (range)
-    return middle;
+    return last;
   return -1;
 }
 
@@ -1452,12 +3023,12 @@ static int8_t
 linearSearch(embedDBState *state,
 	     void *buf,
 	     void *key,
-	     int32_t pageId,
-	     int32_t low,
-	     int32_t high)
+	     int64_t pageId,
+	     int64_t low,
+	     int64_t high)
 {
   int32_t pageError = 0;
-  int32_t physPageId;
+  pgid_t physPageId;
   while (1) {
     /* Move logical page number to physical page id based on location of first data page */
     physPageId = pageId % state->numDataPages;
@@ -1494,26 +3065,28 @@ binarySearch(embedDBState * state,
 	     void *         key)
 {
   int8_t retval = -1;
-  uint32_t first = state->minDataPageId, last = state->nextDataPageId - 1;
-  uint32_t pageId = (first + last) / 2;
+  pgid_t first = state->minDataPageId, last = state->nextDataPageId - 1;
+  pgid_t pageId = first + (last - first) / 2;
   while (1) {
     /* Read page into buffer */
     if (readPage(state, pageId % state->numDataPages) != 0) {
       break;
     }
     
-    if (first >= last) {
-      break;
-    }
-    
     if (state->compareKey(key, embedDBGetMinKey(state, buffer)) < 0) {
       /* Key is less than smallest record in block. */
+      if (pageId == first) {
+	break;
+      }
       last = pageId - 1;
-      pageId = (first + last) / 2;
+      pageId = first + (last - first) / 2;
     } else if (state->compareKey(key, embedDBGetMaxKey(state, buffer)) > 0) {
       /* Key is larger than largest record in block. */
+      if (pageId == last) {
+	break;
+      }
       first = pageId + 1;
-      pageId = (first + last) / 2;
+      pageId = first + (last - first) / 2;
     } else {
       /* Found correct block */
       retval = 0;
@@ -1524,13 +3097,151 @@ binarySearch(embedDBState * state,
   return retval;
 }
 
+/**
+ * @brief   Interpolation search over the logical data pages. The page
+ *          holding a key is estimated from the keys at both ends of the
+ *          remaining page range, starting from the smallest key of
+ *          minDataPageId and the smallest key in the write buffer. If an
+ *          estimate does not at least halve the range, the next probe is
+ *          a regular binary search step.
+ * @param   state   embedDB algorithm state structure
+ * @param   buffer  Pointer to the data read buffer
+ * @param   key     Key to search for
+ * @param   pageId  Return variable for the logical id of the first page
+ *                  that may contain a key >= the search key. Equals
+ *                  nextDataPageId if only the write buffer may.
+ * @return  Return 0 if the key is in the range of the page left in the
+ *          read buffer. Non-zero value if it is not on any page.
+ */
+static int8_t
+interpolationSearch(embedDBState * state,
+		    void *         buffer,
+		    void *         key,
+		    pgid_t *       pageId)
+{
+  int64_t first = state->minDataPageId, last = (int64_t)state->nextDataPageId - 1;
+  uint64_t keyVal = 0, loKey = 0, hiKey = 0;
+  int64_t loPage = 0, hiPage = 0, probe = 0;
+  memcpy(&keyVal, key, state->keySize);
+  
+  *pageId = state->minDataPageId;
+  if (first > last) {
+    return -1;
+  }
+  
+  /* The smallest key on minDataPageId only changes when a block is
+     erased, so it is cached rather than read on every search */
+  if (state->searchAnchorPageId != state->minDataPageId) {
+    if (readPage(state, state->minDataPageId % state->numDataPages) != 0) {
+      return -1;
+    }
+    memcpy(&state->searchAnchorKey, embedDBGetMinKey(state, buffer), state->keySize);
+    state->searchAnchorPageId = state->minDataPageId;
+  }
+  loPage = first;
+  loKey = state->searchAnchorKey;
+  if (keyVal < loKey) {
+    return -1;
+  }
+  
+  /* Upper end of the range comes from the write buffer when possible */
+  if (EMBEDDB_GET_COUNT(state->buffer) > 0) {
+    memcpy(&hiKey, embedDBGetMinKey(state, state->buffer), state->keySize);
+    hiPage = state->nextDataPageId;
+    if (keyVal >= hiKey) {
+      *pageId = state->nextDataPageId;
+      return -1;
+    }
+  } else {
+    if (readPage(state, last % state->numDataPages) != 0) {
+      return -1;
+    }
+    memcpy(&hiKey, embedDBGetMaxKey(state, buffer), state->keySize);
+    hiPage = last;
+    if (keyVal > hiKey) {
+      *pageId = state->nextDataPageId;
+      return -1;
+    }
+  }
+  
+  bool binaryStep = false;
+  while (first <= last) {
+    int64_t range = last - first + 1;
+    if (binaryStep || hiKey <= loKey) {
+      probe = first + (last - first) / 2;
+    } else {
+      probe = loPage + (int64_t)((keyVal - loKey) * (long double)(hiPage - loPage) / (long double)(hiKey - loKey));
+    }
+    if (probe < first) {
+      probe = first;
+    } else if (probe > last) {
+      probe = last;
+    }
+    
+    if (readPage(state, probe % state->numDataPages) != 0) {
+      return -1;
+    }
+    
+    if (state->compareKey(key, embedDBGetMinKey(state, buffer)) < 0) {
+      /* Key is less than smallest record in block. */
+      last = probe - 1;
+      hiPage = probe;
+      memcpy(&hiKey, embedDBGetMinKey(state, buffer), state->keySize);
+    } else if (state->compareKey(key, embedDBGetMaxKey(state, buffer)) > 0) {
+      /* Key is larger than largest record in block. */
+      first = probe + 1;
+      loPage = probe;
+      memcpy(&loKey, embedDBGetMaxKey(state, buffer), state->keySize);
+    } else {
+      /* Found correct block */
+      *pageId = probe;
+      return 0;
+    }
+    
+    /* Estimate missed badly, so take a binary step next time */
+    binaryStep = (last - first + 1) > range / 2;
+  }
+  
+  *pageId = first;
+  return -1;
+}
+
+/**
+ * @brief   Looks up the page holding a key in the fence index. Pages that
+ *          the index dropped to stay within its memory budget are searched
+ *          with a binary search instead.
+ * @param   state   embedDB algorithm state structure
+ * @param   buffer  Pointer to the data read buffer
+ * @param   key     Key to search for
+ * @return  Return 0 if the page that may hold the key was read into the
+ *          buffer. Non-zero value if the key is not on any page.
+ */
+static int8_t
+fenceSearch(embedDBState * state,
+	    void *         buffer,
+	    void *         key)
+{
+  pgid_t pageId = 0;
+  if (fenceIndexFind(state->fence, key, &pageId) != 0) {
+    if (fenceIndexFirstPage(state->fence) > state->minDataPageId) {
+      return binarySearch(state, buffer, key);
+    }
+    return -1;
+  }
+  
+  if (pageId < state->minDataPageId || pageId >= state->nextDataPageId) {
+    return -1;
+  }
+  return readPage(state, pageId % state->numDataPages);
+}
+
 static int8_t
 splineSearch(embedDBState * state,
 	     void *         buffer,
 	     void *         key)
 {
   /* Spline search */
-  uint32_t location, lowbound, highbound;
+  pgid_t location, lowbound, highbound;
   splineFind(state->spl, key, state->compareKey, &location, &lowbound, &highbound);
   
   /* If the spline thinks the data is on a page smaller than the
@@ -1543,7 +3254,7 @@ splineSearch(embedDBState * state,
      page we have, we can move the lowbound and location up */
   if (lowbound < state->minDataPageId) {
     lowbound = state->minDataPageId;
-    location = (lowbound + highbound) / 2;
+    location = lowbound + (highbound - lowbound) / 2;
   }
   
   // Check if the currently buffered page is the correct one
@@ -1558,6 +3269,245 @@ splineSearch(embedDBState * state,
   return 0;
 }
 
+/**
+ * @brief	Reads the data page that may hold a key into the read buffer,
+ *          using the page search method selected by the parameters.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to the data read buffer
+ * @param	key		Key to search for
+ * @return	Return 0 if a page was found. Non-zero value if error.
+ */
+static int8_t
+searchDataPages(embedDBState * state,
+		void *         buffer,
+		void *         key)
+{
+  if (EMBEDDB_USING_INTERPOLATION_SEARCH(state->parameters)) {
+    /* Interpolation search with binary fallback */
+    pgid_t pageId = 0;
+    return interpolationSearch(state, buffer, key, &pageId);
+  } else if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    /* Exact page lookup */
+    return fenceSearch(state, buffer, key);
+  } else if (EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+    /* Regular binary search */
+    return binarySearch(state, buffer, key);
+  }
+  /* Spline search */
+  return splineSearch(state, buffer, key);
+}
+
+/**
+ * @brief	Binary search for the last data page in a range whose smallest
+ *          key is <= key. The page found is left in the read buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to the data read buffer
+ * @param	key		Key to search for
+ * @param	first	Logical id of the first page in the range
+ * @param	last	Logical id of the last page in the range
+ * @param	pageId	Return variable for the logical id of the page found
+ * @return	Return 0 if a page was found. Non-zero value if every page in
+ *          the range starts after key or a page could not be read.
+ */
+static int8_t
+floorPageSearch(embedDBState * state,
+		void *         buffer,
+		void *         key,
+		pgid_t         first,
+		pgid_t         last,
+		pgid_t *       pageId)
+{
+  int8_t retval = -1;
+  int64_t low = first, high = last;
+  while (low <= high) {
+    int64_t middle = low + (high - low) / 2;
+    if (readPage(state, middle % state->numDataPages) != 0) {
+      return -1;
+    }
+    if (state->compareKey(embedDBGetMinKey(state, buffer), key) <= 0) {
+      *pageId = middle;
+      retval = 0;
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+  
+  if (retval == 0) {
+    return readPage(state, *pageId % state->numDataPages);
+  }
+  return retval;
+}
+
+/**
+ * @brief	Reads the last data page whose smallest key is <= key into the
+ *          read buffer, using the page search method selected by the
+ *          parameters.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to the data read buffer
+ * @param	key		Key to search for
+ * @param	pageId	Return variable for the logical id of the page found
+ * @return	Return 0 if a page was found. Non-zero value if key is below
+ *          every stored page or a page could not be read.
+ */
+static int8_t
+floorPageFind(embedDBState * state,
+	      void *         buffer,
+	      void *         key,
+	      pgid_t *       pageId)
+{
+  if (state->nextDataPageId == state->minDataPageId) {
+    return -1;
+  }
+  pgid_t lastPage = state->nextDataPageId - 1;
+  
+  if (EMBEDDB_USING_INTERPOLATION_SEARCH(state->parameters)) {
+    /* Either the page holding key, or the page after the floor page */
+    pgid_t nextPage = state->minDataPageId;
+    if (interpolationSearch(state, buffer, key, &nextPage) == 0) {
+      *pageId = nextPage;
+      return 0;
+    }
+    if (nextPage <= state->minDataPageId) {
+      return -1;
+    }
+    *pageId = nextPage - 1;
+    return readPage(state, *pageId % state->numDataPages);
+  }
+  
+  if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    /* Exact page lookup, with a binary search over dropped pages */
+    if (fenceIndexFind(state->fence, key, pageId) == 0 &&
+	*pageId >= state->minDataPageId && *pageId <= lastPage) {
+      return readPage(state, *pageId % state->numDataPages);
+    }
+    pgid_t firstIndexed = fenceIndexFirstPage(state->fence);
+    if (firstIndexed <= state->minDataPageId) {
+      return -1;
+    }
+    return floorPageSearch(state, buffer, key, state->minDataPageId, min(firstIndexed - 1, lastPage), pageId);
+  }
+  
+  if (EMBEDDB_USING_SPLINE(state->parameters) && state->spl->count != 0) {
+    /* Search within the spline bounds, widening them if they missed */
+    pgid_t location, lowbound, highbound;
+    splineFind(state->spl, key, state->compareKey, &location, &lowbound, &highbound);
+    pgid_t low = max(lowbound, state->minDataPageId);
+    pgid_t high = min(highbound, lastPage);
+    if (low > high) {
+      low = state->minDataPageId;
+      high = lastPage;
+    }
+    
+    if (floorPageSearch(state, buffer, key, low, high, pageId) != 0) {
+      if (low == state->minDataPageId) {
+	return -1;
+      }
+      return floorPageSearch(state, buffer, key, state->minDataPageId, low - 1, pageId);
+    }
+    if (*pageId == high && high < lastPage &&
+	state->compareKey(embedDBGetMaxKey(state, buffer), key) < 0) {
+      pgid_t found = *pageId;
+      if (floorPageSearch(state, buffer, key, high + 1, lastPage, pageId) != 0) {
+	*pageId = found;
+	return readPage(state, found % state->numDataPages);
+      }
+    }
+    return 0;
+  }
+  
+  /* Regular binary search */
+  return floorPageSearch(state, buffer, key, state->minDataPageId, lastPage, pageId);
+}
+
+/**
+ * @brief	Finds the record with the largest key <= key. The write buffer
+ *          is searched first, so no I/O is done if the record is in it.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @param	pageId	Return variable for the logical id of the page holding
+ *                  the record. Equals nextDataPageId for the write buffer,
+ *                  and is one more for the reorder buffer.
+ * @return	Pointer to the record in the write or read buffer. NULL if key
+ *          is below every record.
+ */
+static void *
+embedDBFloorRecord(embedDBState * state,
+		   void *         key,
+		   pgid_t *       pageId)
+{
+  if (reorderHolds(state, key)) {
+    count_t pos = reorderPosition(state, key);
+    int8_t *record = (int8_t *)state->reorderBuffer + pos * state->recordSize;
+    if (pos == state->reorderCount || state->compareKey(record, key) != 0) {
+      record -= state->recordSize;
+    }
+    *pageId = state->nextDataPageId + 1;
+    return record;
+  }
+  
+  void *buf = state->buffer;
+  if (EMBEDDB_GET_COUNT(buf) > 0 && state->compareKey(key, embedDBGetMinKey(state, buf)) >= 0) {
+    *pageId = state->nextDataPageId;
+  } else {
+    buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    if (floorPageFind(state, buf, key, pageId) != 0) {
+      return NULL;
+    }
+  }
+  
+  /* The page holds keys on both sides of key, unless key is above it */
+  pgid_t recordNum = EMBEDDB_GET_COUNT(buf) - 1;
+  if (state->compareKey(key, embedDBGetMaxKey(state, buf)) < 0) {
+    recordNum = embedDBSearchNode(state, buf, key, 1);
+  }
+  return (int8_t *)buf + state->headerSize + recordNum * state->recordSize;
+}
+
+/**
+ * @brief	Returns the record following a record found by
+ *          embedDBFloorRecord, reading the next page if needed.
+ * @param	state	embedDB algorithm state structure
+ * @param	record	Pointer to the record, or NULL for the first record
+ * @param	pageId	Logical id of the page holding the record
+ * @return	Pointer to the next record in the write or read buffer. NULL if
+ *          there is none or a page could not be read.
+ */
+static void *
+embedDBRecordAfter(embedDBState * state,
+		   void *         record,
+		   pgid_t         pageId)
+{
+  void *writeBuf = state->buffer;
+  void *readBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+  int8_t *window = (int8_t *)state->reorderBuffer;
+  count_t windowCount = EMBEDDB_USING_REORDER_BUFFER(state->parameters) ? state->reorderCount : 0;
+  if (record != NULL) {
+    int8_t *next = (int8_t *)record + state->recordSize;
+    if (pageId > state->nextDataPageId) {
+      return next < window + windowCount * state->recordSize ? next : NULL;
+    }
+    void *buf = pageId == state->nextDataPageId ? writeBuf : readBuf;
+    if (next <= (int8_t *)embedDBGetMaxKey(state, buf)) {
+      return next;
+    }
+    pageId++;
+  } else {
+    pageId = state->minDataPageId;
+  }
+  
+  if (pageId < state->nextDataPageId) {
+    if (readPage(state, pageId % state->numDataPages) != 0) {
+      return NULL;
+    }
+    return embedDBGetMinKey(state, readBuf);
+  }
+  if (pageId == state->nextDataPageId && EMBEDDB_GET_COUNT(writeBuf) > 0) {
+    return embedDBGetMinKey(state, writeBuf);
+  }
+  return windowCount > 0 ? window : NULL;
+}
+
 /**
  * @brief	Given a key, searches for data associated with
  *          that key in embedDB buffer using embedDBSearchNode.
@@ -1568,7 +3518,7 @@ splineSearch(embedDBState * state,
  * @param	data	Pre-allocated memory to copy data for record
  * @return	Return non-negative integer representing offset if success. Non-zero value if error.
  */
-static int8_t
+static int32_t
 searchBuffer(embedDBState * state,
 	     void *         buffer,
 	     void *         key,
@@ -1606,9 +3556,19 @@ embedDBGet(embedDBState * state,
 	   void *         key,
 	   void *         data)
 {
+  /* Keys held for reordering are larger than any that were written */
+  if (reorderHolds(state, key)) {
+    void *record = reorderFind(state, key);
+    if (record == NULL) {
+      return NO_RECORD_FOUND;
+    }
+    memcpy(data, (int8_t *)record + state->keySize, state->dataSize);
+    return 0;
+  }
+  
   void *outputBuffer = state->buffer;
-  if (state->nextDataPageId == 0) {
-    int8_t success = searchBuffer(state, outputBuffer, key, data);
+  if (state->nextDataPageId == state->minDataPageId) {
+    int32_t success = searchBuffer(state, outputBuffer, key, data);
     if (success != NO_RECORD_FOUND) {
       return 0;
     }
@@ -1637,15 +3597,7 @@ embedDBGet(embedDBState * state,
     }
   }
   
-  int8_t searchResult = 0;
-  if (EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
-    /* Regular binary search */
-    searchResult = binarySearch(state, buf, key);
-  } else {
-    /* Spline search */
-    searchResult = splineSearch(state, buf, key);
-  }
-  
+  int8_t searchResult = searchDataPages(state, buf, key);
   if (searchResult != 0) {
     EDB_PERRF("ERROR: embedDBGet was unable to find page to search for record\n");
     return -1;
@@ -1663,6 +3615,40 @@ embedDBGet(embedDBState * state,
   return -1;
 }
 
+/**
+ * @brief	Finds the record for a key for a variable data read, leaving its
+ *          page in the data read buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return the record number on the page, or NO_RECORD_FOUND.
+ */
+static int32_t
+findVarRecord(embedDBState * state,
+	      void *         key,
+	      void *         data)
+{
+  void *outputBuffer = (int8_t *)state->buffer;
+  
+  // search output buffer for record, mem copy fixed record into data
+  int32_t recordNum = searchBuffer(state, outputBuffer, key, data);
+  
+  // if there are records found in the output buffer
+  if (recordNum != NO_RECORD_FOUND) {
+    // the stream reads variable data that is still buffered from the var write buffer
+    flushVarSharingSlot(state);
+    // copy contents of write buffer to read buffer for setting up the stream
+    readToWriteBuf(state);
+    // else if there are records in the file system, mem cpy fixed record into data
+  } else if (embedDBGet(state, key, data) == RECORD_FOUND) {
+    // get pointer from the read buffer
+    void *buf = (int8_t *)state->buffer + (state->pageSize * EMBEDDB_DATA_READ_BUFFER);
+    // retrieve offset
+    recordNum = embedDBSearchNode(state, buf, key, 0);
+  }
+  return recordNum;
+}
+
 /**
  * @brief	Given a key, returns data associated with key.
  * 			Data is copied from database into data buffer.
@@ -1671,8 +3657,8 @@ embedDBGet(embedDBState * state,
  * @param	data	Pre-allocated memory to copy data for record
  * @param varData  Return variable for variable data as a
  *                 embedDBVarDataStream (Unallocated). Returns NULL if
- *                 no variable data. **Be sure to free the stream
- *                 after you are done with it**
+ *                 no variable data. **Be sure to free the stream with
+ *                 embedDBFreeVarDataStream after you are done with it**
  * @return	Return 0 if success. Non-zero value if error.
  * 			-1 : Error reading file or failed memory allocation
  * 			1  : Variable data was deleted to make room for newer data
@@ -1687,24 +3673,9 @@ embedDBGetVar(embedDBState *          state,
     EDB_PERRF("ERROR: embedDBGetVar called when not using variable data\n");
     return 0;
   }
-  void *outputBuffer = (int8_t *)state->buffer;
-  
-  // search output buffer for record, mem copy fixed record into data
-  int8_t recordNum = searchBuffer(state, outputBuffer, key, data);
   
-  // if there are records found in the output buffer
-  if (recordNum != NO_RECORD_FOUND) {
-    // flush variable record buffer to storage to read later on
-    embedDBFlushVar(state);
-    // copy contents of write buffer to read buffer for embedDBSetupVarDataStream()
-    readToWriteBuf(state);
-    // else if there are records in the file system, mem cpy fixed record into data
-  } else if (embedDBGet(state, key, data) == RECORD_FOUND) {
-    // get pointer from the read buffer
-    void *buf = (int8_t *)state->buffer + (state->pageSize * EMBEDDB_DATA_READ_BUFFER);
-    // retrieve offset
-    recordNum = embedDBSearchNode(state, buf, key, 0);
-  } else {
+  int32_t recordNum = findVarRecord(state, key, data);
+  if (recordNum == NO_RECORD_FOUND) {
     return NO_RECORD_FOUND;
   }
   
@@ -1725,18 +3696,439 @@ embedDBGetVar(embedDBState *          state,
 }
 
 /**
- * @brief	Initialize iterator on embedDB structure.
+ * @brief	Given a key, returns data associated with key, setting up a
+ *          caller-allocated stream for its variable data.
  * @param	state	embedDB algorithm state structure
- * @param	it		embedDB iterator state structure
+ * @param	key		Key for record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @param	varData	Pre-allocated stream for the variable data. totalBytes
+ *                  is set to 0 if the record has no variable data.
+ * @return	Return 0 if success. Non-zero value if error.
+ * 			-1 : Error reading file or key not found
+ * 			1  : Variable data was deleted to make room for newer data
  */
-void
-embedDBInitIterator(embedDBState *    state,
-		    embedDBIterator * it)
+int8_t
+embedDBGetVarInto(embedDBState *         state,
+		  void *                 key,
+		  void *                 data,
+		  embedDBVarDataStream * varData)
 {
-  /* Build query bitmap (if used) */
-  it->queryBitmap = NULL;
-  if (EMBEDDB_USING_BMAP(state->parameters)) {
-    /* Verify that bitmap index is useful (must have set either min or max data value) */
+  if (!EMBEDDB_USING_VDATA(state->parameters)) {
+    EDB_PERRF("ERROR: embedDBGetVarInto called when not using variable data\n");
+    return -1;
+  }
+  
+  int32_t recordNum = findVarRecord(state, key, data);
+  if (recordNum == NO_RECORD_FOUND) {
+    return NO_RECORD_FOUND;
+  }
+  
+  switch (fillVarDataStream(state, key, varData, recordNum)) {
+  case 0:
+    return 0;
+  case 1:
+    return 1;
+  }
+  return -1;
+}
+
+/**
+ * @brief	Finds the record for a key on the data pages, leaving its page in
+ *          the read buffer. When keys are requested in ascending order, a
+ *          key on the page already in the read buffer or on the page after
+ *          it is found without searching for its page.
+ * @param	state		embedDB algorithm state structure
+ * @param	key			Key for record
+ * @param	currentPage	Logical id of the page in the read buffer, or
+ *                      EDB_PGID_MAX if none. Updated when a page is read.
+ * @return	Return the record number on the page, or NO_RECORD_FOUND.
+ */
+static pgid_t
+embedDBGetManyFromPages(embedDBState * state,
+			void *         key,
+			pgid_t *       currentPage)
+{
+  void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+  
+  if (*currentPage != EDB_PGID_MAX &&
+      state->bufferedPageId == *currentPage % state->numDataPages) {
+    if (state->compareKey(key, embedDBGetMaxKey(state, buf)) <= 0) {
+      if (state->compareKey(key, embedDBGetMinKey(state, buf)) >= 0) {
+	return embedDBSearchNode(state, buf, key, 0);
+      }
+    } else if (*currentPage + 1 < state->nextDataPageId) {
+      /* Sorted keys usually continue on the next page */
+      if (readPage(state, (*currentPage + 1) % state->numDataPages) != 0) {
+	*currentPage = EDB_PGID_MAX;
+	return NO_RECORD_FOUND;
+      }
+      (*currentPage)++;
+      if (state->compareKey(key, embedDBGetMinKey(state, buf)) < 0) {
+	/* Key falls between the two pages */
+	return NO_RECORD_FOUND;
+      }
+      if (state->compareKey(key, embedDBGetMaxKey(state, buf)) <= 0) {
+	return embedDBSearchNode(state, buf, key, 0);
+      }
+    }
+  }
+  
+  if (searchDataPages(state, buf, key) != 0) {
+    *currentPage = EDB_PGID_MAX;
+    return NO_RECORD_FOUND;
+  }
+  memcpy(currentPage, buf, sizeof(pgid_t));
+  return embedDBSearchNode(state, buf, key, 0);
+}
+
+/**
+ * @brief	Given an array of keys, returns the data associated with each key.
+ *          Keys should be sorted in ascending order so that each data page
+ *          is read at most once and keys in the write buffer are found in a
+ *          single pass. Unsorted keys are still answered, with fewer shared
+ *          page reads.
+ * @param	state	embedDB algorithm state structure
+ * @param	keys	Array of numKeys keys
+ * @param	numKeys	Number of keys
+ * @param	data	Pre-allocated memory for numKeys data values
+ * @param	status	Pre-allocated array of numKeys results. Set to 0 if the
+ *                  key was found and -1 if not.
+ * @return	Return the number of keys found.
+ */
+uint32_t
+embedDBGetMany(embedDBState * state,
+	       void *         keys,
+	       uint32_t       numKeys,
+	       void *         data,
+	       int8_t *       status)
+{
+  void *outputBuffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_WRITE_BUFFER;
+  count_t bufferCount = EMBEDDB_GET_COUNT(outputBuffer);
+  pgid_t currentPage = EDB_PGID_MAX;
+  count_t bufferRec = 0;
+  uint32_t numFound = 0;
+  
+  for (uint32_t i = 0; i < numKeys; i++) {
+    void *key = (int8_t *)keys + i * state->keySize;
+    void *keyData = (int8_t *)data + i * state->dataSize;
+    pgid_t recordNum = NO_RECORD_FOUND;
+    status[i] = NO_RECORD_FOUND;
+    
+    if (reorderHolds(state, key)) {
+      void *record = reorderFind(state, key);
+      if (record != NULL) {
+	memcpy(keyData, (int8_t *)record + state->keySize, state->dataSize);
+	status[i] = RECORD_FOUND;
+      }
+    } else if (bufferCount > 0 &&
+	       state->compareKey(key, embedDBGetMinKey(state, outputBuffer)) >= 0) {
+      /* Merge sorted keys with the write buffer records. Start over if
+	 the cursor has passed the key. */
+      if (bufferRec > 0 &&
+	  state->compareKey((int8_t *)outputBuffer + state->headerSize + state->recordSize * (bufferRec - 1), key) >= 0) {
+	bufferRec = 0;
+      }
+      while (bufferRec < bufferCount) {
+	void *record = (int8_t *)outputBuffer + state->headerSize + state->recordSize * bufferRec;
+	int8_t compare = state->compareKey(record, key);
+	if (compare == 0) {
+	  memcpy(keyData, (int8_t *)record + state->keySize, state->dataSize);
+	  status[i] = RECORD_FOUND;
+	  break;
+	} else if (compare > 0) {
+	  break;
+	}
+	bufferRec++;
+      }
+    } else if (state->nextDataPageId > state->minDataPageId) {
+      recordNum = embedDBGetManyFromPages(state, key, &currentPage);
+      if (recordNum != NO_RECORD_FOUND) {
+	void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+	memcpy(keyData, (int8_t *)buf + state->headerSize + state->recordSize * recordNum + state->keySize,
+	       state->dataSize);
+	status[i] = RECORD_FOUND;
+      }
+    }
+    
+    if (status[i] == RECORD_FOUND) {
+      numFound++;
+    }
+  }
+  return numFound;
+}
+
+/**
+ * @brief	Given an array of keys, returns the data and variable data
+ *          associated with each key. Keys should be sorted in ascending
+ *          order so that data pages are read at most once and consecutive
+ *          variable data streams share variable page reads.
+ * @param	state	embedDB algorithm state structure
+ * @param	keys	Array of numKeys keys
+ * @param	numKeys	Number of keys
+ * @param	data	Pre-allocated memory for numKeys data values
+ * @param	varData	Pre-allocated array of numKeys stream pointers. Each is
+ *                  set as by embedDBGetVar. **Be sure to free the streams
+ *                  with embedDBFreeVarDataStream after you are done with
+ *                  them**
+ * @param	status	Pre-allocated array of numKeys results, with the same
+ *                  values embedDBGetVar returns
+ * @return	Return the number of keys found.
+ */
+uint32_t
+embedDBGetManyVar(embedDBState *          state,
+		  void *                  keys,
+		  uint32_t                numKeys,
+		  void *                  data,
+		  embedDBVarDataStream ** varData,
+		  int8_t *                status)
+{
+  if (!EMBEDDB_USING_VDATA(state->parameters)) {
+    EDB_PERRF("ERROR: embedDBGetManyVar called when not using variable data\n");
+    return 0;
+  }
+  
+  void *outputBuffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_WRITE_BUFFER;
+  void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+  bool writeBufferInReadBuffer = false;
+  pgid_t currentPage = EDB_PGID_MAX;
+  uint32_t numFound = 0;
+  
+  for (uint32_t i = 0; i < numKeys; i++) {
+    void *key = (int8_t *)keys + i * state->keySize;
+    void *keyData = (int8_t *)data + i * state->dataSize;
+    pgid_t recordNum = NO_RECORD_FOUND;
+    varData[i] = NULL;
+    status[i] = NO_RECORD_FOUND;
+    
+    if (EMBEDDB_GET_COUNT(outputBuffer) > 0 &&
+	state->compareKey(key, embedDBGetMinKey(state, outputBuffer)) >= 0) {
+      if (!writeBufferInReadBuffer) {
+	/* Streams read buffered variable data from the var write buffer */
+	flushVarSharingSlot(state);
+	readToWriteBuf(state);
+	writeBufferInReadBuffer = true;
+	currentPage = EDB_PGID_MAX;
+      }
+      recordNum = embedDBSearchNode(state, buf, key, 0);
+    } else if (state->nextDataPageId > state->minDataPageId) {
+      writeBufferInReadBuffer = false;
+      recordNum = embedDBGetManyFromPages(state, key, &currentPage);
+    }
+    
+    if (recordNum == NO_RECORD_FOUND) {
+      continue;
+    }
+    
+    memcpy(keyData, (int8_t *)buf + state->headerSize + state->recordSize * recordNum + state->keySize,
+	   state->dataSize);
+    switch (embedDBSetupVarDataStream(state, key, &varData[i], recordNum)) {
+    case 0:
+      status[i] = 0;
+      numFound++;
+      break;
+    case 1:
+      status[i] = 1;
+      numFound++;
+      break;
+    default:
+      status[i] = -1;
+    }
+  }
+  return numFound;
+}
+
+/**
+ * @brief	Finds the newest record. The write buffer is checked first, so
+ *          no I/O is done unless it is empty. Otherwise the last data page
+ *          is read into the data read buffer.
+ * @param	state	embedDB algorithm state structure
+ * @return	Pointer to the record, or NULL if there are no records or the
+ *          last data page could not be read.
+ */
+static void *
+findLatestRecord(embedDBState *state)
+{
+  if (EMBEDDB_USING_REORDER_BUFFER(state->parameters) && state->reorderCount > 0) {
+    return (int8_t *)state->reorderBuffer + (state->reorderCount - 1) * state->recordSize;
+  }
+  
+  void *buf = state->buffer;
+  if (EMBEDDB_GET_COUNT(buf) == 0) {
+    if (state->nextDataPageId == state->minDataPageId) {
+      return NULL;
+    }
+    buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    if (readPage(state, (state->nextDataPageId - 1) % state->numDataPages) != 0) {
+      EDB_PERRF("ERROR: Failed to read the last data page\n");
+      return NULL;
+    }
+    if (EMBEDDB_GET_COUNT(buf) == 0) {
+      return NULL;
+    }
+  }
+  
+  return (int8_t *)buf + state->headerSize + (EMBEDDB_GET_COUNT(buf) - 1) * state->recordSize;
+}
+
+/**
+ * @brief	Returns the newest record. The write buffer is checked first, so
+ *          no I/O is done unless it is empty.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Pre-allocated memory to copy the key of the record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if success. -1 if there are no records or the last
+ *          data page could not be read.
+ */
+int8_t
+embedDBGetLatest(embedDBState * state,
+		 void *         key,
+		 void *         data)
+{
+  void *record = findLatestRecord(state);
+  if (record == NULL) {
+    return -1;
+  }
+  memcpy(key, record, state->keySize);
+  memcpy(data, (int8_t *)record + state->keySize, state->dataSize);
+  return 0;
+}
+
+/**
+ * @brief	Returns the record with the largest key <= key.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @param	foundKey	Pre-allocated memory to copy the key of the record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if success. -1 if every key is larger than key or a
+ *          page could not be read.
+ */
+int8_t
+embedDBGetFloor(embedDBState * state,
+		void *         key,
+		void *         foundKey,
+		void *         data)
+{
+  pgid_t pageId = 0;
+  void *record = embedDBFloorRecord(state, key, &pageId);
+  if (record == NULL) {
+    return -1;
+  }
+  memcpy(foundKey, record, state->keySize);
+  memcpy(data, (int8_t *)record + state->keySize, state->dataSize);
+  return 0;
+}
+
+/**
+ * @brief	Returns the record with the smallest key >= key.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @param	foundKey	Pre-allocated memory to copy the key of the record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if success. -1 if every key is smaller than key or a
+ *          page could not be read.
+ */
+int8_t
+embedDBGetCeiling(embedDBState * state,
+		  void *         key,
+		  void *         foundKey,
+		  void *         data)
+{
+  pgid_t pageId = 0;
+  void *record = embedDBFloorRecord(state, key, &pageId);
+  if (record == NULL || state->compareKey(record, key) < 0) {
+    record = embedDBRecordAfter(state, record, pageId);
+  }
+  if (record == NULL) {
+    return -1;
+  }
+  memcpy(foundKey, record, state->keySize);
+  memcpy(data, (int8_t *)record + state->keySize, state->dataSize);
+  return 0;
+}
+
+/**
+ * @brief	Returns the record whose key is closest to key. Ties return
+ *          the smaller key.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @param	foundKey	Pre-allocated memory to copy the key of the record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if success. -1 if there are no records or a page
+ *          could not be read.
+ */
+int8_t
+embedDBGetNearest(embedDBState * state,
+		  void *         key,
+		  void *         foundKey,
+		  void *         data)
+{
+  pgid_t pageId = 0;
+  void *record = embedDBFloorRecord(state, key, &pageId);
+  if (record == NULL) {
+    return embedDBGetCeiling(state, key, foundKey, data);
+  }
+  
+  /* Copy the floor first as reading the next page replaces it */
+  memcpy(foundKey, record, state->keySize);
+  memcpy(data, (int8_t *)record + state->keySize, state->dataSize);
+  if (state->compareKey(record, key) == 0) {
+    return 0;
+  }
+  
+  record = embedDBRecordAfter(state, record, pageId);
+  if (record != NULL) {
+    uint64_t thisKey = 0, floorKey = 0, ceilingKey = 0;
+    memcpy(&thisKey, key, state->keySize);
+    memcpy(&floorKey, foundKey, state->keySize);
+    memcpy(&ceilingKey, record, state->keySize);
+    if (ceilingKey - thisKey < thisKey - floorKey) {
+      memcpy(foundKey, record, state->keySize);
+      memcpy(data, (int8_t *)record + state->keySize, state->dataSize);
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief	Returns the records of a logical page that is still in memory.
+ *          The write buffer is page nextDataPageId and the reorder buffer,
+ *          if used, follows it as the next page.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageId	Logical page id
+ * @param	count	Return variable for the number of records
+ * @return	Pointer to the first record, or NULL if the page is not in memory.
+ */
+static int8_t *
+memoryPageRecords(embedDBState * state,
+		  pgid_t         pageId,
+		  count_t *      count)
+{
+  if (pageId == state->nextDataPageId) {
+    *count = EMBEDDB_GET_COUNT(state->buffer);
+    return (int8_t *)state->buffer + state->headerSize;
+  }
+  if (pageId == state->nextDataPageId + 1 && EMBEDDB_USING_REORDER_BUFFER(state->parameters)) {
+    *count = state->reorderCount;
+    return (int8_t *)state->reorderBuffer;
+  }
+  *count = 0;
+  return NULL;
+}
+
+/**
+ * @brief	Builds the query bitmap of an iterator from its data range and
+ *          warns if the bitmap index cannot be used to skip pages.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ */
+static void
+initIteratorBitmap(embedDBState *    state,
+		   embedDBIterator * it)
+{
+  /* Build query bitmap (if used) */
+  it->queryBitmap = NULL;
+  if (EMBEDDB_USING_BMAP(state->parameters)) {
+    /* Verify that bitmap index is useful (must have set either min or max data value) */
     if ((it->minData || it->maxData) && EDB_WITH_HEAP) {
       it->queryBitmap = calloc(1, state->bitmapSize);
       state->buildBitmapFromRange(it->minData, it->maxData, it->queryBitmap);
@@ -1752,25 +4144,150 @@ embedDBInitIterator(embedDBState *    state,
     EDB_PERRF("WARN: Iterator not using index to full extent. If this is not intended, "
 	      "ensure that the embedDBState was initialized with an index file.\n");
   }
+}
+
+/**
+ * @brief	Checks the bitmap index to see if the data page the iterator is
+ *          positioned on may hold a record in the query data range.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @return	Return 1 if the page can be skipped, 0 if it must be read and
+ *          -1 if the index page could not be read.
+ */
+static int8_t
+iteratorSkipPage(embedDBState *    state,
+		 embedDBIterator * it)
+{
+  if (it->queryBitmap == NULL) {
+    return 0;
+  }
+  
+  // Find what index page determines if we should read the data page
+  pgid_t indexPage = it->nextDataPage / state->maxIdxRecordsPerPage;
+  uint16_t indexRec = it->nextDataPage % state->maxIdxRecordsPerPage;
+  
+  if (state->indexFile == NULL ||
+      indexPage < state->minIndexPageId ||
+      indexPage >= state->nextIdxPageId) {
+    // The index for this data page is not saved, so the page must be
+    // read regardless
+    return 0;
+  }
+  
+  if (readIndexPage(state, indexPage % state->numIndexPages) != 0) {
+    EDB_PERRF("ERROR: Failed to read index page %" EDB_PRIpgid " (%" EDB_PRIpgid ")\n",
+	      indexPage,
+	      indexPage % state->numIndexPages);
+    return -1;
+  }
+  
+  // Get bitmap for data page in question
+  void *indexBM = (int8_t *)state->buffer + EMBEDDB_INDEX_READ_BUFFER * state->pageSize +
+    EMBEDDB_IDX_HEADER_SIZE + indexRec * state->bitmapSize;
+  
+  return bitmapOverlap(it->queryBitmap, indexBM, state->bitmapSize) ? 0 : 1;
+}
+
+/**
+ * @brief	Initialize iterator on embedDB structure.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ */
+void
+embedDBInitIterator(embedDBState *    state,
+		    embedDBIterator * it)
+{
+  initIteratorBitmap(state, it);
   
   /* Determine which data page should be the first examined if there
      is a min key and that we have spline points */
-  if ((state->spl->count != 0) &&
-      it->minKey &&
-      EMBEDDB_USING_SPLINE(state->parameters)) {
+  if (it->minKey &&
+      EMBEDDB_USING_SPLINE(state->parameters) &&
+      (state->spl->count != 0)) {
     /* Spline search */
-    uint32_t location, lowbound, highbound = 0;
+    pgid_t location, lowbound, highbound = 0;
     splineFind(state->spl, it->minKey, state->compareKey, &location, &lowbound, &highbound);
     
     // Use the low bound as the start for our search
     it->nextDataPage = max(lowbound, state->minDataPageId);
   }
+  else if (it->minKey && EMBEDDB_USING_INTERPOLATION_SEARCH(state->parameters)) {
+    /* Start on the first page that may hold a key >= minKey */
+    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    pgid_t startPage = state->minDataPageId;
+    interpolationSearch(state, buf, it->minKey, &startPage);
+    it->nextDataPage = startPage;
+  }
+  else if (it->minKey && EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    /* Start on the last page whose smallest key is <= minKey */
+    pgid_t startPage = state->minDataPageId;
+    fenceIndexFind(state->fence, it->minKey, &startPage);
+    it->nextDataPage = max(startPage, state->minDataPageId);
+  }
   else {
     it->nextDataPage = state->minDataPageId;
   }
   it->nextDataRec = 0;
 }
 
+/**
+ * @brief	Initialize an iterator that returns records newest first. The
+ *          iterator starts in the write buffer, or on the page that may
+ *          hold maxKey if it is set, and walks back to minDataPageId.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ */
+void
+embedDBInitIteratorReverse(embedDBState *    state,
+			   embedDBIterator * it)
+{
+  initIteratorBitmap(state, it);
+  
+  it->nextDataPage = state->nextDataPageId;
+  it->nextDataRec = EMBEDDB_ITERATOR_PAGE_START;
+  
+  /* Start in the reorder buffer if it may hold keys <= maxKey */
+  if (EMBEDDB_USING_REORDER_BUFFER(state->parameters) && state->reorderCount > 0 &&
+      (it->maxKey == NULL || state->compareKey(it->maxKey, state->reorderBuffer) >= 0)) {
+    it->nextDataPage++;
+    return;
+  }
+  
+  /* Start in the write buffer unless maxKey is on an earlier page */
+  void *outputBuffer = state->buffer;
+  if (it->maxKey == NULL ||
+      state->nextDataPageId == state->minDataPageId ||
+      (EMBEDDB_GET_COUNT(outputBuffer) > 0 &&
+       state->compareKey(it->maxKey, embedDBGetMinKey(state, outputBuffer)) >= 0)) {
+    return;
+  }
+  
+  pgid_t lastPage = state->nextDataPageId - 1;
+  if (EMBEDDB_USING_SPLINE(state->parameters) && state->spl->count != 0) {
+    /* The high bound is the last page the spline allows maxKey on */
+    pgid_t location, lowbound, highbound = 0;
+    splineFind(state->spl, it->maxKey, state->compareKey, &location, &lowbound, &highbound);
+    it->nextDataPage = min(highbound, lastPage);
+  }
+  else if (EMBEDDB_USING_INTERPOLATION_SEARCH(state->parameters)) {
+    /* Page holding maxKey, or the first page with larger keys */
+    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    pgid_t startPage = state->minDataPageId;
+    interpolationSearch(state, buf, it->maxKey, &startPage);
+    it->nextDataPage = startPage;
+  }
+  else if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    /* Last page whose smallest key is <= maxKey. Keys below the index
+       start on the oldest indexed page. */
+    pgid_t startPage = lastPage;
+    if (fenceIndexFind(state->fence, it->maxKey, &startPage) != 0) {
+      startPage = fenceIndexFirstPage(state->fence);
+    }
+    it->nextDataPage = min(startPage, lastPage);
+  }
+  it->nextDataPage = max(it->nextDataPage, state->minDataPageId);
+}
+
 /**
  * @brief	Close iterator after use.
  * @param	it		embedDB iterator structure
@@ -1814,6 +4331,64 @@ embedDBFlushVar(embedDBState *state)
   return 0;
 }
 
+/**
+ * @brief	Writes the partially filled data and index write buffers to
+ *          their page slots without starting new pages. Later records
+ *          keep filling the buffers and the same slots are rewritten.
+ * @param	state	embedDB algorithm state structure
+ * @return	0 if success, -1 if error.
+ */
+static int8_t
+writeTailPages(embedDBState *state)
+{
+  void *buffer = (int8_t *)state->buffer + EMBEDDB_DATA_WRITE_BUFFER * state->pageSize;
+  
+  /* A full page is written as usual so that it gets its index entry */
+  if (EMBEDDB_GET_COUNT(buffer) >= state->maxRecordsPerPage && writeFullPage(state) != 0)
+    return -1;
+  
+  if (EMBEDDB_GET_COUNT(buffer) > 0) {
+    pgid_t pageNum = writePage(state, buffer);
+    if (pageNum == -1)
+      return -1;
+    
+    state->nextDataPageId = pageNum;
+    state->dataTailWritten = 1;
+    
+    /* The model was fitted to the records written so far, so later
+       records in the buffer must not be searched with it */
+    if (EMBEDDB_USING_PAGE_MODEL(state->parameters))
+      memset(EMBEDDB_GET_PAGE_MODEL(buffer, state), 0, EMBEDDB_PAGE_MODEL_SIZE);
+    
+    /* The read buffer may hold an older copy of the slot */
+    if (state->bufferedPageId == pageNum % state->numDataPages)
+      state->bufferedPageId = -1;
+  }
+  
+  if (EMBEDDB_BATCHING_WRITES(state->parameters) && writeDataBatch(state) != 0)
+    return -1;
+  state->fileInterface->flush(state->dataFile);
+  
+  if (!EMBEDDB_USING_INDEX(state->parameters))
+    return 0;
+  
+  void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_WRITE_BUFFER;
+  if (EMBEDDB_GET_COUNT(buf) < 1)
+    return 0;
+  
+  pgid_t idxPageNum = writeIndexPage(state, buf);
+  if (idxPageNum == -1)
+    return -1;
+  
+  state->nextIdxPageId = idxPageNum;
+  state->indexTailWritten = 1;
+  state->fileInterface->flush(state->indexFile);
+  
+  if (state->bufferedIndexPageId == idxPageNum % state->numIndexPages)
+    state->bufferedIndexPageId = -1;
+  return 0;
+}
+
 /**
  * @brief	Flushes output buffer.
  * @param	state	algorithm state structure
@@ -1822,13 +4397,51 @@ embedDBFlushVar(embedDBState *state)
 int8_t
 embedDBFlush(embedDBState *state)
 {
+  if (flushBuffers(state) != 0)
+    return -1;
+  
+  /* Record where each file ends now that its pages are on storage */
+  if (EMBEDDB_USING_SUPERBLOCK(state->parameters) && writeSuperblock(state) != 0) {
+    EDB_PERRF("Failed to write the superblock during embedDBFlush.");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief	Writes the data, index and variable data write buffers.
+ * @param	state	algorithm state structure
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+static int8_t
+flushBuffers(embedDBState *state)
+{
+  if (reorderDrain(state) != 0) {
+    EDB_PERRF("Failed to empty the reorder buffer during embedDBFlush.");
+    return -1;
+  }
+  
+  /* Keep the partial pages in the write buffers so they continue to fill */
+  if (EMBEDDB_RESUMING_TAIL_PAGE(state->parameters)) {
+    if (writeTailPages(state) != 0) {
+      EDB_PERRF("Failed to write tail pages during embedDBFlush.");
+      return -1;
+    }
+    if (EMBEDDB_USING_VDATA(state->parameters) && embedDBFlushVar(state) != 0) {
+      EDB_PERRF("Failed to flush variable data page");
+      return -1;
+    }
+    return 0;
+  }
+  
   // As the first buffer is the data write buffer, no address change is required
   int8_t *buffer = (int8_t *)state->buffer + EMBEDDB_DATA_WRITE_BUFFER * state->pageSize;
   if (EMBEDDB_GET_COUNT(buffer) < 1)
     return 0;
   
   pgid_t pageNum = writePage(state, buffer);
-  if (pageNum == -1) {
+  if (pageNum == -1 ||
+      (EMBEDDB_BATCHING_WRITES(state->parameters) && writeDataBatch(state) != 0)) {
     EDB_PERRF("Failed to write page during embedDBFlush.");
     return -1;
   }
@@ -1870,6 +4483,39 @@ embedDBFlush(embedDBState *state)
       return -1;
     }
   }
+  
+  /* Every record is now on a permanent page */
+  if (EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters)) {
+    state->rlcPendingRecords = 0;
+  }
+  return 0;
+}
+
+/**
+ * @brief	Makes every inserted record durable by writing the partial
+ *          data page (and variable data page) as a record-level
+ *          consistency page. Only needed with EMBEDDB_RLC_GROUP_COMMIT.
+ * @param	state	algorithm state structure
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+int8_t
+embedDBCommit(embedDBState *state)
+{
+  if (!EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters) || state->rlcPendingRecords == 0) {
+    return 0;
+  }
+  
+  /* Records on pages written since the last commit are already durable */
+  if (EMBEDDB_GET_COUNT(state->buffer) > 0 && commitTemporaryPage(state) != 0) {
+    EDB_PERRF("Failed to write record-level consistency page during embedDBCommit.");
+    return -1;
+  }
+  state->rlcPendingRecords = 0;
+  
+  if (EMBEDDB_USING_VDATA(state->parameters) && embedDBFlushVar(state) != 0) {
+    EDB_PERRF("Failed to flush variable data page during embedDBCommit.");
+    return -1;
+  }
   return 0;
 }
 
@@ -1888,65 +4534,51 @@ embedDBNext(embedDBState *    state,
 	    void *            data)
 {
   int searchWriteBuf = 0;
+  pgid_t lastPage = state->nextDataPageId +
+    (EMBEDDB_USING_REORDER_BUFFER(state->parameters) ? 1 : 0);
   while (1) {
-    if (it->nextDataPage > state->nextDataPageId) {
+    if (it->nextDataPage > lastPage) {
       return 0;
     }
-    if (it->nextDataPage == state->nextDataPageId) {
+    if (it->nextDataPage >= state->nextDataPageId) {
       searchWriteBuf = 1;
     }
     
-    // If we are just starting to read a new page and we have a query
-    // bitmap
-    if (it->nextDataRec == 0 && it->queryBitmap != NULL) {
-      // Find what index page determines if we should read the data
-      // page
-      uint32_t indexPage = it->nextDataPage / state->maxIdxRecordsPerPage;
-      uint16_t indexRec = it->nextDataPage % state->maxIdxRecordsPerPage;
-      
-      if (state->indexFile != NULL &&
-	  indexPage >= state->minIndexPageId &&
-	  indexPage < state->nextIdxPageId) {
-	// If the index page that contains this data page exists, else
-	// we must read the data page regardless cause we don't have
-	// the index saved for it
-	
-	if (readIndexPage(state, indexPage % state->numIndexPages) != 0) {
-	  EDB_PERRF("ERROR: Failed to read index page %" PRIu32 " (%" PRIu32 ")\n",
-		    indexPage,
-		    indexPage % state->numIndexPages);
-	  return 0;
-	}
-	
-	// Get bitmap for data page in question
-	void *indexBM = (int8_t *)state->buffer + EMBEDDB_INDEX_READ_BUFFER * state->pageSize +
-	  EMBEDDB_IDX_HEADER_SIZE + indexRec * state->bitmapSize;
-	
-	// Determine if we should read the data page
-	if (!bitmapOverlap(it->queryBitmap, indexBM, state->bitmapSize)) {
-	  // Do not read this data page, try the next one
-	  it->nextDataPage++;
-	  continue;
-	}
+    // If we are just starting to read a new page, check the bitmap
+    // index to see if the page can be skipped
+    if (it->nextDataRec == 0) {
+      int8_t skip = iteratorSkipPage(state, it);
+      if (skip == -1) {
+	return 0;
+      }
+      if (skip) {
+	// Do not read this data page, try the next one
+	it->nextDataPage++;
+	continue;
       }
     }
     
     if (searchWriteBuf == 0 && readPage(state, it->nextDataPage % state->numDataPages) != 0) {
-      EDB_PERRF("ERROR: Failed to read data page %" PRIu32 " (%" PRIu32 ")\n",
+      EDB_PERRF("ERROR: Failed to read data page %" EDB_PRIpgid " (%" EDB_PRIpgid ")\n",
 		it->nextDataPage,
 		it->nextDataPage % state->numDataPages);
       return 0;
     }
     
     // Keep reading record until we find one that matches the query
-    int8_t *buf = searchWriteBuf == 0 ?
-      (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize :
-      (int8_t *)state->buffer + EMBEDDB_DATA_WRITE_BUFFER * state->pageSize;
-    uint32_t pageRecordCount = EMBEDDB_GET_COUNT(buf);
+    count_t pageRecordCount = 0;
+    int8_t *records = NULL;
+    if (searchWriteBuf == 0) {
+      int8_t *buf = (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize;
+      records = buf + state->headerSize;
+      pageRecordCount = EMBEDDB_GET_COUNT(buf);
+    } else {
+      records = memoryPageRecords(state, it->nextDataPage, &pageRecordCount);
+    }
     while (it->nextDataRec < pageRecordCount) {
       // Get record
-      memcpy(key, buf + state->headerSize + it->nextDataRec * state->recordSize, state->keySize);
-      memcpy(data, buf + state->headerSize + it->nextDataRec * state->recordSize + state->keySize,
+      memcpy(key, records + it->nextDataRec * state->recordSize, state->keySize);
+      memcpy(data, records + it->nextDataRec * state->recordSize + state->keySize,
 	     state->dataSize);
       it->nextDataRec++;
       
@@ -1972,6 +4604,35 @@ embedDBNext(embedDBState *    state,
   }
 }
 
+/**
+ * @brief	Moves the iterator to the next record for a variable data read,
+ *          leaving its page in the data read buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if no more records
+ */
+static int8_t
+nextVarRecord(embedDBState *    state,
+	      embedDBIterator * it,
+	      void *            key,
+	      void *            data)
+{
+  // ensure record exists
+  int8_t r = embedDBNext(state, it, key, data);
+  if (!r) {
+    return 0;
+  }
+  
+  /* Records from the write buffer may point into the var write buffer */
+  if (it->nextDataPage >= state->nextDataPageId) {
+    readToWriteBuf(state);
+    flushVarSharingSlot(state);
+  }
+  return 1;
+}
+
 /**
  * @brief	Return next key, data, variable data set for iterator
  * @param	state	embedDB algorithm state structure
@@ -1980,8 +4641,8 @@ embedDBNext(embedDBState *    state,
  * @param	data	Return variable for data (Pre-allocated)
  * @param varData  Return variable for variable data as a
  *                 embedDBVarDataStream (Unallocated). Returns NULL if
- *                 no variable data. **Be sure to free the stream
- *                 after you are done with it**
+ *                 no variable data. **Be sure to free the stream with
+ *                 embedDBFreeVarDataStream after you are done with it**
  * @return	1 if successful, 0 if no more records
  */
 int8_t
@@ -1996,18 +4657,10 @@ embedDBNextVar(embedDBState *          state,
     return 0;
   }
   
-  // ensure record exists
-  int8_t r = embedDBNext(state, it, key, data);
-  if (!r) {
+  if (!nextVarRecord(state, it, key, data)) {
     return 0;
   }
   
-  void *outputBuffer = (int8_t *)state->buffer;
-  if (it->nextDataPage == 0 && (EMBEDDB_GET_COUNT(outputBuffer) > 0)) {
-    readToWriteBuf(state);
-    embedDBFlushVar(state);
-  }
-  
   // Get the vardata address from the record
   count_t recordNum = it->nextDataRec - 1;
   int8_t setupResult = embedDBSetupVarDataStream(state, key, varData, recordNum);
@@ -2024,45 +4677,353 @@ embedDBNextVar(embedDBState *          state,
 }
 
 /**
- * @brief Setup varDataStream object to return the variable data for a record
+ * @brief	Return next key, data, variable data set for iterator, setting up
+ *          a caller-allocated stream for the variable data.
  * @param	state	embedDB algorithm state structure
- * @param   key     Key for the record
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @param	varData	Pre-allocated stream for the variable data. totalBytes
+ *                  is set to 0 if the record has no variable data or it
+ *                  was deleted.
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t
+embedDBNextVarInto(embedDBState *         state,
+		   embedDBIterator *      it,
+		   void *                 key,
+		   void *                 data,
+		   embedDBVarDataStream * varData)
+{
+  if (!EMBEDDB_USING_VDATA(state->parameters)) {
+    EDB_PERRF("ERROR: embedDBNextVarInto called when not using variable data\n");
+    return 0;
+  }
+  
+  if (!nextVarRecord(state, it, key, data)) {
+    return 0;
+  }
+  return fillVarDataStream(state, key, varData, it->nextDataRec - 1) < 2;
+}
+
+/**
+ * @brief	Passes every remaining record of an iterator, with its variable
+ *          data in chunks, to a callback.
+ * @param	state		embedDB algorithm state structure
+ * @param	it			embedDB iterator state structure
+ * @param	key			Buffer for keys (Pre-allocated)
+ * @param	data		Buffer for data (Pre-allocated)
+ * @param	chunk		Buffer the variable data is read into
+ * @param	chunkSize	Size of chunk in bytes
+ * @param	callback	Function called with each chunk
+ * @param	context		Passed unchanged to callback
+ * @return	Number of records passed to callback, or -1 if a read failed
+ */
+int32_t
+embedDBScanVar(embedDBState *         state,
+	       embedDBIterator *      it,
+	       void *                 key,
+	       void *                 data,
+	       void *                 chunk,
+	       uint32_t               chunkSize,
+	       embedDBScanVarCallback callback,
+	       void *                 context)
+{
+  if (!EMBEDDB_USING_VDATA(state->parameters) || chunkSize == 0) {
+    EDB_PERRF("ERROR: embedDBScanVar needs variable data and a chunk buffer\n");
+    return -1;
+  }
+  
+  embedDBVarDataStream stream;
+  int32_t numRecords = 0;
+  while (nextVarRecord(state, it, key, data)) {
+    /* The callback is told when the variable data was overwritten */
+    int8_t status = fillVarDataStream(state, key, &stream, it->nextDataRec - 1);
+    if (status == 2) {
+      EDB_PERRF("ERROR: Failed to read the data page for the scan\n");
+      return -1;
+    }
+    numRecords++;
+    uint32_t offset = 0;
+    do {
+      uint32_t length = embedDBVarDataStreamRead(state, &stream, chunk, chunkSize);
+      if (length == 0 && offset < stream.totalBytes) {
+	EDB_PERRF("ERROR: Failed to read variable data for the scan\n");
+	return -1;
+      }
+      if (callback(context, key, data, chunk, offset, length, stream.totalBytes, status) != 0) {
+	return numRecords;
+      }
+      offset += length;
+    } while (offset < stream.totalBytes);
+  }
+  return numRecords;
+}
+
+/**
+ * @brief	Return previous key, data pair for a reverse iterator.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure initialized by
+ *                  embedDBInitIteratorReverse
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t
+embedDBPrev(embedDBState *    state,
+	    embedDBIterator * it,
+	    void *            key,
+	    void *            data)
+{
+  while (1) {
+    /* Stop if the page was erased to make room for newer data */
+    if (it->nextDataPage < state->minDataPageId) {
+      return 0;
+    }
+    int searchWriteBuf = it->nextDataPage >= state->nextDataPageId;
+    
+    // If we are just starting to read a new page, check the bitmap
+    // index to see if the page can be skipped
+    int8_t skip = 0;
+    if (it->nextDataRec == EMBEDDB_ITERATOR_PAGE_START) {
+      skip = iteratorSkipPage(state, it);
+      if (skip == -1) {
+	return 0;
+      }
+    }
+    
+    if (!skip) {
+      if (searchWriteBuf == 0 && readPage(state, it->nextDataPage % state->numDataPages) != 0) {
+	EDB_PERRF("ERROR: Failed to read data page %" EDB_PRIpgid " (%" EDB_PRIpgid ")\n",
+		  it->nextDataPage,
+		  it->nextDataPage % state->numDataPages);
+	return 0;
+      }
+      
+      count_t pageRecordCount = 0;
+      int8_t *records = NULL;
+      if (searchWriteBuf == 0) {
+	int8_t *buf = (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize;
+	records = buf + state->headerSize;
+	pageRecordCount = EMBEDDB_GET_COUNT(buf);
+      } else {
+	records = memoryPageRecords(state, it->nextDataPage, &pageRecordCount);
+      }
+      if (it->nextDataRec == EMBEDDB_ITERATOR_PAGE_START) {
+	it->nextDataRec = pageRecordCount;
+      }
+      
+      // Keep reading records back to the start of the page until one
+      // matches the query. nextDataRec is left on the returned record.
+      while (it->nextDataRec > 0) {
+	it->nextDataRec--;
+	memcpy(key, records + it->nextDataRec * state->recordSize, state->keySize);
+	memcpy(data, records + it->nextDataRec * state->recordSize + state->keySize,
+	       state->dataSize);
+	
+	// Check record
+	if (it->maxKey != NULL && state->compareKey(key, it->maxKey) > 0)
+	  continue;
+	if (it->minKey != NULL && state->compareKey(key, it->minKey) < 0)
+	  return 0;
+	if (it->minData != NULL && state->compareData(data, it->minData) < 0)
+	  continue;
+	if (it->maxData != NULL && state->compareData(data, it->maxData) > 0)
+	  continue;
+	
+	// If we make it here, the record matches the query
+	return 1;
+      }
+    }
+    
+    // Finished the page without a match, so move to the previous one
+    if (it->nextDataPage <= state->minDataPageId) {
+      return 0;
+    }
+    it->nextDataPage--;
+    it->nextDataRec = EMBEDDB_ITERATOR_PAGE_START;
+  }
+}
+
+/**
+ * @brief	Moves a reverse iterator to the previous record for a variable
+ *          data read, leaving its page in the data read buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure initialized by
+ *                  embedDBInitIteratorReverse
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if no more records
+ */
+static int8_t
+prevVarRecord(embedDBState *    state,
+	      embedDBIterator * it,
+	      void *            key,
+	      void *            data)
+{
+  if (!embedDBPrev(state, it, key, data)) {
+    return 0;
+  }
+  
+  /* Records from the write buffer may point into the var write buffer */
+  if (it->nextDataPage >= state->nextDataPageId) {
+    readToWriteBuf(state);
+    flushVarSharingSlot(state);
+  }
+  return 1;
+}
+
+/**
+ * @brief	Return previous key, data, variable data set for a reverse
+ *          iterator.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure initialized by
+ *                  embedDBInitIteratorReverse
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
  * @param varData  Return variable for variable data as a
  *                 embedDBVarDataStream (Unallocated). Returns NULL if
- *                 no variable data. **Be sure to free the stream
- *                 after you are done with it**
- * @return Returns  0 if sucessfull or no variable data for the record,
- *                  1 if the records variable data was overwritten, 2
- *                  if the page failed to read, and 3 if the memorey
- *                  failed to allocate.
- 
+ *                 no variable data. **Be sure to free the stream with
+ *                 embedDBFreeVarDataStream after you are done with it**
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t
+embedDBPrevVar(embedDBState *          state,
+	       embedDBIterator *       it,
+	       void *                  key,
+	       void *                  data,
+	       embedDBVarDataStream ** varData)
+{
+  if (!EMBEDDB_USING_VDATA(state->parameters)) {
+    EDB_PERRF("ERROR: embedDBPrevVar called when not using variable data\n");
+    return 0;
+  }
+  
+  if (!prevVarRecord(state, it, key, data)) {
+    return 0;
+  }
+  
+  int8_t setupResult = embedDBSetupVarDataStream(state, key, varData, it->nextDataRec);
+  switch (setupResult) {
+  case 0:
+  case 1:
+    return 1;
+  case 2:
+  case 3:
+    return 0;
+  }
+  
+  return 0;
+}
+
+/**
+ * @brief	Return previous key, data, variable data set for a reverse
+ *          iterator, setting up a caller-allocated stream for the variable
+ *          data.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure initialized by
+ *                  embedDBInitIteratorReverse
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @param	varData	Pre-allocated stream for the variable data. totalBytes
+ *                  is set to 0 if the record has no variable data or it
+ *                  was deleted.
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t
+embedDBPrevVarInto(embedDBState *         state,
+		   embedDBIterator *      it,
+		   void *                 key,
+		   void *                 data,
+		   embedDBVarDataStream * varData)
+{
+  if (!EMBEDDB_USING_VDATA(state->parameters)) {
+    EDB_PERRF("ERROR: embedDBPrevVarInto called when not using variable data\n");
+    return 0;
+  }
+  
+  if (!prevVarRecord(state, it, key, data)) {
+    return 0;
+  }
+  return fillVarDataStream(state, key, varData, it->nextDataRec) < 2;
+}
+
+/**
+ * @brief	Sets up a stream to return the variable data for a record on the
+ *          page in the data read buffer. The stream is left empty, with
+ *          dataStart set to EMBEDDB_NO_VAR_DATA, if there is no variable data
+ *          to read.
+ * @param	state			embedDB algorithm state structure
+ * @param	key				Key for the record
+ * @param	stream			Stream to set up
+ * @param	recordNumber	Record number on the page
+ * @return	Returns 0 if sucessfull or no variable data for the record, 1 if
+ *          the records variable data was overwritten, and 2 if the page
+ *          failed to read.
  */
 static int8_t
-embedDBSetupVarDataStream(embedDBState *          state,
-			  void *                  key,
-			  embedDBVarDataStream ** varData,
-			  pgid_t                  recordNumber)
+fillVarDataStream(embedDBState *         state,
+		  void *                 key,
+		  embedDBVarDataStream * stream,
+		  pgid_t                 recordNumber)
 {
   void *dataBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
   void *record = (int8_t *)dataBuf + state->headerSize + recordNumber * state->recordSize;
   
-  uint32_t varDataAddr = 0;
-  memcpy(&varDataAddr, (int8_t *)record + state->keySize + state->dataSize, sizeof(uint32_t));
+  stream->dataStart = EMBEDDB_NO_VAR_DATA;
+  stream->totalBytes = 0;
+  stream->bytesRead = 0;
+  stream->fileOffset = EMBEDDB_NO_VAR_DATA;
+  stream->blockStart = EMBEDDB_NO_VAR_DATA;
+  
+  varaddr_t varDataAddr = 0;
+  memcpy(&varDataAddr, (int8_t *)record + state->keySize + state->dataSize, sizeof(varaddr_t));
   if (varDataAddr == EMBEDDB_NO_VAR_DATA) {
-    *varData = NULL;
     return 0;
   }
   
   // Check if the variable data associated with this key has been overwritten due to file wrap around
   if (state->compareKey(key, &state->minVarRecordId) < 0) {
-    *varData = NULL;
     return 1;
   }
   
-  uint32_t pageNum = (varDataAddr / state->pageSize) % state->numVarPages;
+  return openVarData(state, varDataAddr, stream);
+}
+
+/**
+ * @brief	Returns if a variable data page is still on storage or in the
+ *          write buffer, rather than erased to make room for newer data.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageId	Logical variable page id
+ * @return	True if the page holds its data
+ */
+static bool
+varPageStored(embedDBState * state,
+	      pgid_t         pageId)
+{
+  return pageId <= state->nextVarPageId &&
+    pageId >= state->nextVarPageId + state->numAvailVarPages - state->numVarPages;
+}
+
+/**
+ * @brief	Sets up a stream to return the variable data whose length is
+ *          stored at a given address. Data stored once for an earlier record
+ *          is followed to its copy.
+ * @param	state		embedDB algorithm state structure
+ * @param	varDataAddr	Address of the length of the variable data
+ * @param	stream		Stream to set up
+ * @return	Returns 0 if sucessfull, 1 if the earlier copy of deduplicated
+ *          data was erased, and 2 if the page failed to read.
+ */
+static int8_t
+openVarData(embedDBState *         state,
+	    varaddr_t              varDataAddr,
+	    embedDBVarDataStream * stream)
+{
+  uint32_t pageNum = (uint32_t)(varDataAddr / state->pageSize % state->numVarPages);
   
   // Read in page
-  if (readVariablePage(state, pageNum) != 0) {
+  if (readVarStreamPage(state, pageNum) != 0) {
     EDB_PERRF("ERROR: embedDB failed to read variable page\n");
     return 2;
   }
@@ -2073,158 +5034,1029 @@ embedDBSetupVarDataStream(embedDBState *          state,
   uint32_t dataLen = 0;
   memcpy(&dataLen, (int8_t *)varBuf + pageOffset, sizeof(uint32_t));
   
-  // Move var data address to the beginning of the data, past the data length
-  varDataAddr = (varDataAddr + sizeof(uint32_t)) % (state->numVarPages * state->pageSize);
+  // Deduplicated data is read from its earlier copy, while that is not erased
+  if (dataLen & EMBEDDB_VAR_REFERENCE) {
+    varByteReader reader = {state, varDataAddr + sizeof(uint32_t), pageNum};
+    uint8_t reference[sizeof(varaddr_t) + sizeof(pgid_t)];
+    for (uint32_t i = 0; i < sizeof(reference); i++) {
+      if (!readVarByte(&reader, reference + i)) {
+	EDB_PERRF("ERROR: embedDB failed to read variable page\n");
+	return 2;
+      }
+    }
+    varaddr_t copyAddr = 0;
+    pgid_t copyPageId = 0;
+    memcpy(&copyAddr, reference, sizeof(varaddr_t));
+    memcpy(&copyPageId, reference + sizeof(varaddr_t), sizeof(pgid_t));
+    if (!varPageStored(state, copyPageId)) {
+      return 1;
+    }
+    return openVarData(state, copyAddr, stream);
+  }
+  
+  // Move var data address to the beginning of the data, past the data length
+  varDataAddr = (varDataAddr + sizeof(uint32_t)) % EMBEDDB_VAR_FILE_SIZE(state);
+  
+  // If we end up on the page boundary, we need to move past the header
+  if (varDataAddr % state->pageSize == 0) {
+    varDataAddr += state->variableDataHeaderSize;
+    varDataAddr %= EMBEDDB_VAR_FILE_SIZE(state);
+  }
+  
+  stream->dataStart = varDataAddr;
+  stream->totalBytes = dataLen;
+  stream->bytesRead = 0;
+  stream->fileOffset = varDataAddr;
+  stream->blockStart = EMBEDDB_NO_VAR_DATA;
+  
+  // Compressed data is read a block at a time, starting with the first one
+  if (dataLen & EMBEDDB_VAR_COMPRESSED) {
+    stream->totalBytes = dataLen & ~EMBEDDB_VAR_COMPRESSED;
+    stream->blockStart = varDataAddr;
+    stream->fileOffset = EMBEDDB_NO_VAR_DATA;
+  }
+  return 0;
+}
+
+/**
+ * @brief	Takes a stream from the stream pool, or allocates one when not
+ *          using the pool.
+ * @param	state	embedDB algorithm state structure
+ * @return	The stream, or NULL if none is available
+ */
+static embedDBVarDataStream *
+allocVarDataStream(embedDBState * state)
+{
+  if (EMBEDDB_USING_VAR_STREAM_POOL(state->parameters)) {
+    for (count_t i = 0; i < state->varStreamPoolSize; i++) {
+      uint32_t mask = (uint32_t)1 << i;
+      if (!(state->varStreamPoolInUse & mask)) {
+	state->varStreamPoolInUse |= mask;
+	return state->varStreamPool + i;
+      }
+    }
+    return NULL;
+  }
+  
+  embedDBVarDataStream *stream = NULL;
+  if (EDB_WITH_HEAP) {
+    stream = malloc(sizeof(embedDBVarDataStream));
+  }
+  return stream;
+}
+
+/**
+ * @brief	Frees a stream returned by embedDBGetVar, embedDBGetManyVar,
+ *          embedDBNextVar or embedDBPrevVar. Streams from the stream pool
+ *          are returned to the pool.
+ * @param	state	embedDB algorithm state structure
+ * @param	stream	Variable data stream, or NULL
+ */
+void
+embedDBFreeVarDataStream(embedDBState *         state,
+			 embedDBVarDataStream * stream)
+{
+  if (stream == NULL) {
+    return;
+  }
+  
+  if (EMBEDDB_USING_VAR_STREAM_POOL(state->parameters) &&
+      stream >= state->varStreamPool &&
+      stream < state->varStreamPool + state->varStreamPoolSize) {
+    state->varStreamPoolInUse &= ~((uint32_t)1 << (stream - state->varStreamPool));
+    return;
+  }
+  
+  if (EDB_WITH_HEAP) {
+    free(stream);
+  }
+}
+
+/**
+ * @brief Setup varDataStream object to return the variable data for a record
+ * @param	state	embedDB algorithm state structure
+ * @param   key     Key for the record
+ * @param varData  Return variable for variable data as a
+ *                 embedDBVarDataStream (Unallocated). Returns NULL if
+ *                 no variable data. **Be sure to free the stream with
+ *                 embedDBFreeVarDataStream after you are done with it**
+ * @return Returns  0 if sucessfull or no variable data for the record,
+ *                  1 if the records variable data was overwritten, 2
+ *                  if the page failed to read, and 3 if no stream could
+ *                  be allocated or taken from the stream pool.
+ 
+ */
+static int8_t
+embedDBSetupVarDataStream(embedDBState *          state,
+			  void *                  key,
+			  embedDBVarDataStream ** varData,
+			  pgid_t                  recordNumber)
+{
+  embedDBVarDataStream stream;
+  *varData = NULL;
+  int8_t result = fillVarDataStream(state, key, &stream, recordNumber);
+  if (result != 0 || stream.dataStart == EMBEDDB_NO_VAR_DATA) {
+    return result;
+  }
+  
+  // Create varDataStream
+  embedDBVarDataStream *varDataStream = allocVarDataStream(state);
+  if (!varDataStream) {
+    EDB_PERRF("ERROR: Failed to alloc memory for embedDBVarDataStream\n");
+    return 3;
+  }
+  
+  *varDataStream = stream;
+  *varData = varDataStream;
+  return 0;
+}
+
+/**
+ * @brief	Reads data from variable data stream into the given buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	stream	Variable data stream
+ * @param	buffer	Buffer to read data into
+ * @param	length	Number of bytes to read (Must be <= buffer size)
+ * @return	Number of bytes read
+ */
+uint32_t
+embedDBVarDataStreamRead(embedDBState *         state,
+			 embedDBVarDataStream * stream,
+			 void *                 buffer,
+			 uint32_t               length)
+{
+  if (buffer == NULL) {
+    EDB_PERRF("ERROR: Cannot pass null buffer to embedDBVarDataStreamRead\n");
+    return 0;
+  }
+  
+  if (stream->bytesRead >= stream->totalBytes) {
+    return 0;
+  }
+  
+  if (stream->blockStart != EMBEDDB_NO_VAR_DATA) {
+    return readCompressedVarStream(state, stream, (uint8_t *)buffer, length);
+  }
+  
+  // Keep reading in data until the buffer is full
+  void *varDataBuf = (int8_t *)state->buffer +
+    state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+  uint32_t amtRead = 0;
+  bool pageLoaded = false;
+  while (amtRead < length && stream->bytesRead < stream->totalBytes) {
+    // Skip past the header when starting a page
+    if (stream->fileOffset % state->pageSize == 0) {
+      stream->fileOffset += state->variableDataHeaderSize;
+    }
+    
+    if (!pageLoaded) {
+      // Whole pages go straight into the buffer
+      int32_t directRead = readVarStreamDirect(state, stream, (int8_t *)buffer, amtRead, length);
+      if (directRead < 0) {
+	EDB_PERRF("ERROR: Couldn't read variable data pages\n");
+	return 0;
+      }
+      if (directRead > 0) {
+	amtRead += directRead;
+	continue;
+      }
+      
+      // Read in var page containing the data to read
+      uint32_t pageNum = (uint32_t)(stream->fileOffset / state->pageSize % state->numVarPages);
+      if (readVarStreamPage(state, pageNum) != 0) {
+	EDB_PERRF("ERROR: Couldn't read variable data page %" PRIu32 "\n", pageNum);
+	return 0;
+      }
+      pageLoaded = true;
+    }
+    
+    uint32_t pageOffset = stream->fileOffset % state->pageSize;
+    uint32_t amtToRead = min(stream->totalBytes - stream->bytesRead,
+			     min(state->pageSize - pageOffset, length - amtRead));
+    memcpy((int8_t *)buffer + amtRead, (int8_t *)varDataBuf + pageOffset, amtToRead);
+    amtRead += amtToRead;
+    stream->bytesRead += amtToRead;
+    stream->fileOffset += amtToRead;
+    
+    // The rest of the data is on the next page
+    if (stream->fileOffset % state->pageSize == 0) {
+      pageLoaded = false;
+    }
+  }
+  
+  return amtRead;
+}
+
+/**
+ * @brief	Returns the file offset of the variable data byte a number of
+ *          bytes after another, skipping the headers of the pages between.
+ * @param	state		embedDB algorithm state structure
+ * @param	fileOffset	File offset of a variable data byte
+ * @param	numBytes	Number of bytes to move forward
+ * @return	File offset of the byte, never at the start of a page header
+ */
+static varaddr_t
+varDataOffsetAdd(embedDBState * state,
+		 varaddr_t      fileOffset,
+		 uint32_t       numBytes)
+{
+  if (fileOffset % state->pageSize == 0) {
+    fileOffset += state->variableDataHeaderSize;
+  }
+  
+  // Data on the first page runs to the end of the page
+  uint32_t firstPageBytes = state->pageSize - fileOffset % state->pageSize;
+  if (numBytes < firstPageBytes) {
+    return fileOffset + numBytes;
+  }
+  
+  // Every later page holds pageSize - variableDataHeaderSize bytes
+  uint32_t dataPerPage = state->pageSize - state->variableDataHeaderSize;
+  uint32_t pageBytes = numBytes - firstPageBytes;
+  varaddr_t page = fileOffset / state->pageSize + 1 + pageBytes / dataPerPage;
+  return page * state->pageSize + state->variableDataHeaderSize + pageBytes % dataPerPage;
+}
+
+/**
+ * @brief	Returns the next byte of variable data for lzDecompress.
+ * @param	source	varByteReader to read from
+ * @param	byte	Return variable for the byte
+ * @return	true on success, false if the page could not be read
+ */
+static bool
+readVarByte(void *    source,
+	    uint8_t * byte)
+{
+  varByteReader *reader = (varByteReader *)source;
+  embedDBState *state = reader->state;
+  if (reader->fileOffset % state->pageSize == 0) {
+    reader->fileOffset += state->variableDataHeaderSize;
+  }
+  
+  pgid_t pageNum = (reader->fileOffset / state->pageSize) % state->numVarPages;
+  if (pageNum != reader->pageNum) {
+    if (readVarStreamPage(state, pageNum) != 0) {
+      return false;
+    }
+    reader->pageNum = pageNum;
+  }
+  
+  uint8_t *varBuf = (uint8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+  *byte = varBuf[reader->fileOffset % state->pageSize];
+  reader->fileOffset++;
+  return true;
+}
+
+/**
+ * @brief	Reads the 2 byte stored length at the start of a compressed block.
+ * @param	reader	Reader at the start of the block, left after the length
+ * @param	length	Return variable for the stored length
+ * @return	true on success, false if the page could not be read
+ */
+static bool
+readVarBlockLength(varByteReader * reader,
+		   uint16_t *      length)
+{
+  uint8_t bytes[sizeof(uint16_t)];
+  if (!readVarByte(reader, bytes) || !readVarByte(reader, bytes + 1)) {
+    return false;
+  }
+  memcpy(length, bytes, sizeof(uint16_t));
+  return true;
+}
+
+/**
+ * @brief	Makes sure the block at blockStart of a compressed stream is
+ *          decompressed in the codec buffer, and sets fileOffset to the
+ *          start of the block after it. The buffer remembers the last block
+ *          decompressed, so streams only decompress a block again if another
+ *          block was read in between.
+ * @param	state	embedDB algorithm state structure
+ * @param	stream	Variable data stream of compressed data
+ * @return	0 if success, -1 if a page could not be read or the block is
+ *          not valid
+ */
+static int8_t
+loadVarCodecBlock(embedDBState *         state,
+		  embedDBVarDataStream * stream)
+{
+  varaddr_t blockId = stream->blockStart % EMBEDDB_VAR_FILE_SIZE(state);
+  bool loaded = state->varCodecBlock == blockId;
+  if (loaded && stream->fileOffset != EMBEDDB_NO_VAR_DATA) {
+    return 0;
+  }
+  
+  varByteReader reader = {state, stream->blockStart, EMBEDDB_NO_VAR_DATA};
+  uint16_t storedLength = 0;
+  if (!readVarBlockLength(&reader, &storedLength)) {
+    return -1;
+  }
+  uint32_t blockOffset = stream->bytesRead % EMBEDDB_VAR_BLOCK_SIZE(state);
+  uint16_t blockLength = min(EMBEDDB_VAR_BLOCK_SIZE(state), stream->totalBytes - (stream->bytesRead - blockOffset));
+  if (storedLength == 0 || storedLength > blockLength) {
+    return -1;
+  }
+  stream->fileOffset = varDataOffsetAdd(state, reader.fileOffset, storedLength);
+  if (loaded) {
+    return 0;
+  }
+  
+  // Blocks that did not compress are stored as they are
+  uint8_t *codecBuf = (uint8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_CODEC_BUFFER(state->parameters);
+  state->varCodecBlock = EMBEDDB_NO_VAR_DATA;
+  if (storedLength == blockLength) {
+    for (uint16_t i = 0; i < blockLength; i++) {
+      if (!readVarByte(&reader, codecBuf + i)) {
+	return -1;
+      }
+    }
+  } else if (lzDecompress(readVarByte, &reader, storedLength, codecBuf, blockLength) != blockLength) {
+    return -1;
+  }
+  state->varCodecBlock = blockId;
+  return 0;
+}
+
+/**
+ * @brief	Reads data from a stream of compressed variable data into the
+ *          given buffer, one decompressed block at a time.
+ * @param	state	embedDB algorithm state structure
+ * @param	stream	Variable data stream of compressed data
+ * @param	buffer	Buffer to read data into
+ * @param	length	Number of bytes to read (Must be <= buffer size)
+ * @return	Number of bytes read
+ */
+static uint32_t
+readCompressedVarStream(embedDBState *         state,
+			embedDBVarDataStream * stream,
+			uint8_t *              buffer,
+			uint32_t               length)
+{
+  uint8_t *codecBuf = (uint8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_CODEC_BUFFER(state->parameters);
+  uint32_t amtRead = 0;
+  while (amtRead < length && stream->bytesRead < stream->totalBytes) {
+    if (loadVarCodecBlock(state, stream) != 0) {
+      EDB_PERRF("ERROR: Couldn't read compressed variable data block\n");
+      return 0;
+    }
+    
+    uint32_t blockOffset = stream->bytesRead % EMBEDDB_VAR_BLOCK_SIZE(state);
+    uint32_t blockLength = min(EMBEDDB_VAR_BLOCK_SIZE(state), stream->totalBytes - (stream->bytesRead - blockOffset));
+    uint32_t amtToRead = min(blockLength - blockOffset, length - amtRead);
+    memcpy(buffer + amtRead, codecBuf + blockOffset, amtToRead);
+    amtRead += amtToRead;
+    stream->bytesRead += amtToRead;
+    
+    // Move on to the next block
+    if (stream->bytesRead % EMBEDDB_VAR_BLOCK_SIZE(state) == 0) {
+      stream->blockStart = stream->fileOffset;
+      stream->fileOffset = EMBEDDB_NO_VAR_DATA;
+    }
+  }
+  return amtRead;
+}
+
+/**
+ * @brief	Moves a variable data stream to a byte offset in its data, so the
+ *          next read starts there. The page holding the offset is found
+ *          from the page size and header size, without reading any pages.
+ *          For compressed data, the stored lengths of the blocks before the
+ *          offset are read instead.
+ * @param	state	embedDB algorithm state structure
+ * @param	stream	Variable data stream
+ * @param	offset	Offset in bytes from the start of the data, at most
+ *                  totalBytes
+ * @return	0 if success, -1 if the offset is past the end of the data
+ */
+int8_t
+embedDBVarDataStreamSeek(embedDBState *         state,
+			 embedDBVarDataStream * stream,
+			 uint32_t               offset)
+{
+  if (offset > stream->totalBytes) {
+    EDB_PERRF("ERROR: Cannot seek past the end of a variable data stream\n");
+    return -1;
+  }
+  
+  if (stream->blockStart == EMBEDDB_NO_VAR_DATA) {
+    stream->fileOffset = varDataOffsetAdd(state, stream->dataStart, offset);
+  } else if (offset < stream->totalBytes) {
+    // Walk the block lengths from the current block or the first one
+    uint32_t block = offset / EMBEDDB_VAR_BLOCK_SIZE(state);
+    uint32_t currentBlock = stream->bytesRead / EMBEDDB_VAR_BLOCK_SIZE(state);
+    varaddr_t blockStart = stream->dataStart;
+    uint32_t i = 0;
+    if (stream->bytesRead < stream->totalBytes && currentBlock <= block) {
+      blockStart = stream->blockStart;
+      i = currentBlock;
+    }
+    for (; i < block; i++) {
+      varByteReader reader = {state, blockStart, EMBEDDB_NO_VAR_DATA};
+      uint16_t storedLength = 0;
+      if (!readVarBlockLength(&reader, &storedLength)) {
+	EDB_PERRF("ERROR: Couldn't read compressed variable data block\n");
+	return -1;
+      }
+      blockStart = varDataOffsetAdd(state, reader.fileOffset, storedLength);
+    }
+    if (blockStart != stream->blockStart) {
+      stream->blockStart = blockStart;
+      stream->fileOffset = EMBEDDB_NO_VAR_DATA;
+    }
+  }
+  stream->bytesRead = offset;
+  return 0;
+}
+
+/**
+ * @brief	Reads whole variable data pages of a stream straight into the
+ *          caller's buffer, leaving out their headers. Pages are read when
+ *          the stream is at the start of a page's data and the buffer has
+ *          room for all of its data. The header of the first page lands on
+ *          the variableDataHeaderSize bytes before the data, which are
+ *          restored after the read.
+ * @param	state	embedDB algorithm state structure
+ * @param	stream	Variable data stream
+ * @param	buffer	Buffer the stream is being read into
+ * @param	amtRead	Number of bytes already in the buffer
+ * @param	length	Size of the buffer
+ * @return	Number of bytes read, 0 if no page could be read straight into
+ *          the buffer, and -1 if a read failed.
+ */
+static int32_t
+readVarStreamDirect(embedDBState *         state,
+		    embedDBVarDataStream * stream,
+		    int8_t *               buffer,
+		    uint32_t               amtRead,
+		    uint32_t               length)
+{
+  uint32_t headerSize = state->variableDataHeaderSize;
+  uint32_t dataPerPage = state->pageSize - headerSize;
+  if (stream->fileOffset % state->pageSize != headerSize || amtRead < headerSize) {
+    return 0;
+  }
+  
+  // Pages must end within the buffer and the stream
+  uint32_t remaining = min(length - amtRead, stream->totalBytes - stream->bytesRead);
+  pgid_t pageNum = (stream->fileOffset / state->pageSize) % state->numVarPages;
+  uint32_t numPages = (remaining + headerSize) / state->pageSize;
+  
+  // Stop at the end of the file and at the page still in the write buffer
+  numPages = min(numPages, state->numVarPages - pageNum);
+  pgid_t writeBufferPage = state->nextVarPageId % state->numVarPages;
+  if (state->numAvailVarPages > 0 && writeBufferPage >= pageNum &&
+      writeBufferPage < pageNum + numPages) {
+    numPages = writeBufferPage - pageNum;
+  }
+  if (numPages == 0) {
+    return 0;
+  }
+  
+  // Keep the bytes the first header lands on in the var read buffer
+  int8_t *dest = buffer + amtRead;
+  void *varBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+  memcpy(varBuf, dest - headerSize, headerSize);
+  state->bufferedVarPage = -1;
+  
+  bool success = true;
+  if (state->fileInterface->readPages != NULL) {
+    success = state->fileInterface->readPages(dest - headerSize, pageNum, numPages,
+					      state->pageSize, state->varFile);
+    // Move the data of each page down over the headers before it
+    for (uint32_t i = 1; success && i < numPages; i++) {
+      memmove(dest + i * dataPerPage, dest + i * state->pageSize, dataPerPage);
+    }
+  } else {
+    // Reading the last page first lets each page's data cover the header after it
+    for (uint32_t i = numPages; success && i > 0; i--) {
+      success = state->fileInterface->read(dest + (i - 1) * dataPerPage - headerSize,
+					   pageNum + i - 1, state->pageSize, state->varFile);
+    }
+  }
+  memcpy(dest - headerSize, varBuf, headerSize);
+  if (!success) {
+    return -1;
+  }
+  
+  state->numReads += numPages;
+  if (EMBEDDB_USING_VAR_READ_AHEAD(state->parameters)) {
+    state->varReadAheadNext = pageNum + numPages;
+  }
+  stream->bytesRead += numPages * dataPerPage;
+  stream->fileOffset += numPages * state->pageSize;
+  return numPages * dataPerPage;
+}
+
+/**
+ * @brief	Prints statistics.
+ * @param	state	embedDB state structure
+ */
+void
+embedDBPrintStats(embedDBState *state)
+{
+  EDB_PRINTF("Num reads: %" EDB_PRIpgid "\n", state->numReads);
+  EDB_PRINTF("Buffer hits: %" EDB_PRIpgid "\n", state->bufferHits);
+  EDB_PRINTF("Num writes: %" EDB_PRIpgid "\n", state->numWrites);
+  EDB_PRINTF("Num index reads: %" EDB_PRIpgid "\n", state->numIdxReads);
+  EDB_PRINTF("Num index writes: %" EDB_PRIpgid "\n", state->numIdxWrites);
+  EDB_PRINTF("Max Error: %" PRId32 "\n", state->maxError);
+  
+  if (EMBEDDB_USING_SPLINE(state->parameters)) {
+    splinePrint(state->spl);
+  }
+  if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    fenceIndexPrint(state->fence);
+  }
+}
+
+/**
+ * @brief	Erases the data block starting at a page and drops the oldest
+ *          pages, which are stored there, from the page indexes.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageNum	Logical page id of the first page in the block
+ * @return	Return 0 if success, -1 if error.
+ */
+static int8_t
+eraseDataBlock(embedDBState *state,
+	       pgid_t        pageNum)
+{
+  pgid_t physicalPageNum = pageNum % state->numDataPages;
+  int8_t eraseResult =
+    state->fileInterface->erase(physicalPageNum,
+				physicalPageNum + state->eraseSizeInPages,
+				state->pageSize, state->dataFile);
+  if (eraseResult != 1) {
+    EDB_PERRF("Failed to erase data page: %" EDB_PRIpgid " (%" EDB_PRIpgid ")\n",
+	      pageNum, physicalPageNum);
+    return -1;
+  }
+  
+  /* Flag the pages as usable to EmbedDB */
+  state->numAvailDataPages += state->eraseSizeInPages;
+  state->minDataPageId += state->eraseSizeInPages;
+  
+  /* remove any spline points related to these pages */
+  if (EMBEDDB_USING_SPLINE(state->parameters) &&
+      !EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
+    cleanSpline(state, state->minDataPageId);
+  }
+  if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+    fenceIndexTrim(state->fence, state->minDataPageId);
+  }
+  return 0;
+}
+
+/**
+ * @brief	Erases the index block starting at a page.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageNum	Logical index page id of the first page in the block
+ * @return	Return 0 if success, -1 if error.
+ */
+static int8_t
+eraseIndexBlock(embedDBState *state,
+		pgid_t        pageNum)
+{
+  pgid_t physicalPageNumber = pageNum % state->numIndexPages;
+  int8_t eraseResult = state->fileInterface->erase(physicalPageNumber,
+						   physicalPageNumber + state->eraseSizeInPages,
+						   state->pageSize, state->indexFile);
+  if (eraseResult != 1) {
+    EDB_PERRF("Failed to erase index page: %" EDB_PRIpgid " (%" EDB_PRIpgid ")\n",
+	      pageNum, physicalPageNumber);
+    return -1;
+  }
+  state->numAvailIndexPages += state->eraseSizeInPages;
+  state->minIndexPageId += state->eraseSizeInPages;
+  return 0;
+}
+
+/**
+ * @brief	Erases the variable data block starting at a page and moves
+ *          minVarRecordId past the records whose data was stored there,
+ *          and past the records referencing deduplicated copies stored
+ *          there.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageNum	Logical variable page id of the first page in the block
+ * @return	Return 0 if success, -1 if error.
+ */
+static int8_t
+eraseVarBlock(embedDBState *state,
+	      pgid_t        pageNum)
+{
+  pgid_t physicalPageId = pageNum % state->numVarPages;
+  
+  // Read the last page of the block before it is erased to find which records lose their data
+  pgid_t lastPageId = (physicalPageId + state->eraseSizeInPages - 1) % state->numVarPages;
+  if (readVariablePage(state, lastPageId) != 0) {
+    return -1;
+  }
+  uint64_t lastRecordId = 0;
+  memcpy(&lastRecordId, (int8_t *)state->buffer +
+	 state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters) + sizeof(pgid_t),
+	 state->keySize);
+  
+  /* References written before embedDBInit are not in the dedup table. A
+     copy is only referenced from the following half of the file, so the
+     newest page that may reference the block bounds their keys. */
+  pgid_t lastLogicalPageId = pageNum + state->eraseSizeInPages - 1 - state->numVarPages;
+  if (EMBEDDB_DEDUPING_VDATA(state->parameters) && pageNum >= state->numVarPages &&
+      lastLogicalPageId < state->varDedupStartPageId) {
+    pgid_t refPageId = min(lastLogicalPageId + state->numVarPages / 2 - 1, state->varDedupStartPageId - 1);
+    if (refPageId > lastLogicalPageId) {
+      if (readVariablePage(state, refPageId % state->numVarPages) != 0) {
+	return -1;
+      }
+      memcpy(&lastRecordId, (int8_t *)state->buffer +
+	     state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters) + sizeof(pgid_t),
+	     state->keySize);
+    }
+  }
+  
+  int8_t eraseResult =
+    state->fileInterface->erase(physicalPageId, physicalPageId + state->eraseSizeInPages,
+				state->pageSize, state->varFile);
+  if (eraseResult != 1) {
+    EDB_PERRF("Failed to erase variable data page: %" EDB_PRIpgid " (%" EDB_PRIpgid ")\n",
+	      pageNum, physicalPageId);
+    return -1;
+  }
+  state->numAvailVarPages += state->eraseSizeInPages;
+  state->bufferedVarPage = -1;
+  if (EMBEDDB_USING_VAR_READ_AHEAD(state->parameters)) {
+    state->varReadAheadCount = 0;
+  }
+  // Add one because that record was erased. Erasing a copy may have moved it further already.
+  if (state->minVarRecordId == UINT64_MAX || lastRecordId + 1 > state->minVarRecordId) {
+    state->minVarRecordId = lastRecordId + 1;
+  }
+  
+  // Records referencing copies in the erased block lose their data too
+  if (EMBEDDB_DEDUPING_VDATA(state->parameters)) {
+    for (count_t i = 0; i < state->varDedupSlots; i++) {
+      embedDBVarDedupEntry *entry = state->varDedupTable + i;
+      if (entry->hash != 0 && !varPageStored(state, entry->pageId)) {
+	if (entry->refKey >= state->minVarRecordId) {
+	  state->minVarRecordId = entry->refKey + 1;
+	}
+	memset(entry, 0, sizeof(embedDBVarDedupEntry));
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief	Erases the next block of each file whose free pages have run
+ *          out, so the following page writes do not wait for an erase.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t
+embedDBPreErase(embedDBState *state)
+{
+  /* The shifting record-level consistency blocks keep the next data block erased */
+  if (!EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) &&
+      state->numAvailDataPages <= 0 &&
+      eraseDataBlock(state, state->nextDataPageId + state->dataTailWritten) != 0) {
+    return -1;
+  }
+  
+  if (state->indexFile != NULL && EMBEDDB_USING_INDEX(state->parameters) &&
+      state->numAvailIndexPages <= 0 &&
+      eraseIndexBlock(state, state->nextIdxPageId + state->indexTailWritten) != 0) {
+    return -1;
+  }
+  
+  if (EMBEDDB_USING_VDATA(state->parameters) && state->numAvailVarPages <= 0 &&
+      eraseVarBlock(state, state->nextVarPageId) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief	Reports the keys still stored and the space left in the data and
+ *          variable data regions.
+ * @param	state	embedDB algorithm state structure
+ * @param	data	Return variable for the data region
+ * @param	var		Return variable for the variable data region, may be NULL
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t
+embedDBGetSpaceInfo(embedDBState *state, embedDBRegionInfo *data, embedDBRegionInfo *var)
+{
+  memset(data, 0, sizeof(embedDBRegionInfo));
+  count_t count = EMBEDDB_GET_COUNT(state->buffer);
+  data->numPages = state->numDataPages;
+  data->freePages = state->numAvailDataPages;
+  /* The oldest block is erased by the insert that finds the write buffer full and no page free */
+  data->recordsUntilOverwrite = (state->maxRecordsPerPage - count) +
+    state->numAvailDataPages * state->maxRecordsPerPage;
+  data->freeBytes = data->recordsUntilOverwrite * state->recordSize;
+  
+  void *record = findLatestRecord(state);
+  if (record != NULL) {
+    memcpy(&data->maxKey, record, state->keySize);
+    void *oldest = (int8_t *)state->buffer + state->headerSize;
+    if (state->nextDataPageId > state->minDataPageId) {
+      if (readPage(state, state->minDataPageId % state->numDataPages) != 0) {
+	EDB_PERRF("ERROR: Failed to read the oldest data page\n");
+	return -1;
+      }
+      oldest = embedDBGetMinKey(state, (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER);
+    } else if (count == 0) {
+      oldest = state->reorderBuffer;
+    }
+    memcpy(&data->minKey, oldest, state->keySize);
+    data->hasKeys = 1;
+  } else if (state->nextDataPageId != state->minDataPageId) {
+    return -1;
+  }
+  
+  if (var == NULL) {
+    return 0;
+  }
+  memset(var, 0, sizeof(embedDBRegionInfo));
+  if (!EMBEDDB_USING_VDATA(state->parameters)) {
+    return 0;
+  }
+  
+  uint32_t dataPerPage = state->pageSize - state->variableDataHeaderSize;
+  uint32_t bufferUsed = state->currentVarLoc % state->pageSize - state->variableDataHeaderSize;
+  var->numPages = state->numVarPages;
+  var->freePages = state->numAvailVarPages;
+  /* The byte that fills the write buffer when no page is free erases the oldest block */
+  var->freeBytes = dataPerPage - bufferUsed - 1 + state->numAvailVarPages * dataPerPage;
+  if (state->minVarRecordId != UINT64_MAX && data->hasKeys) {
+    var->minKey = state->minVarRecordId;
+    var->maxKey = data->maxKey;
+    var->hasKeys = 1;
+  }
+  
+  /* Predict the inserts left from the average variable data per record so far */
+  uint64_t bytesWritten = (uint64_t)state->nextVarPageId * dataPerPage + bufferUsed;
+  uint64_t recordsWritten = (uint64_t)state->nextDataPageId * state->maxRecordsPerPage + count;
+  if (bytesWritten == 0) {
+    var->recordsUntilOverwrite = UINT32_MAX;
+  } else {
+    uint64_t records = var->freeBytes * recordsWritten / bytesWritten;
+    var->recordsUntilOverwrite = records > UINT32_MAX ? UINT32_MAX : (uint32_t)records;
+  }
+  return 0;
+}
+
+/**
+ * @brief	Moves pages from the data region to the variable data region,
+ *          or back if numPages is negative. Only the page counts change, so
+ *          the logical page ids a region keeps must map to the same physical
+ *          pages under both counts. Before a region wraps its ids are below
+ *          both counts. A wrapped data region can grow when the next page
+ *          starts a pass and its pages start at a multiple of the new count,
+ *          and shrink when the newest pages that fit start at slot 0 under
+ *          both counts. The older pages are then dropped as if erased. A
+ *          wrapped variable data region can only grow, like the data region.
+ * @param	state		embedDB algorithm state structure
+ * @param	numPages	Pages to move, a multiple of eraseSizeInPages
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t
+embedDBRebalance(embedDBState *state, int32_t numPages)
+{
+  if (!EMBEDDB_USING_VDATA(state->parameters) || EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+    EDB_PERRF("ERROR: Rebalancing needs variable data and does not support "
+	      "record-level consistency.\n");
+    return -1;
+  }
+  
+  if (numPages % (int32_t)state->eraseSizeInPages != 0) {
+    EDB_PERRF("ERROR: The number of pages to move must be divisible by the erase size in pages.\n");
+    return -1;
+  }
+  
+  int64_t numDataPages = (int64_t)state->numDataPages - numPages;
+  int64_t numVarPages = (int64_t)state->numVarPages + numPages;
+  if (numDataPages < (EMBEDDB_USING_INDEX(state->parameters) * 2 + 2) * state->eraseSizeInPages ||
+      numVarPages < 2 * state->eraseSizeInPages) {
+    EDB_PERRF("ERROR: Rebalancing would leave a region smaller than its minimum.\n");
+    return -1;
+  }
+#if !defined(EMBEDDB_64BIT_PAGE_IDS)
+  if (numVarPages * state->pageSize > UINT32_MAX) {
+    EDB_PERRF("ERROR: Rebalancing would make the variable data file 4 GB or more.\n");
+    return -1;
+  }
+#endif
+  
+  /* A wrapped data region holds ids up to nextDataPageId - 1 in the pass
+   * before the next page. Growing keeps the whole pass, which starts at
+   * nextDataPageId - numDataPages. Shrinking keeps the newest new count
+   * pages, which start at nextDataPageId - numDataPages'. A tail page
+   * written by a flush would move, so it must be completed first. */
+  pgid_t nextDataPageId = state->nextDataPageId;
+  bool dataWrapped = state->minDataPageId != 0;
+  bool dataFits;
+  if (!dataWrapped) {
+    dataFits = (int64_t)state->numAvailDataPages - numPages >= 0;
+  } else if (state->dataTailWritten) {
+    dataFits = false;
+  } else if (numPages <= 0) {
+    dataFits = nextDataPageId % state->numDataPages == 0 &&
+      (nextDataPageId - state->numDataPages) % (pgid_t)numDataPages == 0;
+  } else {
+    dataFits = nextDataPageId % state->numDataPages == (pgid_t)numDataPages &&
+      nextDataPageId % (pgid_t)numDataPages == 0;
+  }
+  
+  /* A wrapped variable data region can only grow, and only when the next page
+   * starts a pass over the region with no data buffered for it. Its pages then
+   * hold ids nextVarPageId - numVarPages up to nextVarPageId - 1, which keep
+   * their slots under the new count if the first of them is a multiple of it. */
+  bool varWrapped = state->nextVarPageId + state->numAvailVarPages != state->numVarPages;
+  bool varFits;
+  if (!varWrapped) {
+    varFits = (int64_t)state->numAvailVarPages + numPages >= 0;
+  } else {
+    varFits = numPages >= 0 &&
+      state->nextVarPageId % state->numVarPages == 0 &&
+      (state->nextVarPageId - state->numVarPages) % (pgid_t)numVarPages == 0 &&
+      state->currentVarLoc % state->pageSize == state->variableDataHeaderSize;
+  }
   
-  // If we end up on the page boundary, we need to move past the header
-  if (varDataAddr % state->pageSize == 0) {
-    varDataAddr += state->variableDataHeaderSize;
-    varDataAddr %= (state->numVarPages * state->pageSize);
+  if (!dataFits || !varFits) {
+    EDB_PERRF("ERROR: Rebalancing would move pages a region still holds, or "
+	      "drop pages before the region has wrapped.\n");
+    return -1;
   }
   
-  // Create varDataStream
-  embedDBVarDataStream *varDataStream = NULL;
-  if (EDB_WITH_HEAP) {
-    varDataStream = malloc(sizeof(embedDBVarDataStream));
+  /* Batched pages are written to the slots of the old count */
+  if (EMBEDDB_BATCHING_WRITES(state->parameters) && writeDataBatch(state) != 0) {
+    return -1;
   }
-  if (!varDataStream) {
-    EDB_PERRF("ERROR: Failed to alloc memory for embedDBVarDataStream\n");
-    return 3;
+  
+  if (dataWrapped && numPages < 0) {
+    /* The new pages may still hold pages from before an earlier shrink */
+    if (state->fileInterface->erase(state->numDataPages, (uint32_t)numDataPages,
+				    state->pageSize, state->dataFile) != 1) {
+      EDB_PERRF("ERROR: Failed to erase the new data pages.\n");
+      return -1;
+    }
+  } else if (dataWrapped && numPages > 0 &&
+	     state->minDataPageId < nextDataPageId - (pgid_t)numDataPages) {
+    /* The oldest pages are dropped as if their blocks had been erased */
+    pgid_t minDataPageId = nextDataPageId - (pgid_t)numDataPages;
+    state->numAvailDataPages += minDataPageId - state->minDataPageId;
+    state->minDataPageId = minDataPageId;
+    if (EMBEDDB_USING_SPLINE(state->parameters) &&
+	!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
+      cleanSpline(state, state->minDataPageId);
+    }
+    if (EMBEDDB_USING_FENCE_INDEX(state->parameters)) {
+      fenceIndexTrim(state->fence, state->minDataPageId);
+    }
   }
   
-  varDataStream->dataStart = varDataAddr;
-  varDataStream->totalBytes = dataLen;
-  varDataStream->bytesRead = 0;
-  varDataStream->fileOffset = varDataAddr;
+  state->numDataPages = (uint32_t)numDataPages;
+  state->numAvailDataPages -= numPages;
+  state->bufferedPageId = -1;
+  state->numVarPages = (uint32_t)numVarPages;
+  state->numAvailVarPages += numPages;
+  if (varWrapped) {
+    state->currentVarLoc = state->nextVarPageId % state->numVarPages * state->pageSize +
+      state->variableDataHeaderSize;
+  }
+  if (EMBEDDB_USING_VAR_READ_AHEAD(state->parameters)) {
+    state->varReadAheadCount = 0;
+  }
   
-  *varData = varDataStream;
+  if (EMBEDDB_USING_SUPERBLOCK(state->parameters)) {
+    return embedDBFlush(state);
+  }
   return 0;
 }
 
 /**
- * @brief	Reads data from variable data stream into the given buffer.
+ * @brief	Writes the pages in the write batch to storage with one write.
  * @param	state	embedDB algorithm state structure
- * @param	stream	Variable data stream
- * @param	buffer	Buffer to read data into
- * @param	length	Number of bytes to read (Must be <= buffer size)
- * @return	Number of bytes read
+ * @return	Return 0 if success, -1 if error.
  */
-uint32_t
-embedDBVarDataStreamRead(embedDBState *         state,
-			 embedDBVarDataStream * stream,
-			 void *                 buffer,
-			 uint32_t               length)
+static int8_t
+writeDataBatch(embedDBState *state)
 {
-  if (buffer == NULL) {
-    EDB_PERRF("ERROR: Cannot pass null buffer to embedDBVarDataStreamRead\n");
+  if (state->writeBatchCount == 0)
     return 0;
-  }
-  
-  // Read in var page containing the data to read
-  uint32_t pageNum = (stream->fileOffset / state->pageSize) % state->numVarPages;
-  if (readVariablePage(state, pageNum) != 0) {
-    EDB_PERRF("ERROR: Couldn't read variable data page %" PRIu32 "\n", pageNum);
-    return 0;
-  }
   
-  // Keep reading in data until the buffer is full
-  void *varDataBuf = (int8_t *)state->buffer +
-    state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
-  uint32_t amtRead = 0;
-  while (amtRead < length && stream->bytesRead < stream->totalBytes) {
-    uint16_t pageOffset = stream->fileOffset % state->pageSize;
-    uint32_t amtToRead = min(stream->totalBytes - stream->bytesRead,
-			     min(state->pageSize - pageOffset, length - amtRead));
-    memcpy((int8_t *)buffer + amtRead, (int8_t *)varDataBuf + pageOffset, amtToRead);
-    amtRead += amtToRead;
-    stream->bytesRead += amtToRead;
-    stream->fileOffset += amtToRead;
-    
-    // If we need to keep reading, read the next page
-    if (amtRead < length && stream->bytesRead < stream->totalBytes) {
-      pageNum = (pageNum + 1) % state->numVarPages;
-      if (readVariablePage(state, pageNum) != 0) {
-	EDB_PERRF("ERROR: Couldn't read variable data page %" PRIu32 "\n", pageNum);
-	return 0;
-      }
-      // Skip past the header
-      stream->fileOffset += state->variableDataHeaderSize;
+  /* Batches end on a batch boundary, so they never wrap past the end of the file */
+  pgid_t physicalPageNum = state->writeBatchPageId % state->numDataPages;
+  bool success = true;
+  if (state->fileInterface->writePages != NULL) {
+    success = state->fileInterface->writePages(state->writeBatch, physicalPageNum,
+					       state->writeBatchCount, state->pageSize,
+					       state->dataFile);
+  } else {
+    for (count_t i = 0; i < state->writeBatchCount && success; i++) {
+      success = state->fileInterface->write((int8_t *)state->writeBatch + i * state->pageSize,
+					    physicalPageNum + i, state->pageSize, state->dataFile);
     }
   }
+  if (!success) {
+    EDB_PERRF("Failed to write data pages: %" EDB_PRIpgid " (%" EDB_PRIpgid ")\n",
+	      state->writeBatchPageId, physicalPageNum);
+    return -1;
+  }
   
-  return amtRead;
+  state->writeBatchCount = 0;
+  return 0;
 }
 
 /**
- * @brief	Prints statistics.
- * @param	state	embedDB state structure
+ * @brief	Adds a data page to the write batch, writing the batch once it
+ *          reaches a batch boundary.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Page to add
+ * @param	pageNum	Logical page id of the page
+ * @return	Return 0 if success, -1 if error.
  */
-void
-embedDBPrintStats(embedDBState *state)
+static int8_t
+batchDataPage(embedDBState *state,
+	      void *         buffer,
+	      pgid_t         pageNum)
 {
-  EDB_PRINTF("Num reads: %" PRIu32 "\n", state->numReads);
-  EDB_PRINTF("Buffer hits: %" PRIu32 "\n", state->bufferHits);
-  EDB_PRINTF("Num writes: %" PRIu32 "\n", state->numWrites);
-  EDB_PRINTF("Num index reads: %" PRIu32 "\n", state->numIdxReads);
-  EDB_PRINTF("Num index writes: %" PRIu32 "\n", state->numIdxWrites);
-  EDB_PRINTF("Max Error: %" PRId32 "\n", state->maxError);
+  if (state->writeBatchCount == 0)
+    state->writeBatchPageId = pageNum;
   
-  if (EMBEDDB_USING_SPLINE(state->parameters)) {
-    splinePrint(state->spl);
-  }
+  /* A rewritten tail page replaces its copy in the batch */
+  memcpy((int8_t *)state->writeBatch + (pageNum - state->writeBatchPageId) * state->pageSize,
+	 buffer, state->pageSize);
+  state->writeBatchCount = pageNum - state->writeBatchPageId + 1;
+  
+  if ((pageNum + 1) % state->writeBatchPages == 0)
+    return writeDataBatch(state);
+  return 0;
 }
 
 /**
- * @brief	Writes page in buffer to storage. Returns page number.
+ * @brief	Gives the page in buffer the next page id and its page model,
+ *          and erases the next block if no page is free.
  * @param	state	embedDB algorithm state structure
- * @param	buffer	Buffer for writing out page
+ * @param	buffer	Buffer holding the page
  * @return	Return page number if success, -1 if error.
  */
-pgid_t
-writePage(embedDBState * state,
-	  void *         buffer)
+static pgid_t
+prepareDataPage(embedDBState * state,
+		void *         buffer)
 {
   if (state->dataFile == NULL)
     return -1;
   
   /* Always writes to next page number. Returned to user. */
   pgid_t pageNum = state->nextDataPageId++;
-  pgid_t physicalPageNum = pageNum % state->numDataPages;
   
   /* Setup page number in header */
   memcpy(buffer, &(pageNum), sizeof(pgid_t));
   
-  if (state->numAvailDataPages <= 0) {
-    /* Erase pages to make space for new data */
-    int8_t eraseResult =
-      state->fileInterface->erase(physicalPageNum,
-				  physicalPageNum + state->eraseSizeInPages,
-				  state->pageSize, state->dataFile);
-    if (eraseResult != 1) {
-      EDB_PERRF("Failed to erase data page: %" PRIu32 " (%" PRIu32 ")\n",
-		pageNum, physicalPageNum);
-      return -1;
-    }
-    
-    /* Flag the pages as usable to EmbedDB */
-    state->numAvailDataPages += state->eraseSizeInPages;
-    state->minDataPageId += state->eraseSizeInPages;
-    
-    /* remove any spline points related to these pages */
-    if (!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
-      cleanSpline(state, state->minDataPageId);
-    }
+  if (EMBEDDB_USING_PAGE_MODEL(state->parameters)) {
+    embedDBFitPageModel(state, buffer);
   }
   
-  /* Seek to page location in file */
-  int32_t val = state->fileInterface->write(buffer, physicalPageNum, state->pageSize, state->dataFile);
-  if (val == 0) {
-    EDB_PERRF("Failed to write data page: %" PRIu32 " (%" PRIu32 ")\n",
-	      pageNum, physicalPageNum);
+  /* A tail page written by a flush already owns its slot */
+  if (!state->dataTailWritten && state->numAvailDataPages <= 0 &&
+      eraseDataBlock(state, pageNum) != 0) {
+    return -1;
+  }
+  return pageNum;
+}
+
+/**
+ * @brief	Writes page in buffer to storage. Returns page number.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Buffer for writing out page
+ * @return	Return page number if success, -1 if error.
+ */
+pgid_t
+writePage(embedDBState * state,
+	  void *         buffer)
+{
+  pgid_t pageNum = prepareDataPage(state, buffer);
+  if (pageNum == -1)
     return -1;
+  pgid_t physicalPageNum = pageNum % state->numDataPages;
+  
+  if (EMBEDDB_BATCHING_WRITES(state->parameters)) {
+    if (batchDataPage(state, buffer, pageNum) != 0)
+      return -1;
+  } else {
+    /* Seek to page location in file */
+    int32_t val = state->fileInterface->write(buffer, physicalPageNum, state->pageSize, state->dataFile);
+    if (val == 0) {
+      EDB_PERRF("Failed to write data page: %" EDB_PRIpgid " (%" EDB_PRIpgid ")\n",
+		pageNum, physicalPageNum);
+      return -1;
+    }
   }
   
-  state->numAvailDataPages--;
+  if (!state->dataTailWritten)
+    state->numAvailDataPages--;
+  state->dataTailWritten = 0;
   state->numWrites++;
   
   return pageNum;
@@ -2281,7 +6113,7 @@ writeTemporaryPage(embedDBState * state,
 						    state->pageSize, state->dataFile);
   if (!writeSuccess) {
     EDB_PERRF("Failed to write temporary page for record-level-consistency:"
-	      " Logical Page Number %" PRIu32 " - Physical Page (%" PRIu32 ")\n",
+	      " Logical Page Number %" EDB_PRIpgid " - Physical Page (%" PRIu32 ")\n",
 	      state->nextDataPageId,
 	      state->nextRLCPhysicalPageLocation - 1);
     return -1;
@@ -2290,6 +6122,148 @@ writeTemporaryPage(embedDBState * state,
   return 0;
 }
 
+/**
+ * @brief	Computes the check stored with a record log entry, or with a
+ *          log page header when record is NULL. Covers the data page id
+ *          and record index so stale entries from earlier pages fail.
+ * @param	pageId	Logical id of the data page being logged
+ * @param	index	Index of the record in the data page
+ * @param	record	Record bytes
+ * @param	length	Number of record bytes
+ * @return	CRC-16/CCITT of the page id, index and record
+ */
+static uint16_t
+recordLogCheck(pgid_t   pageId,
+	       count_t  index,
+	       void *   record,
+	       uint16_t length)
+{
+  uint8_t header[sizeof(pgid_t) + sizeof(count_t)];
+  memcpy(header, &pageId, sizeof(pgid_t));
+  memcpy(header + sizeof(pgid_t), &index, sizeof(count_t));
+  return crc16(crc16(0xFFFF, header, sizeof(header)), record, length);
+}
+
+/**
+ * @brief	Continues a CRC-16/CCITT over more bytes.
+ * @param	crc		CRC of the bytes so far, 0xFFFF to start
+ * @param	bytes	Bytes to add
+ * @param	length	Number of bytes
+ * @return	CRC including the new bytes
+ */
+static uint16_t
+crc16(uint16_t crc,
+      void *   bytes,
+      uint16_t length)
+{
+  for (uint16_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)((uint8_t *)bytes)[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+/**
+ * @brief	Moves the record log to its next page, erasing the next erase
+ *          block of the record-level consistency area on entering it.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+static int8_t
+advanceRecordLog(embedDBState *state)
+{
+  uint32_t numLogPages = 2 * state->eraseSizeInPages;
+  uint32_t logPage = (state->nextRLCPhysicalPageLocation + state->numDataPages -
+		      state->rlcPhysicalStartingPage) % state->numDataPages;
+  logPage = (logPage + 1) % numLogPages;
+  state->nextRLCPhysicalPageLocation = (state->rlcPhysicalStartingPage + logPage) % state->numDataPages;
+  state->rlcLogSlot = 0;
+  
+  if (logPage % state->eraseSizeInPages == 0) {
+    uint32_t eraseStartingPage = state->nextRLCPhysicalPageLocation;
+    if (!state->fileInterface->erase(eraseStartingPage, eraseStartingPage + state->eraseSizeInPages,
+				     state->pageSize, state->dataFile)) {
+      EDB_PERRF("Failed to erase block starting at physical page %" PRIu32 " in the data file.",
+		eraseStartingPage);
+      return -2;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief	Appends the write buffer records that are not yet logged to
+ *          the record log, one entry per record. A new data page starts
+ *          its log on a fresh log page.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+static int8_t
+appendRecordLog(embedDBState *state)
+{
+  if (state->dataFile == NULL) {
+    EDB_PERRF("The dataFile in embedDBState was null.");
+    return -3;
+  }
+  
+  if (state->rlcLogPageId != state->nextDataPageId) {
+    if (state->rlcLogSlot > 0 && advanceRecordLog(state) != 0) {
+      return -2;
+    }
+    state->rlcLogPageId = state->nextDataPageId;
+    state->rlcLoggedCount = 0;
+  }
+  
+  uint32_t entrySize = state->recordSize + EMBEDDB_RLC_LOG_CHECK_SIZE;
+  count_t entriesPerLogPage = (state->pageSize - EMBEDDB_RLC_LOG_HEADER_SIZE) / entrySize;
+  count_t count = EMBEDDB_GET_COUNT(state->buffer);
+  int8_t *records = (int8_t *)state->buffer + state->headerSize;
+  
+  /* Entries are built in the read buffer */
+  int8_t *out = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+  state->bufferedPageId = -1;
+  
+  while (state->rlcLoggedCount < count) {
+    if (state->rlcLogSlot >= entriesPerLogPage && advanceRecordLog(state) != 0) {
+      return -2;
+    }
+    
+    uint32_t length = 0;
+    uint32_t offset = EMBEDDB_RLC_LOG_HEADER_SIZE + state->rlcLogSlot * entrySize;
+    if (state->rlcLogSlot == 0) {
+      uint16_t check = recordLogCheck(state->rlcLogPageId, state->rlcLoggedCount, NULL, 0);
+      memcpy(out, &state->rlcLogPageId, sizeof(pgid_t));
+      memcpy(out + sizeof(pgid_t), &state->rlcLoggedCount, sizeof(count_t));
+      memcpy(out + sizeof(pgid_t) + sizeof(count_t), &check, EMBEDDB_RLC_LOG_CHECK_SIZE);
+      length = EMBEDDB_RLC_LOG_HEADER_SIZE;
+      offset = 0;
+    }
+    
+    count_t numEntries = min(entriesPerLogPage - state->rlcLogSlot, count - state->rlcLoggedCount);
+    for (count_t i = 0; i < numEntries; i++) {
+      count_t index = state->rlcLoggedCount + i;
+      int8_t *record = records + index * state->recordSize;
+      uint16_t check = recordLogCheck(state->rlcLogPageId, index, record, state->recordSize);
+      memcpy(out + length, record, state->recordSize);
+      memcpy(out + length + state->recordSize, &check, EMBEDDB_RLC_LOG_CHECK_SIZE);
+      length += entrySize;
+    }
+    
+    if (!state->fileInterface->writeBytes(out, state->nextRLCPhysicalPageLocation, offset, length,
+					  state->pageSize, state->dataFile)) {
+      EDB_PERRF("Failed to append to the record log at physical page %" PRIu32 "\n",
+		state->nextRLCPhysicalPageLocation);
+      return -1;
+    }
+    state->rlcLogSlot += numEntries;
+    state->rlcLoggedCount += numEntries;
+  }
+  
+  return 0;
+}
+
 /**
  * @brief	Calculates the number of spline points not in use by embedDB and deletes them
  * @param	state	embedDB algorithm state structure
@@ -2298,14 +6272,14 @@ writeTemporaryPage(embedDBState * state,
  */
 static uint32_t
 cleanSpline(embedDBState * state,
-	    uint32_t       minPageNumber)
+	    pgid_t         minPageNumber)
 {
   uint32_t numPointsErased = 0;
   void *nextPoint;
-  uint32_t currentPageNumber = 0;
+  pgid_t currentPageNumber = 0;
   for (size_t i = 0; i < state->spl->count; i++) {
     nextPoint = splinePointLocation(state->spl, i + 1);
-    memcpy(&currentPageNumber, (int8_t *)nextPoint + state->keySize, sizeof(uint32_t));
+    memcpy(&currentPageNumber, (int8_t *)nextPoint + state->keySize, sizeof(pgid_t));
     if (currentPageNumber < minPageNumber) {
       numPointsErased++;
     } else {
@@ -2340,30 +6314,23 @@ writeIndexPage(embedDBState * state,
   /* Setup page number in header */
   memcpy(buffer, &(pageNum), sizeof(pgid_t));
   
-  if (state->numAvailIndexPages <= 0) {
-    // Erase index pages to make room for new page
-    int8_t eraseResult = state->fileInterface->erase(physicalPageNumber,
-						     physicalPageNumber + state->eraseSizeInPages,
-						     state->pageSize, state->indexFile);
-    if (eraseResult != 1) {
-      EDB_PERRF("Failed to erase data page: %" PRIu32 " (%" PRIu32 ")\n",
-		pageNum, physicalPageNumber);
-      return -1;
-    }
-    state->numAvailIndexPages += state->eraseSizeInPages;
-    state->minIndexPageId += state->eraseSizeInPages;
+  if (!state->indexTailWritten && state->numAvailIndexPages <= 0 &&
+      eraseIndexBlock(state, pageNum) != 0) {
+    return -1;
   }
   
   /* Seek to page location in file */
   int32_t val = state->fileInterface->write(buffer, physicalPageNumber,
 					    state->pageSize, state->indexFile);
   if (val == 0) {
-    EDB_PERRF("Failed to write index page: %" PRIu32 " (%" PRIu32 ")\n",
+    EDB_PERRF("Failed to write index page: %" EDB_PRIpgid " (%" EDB_PRIpgid ")\n",
 	      pageNum, physicalPageNumber);
     return -1;
   }
   
-  state->numAvailIndexPages--;
+  if (!state->indexTailWritten)
+    state->numAvailIndexPages--;
+  state->indexTailWritten = 0;
   state->numIdxWrites++;
   
   return pageNum;
@@ -2387,27 +6354,8 @@ writeVariablePage(embedDBState * state,
   pgid_t physicalPageId = state->nextVarPageId % state->numVarPages;
   
   // Erase data if needed
-  if (state->numAvailVarPages <= 0) {
-    int8_t eraseResult =
-      state->fileInterface->erase(physicalPageId, physicalPageId + state->eraseSizeInPages,
-				  state->pageSize, state->varFile);
-    if (eraseResult != 1) {
-      EDB_PERRF("Failed to erase data page: %" PRIu32 " (%" PRIu32 ")\n",
-		state->nextVarPageId, physicalPageId);
-      return -1;
-    }
-    state->numAvailVarPages += state->eraseSizeInPages;
-    // Last page that is deleted
-    pgid_t pageNum = (physicalPageId + state->eraseSizeInPages - 1) % state->numVarPages;
-    
-    // Read in that page so we can update which records we still have the data for
-    if (readVariablePage(state, pageNum) != 0) {
-      return -1;
-    }
-    void *buf = (int8_t *)state->buffer +
-      state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters) + sizeof(pgid_t);
-    memcpy(&state->minVarRecordId, buf, state->keySize);
-    state->minVarRecordId += 1;  // Add one because the result from the last line is a record that is erased
+  if (state->numAvailVarPages <= 0 && eraseVarBlock(state, state->nextVarPageId) != 0) {
+    return -1;
   }
   
   // Add logical page number to data page
@@ -2417,10 +6365,16 @@ writeVariablePage(embedDBState * state,
   // Write to file
   uint32_t val = state->fileInterface->write(buffer, physicalPageId, state->pageSize, state->varFile);
   if (val == 0) {
-    EDB_PERRF("Failed to write vardata page: %" PRIu32 "\n", state->nextVarPageId);
+    EDB_PERRF("Failed to write vardata page: %" EDB_PRIpgid "\n", state->nextVarPageId);
     return -1;
   }
   
+  // The read-ahead window must not keep the old copy of the page
+  if (EMBEDDB_USING_VAR_READ_AHEAD(state->parameters) && physicalPageId >= state->varReadAheadStart &&
+      physicalPageId < state->varReadAheadStart + state->varReadAheadCount) {
+    state->varReadAheadCount = 0;
+  }
+  
   state->nextVarPageId++;
   state->numAvailVarPages--;
   state->numWrites++;
@@ -2441,6 +6395,8 @@ readToWriteBuf(embedDBState * state)
   void *writeBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_WRITE_BUFFER;
   // copy write buffer to the read buffer.
   memcpy(readBuf, writeBuf, state->pageSize);
+  // the read buffer no longer holds a page from storage
+  state->bufferedPageId = -1;
 }
 
 /**
@@ -2458,6 +6414,46 @@ readToWriteBufVar(embedDBState *state)
   memcpy(readBuf, writeBuf, state->pageSize);
 }
 
+/**
+ * @brief	Reads a variable data page for a stream. The page being filled
+ *          is copied from the variable data write buffer, since it is not
+ *          on storage yet.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageNum	Physical page number to read
+ * @return	Return 0 if success, -1 if error.
+ */
+static int8_t
+readVarStreamPage(embedDBState *state,
+		  pgid_t        pageNum)
+{
+  /* While the file is full, the slot still holds the oldest page (see flushVarSharingSlot) */
+  if (pageNum != state->nextVarPageId % state->numVarPages || state->numAvailVarPages <= 0) {
+    return readVariablePage(state, pageNum);
+  }
+  
+  readToWriteBufVar(state);
+  // the read buffer no longer holds a page from storage
+  state->bufferedVarPage = -1;
+  return 0;
+}
+
+/**
+ * @brief	Flushes the variable data write buffer only when its slot is
+ *          shared with the oldest page. That happens once the file is
+ *          full, until the buffer is written over the oldest page, so
+ *          streams could not tell the two apart. Otherwise the buffered
+ *          data is read from memory and nothing is written.
+ * @param	state	embedDB algorithm state structure
+ * @return	0 if success, -1 if error.
+ */
+static int8_t
+flushVarSharingSlot(embedDBState *state)
+{
+  if (state->numAvailVarPages > 0)
+    return 0;
+  return embedDBFlushVar(state);
+}
+
 /**
  * @brief	Reads given page from storage.
  * @param	state	embedDB algorithm state structure
@@ -2476,6 +6472,17 @@ readPage(embedDBState * state,
   
   void *buf = (int8_t *)state->buffer + state->pageSize;
   
+  /* Pages in the write batch are not on storage yet */
+  if (EMBEDDB_BATCHING_WRITES(state->parameters) && state->writeBatchCount > 0) {
+    pgid_t firstBatchPage = state->writeBatchPageId % state->numDataPages;
+    if (pageNum >= firstBatchPage && pageNum < firstBatchPage + state->writeBatchCount) {
+      memcpy(buf, (int8_t *)state->writeBatch + (pageNum - firstBatchPage) * state->pageSize,
+	     state->pageSize);
+      state->bufferedPageId = pageNum;
+      return 0;
+    }
+  }
+  
   /* Page is not in buffer. Read from storage. */
   /* Read page into start of buffer 1 */
   if (0 == state->fileInterface->read(buf, pageNum, state->pageSize, state->dataFile))
@@ -2533,6 +6540,11 @@ readVariablePage(embedDBState * state,
   // Get buffer to read into
   void *buf = (int8_t *)state->buffer + EMBEDDB_VAR_READ_BUFFER(state->parameters) * state->pageSize;
   
+  if (EMBEDDB_USING_VAR_READ_AHEAD(state->parameters) && readVarPageAhead(state, pageNum, buf)) {
+    state->bufferedVarPage = pageNum;
+    return 0;
+  }
+  
   // Read in one page worth of data
   if (state->fileInterface->read(buf, pageNum, state->pageSize, state->varFile) == 0) {
     return -1;
@@ -2544,6 +6556,60 @@ readVariablePage(embedDBState * state,
   return 0;
 }
 
+/**
+ * @brief	Copies a variable data page from the read-ahead window. A read
+ *          of the page after the last one read from storage refills the
+ *          window starting at that page, so a forward scan reads the file
+ *          varReadAheadPages pages at a time. Other pages are left to be
+ *          read on their own.
+ * @param 	state 	embedDB algorithm state structure
+ * @param 	pageNum Physical page number to read
+ * @param 	buf 	Buffer to copy the page to
+ * @return 	1 if the page was copied, 0 if it must be read from storage
+ */
+static int8_t
+readVarPageAhead(embedDBState * state,
+		 pgid_t         pageNum,
+		 void *         buf)
+{
+  if (pageNum < state->varReadAheadStart || pageNum >= state->varReadAheadStart + state->varReadAheadCount) {
+    if (pageNum != state->varReadAheadNext) {
+      state->varReadAheadNext = pageNum + 1;
+      return 0;
+    }
+    
+    // Stop at the end of the file and before the page in the write buffer
+    pgid_t writeBufferPage = state->nextVarPageId % state->numVarPages;
+    pgid_t endPage = writeBufferPage > pageNum ? writeBufferPage : state->numVarPages;
+    count_t numPages = min(state->varReadAheadPages, endPage - pageNum);
+    
+    bool success = numPages > 1;
+    if (success && state->fileInterface->readPages != NULL) {
+      success = state->fileInterface->readPages(state->varReadAhead, pageNum, numPages,
+						state->pageSize, state->varFile);
+    } else {
+      for (count_t i = 0; success && i < numPages; i++) {
+	success = state->fileInterface->read((int8_t *)state->varReadAhead + i * state->pageSize,
+					     pageNum + i, state->pageSize, state->varFile);
+      }
+    }
+    if (!success) {
+      state->varReadAheadCount = 0;
+      state->varReadAheadNext = pageNum + 1;
+      return 0;
+    }
+    
+    state->numReads += numPages;
+    state->varReadAheadStart = pageNum;
+    state->varReadAheadCount = numPages;
+    state->varReadAheadNext = pageNum + numPages;
+  }
+  
+  memcpy(buf, (int8_t *)state->varReadAhead + (pageNum - state->varReadAheadStart) * state->pageSize,
+	 state->pageSize);
+  return 1;
+}
+
 /**
  * @brief	Resets statistics.
  * @param	state	embedDB state structure
@@ -2566,6 +6632,11 @@ void
 embedDBClose(embedDBState * state)
 {
   if (state->dataFile != NULL) {
+    /* Full pages still in the write batch are not on storage yet */
+    if (EMBEDDB_BATCHING_WRITES(state->parameters) && state->writeBatch != NULL &&
+	writeDataBatch(state) != 0) {
+      EDB_PERRF("Failed to write the data page batch during embedDBClose.\n");
+    }
     state->fileInterface->close(state->dataFile);
   }
   if (state->indexFile != NULL) {
@@ -2574,6 +6645,9 @@ embedDBClose(embedDBState * state)
   if (state->varFile != NULL) {
     state->fileInterface->close(state->varFile);
   }
+  if (EMBEDDB_USING_SUPERBLOCK(state->parameters) && state->superblockFile != NULL) {
+    state->fileInterface->close(state->superblockFile);
+  }
   if (EMBEDDB_USING_SPLINE(state->parameters)) {
     splineClose(state->spl);
     if (EDB_WITH_HEAP) {
@@ -2581,4 +6655,35 @@ embedDBClose(embedDBState * state)
     }
     state->spl = NULL;
   }
+  if (EMBEDDB_USING_FENCE_INDEX(state->parameters) && state->fence != NULL) {
+    fenceIndexClose(state->fence);
+    if (EDB_WITH_HEAP) {
+      free(state->fence);
+    }
+    state->fence = NULL;
+  }
+  if (EMBEDDB_USING_REORDER_BUFFER(state->parameters) && state->reorderBuffer != NULL) {
+    if (EDB_WITH_HEAP) {
+      free(state->reorderBuffer);
+    }
+    state->reorderBuffer = NULL;
+  }
+  if (EMBEDDB_BATCHING_WRITES(state->parameters) && state->writeBatch != NULL) {
+    if (EDB_WITH_HEAP) {
+      free(state->writeBatch);
+    }
+    state->writeBatch = NULL;
+  }
+  if (EMBEDDB_USING_VAR_READ_AHEAD(state->parameters) && state->varReadAhead != NULL) {
+    if (EDB_WITH_HEAP) {
+      free(state->varReadAhead);
+    }
+    state->varReadAhead = NULL;
+  }
+  if (EMBEDDB_DEDUPING_VDATA(state->parameters) && state->varDedupTable != NULL) {
+    if (EDB_WITH_HEAP) {
+      free(state->varDedupTable);
+    }
+    state->varDedupTable = NULL;
+  }
 }
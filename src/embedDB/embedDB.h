@@ -65,11 +65,23 @@ extern "C" {
 #endif
 #define EDB_WITH_HEAP (!EDB_NO_HEAP)
 
+#include "../fence-index/fenceIndex.h"
+#include "../lz-codec/lzCodec.h"
 #include "../spline/spline.h"
 
 /* Define type for page record count. */
 typedef uint16_t count_t;
 
+/* Define type for byte addresses in the variable data file. Records store
+   them, so they are as wide as page ids. */
+#if defined(EMBEDDB_64BIT_PAGE_IDS)
+typedef uint64_t varaddr_t;
+#define EMBEDDB_NO_VAR_DATA UINT64_MAX
+#else
+typedef uint32_t varaddr_t;
+#define EMBEDDB_NO_VAR_DATA UINT32_MAX
+#endif
+
 #define EMBEDDB_USE_INDEX 1
 #define EMBEDDB_USE_MAX_MIN 2
 #define EMBEDDB_USE_SUM 4
@@ -79,6 +91,19 @@ typedef uint16_t count_t;
 #define EMBEDDB_RECORD_LEVEL_CONSISTENCY 64
 #define EMBEDDB_USE_BINARY_SEARCH 128
 #define EMBEDDB_DISABLE_SPLINE_CLEAN 256
+#define EMBEDDB_USE_INTERPOLATION_SEARCH 512
+#define EMBEDDB_USE_FENCE_INDEX 1024
+#define EMBEDDB_USE_PAGE_MODEL 2048
+#define EMBEDDB_USE_REORDER_BUFFER 4096
+#define EMBEDDB_RLC_GROUP_COMMIT 8192
+#define EMBEDDB_RLC_APPEND_LOG 16384
+#define EMBEDDB_RESUME_TAIL_PAGE 32768
+#define EMBEDDB_BATCH_WRITES 65536
+#define EMBEDDB_USE_SUPERBLOCK 131072
+#define EMBEDDB_USE_VAR_STREAM_POOL 262144
+#define EMBEDDB_COMPRESS_VDATA 524288
+#define EMBEDDB_VAR_READ_AHEAD 1048576
+#define EMBEDDB_DEDUP_VDATA 2097152
 
 #define EMBEDDB_USING_INDEX(x) ((x & EMBEDDB_USE_INDEX) > 0 ? 1 : 0)
 #define EMBEDDB_USING_MAX_MIN(x) ((x & EMBEDDB_USE_MAX_MIN) > 0 ? 1 : 0)
@@ -86,19 +111,70 @@ typedef uint16_t count_t;
 #define EMBEDDB_USING_BMAP(x) ((x & EMBEDDB_USE_BMAP) > 0 ? 1 : 0)
 #define EMBEDDB_USING_VDATA(x) ((x & EMBEDDB_USE_VDATA) > 0 ? 1 : 0)
 #define EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(x) ((x & EMBEDDB_RECORD_LEVEL_CONSISTENCY) > 0 ? 1 : 0)
+#define EMBEDDB_USING_RLC_GROUP_COMMIT(x) ((x & EMBEDDB_RLC_GROUP_COMMIT) > 0 ? 1 : 0)
+#define EMBEDDB_USING_RLC_APPEND_LOG(x) ((x & EMBEDDB_RLC_APPEND_LOG) > 0 ? 1 : 0)
+#define EMBEDDB_RESUMING_TAIL_PAGE(x) ((x & EMBEDDB_RESUME_TAIL_PAGE) > 0 ? 1 : 0)
+#define EMBEDDB_BATCHING_WRITES(x) ((x & EMBEDDB_BATCH_WRITES) > 0 ? 1 : 0)
+#define EMBEDDB_USING_SUPERBLOCK(x) ((x & EMBEDDB_USE_SUPERBLOCK) > 0 ? 1 : 0)
+#define EMBEDDB_USING_VAR_STREAM_POOL(x) ((x & EMBEDDB_USE_VAR_STREAM_POOL) > 0 ? 1 : 0)
+#define EMBEDDB_COMPRESSING_VDATA(x) ((x & EMBEDDB_COMPRESS_VDATA) > 0 ? 1 : 0)
+#define EMBEDDB_USING_VAR_READ_AHEAD(x) ((x & EMBEDDB_VAR_READ_AHEAD) > 0 ? 1 : 0)
+#define EMBEDDB_DEDUPING_VDATA(x) ((x & EMBEDDB_DEDUP_VDATA) > 0 ? 1 : 0)
 #define EMBEDDB_USING_BINARY_SEARCH(x) ((x & EMBEDDB_USE_BINARY_SEARCH) > 0 ? 1 : 0)
-#define EMBEDDB_USING_SPLINE(x) (!EMBEDDB_USING_BINARY_SEARCH(x))
+#define EMBEDDB_USING_INTERPOLATION_SEARCH(x) ((x & EMBEDDB_USE_INTERPOLATION_SEARCH) > 0 ? 1 : 0)
+#define EMBEDDB_USING_PAGE_MODEL(x) ((x & EMBEDDB_USE_PAGE_MODEL) > 0 ? 1 : 0)
+#define EMBEDDB_USING_FENCE_INDEX(x) ((x & EMBEDDB_USE_FENCE_INDEX) > 0 ? 1 : 0)
+#define EMBEDDB_USING_REORDER_BUFFER(x) ((x & EMBEDDB_USE_REORDER_BUFFER) > 0 ? 1 : 0)
+#define EMBEDDB_USING_SPLINE(x) (!EMBEDDB_USING_BINARY_SEARCH(x) && !EMBEDDB_USING_INTERPOLATION_SEARCH(x) && !EMBEDDB_USING_FENCE_INDEX(x))
 #define EMBEDDB_DISABLED_SPLINE_CLEAN(x) ((x & EMBEDDB_DISABLE_SPLINE_CLEAN) > 0 ? 1 : 0)
 #define EMBEDDB_RESETING_DATA(x) ((x & EMBEDDB_RESET_DATA) > 0 ? 1 : 0)
 
-/* Offsets with header */
-#define EMBEDDB_COUNT_OFFSET 4
-#define EMBEDDB_BITMAP_OFFSET 6
+/* Offsets with header. Pages start with their logical page id, so the
+   header grows with EMBEDDB_64BIT_PAGE_IDS. */
+#define EMBEDDB_COUNT_OFFSET sizeof(pgid_t)
+#define EMBEDDB_BITMAP_OFFSET (EMBEDDB_COUNT_OFFSET + 2)
 // #define EMBEDDB_MIN_OFFSET		8
-#define EMBEDDB_MIN_OFFSET 14
-#define EMBEDDB_IDX_HEADER_SIZE 16
+#define EMBEDDB_MIN_OFFSET (EMBEDDB_BITMAP_OFFSET + 8)
+
+/* Index pages: page id, count, padding, first data page id, unused */
+#define EMBEDDB_IDX_FIRST_PAGE_OFFSET (2 * sizeof(pgid_t))
+#define EMBEDDB_IDX_HEADER_SIZE (4 * sizeof(pgid_t))
+
+/* Record-level consistency log pages start with the data page id, the
+   index of their first record and a check of both */
+#define EMBEDDB_RLC_LOG_HEADER_SIZE (sizeof(pgid_t) + 4)
+#define EMBEDDB_RLC_LOG_CHECK_SIZE 2
+
+/* In-page model at the end of the data page header: 4 byte slope, 4 byte intercept, 2 byte max error */
+#define EMBEDDB_PAGE_MODEL_SIZE 10
+
+/* Superblock pages start with this value. Reopening with different
+   layout flags, sizes or page counts is refused. The 64-bit page id
+   build lays the superblock out differently and uses its own value. */
+#define EMBEDDB_SUPERBLOCK_MAGIC_32 0x42534445
+#define EMBEDDB_SUPERBLOCK_MAGIC_64 0x38534445
+#if defined(EMBEDDB_64BIT_PAGE_IDS)
+#define EMBEDDB_SUPERBLOCK_MAGIC EMBEDDB_SUPERBLOCK_MAGIC_64
+#else
+#define EMBEDDB_SUPERBLOCK_MAGIC EMBEDDB_SUPERBLOCK_MAGIC_32
+#endif
+#define EMBEDDB_SUPERBLOCK_LAYOUT_FLAGS (EMBEDDB_USE_INDEX | EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_BMAP | EMBEDDB_USE_VDATA | EMBEDDB_USE_PAGE_MODEL)
 
-#define EMBEDDB_NO_VAR_DATA UINT32_MAX
+/* Set in the length of compressed variable data. The data is stored as
+   blocks of up to pageSize bytes, each after a 2 byte stored length, and
+   blocks that do not compress are stored as they are. */
+#define EMBEDDB_VAR_COMPRESSED 0x80000000
+
+/* Set in the length of variable data stored once for an earlier record.
+   The length is followed by the address of the earlier record's length
+   and the logical page id it is on, which tells if it was erased. */
+#define EMBEDDB_VAR_REFERENCE 0x40000000
+
+/* Largest page size. Offsets in a page and records per page must fit in a count_t. */
+#define EMBEDDB_MAX_PAGE_SIZE 65536
+
+/* nextDataRec of a reverse iterator that has not started reading its page */
+#define EMBEDDB_ITERATOR_PAGE_START UINT16_MAX
 
 #if !defined(ARDUINO) || defined(DIST)
 #define max(a, b) ((a) > (b) ? (a) : (b))
@@ -113,6 +189,8 @@ typedef uint16_t count_t;
 #define EMBEDDB_GET_MIN_KEY(x) ((void *)((int8_t *)x + EMBEDDB_MIN_OFFSET))
 #define EMBEDDB_GET_MAX_KEY(x, y) ((void *)((int8_t *)x + EMBEDDB_MIN_OFFSET + y->keySize))
 
+#define EMBEDDB_GET_PAGE_MODEL(x, y) ((void *)((int8_t *)x + y->headerSize - EMBEDDB_PAGE_MODEL_SIZE))
+
 #define EMBEDDB_GET_MIN_DATA(x, y) ((void *)((int8_t *)x + EMBEDDB_MIN_OFFSET + y->keySize * 2))
 #define EMBEDDB_GET_MAX_DATA(x, y) ((void *)((int8_t *)x + EMBEDDB_MIN_OFFSET + y->keySize * 2 + y->dataSize))
 
@@ -122,6 +200,11 @@ typedef uint16_t count_t;
 #define EMBEDDB_INDEX_READ_BUFFER 3
 #define EMBEDDB_VAR_WRITE_BUFFER(x) ((x & EMBEDDB_USE_INDEX) ? 4 : 2)
 #define EMBEDDB_VAR_READ_BUFFER(x) ((x & EMBEDDB_USE_INDEX) ? 5 : 3)
+#define EMBEDDB_VAR_CODEC_BUFFER(x) (EMBEDDB_VAR_READ_BUFFER(x) + 1)
+/* Compressed variable data blocks hold up to a page, but no more than the codec takes */
+#define EMBEDDB_VAR_BLOCK_SIZE(x) min((x)->pageSize, LZ_CODEC_MAX_BLOCK)
+/* Size of the variable data file in bytes, computed without overflowing 32 bits */
+#define EMBEDDB_VAR_FILE_SIZE(x) ((varaddr_t)(x)->numVarPages * (x)->pageSize)
 
 #define EMBEDDB_FILE_MODE_W_PLUS_B 0  // Open file as read/write, creates file if doesn't exist, overwrites if it does. aka "w+b"
 #define EMBEDDB_FILE_MODE_R_PLUS_B 1  // Open file as read/write, file must exist, keeps data if it does. aka "r+b"
@@ -191,7 +274,7 @@ typedef struct {
    * @param	file		The file data that was stored in embedDBState->dataFile etc
    * @return	true on success
    */
-  bool (*erase)(pgid_t startPage, pgid_t endPage, uint32_t pageSize, void *file);
+  bool (*erase)(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file);
 
   /**
    * @brief  Closes the file
@@ -212,12 +295,68 @@ typedef struct {
    * @return	true on success
    */
   bool (*flush)(void *file);
+
+  /**
+   * @brief	Writes consecutive pages with one write. Used by embedDBBulkLoad
+   *          to write whole erase blocks and by EMBEDDB_BATCH_WRITES. May be
+   *          NULL, in which case the pages are written one at a time.
+   * @param	buffer		The pages to write to file
+   * @param	pageNum		First page number to write. Is treated as an offset from the beginning of the file
+   * @param	numPages	Number of pages to write
+   * @param	pageSize	Number of bytes in a page
+   * @param	file		The file data that was stored in embedDBState->dataFile etc
+   * @return	true on success
+   */
+  bool (*writePages)(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file);
+
+  /**
+   * @brief	Writes part of a page without changing the rest of it. Only
+   *          used with EMBEDDB_RLC_APPEND_LOG, and may be NULL otherwise.
+   * @param	buffer		The data to write to file
+   * @param	pageNum		Page number to write. Is treated as an offset from the beginning of the file
+   * @param	offset		Byte offset within the page
+   * @param	length		Number of bytes to write
+   * @param	pageSize	Number of bytes in a page
+   * @param	file		The file data that was stored in embedDBState->dataFile etc
+   * @return	true on success
+   */
+  bool (*writeBytes)(void *buffer, uint32_t pageNum, uint32_t offset, uint32_t length, uint32_t pageSize, void *file);
+
+  /**
+   * @brief	Reads consecutive pages with one read. Used to read long
+   *          variable data straight into the caller's buffer. May be NULL,
+   *          in which case the pages are read one at a time.
+   * @param	buffer		Pre-allocated buffer for numPages pages
+   * @param	pageNum		First page number to read. Is treated as an offset from the beginning of the file
+   * @param	numPages	Number of pages to read
+   * @param	pageSize	Number of bytes in a page
+   * @param	file		The file data that was stored in embedDBState->dataFile etc
+   * @return	true on success
+   */
+  bool (*readPages)(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file);
 } embedDBFileInterface;
 
+typedef struct {
+    uint32_t totalBytes; /* Total number of bytes in the stream */
+    uint32_t bytesRead;  /* Number of bytes read so far */
+    varaddr_t dataStart;  /* Start of data as an offset in bytes from the beginning of the file */
+    varaddr_t fileOffset; /* Where the iterator should start reading data next time (offset from start of file). For compressed data, the start of the block after blockStart, or EMBEDDB_NO_VAR_DATA if not known yet */
+    varaddr_t blockStart; /* Start of the compressed block holding the next byte to read, or EMBEDDB_NO_VAR_DATA if the data is not compressed */
+} embedDBVarDataStream;
+
+typedef struct {
+    uint32_t hash;    /* Hash of the variable data, 0 if the slot is empty */
+    uint32_t length;  /* Length of the variable data */
+    varaddr_t address; /* Address of the length of the variable data in the file */
+    pgid_t pageId;    /* Logical page id of the page the length is on */
+    uint64_t refKey;  /* Newest key of a record referencing the copy, 0 if none */
+} embedDBVarDedupEntry;
+
 typedef struct {
     void *dataFile;                                                       /* File for storing data records. */
     void *indexFile;                                                      /* File for storing index records. */
     void *varFile;                                                        /* File for storing variable length data. */
+    void *superblockFile;                                                 /* File for the superblock ring, 2 * eraseSizeInPages pages (EMBEDDB_USE_SUPERBLOCK) */
     embedDBFileInterface *fileInterface;                                  /* Interface to the file storage */
     uint32_t numDataPages;                                                /* The number of pages will use for storing fixed records*/
     uint32_t numIndexPages;                                               /* The number of pages will use for storing the data index */
@@ -226,27 +365,58 @@ typedef struct {
     uint32_t numAvailDataPages;                                           /* Number of writable data pages left before needing to delete */
     uint32_t numAvailIndexPages;                                          /* Number of writable index pages left before needing to delete */
     uint32_t numAvailVarPages;                                            /* Number of writable var pages left before needing to delete */
-    uint32_t minDataPageId;                                               /* Lowest logical data page id that is saved on file */
-    uint32_t minIndexPageId;                                              /* Lowest logical index page id that is saved on file */
+    pgid_t minDataPageId;                                                   /* Lowest logical data page id that is saved on file */
+    pgid_t minIndexPageId;                                                  /* Lowest logical index page id that is saved on file */
     uint64_t minVarRecordId;                                              /* Minimum record id that we still have variable data for */
     pgid_t nextDataPageId;                                                  /* Next logical page id. Page id is an incrementing value and may not always be same as physical page id. */
     pgid_t nextIdxPageId;                                                   /* Next logical page id for index. Page id is an incrementing value and may not always be same as physical page id. */
     pgid_t nextVarPageId;                                                   /* Page number of next var page to be written */
     uint32_t nextRLCPhysicalPageLocation;                                 /* Physical page number for the location for the next record-level-consistency page */
     uint32_t rlcPhysicalStartingPage;                                     /* Physical page number for the starting page of the record-level consistnecy pages */
+    uint32_t rlcCommitRecords;                                            /* With EMBEDDB_RLC_GROUP_COMMIT, commit after this many records (0 to not commit by count) */
+    uint32_t rlcCommitIntervalMs;                                         /* With EMBEDDB_RLC_GROUP_COMMIT, commit on the first insert this many ms after the last commit (0 to not commit by time) */
+    uint32_t (*getTimeMs)(void);                                          /* Millisecond clock used by rlcCommitIntervalMs */
+    uint32_t rlcPendingRecords;                                           /* Records inserted since the last record-level consistency commit */
+    uint32_t rlcLastCommitMs;                                             /* Time of the last record-level consistency commit */
+    pgid_t rlcLogPageId;                                                    /* Data page whose records are in the record log (EMBEDDB_RLC_APPEND_LOG) */
+    count_t rlcLoggedCount;                                               /* Number of write buffer records already in the record log */
+    count_t rlcLogSlot;                                                   /* Next entry in the current record log page */
+    int8_t dataTailWritten;                                               /* Write buffer already holds its data page slot after a flush (EMBEDDB_RESUME_TAIL_PAGE) */
+    int8_t indexTailWritten;                                              /* Index write buffer already holds its index page slot after a flush (EMBEDDB_RESUME_TAIL_PAGE) */
     pgid_t currentVarLoc;                                                   /* Current variable address offset to write at (bytes from beginning of file) */
     void *buffer;                                                         /* Pre-allocated memory buffer for use by algorithm */
     spline *spl;                                                          /* Spline model */
+    fenceIndex *fence;                                                    /* Exact index of page min keys (EMBEDDB_USE_FENCE_INDEX) */
+    void *reorderBuffer;                                                  /* Records held back in key order so late keys can still be inserted (EMBEDDB_USE_REORDER_BUFFER) */
+    count_t reorderWindow;                                                /* Maximum number of records held in the reorder buffer (EMBEDDB_USE_REORDER_BUFFER) */
+    count_t reorderCount;                                                 /* Number of records in the reorder buffer */
+    void *writeBatch;                                                     /* Full data pages waiting to be written together (EMBEDDB_BATCH_WRITES) */
+    count_t writeBatchPages;                                              /* Number of data pages the write batch holds, a divisor of eraseSizeInPages (EMBEDDB_BATCH_WRITES) */
+    count_t writeBatchCount;                                              /* Number of data pages in the write batch */
+    pgid_t writeBatchPageId;                                              /* Logical id of the first page in the write batch */
+    uint32_t superblockSequence;                                          /* Sequence number of the newest superblock, 0 if there is none */
+    uint32_t superblockSlot;                                              /* Next page of the superblock ring to write */
+    embedDBVarDataStream *varStreamPool;                                  /* Caller-allocated streams handed out by the variable data reads (EMBEDDB_USE_VAR_STREAM_POOL) */
+    count_t varStreamPoolSize;                                            /* Number of streams in varStreamPool, at most 32 (EMBEDDB_USE_VAR_STREAM_POOL) */
+    uint32_t varStreamPoolInUse;                                          /* Bitmap of the pool streams in use */
+    void *varReadAhead;                                                   /* Variable data pages read ahead of a forward scan (EMBEDDB_VAR_READ_AHEAD) */
+    count_t varReadAheadPages;                                            /* Number of pages the read-ahead window holds, at least 2 (EMBEDDB_VAR_READ_AHEAD) */
+    count_t varReadAheadCount;                                            /* Number of pages in the read-ahead window */
+    pgid_t varReadAheadStart;                                               /* Physical page id of the first page in the read-ahead window */
+    pgid_t varReadAheadNext;                                                /* Physical page id that continues the last run of variable page reads */
+    embedDBVarDedupEntry *varDedupTable;                                  /* Recently inserted variable data, by hash (EMBEDDB_DEDUP_VDATA) */
+    count_t varDedupSlots;                                                /* Number of entries in varDedupTable (EMBEDDB_DEDUP_VDATA) */
+    pgid_t varDedupStartPageId;                                           /* Var page written when embedDBInit ran, references on older pages are not in varDedupTable (EMBEDDB_DEDUP_VDATA) */
     uint32_t numSplinePoints;                                             /* Number of spline points to allocate */
     int32_t indexMaxError;                                                /* Max error for indexing structure (Spline or PGM) */
     int8_t bufferSizeInBlocks;                                            /* Size of buffer in blocks */
-    count_t pageSize;                                                     /* Size of physical page on device */
-    int16_t parameters;                                                   /* Parameter flags for indexing and bitmaps */
-    int8_t keySize;                                                       /* Size of key in bytes (fixed-size records) */
-    int8_t dataSize;                                                      /* Size of data in bytes (fixed-size records). Do not include space for variable size records if you are using them. */
-    int8_t recordSize;                                                    /* Size of record in bytes (fixed-size records) */
-    int8_t headerSize;                                                    /* Size of header in bytes (calculated during init()) */
-    int8_t variableDataHeaderSize;                                        /* Size of page header in variable data files (calculated during init()) */
+    uint32_t pageSize;                                                    /* Size of physical page on device, up to 64 KB */
+    uint32_t parameters;                                                  /* Parameter flags for indexing and bitmaps */
+    uint16_t keySize;                                                     /* Size of key in bytes (fixed-size records) */
+    uint16_t dataSize;                                                    /* Size of data in bytes (fixed-size records). Do not include space for variable size records if you are using them. */
+    uint16_t recordSize;                                                  /* Size of record in bytes (fixed-size records) */
+    uint16_t headerSize;                                                  /* Size of header in bytes (calculated during init()) */
+    uint16_t variableDataHeaderSize;                                      /* Size of page header in variable data files (calculated during init()) */
     int8_t bitmapSize;                                                    /* Size of bitmap in bytes */
     count_t maxRecordsPerPage;                                            /* Maximum records per page */
     count_t maxIdxRecordsPerPage;                                         /* Maximum index records per page */
@@ -266,12 +436,18 @@ typedef struct {
     pgid_t bufferedPageId;                                                  /* Page id currently in read buffer */
     pgid_t bufferedIndexPageId;                                             /* Index page id currently in index read buffer */
     pgid_t bufferedVarPage;                                                 /* Variable page id currently in variable read buffer */
+    varaddr_t varCodecBlock;                                              /* Start of the compressed block decompressed in the codec buffer, or EMBEDDB_NO_VAR_DATA (EMBEDDB_COMPRESS_VDATA) */
+    pgid_t searchAnchorPageId;                                              /* Logical page id whose smallest key is cached for interpolation search */
+    uint64_t searchAnchorKey;                                             /* Smallest key on page searchAnchorPageId */
     uint8_t recordHasVarData;                                             /* Internal flag to signal that the record currently being written has var data */
 } embedDBState;
 
+/* Supplies records to embedDBBulkLoad. Returns 1 if a record was copied to key and data, 0 at the end of the stream and a negative value on error. */
+typedef int8_t (*embedDBBulkLoadReader)(void *context, void *key, void *data);
+
 typedef struct {
-    uint32_t nextDataPage; /* Next data page that the iterator should read */
-    uint16_t nextDataRec;  /* Next record on the data page tat the iterator should read */
+    pgid_t nextDataPage; /* Next data page that the iterator should read */
+    uint16_t nextDataRec;  /* Next record on the data page tat the iterator should read. Last record returned for reverse iterators. */
     void *minKey;
     void *maxKey;
     void *minData;
@@ -280,11 +456,17 @@ typedef struct {
 } embedDBIterator;
 
 typedef struct {
-    uint32_t totalBytes; /* Total number of bytes in the stream */
-    uint32_t bytesRead;  /* Number of bytes read so far */
-    uint32_t dataStart;  /* Start of data as an offset in bytes from the beginning of the file */
-    uint32_t fileOffset; /* Where the iterator should start reading data next time (offset from start of file) */
-} embedDBVarDataStream;
+    uint64_t minKey;                /* Smallest key whose data is still stored */
+    uint64_t maxKey;                /* Largest key stored */
+    int8_t hasKeys;                 /* 1 if the region holds records, and minKey and maxKey are set */
+    uint32_t numPages;              /* Number of pages in the region */
+    uint32_t freePages;             /* Pages that can be written before the oldest data is erased */
+    uint32_t freeBytes;             /* Most bytes that can be stored before the oldest data is erased. Partial pages written early, as variable data pages are when a data page fills, leave less. */
+    uint32_t recordsUntilOverwrite; /* Inserts before the oldest data is erased. Predicted from the average so far for variable data, UINT32_MAX if none was stored. */
+} embedDBRegionInfo;
+
+/* Receives the records of embedDBScanVar. Called once for each chunk of a record's variable data, starting at byte offset, and once with length 0 if it has none. varStatus is 0 if the record's variable data was read or it has none, and 1 if it was overwritten. Returns 0 to continue the scan and non-zero to stop it. */
+typedef int8_t (*embedDBScanVarCallback)(void *context, void *key, void *data, void *chunk, uint32_t offset, uint32_t length, uint32_t totalBytes, int8_t varStatus);
 
 typedef enum {
     ITERATE_NO_MATCH = -1,
@@ -322,6 +504,15 @@ void embedDBPrintInit(embedDBState *state);
  */
 int8_t embedDBPut(embedDBState *state, void *key, void *data);
 
+/**
+ * @brief	Loads a stream of records in ascending key order, building each page, its bitmap and index entries in one pass.
+ * @param	state	embedDB algorithm state structure
+ * @param	reader	Callback that copies the next key and data into the pointers it is given. Returns 1 if it copied a record, 0 at the end of the stream and a negative value on error.
+ * @param	context	Passed to every call of reader
+ * @return	Return 0 if success. 1 if a key was out of order, -1 if the reader or a page write failed.
+ */
+int8_t embedDBBulkLoad(embedDBState *state, embedDBBulkLoadReader reader, void *context);
+
 /**
  * @brief	Puts the given key, data, and variable length data into the structure.
  * @param	state			embedDB algorithm state structure
@@ -350,13 +541,94 @@ int8_t embedDBGet(embedDBState *state, void *key, void *data);
  * @param	state	embedDB algorithm state structure
  * @param	key		Key for record
  * @param	data	Pre-allocated memory to copy data for record
- * @param	varData	Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream after you are done with it**
+ * @param	varData	Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream with embedDBFreeVarDataStream after you are done with it**
  * @return	Return 0 if success. Non-zero value if error.
  * 			-1 : Error reading file
  * 			1  : Variable data was deleted to make room for newer data
  */
 int8_t embedDBGetVar(embedDBState *state, void *key, void *data, embedDBVarDataStream **varData);
 
+/**
+ * @brief	Given a key, returns data associated with key, setting up a
+ *          caller-allocated stream for its variable data. No memory is
+ *          allocated, so this can be used without a heap.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @param	varData	Pre-allocated stream for the variable data. totalBytes is set to 0 if the record has no variable data.
+ * @return	Return 0 if success. Non-zero value if error.
+ * 			-1 : Error reading file or key not found
+ * 			1  : Variable data was deleted to make room for newer data
+ */
+int8_t embedDBGetVarInto(embedDBState *state, void *key, void *data, embedDBVarDataStream *varData);
+
+/**
+ * @brief	Given an array of keys, returns the data associated with each key.
+ *          Keys should be sorted in ascending order so that each data page is
+ *          read at most once. Unsorted keys are still answered, with fewer
+ *          shared page reads.
+ * @param	state	embedDB algorithm state structure
+ * @param	keys	Array of numKeys keys
+ * @param	numKeys	Number of keys
+ * @param	data	Pre-allocated memory for numKeys data values
+ * @param	status	Pre-allocated array of numKeys results. Set to 0 if the key was found and -1 if not.
+ * @return	Return the number of keys found.
+ */
+uint32_t embedDBGetMany(embedDBState *state, void *keys, uint32_t numKeys, void *data, int8_t *status);
+
+/**
+ * @brief	Given an array of keys, returns the data and variable data associated with each key.
+ *          Keys should be sorted in ascending order so that data pages are read at most once
+ *          and consecutive variable data streams share variable page reads.
+ * @param	state	embedDB algorithm state structure
+ * @param	keys	Array of numKeys keys
+ * @param	numKeys	Number of keys
+ * @param	data	Pre-allocated memory for numKeys data values
+ * @param	varData	Pre-allocated array of numKeys stream pointers, each set as by embedDBGetVar. **Be sure to free the streams with embedDBFreeVarDataStream after you are done with them**
+ * @param	status	Pre-allocated array of numKeys results, with the values embedDBGetVar returns
+ * @return	Return the number of keys found.
+ */
+uint32_t embedDBGetManyVar(embedDBState *state, void *keys, uint32_t numKeys, void *data, embedDBVarDataStream **varData, int8_t *status);
+
+/**
+ * @brief	Returns the newest record. No I/O is done if it is in the write buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Pre-allocated memory to copy the key of the record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if success. -1 if there are no records or the last data page could not be read.
+ */
+int8_t embedDBGetLatest(embedDBState *state, void *key, void *data);
+
+/**
+ * @brief	Returns the record with the largest key <= key.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @param	foundKey	Pre-allocated memory to copy the key of the record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if success. -1 if every key is larger than key or a page could not be read.
+ */
+int8_t embedDBGetFloor(embedDBState *state, void *key, void *foundKey, void *data);
+
+/**
+ * @brief	Returns the record with the smallest key >= key.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @param	foundKey	Pre-allocated memory to copy the key of the record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if success. -1 if every key is smaller than key or a page could not be read.
+ */
+int8_t embedDBGetCeiling(embedDBState *state, void *key, void *foundKey, void *data);
+
+/**
+ * @brief	Returns the record whose key is closest to key. Ties return the smaller key.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @param	foundKey	Pre-allocated memory to copy the key of the record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if success. -1 if there are no records or a page could not be read.
+ */
+int8_t embedDBGetNearest(embedDBState *state, void *key, void *foundKey, void *data);
+
 /**
  * @brief	Initialize iterator on embedDB structure.
  * @param	state	embedDB algorithm state structure
@@ -364,6 +636,14 @@ int8_t embedDBGetVar(embedDBState *state, void *key, void *data, embedDBVarDataS
  */
 void embedDBInitIterator(embedDBState *state, embedDBIterator *it);
 
+/**
+ * @brief	Initialize an iterator that returns records newest first,
+ *          starting from the write buffer or the page that may hold maxKey.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ */
+void embedDBInitIteratorReverse(embedDBState *state, embedDBIterator *it);
+
 /**
  * @brief	Close iterator after use.
  * @param	it		embedDB iterator structure
@@ -386,11 +666,74 @@ int8_t embedDBNext(embedDBState *state, embedDBIterator *it, void *key, void *da
  * @param	it		embedDB iterator state structure
  * @param	key		Return variable for key (Pre-allocated)
  * @param	data	Return variable for data (Pre-allocated)
- * @param	varData	Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream after you are done with it**
+ * @param	varData	Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream with embedDBFreeVarDataStream after you are done with it**
  * @return	1 if successful, 0 if no more records
  */
 int8_t embedDBNextVar(embedDBState *state, embedDBIterator *it, void *key, void *data, embedDBVarDataStream **varData);
 
+/**
+ * @brief	Return next key, data, variable data set for iterator, setting up
+ *          a caller-allocated stream for the variable data. The same stream
+ *          may be passed for every record.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @param	varData	Pre-allocated stream for the variable data. totalBytes is set to 0 if the record has no variable data or it was deleted.
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBNextVarInto(embedDBState *state, embedDBIterator *it, void *key, void *data, embedDBVarDataStream *varData);
+
+/**
+ * @brief	Passes every remaining record of an iterator, with its variable
+ *          data in chunks, to a callback. The variable data of a forward
+ *          scan is read in one pass over the variable data file.
+ * @param	state		embedDB algorithm state structure
+ * @param	it			embedDB iterator state structure
+ * @param	key			Buffer for keys (Pre-allocated)
+ * @param	data		Buffer for data (Pre-allocated)
+ * @param	chunk		Buffer the variable data is read into. Chunks of at least a page are read straight from storage.
+ * @param	chunkSize	Size of chunk in bytes
+ * @param	callback	Function called with each chunk
+ * @param	context		Passed unchanged to callback
+ * @return	Number of records passed to callback, or -1 if a read failed
+ */
+int32_t embedDBScanVar(embedDBState *state, embedDBIterator *it, void *key, void *data, void *chunk, uint32_t chunkSize, embedDBScanVarCallback callback, void *context);
+
+/**
+ * @brief	Return previous key, data pair for a reverse iterator.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure initialized by embedDBInitIteratorReverse
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBPrev(embedDBState *state, embedDBIterator *it, void *key, void *data);
+
+/**
+ * @brief	Return previous key, data, variable data set for a reverse iterator.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure initialized by embedDBInitIteratorReverse
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @param	varData	Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream with embedDBFreeVarDataStream after you are done with it**
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBPrevVar(embedDBState *state, embedDBIterator *it, void *key, void *data, embedDBVarDataStream **varData);
+
+/**
+ * @brief	Return previous key, data, variable data set for a reverse
+ *          iterator, setting up a caller-allocated stream for the variable data.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure initialized by
+ *                  embedDBInitIteratorReverse
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @param	varData	Pre-allocated stream for the variable data. totalBytes is set to 0 if the record has no variable data or it was deleted.
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBPrevVarInto(embedDBState *state, embedDBIterator *it, void *key, void *data, embedDBVarDataStream *varData);
+
 /**
  * @brief	Reads data from variable data stream into the given buffer.
  * @param	state	embedDB algorithm state structure
@@ -401,6 +744,25 @@ int8_t embedDBNextVar(embedDBState *state, embedDBIterator *it, void *key, void
  */
 uint32_t embedDBVarDataStreamRead(embedDBState *state, embedDBVarDataStream *stream, void *buffer, uint32_t length);
 
+/**
+ * @brief	Moves a variable data stream to a byte offset in its data, so the
+ *          next read starts there. No pages are read to find the offset.
+ * @param	state	embedDB algorithm state structure
+ * @param	stream	Variable data stream
+ * @param	offset	Offset in bytes from the start of the data, at most totalBytes
+ * @return	0 if success, -1 if the offset is past the end of the data
+ */
+int8_t embedDBVarDataStreamSeek(embedDBState *state, embedDBVarDataStream *stream, uint32_t offset);
+
+/**
+ * @brief	Frees a stream returned by embedDBGetVar, embedDBGetManyVar,
+ *          embedDBNextVar or embedDBPrevVar. Streams from the stream pool
+ *          are returned to the pool. NULL is ignored.
+ * @param	state	embedDB algorithm state structure
+ * @param	stream	Variable data stream
+ */
+void embedDBFreeVarDataStream(embedDBState *state, embedDBVarDataStream *stream);
+
 /**
  * @brief	Flushes output buffer.
  * @param	state	algorithm state structure
@@ -415,6 +777,56 @@ int8_t embedDBFlush(embedDBState *state);
  */
 int8_t embedDBFlushVar(embedDBState *state);
 
+/**
+ * @brief	Makes every inserted record durable by writing the partial
+ *          data page (and variable data page) as a record-level
+ *          consistency page. Only needed with EMBEDDB_RLC_GROUP_COMMIT.
+ * @param	state	algorithm state structure
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+int8_t embedDBCommit(embedDBState *state);
+
+/**
+ * @brief	Erases the next erase block of the data, index and variable
+ *          data files once their free pages have run out, so the insert
+ *          that needs the block does not wait for the erase. Call it when
+ *          the device is idle. It must not run at the same time as any
+ *          other call on the same state.
+ * @param	state	algorithm state structure
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+int8_t embedDBPreErase(embedDBState *state);
+
+/**
+ * @brief	Reports the keys still stored and the space left in the data and
+ *          variable data regions.
+ * @param	state	algorithm state structure
+ * @param	data	Return variable for the data region
+ * @param	var		Return variable for the variable data region. May be NULL,
+ *                  and is cleared if variable data is not used.
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+int8_t embedDBGetSpaceInfo(embedDBState *state, embedDBRegionInfo *data, embedDBRegionInfo *var);
+
+/**
+ * @brief	Moves pages from the data region to the variable data region,
+ *          or back if numPages is negative. Before a region wraps, the
+ *          shrinking one must keep the pages it has written. A wrapped data
+ *          region can grow when nextDataPageId is a multiple of numDataPages
+ *          and nextDataPageId - numDataPages is a multiple of the new count.
+ *          It can shrink when nextDataPageId is a multiple of the new count
+ *          and leaves the new count as its remainder by numDataPages, which
+ *          drops the pages that no longer fit. A wrapped variable data
+ *          region can only grow, right after a flush that left nextVarPageId
+ *          at a multiple of numVarPages and nextVarPageId - numVarPages at a
+ *          multiple of the new count. Flushes the buffers when using the
+ *          superblock so it records the new page counts.
+ * @param	state		algorithm state structure
+ * @param	numPages	Pages to move, a multiple of eraseSizeInPages
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+int8_t embedDBRebalance(embedDBState *state, int32_t numPages);
+
 /**
  * @brief	Reads given page from storage.
  * @param	state	embedDB algorithm state structure
@@ -0,0 +1,318 @@
+/******************************************************************************/
+/**
+ * @file        fenceIndex.c
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Implementation of the fence index.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#include "../embedDB/embedDB.h"
+
+#include <string.h>
+
+/**
+ * @brief   Initialize a fence index able to hold the keys of maxPages pages.
+ * @param   fence       Fence index structure
+ * @param   maxPages    Maximum number of pages to index
+ * @param   keySize     Size of key in bytes
+ * @return  Returns zero if successful and non-zero if memory could not be allocated
+ */
+int8_t
+fenceIndexInit(fenceIndex * fence,
+	       uint32_t     maxPages,
+	       uint8_t      keySize)
+{
+  fence->maxBlocks = maxPages / FENCE_INDEX_KEYS_PER_BLOCK + 2;
+  /* Always leave room for two blocks of worst case 10 byte varints */
+  fence->poolSize = max(maxPages * FENCE_INDEX_BYTES_PER_PAGE,
+			2 * FENCE_INDEX_KEYS_PER_BLOCK * 10);
+  fence->firstBlock = 0;
+  fence->numBlocks = 0;
+  fence->poolUsed = 0;
+  fence->firstPageId = 0;
+  fence->count = 0;
+  fence->lastKey = 0;
+  fence->lastDelta = 0;
+  fence->keySize = keySize;
+  fence->blocks = NULL;
+  fence->pool = NULL;
+  if (!EDB_WITH_HEAP) {
+    return -1;
+  }
+  fence->blocks = (fenceBlock *)malloc(fence->maxBlocks * sizeof(fenceBlock));
+  fence->pool = (uint8_t *)malloc(fence->poolSize);
+  if (fence->blocks == NULL || fence->pool == NULL) {
+    fenceIndexClose(fence);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief   Drops the oldest block from the index.
+ * @param   fence   Fence index structure
+ */
+static void
+fenceIndexEvictBlock(fenceIndex * fence)
+{
+  if (fence->numBlocks == 0)
+    return;
+  
+  uint32_t blockBytes = fence->poolUsed;
+  if (fence->numBlocks > 1) {
+    uint32_t nextBlock = (fence->firstBlock + 1) % fence->maxBlocks;
+    blockBytes = (fence->blocks[nextBlock].offset + fence->poolSize -
+		  fence->blocks[fence->firstBlock].offset) % fence->poolSize;
+  }
+  fence->poolUsed -= blockBytes;
+  fence->firstBlock = (fence->firstBlock + 1) % fence->maxBlocks;
+  fence->numBlocks--;
+  
+  uint32_t removed = min(fence->count, FENCE_INDEX_KEYS_PER_BLOCK);
+  fence->count -= removed;
+  fence->firstPageId += removed;
+}
+
+/**
+ * @brief   Adds the smallest key of a page to the index. Pages must be added
+ *          in order. If pageId does not follow the last page added, the
+ *          index is restarted at pageId.
+ * @param   fence   Fence index structure
+ * @param   key     Smallest key on the page
+ * @param   pageId  Logical page id
+ */
+void
+fenceIndexAdd(fenceIndex * fence,
+	      void *       key,
+	      pgid_t       pageId)
+{
+  uint64_t keyVal = 0;
+  memcpy(&keyVal, key, fence->keySize);
+  
+  if (fence->count > 0 && pageId != fence->firstPageId + fence->count) {
+    fence->numBlocks = 0;
+    fence->poolUsed = 0;
+    fence->count = 0;
+  }
+  if (fence->count == 0) {
+    fence->firstBlock = 0;
+    fence->firstPageId = pageId;
+  }
+  
+  if (fence->count % FENCE_INDEX_KEYS_PER_BLOCK == 0) {
+    /* First key of a block goes in the directory */
+    if (fence->numBlocks == fence->maxBlocks) {
+      fenceIndexEvictBlock(fence);
+    }
+    uint32_t offset = 0;
+    if (fence->numBlocks > 0) {
+      offset = (fence->blocks[fence->firstBlock].offset + fence->poolUsed) % fence->poolSize;
+    }
+    fenceBlock *block = &fence->blocks[(fence->firstBlock + fence->numBlocks) % fence->maxBlocks];
+    block->baseKey = keyVal;
+    block->offset = offset;
+    fence->numBlocks++;
+    fence->lastDelta = 0;
+  } else {
+    /* Zig-zag encode the change in delta so regular series take one byte */
+    uint64_t delta = keyVal - fence->lastKey;
+    uint64_t change = delta - fence->lastDelta;
+    uint64_t value = (change << 1) ^ (uint64_t)((int64_t)change >> 63);
+    uint8_t bytes[10];
+    uint8_t numBytes = 0;
+    do {
+      bytes[numBytes] = value & 0x7F;
+      value >>= 7;
+      if (value != 0)
+	bytes[numBytes] |= 0x80;
+      numBytes++;
+    } while (value != 0);
+    
+    /* Make room by dropping the oldest pages, never the current block */
+    while (fence->poolSize - fence->poolUsed < numBytes && fence->numBlocks > 1) {
+      fenceIndexEvictBlock(fence);
+    }
+    uint32_t pos = (fence->blocks[fence->firstBlock].offset + fence->poolUsed) % fence->poolSize;
+    for (uint8_t i = 0; i < numBytes; i++) {
+      fence->pool[(pos + i) % fence->poolSize] = bytes[i];
+    }
+    fence->poolUsed += numBytes;
+    fence->lastDelta = delta;
+  }
+  
+  fence->lastKey = keyVal;
+  fence->count++;
+}
+
+/**
+ * @brief   Removes pages with ids smaller than minPageId. Pages are released
+ *          a block at a time, so a few older pages may remain indexed.
+ * @param   fence       Fence index structure
+ * @param   minPageId   Smallest logical page id that must stay indexed
+ */
+void
+fenceIndexTrim(fenceIndex * fence,
+	       pgid_t       minPageId)
+{
+  while (fence->numBlocks > 1 &&
+	 fence->firstPageId + FENCE_INDEX_KEYS_PER_BLOCK <= minPageId) {
+    fenceIndexEvictBlock(fence);
+  }
+}
+
+/**
+ * @brief   Finds the last page whose smallest key is less than or equal to key.
+ * @param   fence   Fence index structure
+ * @param   key     Key to search for
+ * @param   pageId  Return variable for the logical page id
+ * @return  Returns zero if found and non-zero if key is smaller than every indexed key
+ */
+int8_t
+fenceIndexFind(fenceIndex * fence,
+	       void *       key,
+	       pgid_t *     pageId)
+{
+  uint64_t keyVal = 0;
+  memcpy(&keyVal, key, fence->keySize);
+  
+  if (fence->count == 0 || keyVal < fence->blocks[fence->firstBlock].baseKey) {
+    return -1;
+  }
+  
+  /* Binary search the directory for the last block starting at or before key */
+  uint32_t low = 0, high = fence->numBlocks - 1;
+  while (low < high) {
+    uint32_t mid = (low + high + 1) / 2;
+    if (fence->blocks[(fence->firstBlock + mid) % fence->maxBlocks].baseKey <= keyVal) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  
+  /* Decode the block until the next page starts after key */
+  fenceBlock *block = &fence->blocks[(fence->firstBlock + low) % fence->maxBlocks];
+  uint32_t keysInBlock = min(fence->count - low * FENCE_INDEX_KEYS_PER_BLOCK,
+			     FENCE_INDEX_KEYS_PER_BLOCK);
+  uint32_t pos = block->offset;
+  uint64_t current = block->baseKey, delta = 0;
+  uint32_t page = 0;
+  for (uint32_t i = 1; i < keysInBlock; i++) {
+    uint64_t value = 0;
+    uint8_t shift = 0, byte;
+    do {
+      byte = fence->pool[pos];
+      pos = (pos + 1) % fence->poolSize;
+      value |= (uint64_t)(byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    delta += (value >> 1) ^ (~(value & 1) + 1);
+    if (current + delta > keyVal)
+      break;
+    current += delta;
+    page++;
+  }
+  
+  *pageId = fence->firstPageId + low * FENCE_INDEX_KEYS_PER_BLOCK + page;
+  return 0;
+}
+
+/**
+ * @brief   Returns the first logical page id covered by the index.
+ * @param   fence   Fence index structure
+ * @return  Returns the page id, or EDB_PGID_MAX if the index is empty
+ */
+pgid_t
+fenceIndexFirstPage(fenceIndex * fence)
+{
+  return fence->count == 0 ? EDB_PGID_MAX : fence->firstPageId;
+}
+
+/**
+ * @brief   Returns the number of bytes of memory used by the index.
+ * @param   fence   Fence index structure
+ * @return  Size of the index in bytes
+ */
+uint32_t
+fenceIndexSize(fenceIndex * fence)
+{
+  return sizeof(fenceIndex) + fence->maxBlocks * sizeof(fenceBlock) + fence->poolSize;
+}
+
+/**
+ * @brief   Returns the memory in bytes the index needs per million pages at
+ *          the compression achieved for the keys it currently holds.
+ * @param   fence   Fence index structure
+ * @return  Bytes per million pages, or 0 if the index is empty
+ */
+uint32_t
+fenceIndexBytesPerMillionPages(fenceIndex * fence)
+{
+  if (fence->count == 0)
+    return 0;
+  uint64_t bytes = (uint64_t)fence->numBlocks * sizeof(fenceBlock) + fence->poolUsed;
+  return (uint32_t)(bytes * 1000000 / fence->count);
+}
+
+/**
+ * @brief   Print a fence index summary.
+ * @param   fence   Fence index structure
+ */
+void
+fenceIndexPrint(fenceIndex * fence)
+{
+  if (!fence) {
+    EDB_PRINTF("No fence index to print.\n");
+    return;
+  }
+  EDB_PRINTF("Fence index pages: %" PRIu32 " (first page %" EDB_PRIpgid ")\n",
+	     fence->count, fence->firstPageId);
+  EDB_PRINTF("Fence index blocks: %" PRIu32 " Pool bytes used: %" PRIu32 " of %" PRIu32 "\n",
+	     fence->numBlocks, fence->poolUsed, fence->poolSize);
+  EDB_PRINTF("Fence index bytes per million pages: %" PRIu32 "\n",
+	     fenceIndexBytesPerMillionPages(fence));
+}
+
+/**
+ * @brief   Free memory allocated for the fence index.
+ * @param   fence   Fence index structure
+ */
+void
+fenceIndexClose(fenceIndex * fence)
+{
+  if (EDB_WITH_HEAP) {
+    free(fence->blocks);
+    free(fence->pool);
+  }
+  fence->blocks = NULL;
+  fence->pool = NULL;
+  fence->count = 0;
+  fence->numBlocks = 0;
+}
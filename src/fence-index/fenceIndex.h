@@ -0,0 +1,158 @@
+/******************************************************************************/
+/**
+ * @file        fenceIndex.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Exact in-memory index of the smallest key on every data page.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+#ifndef FENCE_INDEX_H
+#define FENCE_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../spline/spline.h"
+
+/* Number of page keys encoded together behind one directory entry */
+#define FENCE_INDEX_KEYS_PER_BLOCK 32
+
+/* Bytes of key pool reserved per data page. Regular key series need
+   about one byte per page, so the default leaves room for some jitter.
+   When the pool fills, the oldest pages are dropped from the index. */
+#if !defined(FENCE_INDEX_BYTES_PER_PAGE)
+#define FENCE_INDEX_BYTES_PER_PAGE 2
+#endif
+
+typedef struct {
+  uint64_t baseKey;  /* Smallest key of the first page in the block */
+  uint32_t offset;   /* Pool offset of the encoded keys of the rest of the block */
+} fenceBlock;
+
+typedef struct fenceIndex_s fenceIndex;
+
+/*
+ * Page min keys are appended in page order. The first key of every
+ * block of FENCE_INDEX_KEYS_PER_BLOCK pages is stored in the block
+ * directory, and the others as zig-zag varints of the difference
+ * between consecutive key deltas. Both the directory and the key pool
+ * are circular so pages can be trimmed from the front as storage wraps.
+ */
+struct fenceIndex_s {
+  fenceBlock * blocks;      /* Circular block directory */
+  uint8_t *    pool;        /* Circular pool of encoded keys */
+  uint32_t     maxBlocks;   /* Number of directory entries allocated */
+  uint32_t     poolSize;    /* Size of pool in bytes */
+  uint32_t     firstBlock;  /* Directory index of the oldest block */
+  uint32_t     numBlocks;   /* Number of blocks in use */
+  uint32_t     poolUsed;    /* Number of pool bytes in use */
+  pgid_t       firstPageId; /* Logical page id of the first key of the oldest block */
+  uint32_t     count;       /* Number of page keys stored */
+  uint64_t     lastKey;     /* Most recently added key */
+  uint64_t     lastDelta;   /* Difference between the two most recently added keys */
+  uint8_t      keySize;     /* Size of key in bytes */
+};
+
+/**
+ * @brief   Initialize a fence index able to hold the keys of maxPages pages.
+ * @param   fence       Fence index structure
+ * @param   maxPages    Maximum number of pages to index
+ * @param   keySize     Size of key in bytes
+ * @return  Returns zero if successful and non-zero if memory could not be allocated
+ */
+int8_t fenceIndexInit(fenceIndex * fence, uint32_t maxPages, uint8_t keySize);
+
+/**
+ * @brief   Adds the smallest key of a page to the index. Pages must be added
+ *          in order. If pageId does not follow the last page added, the
+ *          index is restarted at pageId.
+ * @param   fence   Fence index structure
+ * @param   key     Smallest key on the page
+ * @param   pageId  Logical page id
+ */
+void fenceIndexAdd(fenceIndex * fence, void * key, pgid_t pageId);
+
+/**
+ * @brief   Removes pages with ids smaller than minPageId. Pages are released
+ *          a block at a time, so a few older pages may remain indexed.
+ * @param   fence       Fence index structure
+ * @param   minPageId   Smallest logical page id that must stay indexed
+ */
+void fenceIndexTrim(fenceIndex * fence, pgid_t minPageId);
+
+/**
+ * @brief   Finds the last page whose smallest key is less than or equal to key.
+ * @param   fence   Fence index structure
+ * @param   key     Key to search for
+ * @param   pageId  Return variable for the logical page id
+ * @return  Returns zero if found and non-zero if key is smaller than every indexed key
+ */
+int8_t fenceIndexFind(fenceIndex * fence, void * key, pgid_t * pageId);
+
+/**
+ * @brief   Returns the first logical page id covered by the index.
+ * @param   fence   Fence index structure
+ * @return  Returns the page id, or EDB_PGID_MAX if the index is empty
+ */
+pgid_t fenceIndexFirstPage(fenceIndex * fence);
+
+/**
+ * @brief   Returns the number of bytes of memory used by the index.
+ * @param   fence   Fence index structure
+ */
+uint32_t fenceIndexSize(fenceIndex * fence);
+
+/**
+ * @brief   Returns the memory in bytes the index needs per million pages at
+ *          the compression achieved for the keys it currently holds.
+ * @param   fence   Fence index structure
+ */
+uint32_t fenceIndexBytesPerMillionPages(fenceIndex * fence);
+
+/**
+ * @brief   Print a fence index summary.
+ * @param   fence   Fence index structure
+ */
+void fenceIndexPrint(fenceIndex * fence);
+
+/**
+ * @brief   Free memory allocated for the fence index.
+ * @param   fence   Fence index structure
+ */
+void fenceIndexClose(fenceIndex * fence);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
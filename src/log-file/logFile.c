@@ -0,0 +1,579 @@
+/******************************************************************************/
+/**
+ * @file        logFile.c
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Single circular log holding the data, index and variable data pages.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#include "logFile.h"
+
+#include <string.h>
+
+/**
+ * @brief   Initialize a log with room for the given number of pages.
+ * @param   log             Log structure
+ * @param   base            Interface to the file holding the log
+ * @param   file            File holding the log, for example from setupFile
+ * @param   pageSize        Size of an EmbedDB page
+ * @param   numDataPages    Largest numDataPages the EmbedDB state will use
+ * @param   numIndexPages   Largest numIndexPages the EmbedDB state will use (0 if not used)
+ * @param   numVarPages     Largest numVarPages the EmbedDB state will use (0 if not used)
+ * @param   numSlots        Number of page slots in the file. Must be larger than
+ *                          the number of pages the streams hold at once, but
+ *                          may be less than the sum of the stream sizes.
+ * @return  Returns zero if successful and non-zero if memory could not be allocated
+ *          or numSlots does not fit in logslot_t
+ */
+int8_t
+logFileInit(logFile *              log,
+	    embedDBFileInterface * base,
+	    void *                 file,
+	    uint32_t               pageSize,
+	    uint32_t               numDataPages,
+	    uint32_t               numIndexPages,
+	    uint32_t               numVarPages,
+	    uint32_t               numSlots)
+{
+  log->base = base;
+  log->file = file;
+  log->pageSize = pageSize;
+  log->numSlots = numSlots;
+  log->slotsPerGroup = pageSize > LOG_FILE_TAG_HEADER_SIZE ? (pageSize - LOG_FILE_TAG_HEADER_SIZE) / LOG_FILE_TAG_SIZE : 0;
+  log->streamPages[LOG_FILE_DATA] = numDataPages;
+  log->streamPages[LOG_FILE_INDEX] = numIndexPages;
+  log->streamPages[LOG_FILE_VAR] = numVarPages;
+  log->numPages = 0;
+  for (uint8_t i = 0; i < LOG_FILE_NUM_STREAMS; i++) {
+    log->streamStart[i] = log->numPages;
+    log->numPages += log->streamPages[i];
+    log->streams[i].log = log;
+    log->streams[i].stream = i;
+  }
+  log->baseOpen = false;
+  log->openStreams = 0;
+  log->slotUsed = NULL;
+  log->pageSlot = NULL;
+  log->tagPage = NULL;
+  if (!EDB_WITH_HEAP || numSlots == 0 || numSlots >= LOG_FILE_NO_SLOT || log->slotsPerGroup == 0) {
+    return -1;
+  }
+  log->slotUsed = (uint8_t *)malloc((numSlots + 7) / 8);
+  log->pageSlot = (logslot_t *)malloc(log->numPages * sizeof(logslot_t));
+  log->tagPage = malloc(pageSize);
+  if (log->slotUsed == NULL || log->pageSlot == NULL || log->tagPage == NULL) {
+    logFileClose(log);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief   Marks every slot free and every stream empty.
+ * @param   log     Log structure
+ */
+static void
+logFileReset(logFile *log)
+{
+  memset(log->slotUsed, 0, (log->numSlots + 7) / 8);
+  memset(log->pageSlot, 0xFF, log->numPages * sizeof(logslot_t));
+  memset(log->markerSlot, 0xFF, sizeof(log->markerSlot));
+  memset(log->streamLength, 0, sizeof(log->streamLength));
+  log->head = 0;
+  log->sequence = 0;
+  log->tagGroup = UINT32_MAX;
+  log->tagDirty = false;
+}
+
+/**
+ * @brief   Returns whether a slot holds a page or marker.
+ * @param   log     Log structure
+ * @param   slot    Slot to check
+ */
+static bool
+logFileSlotUsed(logFile *log,
+		uint32_t slot)
+{
+  return (log->slotUsed[slot / 8] >> (slot % 8)) & 1;
+}
+
+/**
+ * @brief   Marks a slot as holding a page or marker, or as free.
+ * @param   log     Log structure
+ * @param   slot    Slot to mark
+ * @param   used    Whether the slot is in use
+ */
+static void
+logFileSetSlotUsed(logFile *log,
+		   uint32_t slot,
+		   bool     used)
+{
+  if (used)
+    log->slotUsed[slot / 8] |= 1 << (slot % 8);
+  else
+    log->slotUsed[slot / 8] &= ~(1 << (slot % 8));
+}
+
+/**
+ * @brief   Returns the page of the file holding a slot.
+ * @param   log     Log structure
+ * @param   slot    Slot in the log
+ */
+static uint32_t
+logFileSlotPage(logFile *log,
+		uint32_t slot)
+{
+  return slot / log->slotsPerGroup * (log->slotsPerGroup + 1) + slot % log->slotsPerGroup;
+}
+
+/**
+ * @brief   Returns the page of the file holding the tags of a group, which
+ *          follows the group's last slot.
+ * @param   log     Log structure
+ * @param   group   Group of slots
+ */
+static uint32_t
+logFileTagPage(logFile *log,
+	       uint32_t group)
+{
+  uint32_t firstSlot = group * log->slotsPerGroup;
+  return logFileSlotPage(log, firstSlot) + min(log->slotsPerGroup, log->numSlots - firstSlot);
+}
+
+/**
+ * @brief   Returns the tag of a slot in the loaded tag page.
+ * @param   log     Log structure
+ * @param   slot    Slot in the group of tagPage
+ */
+static uint8_t *
+logFileTag(logFile *log,
+	   uint32_t slot)
+{
+  return (uint8_t *)log->tagPage + LOG_FILE_TAG_HEADER_SIZE + slot % log->slotsPerGroup * LOG_FILE_TAG_SIZE;
+}
+
+/**
+ * @brief   Writes the loaded tag page, marking the slots freed since it was
+ *          loaded as free.
+ * @param   log     Log structure
+ * @return  Returns true if successful
+ */
+static bool
+logFileWriteTags(logFile *log)
+{
+  uint32_t firstSlot = log->tagGroup * log->slotsPerGroup;
+  uint32_t numGroupSlots = min(log->slotsPerGroup, log->numSlots - firstSlot);
+  for (uint32_t slot = firstSlot; slot < firstSlot + numGroupSlots; slot++) {
+    if (!logFileSlotUsed(log, slot))
+      memset(logFileTag(log, slot), 0xFF, LOG_FILE_TAG_SIZE);
+  }
+  uint32_t magic = LOG_FILE_TAG_MAGIC;
+  memcpy(log->tagPage, &magic, sizeof(uint32_t));
+  memcpy((uint8_t *)log->tagPage + sizeof(uint32_t), &log->tagGroup, sizeof(uint32_t));
+  if (!log->base->write(log->tagPage, logFileTagPage(log, log->tagGroup), log->pageSize, log->file))
+    return false;
+  log->tagDirty = false;
+  return true;
+}
+
+/**
+ * @brief   Reads a group's tag page so its slots can be written. The
+ *          previous group's tags are written first if they changed. If
+ *          slots were freed since the tag page was written, it is written
+ *          again with them free, so a rebuilt map never points a tag at a
+ *          slot written after it.
+ * @param   log     Log structure
+ * @param   group   Group of slots
+ * @return  Returns true if successful
+ */
+static bool
+logFileLoadTags(logFile *log,
+		uint32_t group)
+{
+  if (log->tagGroup == group)
+    return true;
+  if (log->tagGroup != UINT32_MAX && log->tagDirty && !logFileWriteTags(log))
+    return false;
+  
+  log->tagGroup = group;
+  uint32_t firstSlot = group * log->slotsPerGroup;
+  uint32_t numGroupSlots = min(log->slotsPerGroup, log->numSlots - firstSlot);
+  uint32_t magic = 0, tagGroup = 0;
+  bool valid = log->base->read(log->tagPage, logFileTagPage(log, group), log->pageSize, log->file);
+  memcpy(&magic, log->tagPage, sizeof(uint32_t));
+  memcpy(&tagGroup, (uint8_t *)log->tagPage + sizeof(uint32_t), sizeof(uint32_t));
+  if (!valid || magic != LOG_FILE_TAG_MAGIC || tagGroup != group) {
+    /* Only a group that was never written has no tag page */
+    for (uint32_t slot = firstSlot; slot < firstSlot + numGroupSlots; slot++) {
+      if (logFileSlotUsed(log, slot)) {
+	EDB_PERRF("ERROR: Failed to read the tags of log group %lu.\n", (unsigned long)group);
+	log->tagGroup = UINT32_MAX;
+	return false;
+      }
+    }
+    memset(log->tagPage, 0xFF, log->pageSize);
+    return true;
+  }
+  
+  for (uint32_t slot = firstSlot; slot < firstSlot + numGroupSlots; slot++) {
+    uint32_t entry;
+    memcpy(&entry, logFileTag(log, slot), sizeof(uint32_t));
+    if (!logFileSlotUsed(log, slot) && entry != LOG_FILE_NO_ENTRY)
+      return logFileWriteTags(log);
+  }
+  return true;
+}
+
+/**
+ * @brief   Returns the stream an entry of pageSlot belongs to.
+ * @param   log     Log structure
+ * @param   page    Entry in pageSlot
+ */
+static uint8_t
+logFileStreamOf(logFile *log,
+		uint32_t page)
+{
+  uint8_t stream = 0;
+  while (stream + 1 < LOG_FILE_NUM_STREAMS && page >= log->streamStart[stream + 1])
+    stream++;
+  return stream;
+}
+
+/**
+ * @brief   Writes a page to the next free slot and tags it with entry.
+ *          Only slots whose written tag is free are used, so a slot freed
+ *          in the loaded group waits until its tags are written again.
+ * @param   log     Log structure
+ * @param   entry   Entry in pageSlot, or numPages + stream for a truncation marker
+ * @param   buffer  Page to write, or NULL for a marker
+ * @return  Returns the slot written, or LOG_FILE_NO_SLOT if the log is full or the write failed
+ */
+static logslot_t
+logFileAppend(logFile *log,
+	      uint32_t entry,
+	      void *   buffer)
+{
+  uint32_t slot = UINT32_MAX;
+  for (uint8_t attempt = 0; attempt < 2 && slot == UINT32_MAX; attempt++) {
+    if (attempt == 1) {
+      if (log->tagGroup == UINT32_MAX || !logFileWriteTags(log))
+	break;
+    }
+    for (uint32_t i = 0; i < log->numSlots; i++) {
+      uint32_t candidate = (log->head + i) % log->numSlots;
+      if (logFileSlotUsed(log, candidate))
+	continue;
+      if (!logFileLoadTags(log, candidate / log->slotsPerGroup))
+	return LOG_FILE_NO_SLOT;
+      uint32_t tagEntry;
+      memcpy(&tagEntry, logFileTag(log, candidate), sizeof(uint32_t));
+      if (tagEntry == LOG_FILE_NO_ENTRY) {
+	slot = candidate;
+	break;
+      }
+    }
+  }
+  if (slot == UINT32_MAX) {
+    EDB_PERRF("ERROR: The log file has no free slots.\n");
+    return LOG_FILE_NO_SLOT;
+  }
+  
+  if (buffer != NULL && !log->base->write(buffer, logFileSlotPage(log, slot), log->pageSize, log->file))
+    return LOG_FILE_NO_SLOT;
+  
+  uint8_t *tag = logFileTag(log, slot);
+  memcpy(tag, &entry, sizeof(uint32_t));
+  memcpy(tag + sizeof(uint32_t), &log->sequence, sizeof(uint32_t));
+  log->tagDirty = true;
+  logFileSetSlotUsed(log, slot, true);
+  log->head = (slot + 1) % log->numSlots;
+  log->sequence++;
+  return (logslot_t)slot;
+}
+
+/**
+ * @brief   Rebuilds the map from pages to slots by reading every tag page.
+ *          The newest copy of each page is kept, and pages written before
+ *          the newest truncation marker of their stream are dropped.
+ * @param   log     Log structure
+ * @return  Returns zero if successful and non-zero if memory could not be allocated
+ */
+static int8_t
+logFileLoad(logFile *log)
+{
+  logFileReset(log);
+  uint32_t *pageSequence = (uint32_t *)malloc((log->numPages + LOG_FILE_NUM_STREAMS) * sizeof(uint32_t));
+  if (pageSequence == NULL)
+    return -1;
+  
+  bool found = false;
+  uint32_t newest = 0;
+  uint32_t numGroups = (log->numSlots + log->slotsPerGroup - 1) / log->slotsPerGroup;
+  for (uint32_t group = 0; group < numGroups; group++) {
+    if (!log->base->read(log->tagPage, logFileTagPage(log, group), log->pageSize, log->file))
+      continue;
+    uint32_t magic, tagGroup;
+    memcpy(&magic, log->tagPage, sizeof(uint32_t));
+    memcpy(&tagGroup, (uint8_t *)log->tagPage + sizeof(uint32_t), sizeof(uint32_t));
+    if (magic != LOG_FILE_TAG_MAGIC || tagGroup != group)
+      continue;
+    
+    uint32_t firstSlot = group * log->slotsPerGroup;
+    uint32_t numGroupSlots = min(log->slotsPerGroup, log->numSlots - firstSlot);
+    for (uint32_t slot = firstSlot; slot < firstSlot + numGroupSlots; slot++) {
+      uint32_t entry, sequence;
+      memcpy(&entry, logFileTag(log, slot), sizeof(uint32_t));
+      memcpy(&sequence, logFileTag(log, slot) + sizeof(uint32_t), sizeof(uint32_t));
+      if (entry >= log->numPages + LOG_FILE_NUM_STREAMS)
+	continue;
+      
+      if (!found || (int32_t)(sequence - newest) > 0) {
+	newest = sequence;
+	log->head = (slot + 1) % log->numSlots;
+	found = true;
+      }
+      
+      /* Keep the newest copy of each page and the newest marker of each stream */
+      logslot_t *current = entry < log->numPages ? &log->pageSlot[entry] : &log->markerSlot[entry - log->numPages];
+      if (*current != LOG_FILE_NO_SLOT && (int32_t)(sequence - pageSequence[entry]) <= 0)
+	continue;
+      if (*current != LOG_FILE_NO_SLOT)
+	logFileSetSlotUsed(log, *current, false);
+      *current = (logslot_t)slot;
+      logFileSetSlotUsed(log, slot, true);
+      pageSequence[entry] = sequence;
+    }
+  }
+  log->sequence = found ? newest + 1 : 0;
+  
+  for (uint32_t page = 0; page < log->numPages; page++) {
+    if (log->pageSlot[page] == LOG_FILE_NO_SLOT)
+      continue;
+    uint8_t stream = logFileStreamOf(log, page);
+    if (log->markerSlot[stream] != LOG_FILE_NO_SLOT &&
+	(int32_t)(pageSequence[page] - pageSequence[log->numPages + stream]) < 0) {
+      logFileSetSlotUsed(log, log->pageSlot[page], false);
+      log->pageSlot[page] = LOG_FILE_NO_SLOT;
+      continue;
+    }
+    uint32_t length = page - log->streamStart[stream] + 1;
+    if (length > log->streamLength[stream])
+      log->streamLength[stream] = length;
+  }
+  free(pageSequence);
+  return 0;
+}
+
+/**
+ * @brief   Empties a stream. A marker is written so the stream's old pages
+ *          stay dropped when the log is loaded again.
+ * @param   log     Log structure
+ * @param   stream  Stream to empty
+ * @return  Returns true if successful
+ */
+static bool
+logFileTruncate(logFile *log,
+		uint8_t  stream)
+{
+  if (log->streamLength[stream] == 0)
+    return true;
+  
+  logslot_t marker = logFileAppend(log, log->numPages + stream, NULL);
+  if (marker == LOG_FILE_NO_SLOT)
+    return false;
+  if (log->markerSlot[stream] != LOG_FILE_NO_SLOT)
+    logFileSetSlotUsed(log, log->markerSlot[stream], false);
+  log->markerSlot[stream] = marker;
+  
+  for (uint32_t i = 0; i < log->streamPages[stream]; i++) {
+    uint32_t page = log->streamStart[stream] + i;
+    if (log->pageSlot[page] != LOG_FILE_NO_SLOT) {
+      logFileSetSlotUsed(log, log->pageSlot[page], false);
+      log->pageSlot[page] = LOG_FILE_NO_SLOT;
+    }
+  }
+  log->streamLength[stream] = 0;
+  return true;
+}
+
+static bool LOG_READ(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+  logFileStream *stream = (logFileStream *)file;
+  logFile *log = stream->log;
+  if (pageSize != log->pageSize || pageNum >= log->streamLength[stream->stream])
+    return false;
+  
+  logslot_t slot = log->pageSlot[log->streamStart[stream->stream] + pageNum];
+  if (slot == LOG_FILE_NO_SLOT) {
+    /* Erased page */
+    memset(buffer, 0xFF, pageSize);
+    return true;
+  }
+  return log->base->read(buffer, logFileSlotPage(log, slot), log->pageSize, log->file);
+}
+
+static bool LOG_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+  logFileStream *stream = (logFileStream *)file;
+  logFile *log = stream->log;
+  /* Every slot holds exactly one page of the log's size */
+  if (pageSize != log->pageSize || pageNum >= log->streamPages[stream->stream])
+    return false;
+  
+  uint32_t page = log->streamStart[stream->stream] + pageNum;
+  logslot_t slot = logFileAppend(log, page, buffer);
+  if (slot == LOG_FILE_NO_SLOT)
+    return false;
+  
+  /* The old copy's slot can be reused once the new one is written */
+  if (log->pageSlot[page] != LOG_FILE_NO_SLOT)
+    logFileSetSlotUsed(log, log->pageSlot[page], false);
+  log->pageSlot[page] = slot;
+  if (pageNum >= log->streamLength[stream->stream])
+    log->streamLength[stream->stream] = pageNum + 1;
+  return true;
+}
+
+/* Erasing only frees the slots. Reused slots are overwritten in place, so
+   the file holding the log must allow that. */
+static bool LOG_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
+  logFileStream *stream = (logFileStream *)file;
+  logFile *log = stream->log;
+  if (pageSize != log->pageSize)
+    return false;
+  for (uint32_t pageNum = startPage; pageNum < endPage && pageNum < log->streamPages[stream->stream]; pageNum++) {
+    uint32_t page = log->streamStart[stream->stream] + pageNum;
+    if (log->pageSlot[page] != LOG_FILE_NO_SLOT) {
+      logFileSetSlotUsed(log, log->pageSlot[page], false);
+      log->pageSlot[page] = LOG_FILE_NO_SLOT;
+    }
+  }
+  return true;
+}
+
+static bool LOG_OPEN(void *file, uint8_t mode) {
+  logFileStream *stream = (logFileStream *)file;
+  logFile *log = stream->log;
+  
+  /* The first stream opened opens the log, and rebuilds the map if it already exists */
+  if (!log->baseOpen) {
+    if (mode == EMBEDDB_FILE_MODE_R_PLUS_B && log->base->open(log->file, EMBEDDB_FILE_MODE_R_PLUS_B)) {
+      if (logFileLoad(log) != 0) {
+	log->base->close(log->file);
+	return false;
+      }
+    } else if (log->base->open(log->file, EMBEDDB_FILE_MODE_W_PLUS_B)) {
+      logFileReset(log);
+    } else {
+      return false;
+    }
+    log->baseOpen = true;
+  }
+  
+  if (mode == EMBEDDB_FILE_MODE_W_PLUS_B) {
+    if (!logFileTruncate(log, stream->stream))
+      return false;
+  } else if (mode != EMBEDDB_FILE_MODE_R_PLUS_B || log->streamLength[stream->stream] == 0) {
+    return false;
+  }
+  log->openStreams |= 1 << stream->stream;
+  return true;
+}
+
+static bool LOG_CLOSE(void *file) {
+  logFileStream *stream = (logFileStream *)file;
+  logFile *log = stream->log;
+  log->openStreams &= ~(1 << stream->stream);
+  if (log->openStreams == 0 && log->baseOpen) {
+    if (log->tagDirty)
+      logFileWriteTags(log);
+    log->base->close(log->file);
+    log->baseOpen = false;
+  }
+  return true;
+}
+
+static bool LOG_FLUSH(void *file) {
+  logFileStream *stream = (logFileStream *)file;
+  logFile *log = stream->log;
+  if (log->tagDirty && !logFileWriteTags(log))
+    return false;
+  return log->base->flush(log->file);
+}
+
+/**
+ * @brief   Returns the file to store in embedDBState for a stream.
+ * @param   log     Log structure
+ * @param   stream  LOG_FILE_DATA, LOG_FILE_INDEX or LOG_FILE_VAR
+ */
+void *
+logFileGetStream(logFile *log,
+		 uint8_t  stream)
+{
+  return &log->streams[stream];
+}
+
+/**
+ * @brief   Returns a file interface that stores the streams of a log. Use it
+ *          as the fileInterface of the EmbedDB state.
+ */
+embedDBFileInterface *
+getLogFileInterface(void)
+{
+  embedDBFileInterface *fileInterface = (embedDBFileInterface *)malloc(sizeof(embedDBFileInterface));
+  if (fileInterface == NULL)
+    return NULL;
+  fileInterface->close = LOG_CLOSE;
+  fileInterface->read = LOG_READ;
+  fileInterface->write = LOG_WRITE;
+  fileInterface->erase = LOG_ERASE;
+  fileInterface->open = LOG_OPEN;
+  fileInterface->flush = LOG_FLUSH;
+  /* Pages never change in place, and each page is its own slot */
+  fileInterface->writeBytes = NULL;
+  fileInterface->writePages = NULL;
+  fileInterface->readPages = NULL;
+  return fileInterface;
+}
+
+/**
+ * @brief   Free memory allocated for the log. Does not close the file holding it.
+ * @param   log     Log structure
+ */
+void
+logFileClose(logFile *log)
+{
+  if (EDB_WITH_HEAP) {
+    free(log->slotUsed);
+    free(log->pageSlot);
+    free(log->tagPage);
+  }
+  log->slotUsed = NULL;
+  log->pageSlot = NULL;
+  log->tagPage = NULL;
+}
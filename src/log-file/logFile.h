@@ -0,0 +1,156 @@
+/******************************************************************************/
+/**
+ * @file        logFile.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Single circular log holding the data, index and variable data pages.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef LOG_FILE_H
+#define LOG_FILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../embedDB/embedDB.h"
+
+/* Streams stored in the log */
+#define LOG_FILE_DATA 0
+#define LOG_FILE_INDEX 1
+#define LOG_FILE_VAR 2
+#define LOG_FILE_NUM_STREAMS 3
+
+/* Slot numbers in the map are 16 bits unless the log needs more slots */
+#if defined(LOG_FILE_32BIT_SLOTS)
+typedef uint32_t logslot_t;
+#else
+typedef uint16_t logslot_t;
+#endif
+
+/* Bytes in a tag page for each slot recording which page it holds and when it was written */
+#define LOG_FILE_TAG_SIZE 8
+
+/* Bytes at the start of a tag page identifying it */
+#define LOG_FILE_TAG_HEADER_SIZE 8
+#define LOG_FILE_TAG_MAGIC 0x474F4C45
+
+/* Marks a free slot or a page that is not in the log */
+#define LOG_FILE_NO_SLOT ((logslot_t)-1)
+
+/* Tag entry of a free slot */
+#define LOG_FILE_NO_ENTRY UINT32_MAX
+
+typedef struct logFile_s logFile;
+
+typedef struct {
+  logFile *log;     /* Log holding the stream's pages */
+  uint8_t  stream;  /* LOG_FILE_DATA, LOG_FILE_INDEX or LOG_FILE_VAR */
+} logFileStream;
+
+/*
+ * Pages of all three streams are appended to one file in write order, and
+ * any stream may use any free slot. Slots are whole pages in groups, and
+ * the page after each group holds the tags of its slots: the page's
+ * position in the streams and a sequence number. The map from pages to
+ * slots is rebuilt from the tag pages when the file is opened again. A
+ * group's tag page is written when the next write moves past the group
+ * and on flush, and before a group is written again it is rewritten to
+ * mark the slots freed since, so a tag page never describes a slot written
+ * after it. Slots still in use are skipped when the write position wraps.
+ * Truncating one stream uses a slot as a marker, and pages of that stream
+ * written before the marker are ignored when the map is rebuilt.
+ */
+struct logFile_s {
+  embedDBFileInterface *base;                               /* Interface to the file holding the log */
+  void *                file;                               /* File holding the log */
+  uint32_t              pageSize;                           /* Size of an EmbedDB page */
+  uint32_t              numSlots;                           /* Number of page slots in the log */
+  uint32_t              slotsPerGroup;                      /* Slots sharing a tag page */
+  uint32_t              head;                               /* Slot the next page is written to if it is free */
+  uint32_t              sequence;                           /* Sequence number of the next page written */
+  uint8_t *             slotUsed;                           /* Bit for each slot holding a page or marker */
+  logslot_t *           pageSlot;                           /* Slot holding each page of every stream, or LOG_FILE_NO_SLOT */
+  uint32_t              numPages;                           /* Entries in pageSlot */
+  uint32_t              streamStart[LOG_FILE_NUM_STREAMS];  /* First entry of each stream in pageSlot */
+  uint32_t              streamPages[LOG_FILE_NUM_STREAMS];  /* Most pages each stream may have */
+  uint32_t              streamLength[LOG_FILE_NUM_STREAMS]; /* One more than the highest page written to each stream */
+  logslot_t             markerSlot[LOG_FILE_NUM_STREAMS];   /* Slot of each stream's truncation marker, or LOG_FILE_NO_SLOT */
+  logFileStream         streams[LOG_FILE_NUM_STREAMS];      /* Files to use as dataFile, indexFile and varFile */
+  void *                tagPage;                            /* Tag page of the group being written */
+  uint32_t              tagGroup;                           /* Group of tagPage, or UINT32_MAX if none is loaded */
+  bool                  tagDirty;                           /* Whether tagPage has tags not written to the file */
+  bool                  baseOpen;                           /* Whether the file holding the log is open */
+  uint8_t               openStreams;                        /* Bit for each stream EmbedDB has open */
+};
+
+/**
+ * @brief   Initialize a log with room for the given number of pages.
+ * @param   log             Log structure
+ * @param   base            Interface to the file holding the log
+ * @param   file            File holding the log, for example from setupFile
+ * @param   pageSize        Size of an EmbedDB page
+ * @param   numDataPages    Largest numDataPages the EmbedDB state will use
+ * @param   numIndexPages   Largest numIndexPages the EmbedDB state will use (0 if not used)
+ * @param   numVarPages     Largest numVarPages the EmbedDB state will use (0 if not used)
+ * @param   numSlots        Number of page slots in the file. Must be larger than
+ *                          the number of pages the streams hold at once, but
+ *                          may be less than the sum of the stream sizes.
+ * @return  Returns zero if successful and non-zero if memory could not be allocated
+ *          or numSlots does not fit in logslot_t
+ */
+int8_t logFileInit(logFile *log, embedDBFileInterface *base, void *file, uint32_t pageSize,
+                   uint32_t numDataPages, uint32_t numIndexPages, uint32_t numVarPages, uint32_t numSlots);
+
+/**
+ * @brief   Returns the file to store in embedDBState for a stream.
+ * @param   log     Log structure
+ * @param   stream  LOG_FILE_DATA, LOG_FILE_INDEX or LOG_FILE_VAR
+ */
+void *logFileGetStream(logFile *log, uint8_t stream);
+
+/**
+ * @brief   Returns a file interface that stores the streams of a log. Use it
+ *          as the fileInterface of the EmbedDB state.
+ */
+embedDBFileInterface *getLogFileInterface(void);
+
+/**
+ * @brief   Free memory allocated for the log. Does not close the file holding it.
+ * @param   log     Log structure
+ */
+void logFileClose(logFile *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,187 @@
+/******************************************************************************/
+/**
+ * @file        lzCodec.c
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Implementation of the LZ77 codec for variable data.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#include "lzCodec.h"
+
+#include <string.h>
+
+#define LZ_CODEC_NO_POSITION UINT16_MAX
+
+/**
+ * @brief   Hashes the next LZ_CODEC_MIN_MATCH bytes to a match table entry.
+ */
+static uint16_t
+lzHash(const uint8_t *in)
+{
+  uint32_t bytes = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+  return (uint16_t)(((bytes * 2654435761u) >> 16) % LZ_CODEC_HASH_SIZE);
+}
+
+/**
+ * @brief   Writes literal tokens for in[from, to).
+ * @return  false if they do not fit in the output
+ */
+static bool
+lzEmitLiterals(const uint8_t *in,
+	       uint16_t       from,
+	       uint16_t       to,
+	       uint8_t *      out,
+	       uint16_t *     outPos,
+	       uint16_t       outSize)
+{
+  while (from < to) {
+    uint16_t count = to - from;
+    if (count > LZ_CODEC_MAX_LITERALS) {
+      count = LZ_CODEC_MAX_LITERALS;
+    }
+    if ((uint32_t)*outPos + 1 + count > outSize) {
+      return false;
+    }
+    out[(*outPos)++] = (uint8_t)(count - 1);
+    memcpy(out + *outPos, in + from, count);
+    *outPos += count;
+    from += count;
+  }
+  return true;
+}
+
+/**
+ * @brief   Compresses a block of data.
+ * @param   in          Data to compress
+ * @param   inLength    Number of bytes to compress
+ * @param   out         Buffer for the compressed data
+ * @param   outSize     Size of out in bytes
+ * @return  Number of compressed bytes, or 0 if they do not fit in outSize bytes
+ */
+uint16_t
+lzCompress(const uint8_t *in,
+	   uint16_t       inLength,
+	   uint8_t *      out,
+	   uint16_t       outSize)
+{
+  uint16_t table[LZ_CODEC_HASH_SIZE];
+  for (uint16_t i = 0; i < LZ_CODEC_HASH_SIZE; i++) {
+    table[i] = LZ_CODEC_NO_POSITION;
+  }
+  
+  uint16_t pos = 0, literalStart = 0, outPos = 0;
+  while ((uint32_t)pos + LZ_CODEC_MIN_MATCH <= inLength) {
+    uint16_t hash = lzHash(in + pos);
+    uint16_t candidate = table[hash];
+    table[hash] = pos;
+    if (candidate == LZ_CODEC_NO_POSITION ||
+	memcmp(in + candidate, in + pos, LZ_CODEC_MIN_MATCH) != 0) {
+      pos++;
+      continue;
+    }
+    
+    uint16_t length = LZ_CODEC_MIN_MATCH;
+    while ((uint32_t)pos + length < inLength && length < LZ_CODEC_MAX_MATCH &&
+	   in[candidate + length] == in[pos + length]) {
+      length++;
+    }
+    if (!lzEmitLiterals(in, literalStart, pos, out, &outPos, outSize) ||
+	(uint32_t)outPos + 3 > outSize) {
+      return 0;
+    }
+    uint16_t distance = pos - candidate;
+    out[outPos++] = (uint8_t)(0x80 | (length - LZ_CODEC_MIN_MATCH));
+    out[outPos++] = (uint8_t)(distance & 0xFF);
+    out[outPos++] = (uint8_t)(distance >> 8);
+    pos += length;
+    literalStart = pos;
+  }
+  
+  if (!lzEmitLiterals(in, literalStart, inLength, out, &outPos, outSize)) {
+    return 0;
+  }
+  return outPos;
+}
+
+/**
+ * @brief   Decompresses a block of data compressed by lzCompress.
+ * @param   readByte    Function returning the next compressed byte
+ * @param   source      Input source passed to readByte
+ * @param   inLength    Number of compressed bytes
+ * @param   out         Buffer for the decompressed data
+ * @param   outSize     Size of out in bytes
+ * @return  Number of decompressed bytes, or 0 if the input could not be read
+ *          or is not valid
+ */
+uint16_t
+lzDecompress(lzReadByte readByte,
+	     void *     source,
+	     uint16_t   inLength,
+	     uint8_t *  out,
+	     uint16_t   outSize)
+{
+  uint16_t inPos = 0, outPos = 0;
+  uint8_t token, low, high;
+  while (inPos < inLength) {
+    if (!readByte(source, &token)) {
+      return 0;
+    }
+    inPos++;
+    
+    if (token < 0x80) {
+      uint16_t count = (uint16_t)token + 1;
+      if ((uint32_t)inPos + count > inLength || (uint32_t)outPos + count > outSize) {
+	return 0;
+      }
+      for (uint16_t i = 0; i < count; i++) {
+	if (!readByte(source, out + outPos++)) {
+	  return 0;
+	}
+      }
+      inPos += count;
+      continue;
+    }
+    
+    uint16_t length = (uint16_t)(token & 0x7F) + LZ_CODEC_MIN_MATCH;
+    if ((uint32_t)inPos + 2 > inLength || !readByte(source, &low) || !readByte(source, &high)) {
+      return 0;
+    }
+    inPos += 2;
+    uint16_t distance = (uint16_t)(low | (high << 8));
+    if (distance == 0 || distance > outPos || (uint32_t)outPos + length > outSize) {
+      return 0;
+    }
+    /* Byte by byte, since a match may overlap the bytes it produces */
+    for (uint16_t i = 0; i < length; i++, outPos++) {
+      out[outPos] = out[outPos - distance];
+    }
+  }
+  return outPos;
+}
@@ -0,0 +1,104 @@
+/******************************************************************************/
+/**
+ * @file        lzCodec.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Small LZ77 codec for compressing variable data.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of entries in the match hash table. The table is on the stack of
+   lzCompress and takes two bytes per entry. */
+#if !defined(LZ_CODEC_HASH_SIZE)
+#define LZ_CODEC_HASH_SIZE 256
+#endif
+
+/* Shortest and longest match a token can encode */
+#define LZ_CODEC_MIN_MATCH 3
+#define LZ_CODEC_MAX_MATCH (0x7F + LZ_CODEC_MIN_MATCH)
+
+/* Longest literal run a token can encode */
+#define LZ_CODEC_MAX_LITERALS 0x80
+
+/* Largest block lzCompress takes, so positions and lengths fit in 16 bits */
+#define LZ_CODEC_MAX_BLOCK 32768
+
+/**
+ * @brief   Returns the next byte of compressed input for lzDecompress.
+ * @param   source  Input source passed to lzDecompress
+ * @param   byte    Return variable for the byte
+ * @return  true on success, false if the byte could not be read
+ */
+typedef bool (*lzReadByte)(void *source, uint8_t *byte);
+
+/*
+ * Compressed data is a sequence of tokens. A token byte below 0x80 is
+ * followed by token + 1 literal bytes. A token byte of 0x80 or more copies
+ * (token & 0x7F) + LZ_CODEC_MIN_MATCH bytes from earlier output, at the
+ * distance given by the next two bytes, least significant byte first.
+ * Matches are only searched for within the input of one call, so blocks
+ * decompress independently.
+ */
+
+/**
+ * @brief   Compresses a block of data.
+ * @param   in          Data to compress
+ * @param   inLength    Number of bytes to compress, at most LZ_CODEC_MAX_BLOCK
+ * @param   out         Buffer for the compressed data
+ * @param   outSize     Size of out in bytes
+ * @return  Number of compressed bytes, or 0 if they do not fit in outSize bytes
+ */
+uint16_t lzCompress(const uint8_t *in, uint16_t inLength, uint8_t *out, uint16_t outSize);
+
+/**
+ * @brief   Decompresses a block of data compressed by lzCompress.
+ * @param   readByte    Function returning the next compressed byte
+ * @param   source      Input source passed to readByte
+ * @param   inLength    Number of compressed bytes
+ * @param   out         Buffer for the decompressed data
+ * @param   outSize     Size of out in bytes
+ * @return  Number of decompressed bytes, or 0 if the input could not be read
+ *          or is not valid
+ */
+uint16_t lzDecompress(lzReadByte readByte, void *source, uint16_t inLength, uint8_t *out, uint16_t outSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
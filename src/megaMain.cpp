@@ -55,6 +55,8 @@ static ArduinoOutStream cout(Serial);
 /**
  * 0 - 2 are for benchmarks
  * 3 is for the example program
+ * 4 is the record-level consistency group commit benchmark
+ * 5 is the page id width benchmark (build with and without EMBEDDB_64BIT_PAGE_IDS)
  *
  */
 #ifndef WHICH_PROGRAM
@@ -69,6 +71,10 @@ static ArduinoOutStream cout(Serial);
 #include "benchmarks/variableDataBenchmark.h"
 #elif WHICH_PROGRAM == 3
 #include "benchmarks/queryInterfaceBenchmark.h"
+#elif WHICH_PROGRAM == 4
+#include "benchmarks/recordLevelConsistencyBenchmark.h"
+#elif WHICH_PROGRAM == 5
+#include "benchmarks/pageIdBenchmark.h"
 #endif
 
 #define ENABLE_DEDICATED_SPI 1
@@ -109,6 +115,10 @@ void setup() {
     test_vardata();
 #elif WHICH_PROGRAM == 3
     advancedQueryExample();
+#elif WHICH_PROGRAM == 4
+    rlcGroupCommitBenchmark();
+#elif WHICH_PROGRAM == 5
+    pageIdBenchmark();
 #endif
 }
 
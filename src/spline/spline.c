@@ -56,7 +56,7 @@ splineInit(spline * spl,
 	   size_t   maxError,
 	   uint8_t  keySize)
 {
-  uint8_t pointSize = sizeof(uint32_t) + keySize;
+  uint8_t pointSize = sizeof(pgid_t) + keySize;
   if (spl && EDB_WITH_HEAP) {
     spl->count = 0;
     spl->pointsStartIndex = 0;
@@ -103,7 +103,7 @@ splineIsRight(uint64_t x1, int64_t y1,
 void
 splineAdd(spline * spl,
 	  void *   key,
-	  uint32_t page)
+	  pgid_t   page)
 {
   spl->numAddCalls++;
   /* Check if no spline points are currently empty */
@@ -111,10 +111,10 @@ splineAdd(spline * spl,
     /* Add first point in data set to spline. */
     void *firstPoint = splinePointLocation(spl, 0);
     memcpy(firstPoint, key, spl->keySize);
-    memcpy(((int8_t *)firstPoint + spl->keySize), &page, sizeof(uint32_t));
+    memcpy(((int8_t *)firstPoint + spl->keySize), &page, sizeof(pgid_t));
     /* Log first point for wrap around purposes */
     memcpy(spl->firstSplinePoint, key, spl->keySize);
-    memcpy(((int8_t *)spl->firstSplinePoint + spl->keySize), &page, sizeof(uint32_t));
+    memcpy(((int8_t *)spl->firstSplinePoint + spl->keySize), &page, sizeof(pgid_t));
     spl->count++;
     memcpy(spl->lastKey, key, spl->keySize);
     return;
@@ -125,11 +125,11 @@ splineAdd(spline * spl,
   if (spl->numAddCalls == 2) {
     /* Initialize upper and lower limits using second (unique) data point */
     memcpy(spl->lower, key, spl->keySize);
-    uint32_t lowerPage = page < spl->maxError ? 0 : page - spl->maxError;
-    memcpy(((int8_t *)spl->lower + spl->keySize), &lowerPage, sizeof(uint32_t));
+    pgid_t lowerPage = page < spl->maxError ? 0 : page - spl->maxError;
+    memcpy(((int8_t *)spl->lower + spl->keySize), &lowerPage, sizeof(pgid_t));
     memcpy(spl->upper, key, spl->keySize);
-    uint32_t upperPage = page + spl->maxError;
-    memcpy(((int8_t *)spl->upper + spl->keySize), &upperPage, sizeof(uint32_t));
+    pgid_t upperPage = page + spl->maxError;
+    memcpy(((int8_t *)spl->upper + spl->keySize), &upperPage, sizeof(pgid_t));
     memcpy(spl->lastKey, key, spl->keySize);
     spl->lastLoc = page;
   }
@@ -148,25 +148,25 @@ splineAdd(spline * spl,
     spl->count--;
   }
   
-  uint32_t lastPage = 0;
+  pgid_t lastPage = 0;
   uint64_t lastPointKey = 0, upperKey = 0, lowerKey = 0;
   void *lastPointLocation = splinePointLocation(spl, spl->count - 1);
   memcpy(&lastPointKey, lastPointLocation, spl->keySize);
   memcpy(&upperKey, spl->upper, spl->keySize);
   memcpy(&lowerKey, spl->lower, spl->keySize);
-  memcpy(&lastPage, (int8_t *)lastPointLocation + spl->keySize, sizeof(uint32_t));
+  memcpy(&lastPage, (int8_t *)lastPointLocation + spl->keySize, sizeof(pgid_t));
   
   uint64_t xdiff, upperXDiff, lowerXDiff = 0;
-  uint32_t ydiff, upperYDiff = 0;
+  pgid_t ydiff, upperYDiff = 0;
   int64_t lowerYDiff = 0; /* This may be negative */
   
   xdiff = keyVal - lastPointKey;
   ydiff = page - lastPage;
   upperXDiff = upperKey - lastPointKey;
-  memcpy(&upperYDiff, (int8_t *)spl->upper + spl->keySize, sizeof(uint32_t));
+  memcpy(&upperYDiff, (int8_t *)spl->upper + spl->keySize, sizeof(pgid_t));
   upperYDiff -= lastPage;
   lowerXDiff = lowerKey - lastPointKey;
-  memcpy(&lowerYDiff, (int8_t *)spl->lower + spl->keySize, sizeof(uint32_t));
+  memcpy(&lowerYDiff, (int8_t *)spl->lower + spl->keySize, sizeof(pgid_t));
   lowerYDiff -= lastPage;
   
   if (spl->count >= spl->size) {
@@ -179,17 +179,17 @@ splineAdd(spline * spl,
     /* Point is not in error corridor. Add previous point to spline. */
     void *nextSplinePoint = splinePointLocation(spl, spl->count);
     memcpy(nextSplinePoint, spl->lastKey, spl->keySize);
-    memcpy((int8_t *)nextSplinePoint + spl->keySize, &spl->lastLoc, sizeof(uint32_t));
+    memcpy((int8_t *)nextSplinePoint + spl->keySize, &spl->lastLoc, sizeof(pgid_t));
     spl->count++;
     spl->tempLastPoint = 0;
     
     /* Update upper and lower limits. */
     memcpy(spl->lower, key, spl->keySize);
-    uint32_t lowerPage = page < spl->maxError ? 0 : page - spl->maxError;
-    memcpy((int8_t *)spl->lower + spl->keySize, &lowerPage, sizeof(uint32_t));
+    pgid_t lowerPage = page < spl->maxError ? 0 : page - spl->maxError;
+    memcpy((int8_t *)spl->lower + spl->keySize, &lowerPage, sizeof(pgid_t));
     memcpy(spl->upper, key, spl->keySize);
-    uint32_t upperPage = page + spl->maxError;
-    memcpy((int8_t *)spl->upper + spl->keySize, &upperPage, sizeof(uint32_t));
+    pgid_t upperPage = page + spl->maxError;
+    memcpy((int8_t *)spl->upper + spl->keySize, &upperPage, sizeof(pgid_t));
     
     /* If we add a point, we might need to erase again */
     if (spl->count >= spl->size) {
@@ -203,16 +203,16 @@ splineAdd(spline * spl,
     /* Upper limit */
     if (splineIsLeft(upperXDiff, upperYDiff, xdiff, page + spl->maxError - lastPage) == 1) {
       memcpy(spl->upper, key, spl->keySize);
-      uint32_t upperPage = page + spl->maxError;
-      memcpy((int8_t *)spl->upper + spl->keySize, &upperPage, sizeof(uint32_t));
+      pgid_t upperPage = page + spl->maxError;
+      memcpy((int8_t *)spl->upper + spl->keySize, &upperPage, sizeof(pgid_t));
     }
     
     /* Lower limit */
     if (splineIsRight(lowerXDiff, lowerYDiff, xdiff,
 		      (page < spl->maxError ? 0 : page - spl->maxError) - lastPage) == 1) {
       memcpy(spl->lower, key, spl->keySize);
-      uint32_t lowerPage = page < spl->maxError ? 0 : page - spl->maxError;
-      memcpy((int8_t *)spl->lower + spl->keySize, &lowerPage, sizeof(uint32_t));
+      pgid_t lowerPage = page < spl->maxError ? 0 : page - spl->maxError;
+      memcpy((int8_t *)spl->lower + spl->keySize, &lowerPage, sizeof(pgid_t));
     }
   }
   
@@ -223,7 +223,7 @@ splineAdd(spline * spl,
   memcpy(spl->lastKey, key, spl->keySize);
   void *tempSplinePoint = splinePointLocation(spl, spl->count);
   memcpy(tempSplinePoint, spl->lastKey, spl->keySize);
-  memcpy((int8_t *)tempSplinePoint + spl->keySize, &spl->lastLoc, sizeof(uint32_t));
+  memcpy((int8_t *)tempSplinePoint + spl->keySize, &spl->lastLoc, sizeof(pgid_t));
   spl->count++;
   
   spl->tempLastPoint = 1;
@@ -291,12 +291,12 @@ splinePrint(spline *spl)
   EDB_PRINTF("Spline max error (%" PRIu32 "):\n", spl->maxError);
   EDB_PRINTF("Spline points (%zu):\n", spl->count);
   uint64_t keyVal = 0;
-  uint32_t page = 0;
+  pgid_t page = 0;
   for (uint32_t i = 0; i < spl->count; i++) {
     void *point = splinePointLocation(spl, i);
     memcpy(&keyVal, point, spl->keySize);
-    memcpy(&page, (int8_t *)point + spl->keySize, sizeof(uint32_t));
-    EDB_PRINTF("[%" PRIu32 "]: (%" PRIu64 ", %" PRIu32 ")\n", i, keyVal, page);
+    memcpy(&page, (int8_t *)point + spl->keySize, sizeof(pgid_t));
+    EDB_PRINTF("[%" PRIu32 "]: (%" PRIu64 ", %" EDB_PRIpgid ")\n", i, keyVal, page);
   }
   EDB_PRINTF("\n");
 }
@@ -309,7 +309,7 @@ splinePrint(spline *spl)
 uint32_t
 splineSize(spline * spl)
 {
-  return sizeof(spline) + (spl->size * (spl->keySize + sizeof(uint32_t)));
+  return sizeof(spline) + (spl->size * (spl->keySize + sizeof(pgid_t)));
 }
 
 /**
@@ -384,19 +384,19 @@ splineFind(spline * spl,
   
   if (compareKey(key, splinePointLocation(spl, 0)) < 0 || spl->count <= 1) {
     // Key is smaller than any we have on record
-    uint32_t lowEstimate, highEstimate, locEstimate = 0;
-    memcpy(&lowEstimate, (int8_t *)spl->firstSplinePoint + spl->keySize, sizeof(uint32_t));
-    memcpy(&highEstimate, (int8_t *)smallestSplinePoint + spl->keySize, sizeof(uint32_t));
-    locEstimate = (lowEstimate + highEstimate) / 2;
+    pgid_t lowEstimate, highEstimate, locEstimate = 0;
+    memcpy(&lowEstimate, (int8_t *)spl->firstSplinePoint + spl->keySize, sizeof(pgid_t));
+    memcpy(&highEstimate, (int8_t *)smallestSplinePoint + spl->keySize, sizeof(pgid_t));
+    locEstimate = lowEstimate + (highEstimate - lowEstimate) / 2;
     
-    memcpy(loc, &locEstimate, sizeof(uint32_t));
-    memcpy(low, &lowEstimate, sizeof(uint32_t));
-    memcpy(high, &highEstimate, sizeof(uint32_t));
+    memcpy(loc, &locEstimate, sizeof(pgid_t));
+    memcpy(low, &lowEstimate, sizeof(pgid_t));
+    memcpy(high, &highEstimate, sizeof(pgid_t));
     return;
   } else if (compareKey(key, splinePointLocation(spl, spl->count - 1)) > 0) {
-    memcpy(loc, (int8_t *)largestSplinePoint + spl->keySize, sizeof(uint32_t));
-    memcpy(low, (int8_t *)largestSplinePoint + spl->keySize, sizeof(uint32_t));
-    memcpy(high, (int8_t *)largestSplinePoint + spl->keySize, sizeof(uint32_t));
+    memcpy(loc, (int8_t *)largestSplinePoint + spl->keySize, sizeof(pgid_t));
+    memcpy(low, (int8_t *)largestSplinePoint + spl->keySize, sizeof(pgid_t));
+    memcpy(high, (int8_t *)largestSplinePoint + spl->keySize, sizeof(pgid_t));
     return;
   } else {
     // Perform a binary seach to find the spline point above the key
@@ -406,11 +406,11 @@ splineFind(spline * spl,
   
   // Interpolate between two spline points
   void *downKey = splinePointLocation(spl, pointIdx - 1);
-  uint32_t downPage = 0;
-  memcpy(&downPage, (int8_t *)downKey + spl->keySize, sizeof(uint32_t));
+  pgid_t downPage = 0;
+  memcpy(&downPage, (int8_t *)downKey + spl->keySize, sizeof(pgid_t));
   void *upKey = splinePointLocation(spl, pointIdx);
-  uint32_t upPage = 0;
-  memcpy(&upPage, (int8_t *)upKey + spl->keySize, sizeof(uint32_t));
+  pgid_t upPage = 0;
+  memcpy(&upPage, (int8_t *)upKey + spl->keySize, sizeof(pgid_t));
   uint64_t downKeyVal = 0, upKeyVal = 0;
   memcpy(&downKeyVal, downKey, spl->keySize);
   memcpy(&upKeyVal, upKey, spl->keySize);
@@ -426,8 +426,8 @@ splineFind(spline * spl,
   pgid_t lowEstiamte = (spl->maxError > locationEstimate) ? 0 : locationEstimate - spl->maxError;
   memcpy(low, &lowEstiamte, sizeof(pgid_t));
   void *lastSplinePoint = splinePointLocation(spl, spl->count - 1);
-  uint32_t lastSplinePointPage = 0;
-  memcpy(&lastSplinePointPage, (int8_t *)lastSplinePoint + spl->keySize, sizeof(uint32_t));
+  pgid_t lastSplinePointPage = 0;
+  memcpy(&lastSplinePointPage, (int8_t *)lastSplinePoint + spl->keySize, sizeof(pgid_t));
   pgid_t highEstimate = (locationEstimate + spl->maxError > lastSplinePointPage) ?
     lastSplinePointPage : locationEstimate + spl->maxError;
   memcpy(high, &highEstimate, sizeof(pgid_t));
@@ -461,5 +461,5 @@ splinePointLocation(spline * spl,
 		    size_t   pointIndex)
 {
   return (int8_t *)spl->points + (((pointIndex + spl->pointsStartIndex) % spl->size) *
-				  (spl->keySize + sizeof(uint32_t)));
+				  (spl->keySize + sizeof(pgid_t)));
 }
@@ -40,10 +40,20 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <inttypes.h>
 #include <stdint.h>
 
-/* Define type for page ids (physical and logical). */
+/* Define type for page ids (physical and logical). Logical ids only ever
+   grow, so long-lived deployments can widen them to 64 bits at build time. */
+#if defined(EMBEDDB_64BIT_PAGE_IDS)
+typedef uint64_t pgid_t;
+#define EDB_PGID_MAX UINT64_MAX
+#define EDB_PRIpgid PRIu64
+#else
 typedef uint32_t pgid_t;
+#define EDB_PGID_MAX UINT32_MAX
+#define EDB_PRIpgid PRIu32
+#endif
 
 typedef struct spline_s spline;
 
@@ -55,7 +65,7 @@ struct spline_s {
   void *   upper;             /* Upper spline limit */
   void *   lower;             /* Lower spline limit */
   void *   firstSplinePoint;  /* First Point that was added to the spline */
-  uint32_t lastLoc;           /* Location of previous spline key */
+  pgid_t   lastLoc;           /* Location of previous spline key */
   void *   lastKey;           /* Previous spline key */
   uint32_t eraseSize;         /* Size of points to erase if none can be cleaned */
   uint32_t maxError;          /* Maximum error */
@@ -90,7 +100,7 @@ void splineBuild(spline * spl, void ** data, pgid_t size, size_t maxError);
  * @param   key     Data key to be added (must be incrementing)
  * @param   page    Page number for spline point to add
  */
-void splineAdd(spline * spl, void * key, uint32_t page);
+void splineAdd(spline * spl, void * key, pgid_t page);
 
 /**
  * @brief	Print a spline structure.
@@ -0,0 +1,334 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_bulk_load.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test loading sorted record streams into EmbedDB.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+typedef struct {
+    uint32_t next;
+    uint32_t end;
+    uint32_t failAt;
+} sequenceReader;
+
+/* Keys are multiples of 3 so that lookups between them can be checked */
+int8_t readSequence(void *context, void *key, void *data) {
+    sequenceReader *reader = (sequenceReader *)context;
+    if (reader->next >= reader->end) {
+        return 0;
+    }
+    if (reader->next == reader->failAt) {
+        return -1;
+    }
+    uint32_t k = reader->next * 3, d = reader->next % 100;
+    memcpy(key, &k, sizeof(uint32_t));
+    memcpy(data, &d, sizeof(uint32_t));
+    reader->next++;
+    return 1;
+}
+
+void setupEmbedDB(uint32_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->buffer = malloc(state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 1000;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->bitmapSize = 1;
+    state->numSplinePoints = 64;
+    state->parameters = parameters;
+
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = NULL;
+    if (EMBEDDB_USING_INDEX(parameters)) {
+        char indexPath[] = "build/artifacts/indexFile.bin";
+        state->indexFile = setupFile(indexPath);
+    }
+
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp(void) {
+    setupEmbedDB(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_MAX_MIN | EMBEDDB_RESET_DATA);
+}
+
+void tearDown(void) {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+void checkRecords(uint32_t numRecords) {
+    uint32_t data = 0;
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = i * 3;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a loaded key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i % 100, data, "embedDBGet returned the wrong data for a loaded key.");
+        key++;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was never loaded.");
+    }
+}
+
+void embedDBBulkLoad_should_load_records_without_reads() {
+    sequenceReader reader = {0, 20000, UINT32_MAX};
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBBulkLoad(state, readSequence, &reader), "embedDBBulkLoad did not load the stream.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numReads, "embedDBBulkLoad read from storage.");
+
+    uint32_t expectedPages = 20000 / state->maxRecordsPerPage;
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedPages, state->nextDataPageId, "embedDBBulkLoad wrote the wrong number of pages.");
+    checkRecords(20000);
+}
+
+void embedDBBulkLoad_should_build_page_headers_and_bitmap_index() {
+    sequenceReader reader = {0, 5000, UINT32_MAX};
+    TEST_ASSERT_EQUAL_INT8(0, embedDBBulkLoad(state, readSequence, &reader));
+    embedDBFlush(state);
+
+    /* Data filter uses the bitmap index and the page min/max */
+    uint32_t minData = 10, maxData = 12, key = 0, data = 0, count = 0;
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBInitIterator(state, &it);
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_TRUE_MESSAGE(data >= 10 && data <= 12, "Iterator returned a record outside the data range.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key / 3 % 100, data, "Iterator returned the wrong data for a key.");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(150, count, "Iterator did not return every record in the data range.");
+
+    /* Min and max of the first page */
+    void *readBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    TEST_ASSERT_EQUAL_INT8(0, readPage(state, 0));
+    uint32_t value = 0;
+    memcpy(&value, EMBEDDB_GET_MAX_KEY(readBuf, state), sizeof(uint32_t));
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE((state->maxRecordsPerPage - 1) * 3, value, "Page max key was not set.");
+    memcpy(&value, EMBEDDB_GET_MAX_DATA(readBuf, state), sizeof(uint32_t));
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(min(state->maxRecordsPerPage - 1, 99), value, "Page max data was not set.");
+}
+
+void embedDBBulkLoad_should_continue_after_puts() {
+    for (uint32_t i = 0; i < 10; i++) {
+        uint32_t key = i * 3, data = i % 100;
+        TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &key, &data));
+    }
+    sequenceReader reader = {10, 1000, UINT32_MAX};
+    TEST_ASSERT_EQUAL_INT8(0, embedDBBulkLoad(state, readSequence, &reader));
+
+    /* Puts after a bulk load are checked against the loaded keys */
+    uint32_t key = 2997, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &key, &data), "embedDBPut accepted a key that was already loaded.");
+    key = 3000;
+    TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &key, &data));
+    checkRecords(1001);
+}
+
+void embedDBBulkLoad_should_stop_on_out_of_order_key() {
+    sequenceReader reader = {0, 2000, UINT32_MAX};
+    TEST_ASSERT_EQUAL_INT8(0, embedDBBulkLoad(state, readSequence, &reader));
+
+    reader.next = 1000;
+    reader.end = 3000;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBBulkLoad(state, readSequence, &reader), "embedDBBulkLoad accepted a key out of order.");
+    checkRecords(2000);
+
+    uint32_t key = 1000 * 3 + 1, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBBulkLoad kept a key out of order.");
+}
+
+void embedDBBulkLoad_should_keep_records_before_reader_error() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_USE_FENCE_INDEX | EMBEDDB_RESET_DATA);
+    sequenceReader reader = {0, 5000, 4000};
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBBulkLoad(state, readSequence, &reader), "embedDBBulkLoad did not report the reader error.");
+    checkRecords(4000);
+}
+
+uint32_t numPageWrites = 0, numBatchWrites = 0, numBatchPages = 0;
+bool (*fileWrite)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+bool (*fileWritePages)(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file);
+
+bool countingWrite(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    /* Index pages are still written one at a time */
+    if (file == state->dataFile)
+        numPageWrites++;
+    return fileWrite(buffer, pageNum, pageSize, file);
+}
+
+bool countingWritePages(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, pageNum % state->eraseSizeInPages, "A batch did not start on an erase block.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(state->eraseSizeInPages, numPages, "A batch was larger than an erase block.");
+    numBatchWrites++;
+    numBatchPages += numPages;
+    return fileWritePages(buffer, pageNum, numPages, pageSize, file);
+}
+
+void embedDBBulkLoad_should_write_erase_blocks_with_writePages() {
+    fileWrite = state->fileInterface->write;
+    fileWritePages = state->fileInterface->writePages;
+    state->fileInterface->write = countingWrite;
+    state->fileInterface->writePages = countingWritePages;
+    numPageWrites = numBatchWrites = numBatchPages = 0;
+
+    /* Wraps the data file, so blocks are erased while pages are batched */
+    sequenceReader reader = {0, 100000, UINT32_MAX};
+    TEST_ASSERT_EQUAL_INT8(0, embedDBBulkLoad(state, readSequence, &reader));
+    TEST_ASSERT_TRUE_MESSAGE(state->minDataPageId > 0, "The load should have wrapped the data file.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, numPageWrites, "embedDBBulkLoad wrote single data pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(state->nextDataPageId, numBatchPages, "embedDBBulkLoad did not write every page in a batch.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE((state->nextDataPageId + state->eraseSizeInPages - 1) / state->eraseSizeInPages, numBatchWrites, "embedDBBulkLoad did not write whole erase blocks.");
+
+    uint32_t data = 0;
+    for (uint32_t i = 100000 - 20000; i < 100000; i++) {
+        uint32_t key = i * 3;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a loaded key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i % 100, data, "embedDBGet returned the wrong data for a loaded key.");
+    }
+    state->fileInterface->write = fileWrite;
+    state->fileInterface->writePages = fileWritePages;
+}
+
+void embedDBBulkLoad_should_write_pages_singly_without_writePages() {
+    state->fileInterface->writePages = NULL;
+    sequenceReader reader = {0, 5000, UINT32_MAX};
+    TEST_ASSERT_EQUAL_INT8(0, embedDBBulkLoad(state, readSequence, &reader));
+    checkRecords(5000);
+}
+
+void embedDBBulkLoad_should_count_the_flushed_tail_page_once() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RESUME_TAIL_PAGE | EMBEDDB_RESET_DATA);
+    for (uint32_t i = 0; i < 10; i++) {
+        uint32_t key = i * 3, data = i % 100;
+        TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &key, &data));
+    }
+    TEST_ASSERT_EQUAL_INT8(0, embedDBFlush(state));
+
+    /* The first loaded page goes in the tail page's slot, then the load wraps the data file */
+    sequenceReader reader = {10, 100000, UINT32_MAX};
+    TEST_ASSERT_EQUAL_INT8(0, embedDBBulkLoad(state, readSequence, &reader));
+    TEST_ASSERT_TRUE_MESSAGE(state->minDataPageId > 0, "The load should have wrapped the data file.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(state->numDataPages + state->minDataPageId - state->nextDataPageId, state->numAvailDataPages, "embedDBBulkLoad counted the tail page slot twice.");
+
+    uint32_t data = 0;
+    for (uint32_t i = 100000 - 20000; i < 100000; i++) {
+        uint32_t key = i * 3;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a loaded key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i % 100, data, "embedDBGet returned the wrong data for a loaded key.");
+    }
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBBulkLoad_should_load_records_without_reads);
+    RUN_TEST(embedDBBulkLoad_should_build_page_headers_and_bitmap_index);
+    RUN_TEST(embedDBBulkLoad_should_continue_after_puts);
+    RUN_TEST(embedDBBulkLoad_should_stop_on_out_of_order_key);
+    RUN_TEST(embedDBBulkLoad_should_keep_records_before_reader_error);
+    RUN_TEST(embedDBBulkLoad_should_write_erase_blocks_with_writePages);
+    RUN_TEST(embedDBBulkLoad_should_write_pages_singly_without_writePages);
+    RUN_TEST(embedDBBulkLoad_should_count_the_flushed_tail_page_once);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,241 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_floor_ceiling.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB floor, ceiling and nearest key lookups.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+#define NUM_RECORDS 3000
+
+uint64_t keys[NUM_RECORDS];
+
+void setupEmbedDB(uint32_t parameters, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 8;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->buffer = malloc(state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 8;
+    state->eraseSizeInPages = 4;
+    state->bitmapSize = 1;
+    state->numSplinePoints = 64;
+    state->parameters = parameters;
+
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_PATH;
+    state->dataFile = setupFile(dataPath);
+
+    state->compareKey = int64Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp(void) {
+    setupEmbedDB(EMBEDDB_RESET_DATA, 1000);
+}
+
+void tearDown(void) {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void insertRecords() {
+    for (uint32_t i = 0; i < NUM_RECORDS; i++) {
+        /* Irregular timestamps with an occasional long gap */
+        keys[i] = 100000 + (uint64_t)i * 100 + (i * 2654435761u) % 60 + (i / 700) * 50000;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &keys[i], &i), "embedDBPut did not correctly insert data.");
+    }
+}
+
+/* Checks floor, ceiling and nearest for keys around every record, starting at record first */
+void checkLookups(uint32_t first) {
+    uint64_t foundKey = 0;
+    uint32_t data = 0;
+    for (uint32_t i = first; i < NUM_RECORDS; i++) {
+        uint64_t below = keys[i] - 1, above = keys[i] + 1;
+
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetFloor(state, &keys[i], &foundKey, &data), "embedDBGetFloor did not find an exact key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGetFloor returned the wrong record for an exact key.");
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetCeiling(state, &keys[i], &foundKey, &data), "embedDBGetCeiling did not find an exact key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGetCeiling returned the wrong record for an exact key.");
+
+        TEST_ASSERT_EQUAL_INT8(0, embedDBGetFloor(state, &above, &foundKey, &data));
+        TEST_ASSERT_EQUAL_UINT64(keys[i], foundKey);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGetFloor returned the wrong record.");
+
+        TEST_ASSERT_EQUAL_INT8(0, embedDBGetCeiling(state, &below, &foundKey, &data));
+        TEST_ASSERT_EQUAL_UINT64(keys[i], foundKey);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGetCeiling returned the wrong record.");
+
+        TEST_ASSERT_EQUAL_INT8(0, embedDBGetNearest(state, &above, &foundKey, &data));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGetNearest returned the wrong record above a key.");
+        TEST_ASSERT_EQUAL_INT8(0, embedDBGetNearest(state, &below, &foundKey, &data));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGetNearest returned the wrong record below a key.");
+
+        if (i + 1 < NUM_RECORDS) {
+            /* Nearest picks the closer side, and the smaller key on a tie */
+            uint64_t gap = keys[i + 1] - keys[i];
+            uint64_t nearNext = keys[i] + gap / 2 + 1;
+            uint64_t middle = keys[i] + gap / 2;
+            TEST_ASSERT_EQUAL_INT8(0, embedDBGetNearest(state, &nearNext, &foundKey, &data));
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(i + 1, data, "embedDBGetNearest did not pick the closer key.");
+            TEST_ASSERT_EQUAL_INT8(0, embedDBGetNearest(state, &middle, &foundKey, &data));
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGetNearest did not pick the smaller key.");
+        }
+    }
+
+    uint64_t before = keys[first] - 1, after = keys[NUM_RECORDS - 1] + 1;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGetFloor(state, &before, &foundKey, &data), "embedDBGetFloor found a key below every record.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGetCeiling(state, &after, &foundKey, &data), "embedDBGetCeiling found a key above every record.");
+}
+
+void embedDBGetFloor_should_find_neighbours_using_spline() {
+    insertRecords();
+    checkLookups(0);
+}
+
+void embedDBGetFloor_should_find_neighbours_using_binary_search() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_RESET_DATA, 1000);
+    insertRecords();
+    checkLookups(0);
+}
+
+void embedDBGetFloor_should_find_neighbours_using_interpolation_search() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_USE_INTERPOLATION_SEARCH | EMBEDDB_RESET_DATA, 1000);
+    insertRecords();
+    checkLookups(0);
+}
+
+void embedDBGetFloor_should_find_neighbours_using_fence_index() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_USE_FENCE_INDEX | EMBEDDB_RESET_DATA, 1000);
+    insertRecords();
+    checkLookups(0);
+
+    /* Each lookup reads at most the page found and the page after it */
+    uint64_t foundKey = 0;
+    uint32_t data = 0;
+    for (uint32_t i = 0; i < NUM_RECORDS; i += 37) {
+        uint64_t key = keys[i] + 1;
+        embedDBResetStats(state);
+        embedDBGetNearest(state, &key, &foundKey, &data);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(2, state->numReads, "embedDBGetNearest read more than two pages.");
+    }
+}
+
+void embedDBGetFloor_should_skip_erased_pages() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RESET_DATA, 32);
+    insertRecords();
+
+    /* Find the oldest record still stored */
+    uint64_t foundKey = 0;
+    uint32_t data = 0, first = 0;
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGetCeiling(state, &keys[0], &foundKey, &data));
+    first = data;
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, first, "Test did not wrap the data file.");
+    checkLookups(first);
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBGetFloor_should_find_neighbours_using_spline);
+    RUN_TEST(embedDBGetFloor_should_find_neighbours_using_binary_search);
+    RUN_TEST(embedDBGetFloor_should_find_neighbours_using_interpolation_search);
+    RUN_TEST(embedDBGetFloor_should_find_neighbours_using_fence_index);
+    RUN_TEST(embedDBGetFloor_should_skip_erased_pages);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,282 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_get_many.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB multi-key lookups.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setUp(void) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->numSplinePoints = 16;
+    state->bitmapSize = 1;
+    state->bufferSizeInBlocks = 6;
+    state->buffer = calloc(1, state->pageSize * state->bufferSizeInBlocks);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate EmbedDB buffer.");
+    state->numDataPages = 64;
+    state->numIndexPages = 8;
+    state->numVarPages = 64;
+    state->eraseSizeInPages = 4;
+
+    char dataPath[] = DATA_FILE_PATH, indexPath[] = INDEX_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+    state->varFile = setupFile(varPath);
+
+    state->parameters = EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDown(void) {
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+    state = NULL;
+}
+
+void insertRecords(uint32_t numRecords) {
+    char varData[] = "Record 0000";
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = i * 2;
+        uint32_t data = i + 1000;
+        snprintf(varData, sizeof(varData), "Record %04u", (unsigned int)(i % 10000));
+        int8_t result = embedDBPutVar(state, &key, &data, varData, sizeof(varData));
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPutVar did not correctly insert data.");
+    }
+}
+
+void embedDBGetMany_should_return_sorted_keys_from_storage_and_write_buffer() {
+    insertRecords(1000);
+
+    /* Every fifth key, plus odd keys that were never inserted */
+    uint32_t keys[400], data[400];
+    int8_t status[400];
+    for (uint32_t i = 0; i < 400; i++) {
+        keys[i] = i * 5;
+    }
+    uint32_t numFound = embedDBGetMany(state, keys, 400, data, status);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(200, numFound, "embedDBGetMany did not find the expected number of keys.");
+    for (uint32_t i = 0; i < 400; i++) {
+        if (keys[i] % 2 == 0) {
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, status[i], "embedDBGetMany did not find an inserted key.");
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(keys[i] / 2 + 1000, data[i], "embedDBGetMany returned the wrong data.");
+        } else {
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, status[i], "embedDBGetMany found a key that was never inserted.");
+        }
+    }
+
+    /* The last keys are still in the write buffer */
+    uint32_t lastKeys[] = {1996, 1997, 1998, 2000};
+    int8_t lastStatus[4];
+    TEST_ASSERT_EQUAL_UINT32(2, embedDBGetMany(state, lastKeys, 4, data, lastStatus));
+    TEST_ASSERT_EQUAL_INT8(0, lastStatus[0]);
+    TEST_ASSERT_EQUAL_INT8(-1, lastStatus[1]);
+    TEST_ASSERT_EQUAL_INT8(0, lastStatus[2]);
+    TEST_ASSERT_EQUAL_INT8(-1, lastStatus[3]);
+    TEST_ASSERT_EQUAL_UINT32(1999, data[2]);
+}
+
+void embedDBGetMany_should_read_each_page_once() {
+    insertRecords(1000);
+    embedDBFlush(state);
+
+    uint32_t keys[500], data[500];
+    int8_t status[500];
+    for (uint32_t i = 0; i < 500; i++) {
+        keys[i] = i * 4;
+    }
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_UINT32(500, embedDBGetMany(state, keys, 500, data, status));
+
+    /* The keys span the whole data file, so reads should not exceed the number of pages plus the initial search */
+    uint32_t numPages = state->nextDataPageId - state->minDataPageId;
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(numPages + 4, state->numReads, "embedDBGetMany read data pages more than once.");
+}
+
+void embedDBGetMany_should_answer_unsorted_keys() {
+    insertRecords(1000);
+
+    uint32_t keys[] = {1500, 20, 1998, 3, 640, 0, 1998};
+    uint32_t data[7];
+    int8_t status[7];
+    TEST_ASSERT_EQUAL_UINT32(6, embedDBGetMany(state, keys, 7, data, status));
+    for (uint32_t i = 0; i < 7; i++) {
+        if (keys[i] % 2 == 0) {
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, status[i], "embedDBGetMany did not find an unsorted key.");
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(keys[i] / 2 + 1000, data[i], "embedDBGetMany returned the wrong data for an unsorted key.");
+        } else {
+            TEST_ASSERT_EQUAL_INT8(-1, status[i]);
+        }
+    }
+}
+
+void embedDBGetMany_should_answer_unsorted_keys_across_write_buffer_and_storage() {
+    insertRecords(1000);
+
+    /* 1998 and 1994 are still in the write buffer, 10 is on storage */
+    uint32_t keys[] = {1998, 10, 1994, 1995, 1996};
+    uint32_t data[5];
+    int8_t status[5];
+    TEST_ASSERT_EQUAL_UINT32(4, embedDBGetMany(state, keys, 5, data, status));
+    TEST_ASSERT_EQUAL_INT8(0, status[0]);
+    TEST_ASSERT_EQUAL_INT8(0, status[1]);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, status[2], "embedDBGetMany missed a smaller write buffer key after a storage key.");
+    TEST_ASSERT_EQUAL_INT8(-1, status[3]);
+    TEST_ASSERT_EQUAL_INT8(0, status[4]);
+    TEST_ASSERT_EQUAL_UINT32(1999, data[0]);
+    TEST_ASSERT_EQUAL_UINT32(1005, data[1]);
+    TEST_ASSERT_EQUAL_UINT32(1997, data[2]);
+    TEST_ASSERT_EQUAL_UINT32(1998, data[4]);
+}
+
+void embedDBGetManyVar_should_return_variable_data_streams() {
+    insertRecords(600);
+
+    uint32_t keys[60], data[60];
+    int8_t status[60];
+    embedDBVarDataStream *streams[60];
+    for (uint32_t i = 0; i < 60; i++) {
+        keys[i] = i * 20;
+    }
+    TEST_ASSERT_EQUAL_UINT32(60, embedDBGetManyVar(state, keys, 60, data, streams, status));
+
+    char expected[12], actual[12];
+    for (uint32_t i = 0; i < 60; i++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, status[i], "embedDBGetManyVar did not find an inserted key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(keys[i] / 2 + 1000, data[i], "embedDBGetManyVar returned the wrong data.");
+        TEST_ASSERT_NOT_NULL_MESSAGE(streams[i], "embedDBGetManyVar did not return a variable data stream.");
+        snprintf(expected, sizeof(expected), "Record %04u", (unsigned int)(keys[i] / 2 % 10000));
+        uint32_t bytesRead = embedDBVarDataStreamRead(state, streams[i], actual, sizeof(actual));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(actual), bytesRead, "Variable data stream returned the wrong length.");
+        TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(expected, actual, sizeof(actual), "Variable data stream returned the wrong data.");
+        free(streams[i]);
+    }
+}
+
+void embedDBGetManyVar_should_mark_missing_keys() {
+    insertRecords(100);
+
+    uint32_t keys[] = {1, 2, 198, 199};
+    uint32_t data[4];
+    int8_t status[4];
+    embedDBVarDataStream *streams[4];
+    TEST_ASSERT_EQUAL_UINT32(2, embedDBGetManyVar(state, keys, 4, data, streams, status));
+    TEST_ASSERT_EQUAL_INT8(-1, status[0]);
+    TEST_ASSERT_EQUAL_INT8(0, status[1]);
+    TEST_ASSERT_EQUAL_INT8(0, status[2]);
+    TEST_ASSERT_EQUAL_INT8(-1, status[3]);
+    TEST_ASSERT_NULL(streams[0]);
+    TEST_ASSERT_NULL(streams[3]);
+    free(streams[1]);
+    free(streams[2]);
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBGetMany_should_return_sorted_keys_from_storage_and_write_buffer);
+    RUN_TEST(embedDBGetMany_should_read_each_page_once);
+    RUN_TEST(embedDBGetMany_should_answer_unsorted_keys);
+    RUN_TEST(embedDBGetMany_should_answer_unsorted_keys_across_write_buffer_and_storage);
+    RUN_TEST(embedDBGetManyVar_should_return_variable_data_streams);
+    RUN_TEST(embedDBGetManyVar_should_mark_missing_keys);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
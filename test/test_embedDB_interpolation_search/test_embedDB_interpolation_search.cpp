@@ -0,0 +1,243 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_interpolation_search.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB interpolation search over data pages.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setupEmbedDB(uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 2;
+    state->buffer = malloc(state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->eraseSizeInPages = 4;
+    state->parameters = EMBEDDB_USE_INTERPOLATION_SEARCH | EMBEDDB_RESET_DATA;
+
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_PATH;
+    state->dataFile = setupFile(dataPath);
+
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp(void) {
+    setupEmbedDB(1000);
+}
+
+void tearDown(void) {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void insertRecords(uint32_t numRecords, uint32_t keyStep) {
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = i * keyStep;
+        int8_t result = embedDBPut(state, &key, &i);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data (returned non-zero code)");
+    }
+}
+
+void embedDBGet_should_find_all_records_with_few_reads_for_regular_keys() {
+    uint32_t numRecords = 20000;
+    insertRecords(numRecords, 10);
+    embedDBResetStats(state);
+
+    uint32_t data = 0;
+    char message[100];
+    for (uint32_t i = 0; i < numRecords; i += 97) {
+        uint32_t key = i * 10;
+        int8_t getResult = embedDBGet(state, &key, &data);
+        snprintf(message, 100, "embedDBGet was unable to find key %u.", key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, getResult, message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data.");
+    }
+
+    /* Regular keys should be found with about one read per query */
+    uint32_t numQueries = (numRecords + 96) / 97;
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(2 * numQueries, state->numReads, "Interpolation search used too many page reads for regular keys.");
+}
+
+void embedDBGet_should_find_records_with_irregular_keys() {
+    uint32_t key = 0, data = 0;
+    for (uint32_t i = 0; i < 10000; i++) {
+        key += (i % 50 == 0) ? 5000 : 1 + i % 7;
+        embedDBPut(state, &key, &i);
+    }
+
+    key = 0;
+    for (uint32_t i = 0; i < 10000; i++) {
+        key += (i % 50 == 0) ? 5000 : 1 + i % 7;
+        int8_t getResult = embedDBGet(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, getResult, "embedDBGet was unable to find a key with irregular spacing.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data.");
+    }
+
+    /* Keys in the gaps are not found */
+    key = 2;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was never inserted.");
+    key = 4999;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was never inserted.");
+}
+
+void embedDBGet_should_find_records_after_data_wraps() {
+    tearDown();
+    setupEmbedDB(64);
+    uint32_t numRecords = 10000;
+    insertRecords(numRecords, 3);
+    embedDBFlush(state);
+
+    uint32_t data = 0;
+    uint32_t minKey = (state->minDataPageId * state->maxRecordsPerPage) * 3;
+    for (uint32_t key = minKey; key < numRecords * 3; key += 3) {
+        int8_t getResult = embedDBGet(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, getResult, "embedDBGet was unable to find a key after the data wrapped.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key / 3, data, "embedDBGet returned the wrong data.");
+    }
+
+    uint32_t key = minKey - 3;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was overwritten.");
+}
+
+void embedDBIterator_should_start_on_page_with_min_key() {
+    insertRecords(20000, 10);
+
+    embedDBIterator it;
+    uint32_t minKey = 150005, maxKey = 150100;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(150010 / 10 / state->maxRecordsPerPage, it.nextDataPage, "embedDBInitIterator did not start on the page containing the min key.");
+
+    embedDBResetStats(state);
+    uint32_t key = 0, data = 0, expectedKey = 150010;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKey, key, "embedDBNext returned the wrong key.");
+        expectedKey += 10;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(150110, expectedKey, "embedDBNext did not return all keys in the range.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(2, state->numReads, "The iterator read more pages than the key range spans.");
+    embedDBCloseIterator(&it);
+}
+
+void embedDBIterator_should_start_in_write_buffer_when_min_key_is_not_on_storage() {
+    insertRecords(1000, 10);
+
+    embedDBIterator it;
+    uint32_t minKey = 9985;
+    it.minKey = &minKey;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(state->nextDataPageId, it.nextDataPage, "embedDBInitIterator did not start at the write buffer.");
+
+    uint32_t key = 0, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBNext(state, &it, &key, &data), "embedDBNext did not return a record from the write buffer.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(9990, key, "embedDBNext returned the wrong key.");
+    embedDBCloseIterator(&it);
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBGet_should_find_all_records_with_few_reads_for_regular_keys);
+    RUN_TEST(embedDBGet_should_find_records_with_irregular_keys);
+    RUN_TEST(embedDBGet_should_find_records_after_data_wraps);
+    RUN_TEST(embedDBIterator_should_start_on_page_with_min_key);
+    RUN_TEST(embedDBIterator_should_start_in_write_buffer_when_min_key_is_not_on_storage);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
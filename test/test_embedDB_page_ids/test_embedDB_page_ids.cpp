@@ -0,0 +1,276 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_page_ids.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test logical page ids that have grown past 32 bits.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+/* Number of data pages allocated. Logical ids start at a multiple of it so
+   they map to physical page 0. */
+#define NUM_DATA_PAGES 64
+
+/* With 64-bit page ids the test starts two storage wraps before the ids
+   pass UINT32_MAX. The 32-bit build passes INT32_MAX instead. */
+#if defined(EMBEDDB_64BIT_PAGE_IDS)
+#define START_PAGE_ID ((pgid_t)(UINT32_MAX / NUM_DATA_PAGES - 1) * NUM_DATA_PAGES)
+#else
+#define START_PAGE_ID ((pgid_t)(INT32_MAX / NUM_DATA_PAGES - 1) * NUM_DATA_PAGES)
+#endif
+
+/* Number of pages of records inserted */
+#define NUM_PAGES_INSERTED 150
+
+/* Variable data addresses the var test writes across. The 64-bit build
+   stores 8-byte addresses in records, so its var file can pass 4 GB. */
+#if defined(EMBEDDB_64BIT_PAGE_IDS)
+#define VAR_ADDRESS_BOUNDARY ((uint64_t)UINT32_MAX + 1)
+#else
+#define VAR_ADDRESS_BOUNDARY ((uint64_t)INT32_MAX + 1)
+#endif
+
+embedDBState *state;
+
+void initState(uint32_t parameters, uint32_t numVarPages) {
+    state = (embedDBState *)calloc(1, sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 8;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 8;
+    state->buffer = calloc(state->bufferSizeInBlocks, state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->numDataPages = NUM_DATA_PAGES;
+    if (numVarPages > 0) {
+        char varPath[] = VAR_DATA_FILE_PATH;
+        state->varFile = setupFile(varPath);
+        state->numVarPages = numVarPages;
+        state->bufferSizeInBlocks = 6;
+        state->buffer = realloc(state->buffer, state->bufferSizeInBlocks * state->pageSize);
+        TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    }
+    state->eraseSizeInPages = 4;
+    state->parameters = parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int64Comparator;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+}
+
+void closeState(void) {
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->varFile != NULL) {
+        tearDownFile(state->varFile);
+    }
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/* Starts an empty database at START_PAGE_ID and fills NUM_PAGES_INSERTED pages */
+uint32_t insertFromLargePageId(uint32_t parameters) {
+    initState(parameters | EMBEDDB_RESET_DATA, 0);
+    state->nextDataPageId = START_PAGE_ID;
+    state->minDataPageId = START_PAGE_ID;
+    uint32_t numRecords = state->maxRecordsPerPage * NUM_PAGES_INSERTED;
+    for (uint32_t key = 0; key < numRecords; key++) {
+        uint64_t data = key * 3;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert the record.");
+    }
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+    TEST_ASSERT_TRUE_MESSAGE(state->nextDataPageId == START_PAGE_ID + NUM_PAGES_INSERTED, "nextDataPageId did not count every page written.");
+    return numRecords;
+}
+
+/* Checks that every record still on storage is found by key and by the iterator */
+void checkRecords(uint32_t numRecords) {
+    uint32_t firstKey = (uint32_t)(state->minDataPageId - START_PAGE_ID) * state->maxRecordsPerPage;
+    char message[100];
+    for (uint32_t key = firstKey; key < numRecords; key++) {
+        uint64_t data = 0;
+        snprintf(message, 100, "embedDBGet did not find key %lu.", (unsigned long)key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(key * 3, data, "embedDBGet returned the wrong data.");
+    }
+    uint32_t key = firstKey - 1;
+    uint64_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a record that was overwritten.");
+
+    embedDBIterator it;
+    uint32_t minKey = numRecords - 100;
+    it.minKey = &minKey;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t expected = minKey;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected, key, "The iterator returned the wrong key.");
+        expected++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords, expected, "The iterator did not return every record.");
+}
+
+void embedDB_header_should_grow_with_page_id_size(void) {
+    initState(EMBEDDB_RESET_DATA, 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(pgid_t) + 2, state->headerSize, "The data page header did not hold the page id and count.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE((512 - sizeof(pgid_t) - 2) / 12, state->maxRecordsPerPage, "maxRecordsPerPage did not account for the page id size.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4 * sizeof(pgid_t), EMBEDDB_IDX_HEADER_SIZE, "The index page header did not hold its page ids.");
+    closeState();
+}
+
+void embedDBGet_should_find_records_with_large_page_ids_using_spline(void) {
+    checkRecords(insertFromLargePageId(0));
+    closeState();
+}
+
+void embedDBGet_should_find_records_with_large_page_ids_using_binary_search(void) {
+    checkRecords(insertFromLargePageId(EMBEDDB_USE_BINARY_SEARCH));
+    closeState();
+}
+
+void embedDBInit_should_recover_large_page_ids(void) {
+    uint32_t numRecords = insertFromLargePageId(0);
+    pgid_t nextDataPageId = state->nextDataPageId;
+    pgid_t minDataPageId = state->minDataPageId;
+    closeState();
+
+    initState(0, 0);
+    TEST_ASSERT_TRUE_MESSAGE(state->nextDataPageId == nextDataPageId, "embedDBInit did not recover nextDataPageId.");
+    TEST_ASSERT_TRUE_MESSAGE(state->minDataPageId == minDataPageId, "embedDBInit did not recover minDataPageId.");
+    checkRecords(numRecords);
+    closeState();
+}
+
+void embedDBGetVar_should_read_var_data_past_the_address_boundary(void) {
+    /* The var file is sparse on desktop, so only the pages written take space */
+    uint32_t numVarPages = (uint32_t)(VAR_ADDRESS_BOUNDARY / 512) + 64;
+    initState(EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA, numVarPages);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4 + 8 + sizeof(varaddr_t), state->recordSize, "Records did not hold a full variable data address.");
+
+    /* Start writing variable data a few pages before the boundary */
+    state->nextVarPageId = (pgid_t)(VAR_ADDRESS_BOUNDARY / 512) - 4;
+    state->numAvailVarPages = numVarPages - (uint32_t)state->nextVarPageId;
+    state->currentVarLoc = state->nextVarPageId * 512 + state->variableDataHeaderSize;
+
+    char varData[100];
+    char message[100];
+    for (uint32_t key = 0; key < 200; key++) {
+        uint64_t data = key;
+        memset(varData, 'a' + key % 26, sizeof(varData));
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, varData, sizeof(varData)), "embedDBPutVar did not insert the record.");
+    }
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+    TEST_ASSERT_TRUE_MESSAGE(state->currentVarLoc > VAR_ADDRESS_BOUNDARY + 4 * 512, "The variable data did not pass the boundary.");
+
+    char actual[100];
+    for (uint32_t key = 0; key < 200; key++) {
+        uint64_t data = 0;
+        embedDBVarDataStream stream;
+        snprintf(message, 100, "embedDBGetVarInto did not find key %lu.", (unsigned long)key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &stream), message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(actual), embedDBVarDataStreamRead(state, &stream, actual, sizeof(actual)), "Did not read all of the variable data.");
+        memset(varData, 'a' + key % 26, sizeof(varData));
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(varData, actual, sizeof(varData), "The variable data did not match.");
+    }
+    closeState();
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDB_header_should_grow_with_page_id_size);
+    RUN_TEST(embedDBGet_should_find_records_with_large_page_ids_using_spline);
+    RUN_TEST(embedDBGet_should_find_records_with_large_page_ids_using_binary_search);
+    RUN_TEST(embedDBInit_should_recover_large_page_ids);
+    RUN_TEST(embedDBGetVar_should_read_var_data_past_the_address_boundary);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,251 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_pre_erase.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB erasing the next block ahead of the insert that needs it.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+embedDBFileInterface *fileInterface;
+uint32_t numErases = 0;
+
+bool countingErase(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
+    numErases++;
+    return fileInterface->erase(startPage, endPage, pageSize, file);
+}
+
+void setupEmbedDB(uint32_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 6;
+    state->numSplinePoints = 16;
+    state->buffer = calloc(1, state->pageSize * state->bufferSizeInBlocks);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate EmbedDB buffer.");
+    state->numDataPages = 16;
+    state->numIndexPages = 8;
+    state->numVarPages = 8;
+    state->eraseSizeInPages = 4;
+    state->bitmapSize = 1;
+    state->parameters = parameters;
+
+    /* Count erases on a copy of the file interface */
+    fileInterface = getFileInterface();
+    state->fileInterface = (embedDBFileInterface *)malloc(sizeof(embedDBFileInterface));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->fileInterface, "Failed to allocate file interface.");
+    memcpy(state->fileInterface, fileInterface, sizeof(embedDBFileInterface));
+    state->fileInterface->erase = countingErase;
+
+    char dataPath[] = DATA_FILE_PATH, indexPath[] = INDEX_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+    state->varFile = setupFile(varPath);
+
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+    numErases = 0;
+}
+
+void setUp(void) {
+    setupEmbedDB(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_RESET_DATA);
+}
+
+void tearDown(void) {
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL)
+        tearDownFile(state->indexFile);
+    if (state->varFile != NULL)
+        tearDownFile(state->varFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(fileInterface);
+    free(state);
+}
+
+void insertRecords(uint32_t first, uint32_t count) {
+    for (uint32_t key = first; key < first + count; key++) {
+        uint32_t data = key % 100;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert the record.");
+    }
+}
+
+void embedDBPreErase_should_do_nothing_while_pages_are_free() {
+    insertRecords(1, state->maxRecordsPerPage * 5);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPreErase(state), "embedDBPreErase failed.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, numErases, "embedDBPreErase erased a block while free pages remained.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->minDataPageId, "embedDBPreErase dropped data pages.");
+}
+
+void embedDBPreErase_should_move_data_erase_off_insert_path() {
+    /* Fill every data page, leaving the last page in the write buffer */
+    uint32_t numRecords = state->maxRecordsPerPage * 17;
+    insertRecords(1, numRecords);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numAvailDataPages, "The data pages were not all used.");
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPreErase(state), "embedDBPreErase failed.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, numErases, "embedDBPreErase did not erase one data block.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->numAvailDataPages, "embedDBPreErase did not free the erased pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->minDataPageId, "embedDBPreErase did not move minDataPageId.");
+
+    /* The next block of pages is written without erasing */
+    insertRecords(numRecords + 1, state->maxRecordsPerPage * 4);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, numErases, "An insert erased a block that was already erased.");
+
+    uint32_t key = 1, data = 0;
+    TEST_ASSERT_NOT_EQUAL_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet found a record on an erased page.");
+    for (key = state->maxRecordsPerPage * 4 + 1; key <= numRecords + state->maxRecordsPerPage * 4; key++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a stored record.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGet returned the wrong data.");
+    }
+}
+
+void embedDBPreErase_should_erase_index_block() {
+    /* Leave no free index pages */
+    uint32_t key = 1;
+    while (state->numAvailIndexPages > 0) {
+        insertRecords(key, state->maxRecordsPerPage);
+        key += state->maxRecordsPerPage;
+    }
+    uint32_t minIndexPageId = state->minIndexPageId;
+    uint32_t expectedErases = state->numAvailDataPages <= 0 ? 2 : 1;
+    numErases = 0;
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPreErase(state), "embedDBPreErase failed.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedErases, numErases, "embedDBPreErase did not erase one index block.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->numAvailIndexPages, "embedDBPreErase did not free the erased index pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(minIndexPageId + 4, state->minIndexPageId, "embedDBPreErase did not move minIndexPageId.");
+}
+
+void embedDBPreErase_should_update_minVarRecordId() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA);
+
+    char varData[100];
+    uint32_t key = 0, data = 0;
+    while (state->numAvailVarPages > 0) {
+        key++;
+        data = key % 100;
+        memset(varData, (char)key, sizeof(varData));
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, varData, sizeof(varData)), "embedDBPutVar did not insert the record.");
+    }
+    uint32_t lastKey = key;
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPreErase(state), "embedDBPreErase failed.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, numErases, "embedDBPreErase did not erase one variable data block.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->numAvailVarPages, "embedDBPreErase did not free the erased variable data pages.");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(1, (uint32_t)state->minVarRecordId, "embedDBPreErase did not move minVarRecordId.");
+
+    embedDBVarDataStream *varStream = NULL;
+    key = 1;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBGetVar(state, &key, &data, &varStream), "embedDBGetVar returned erased variable data.");
+    if (varStream != NULL)
+        free(varStream);
+
+    key = lastKey;
+    varStream = NULL;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &data, &varStream), "embedDBGetVar did not find the newest variable data.");
+    TEST_ASSERT_NOT_NULL_MESSAGE(varStream, "embedDBGetVar did not return a stream.");
+    char buf[100];
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(buf), embedDBVarDataStreamRead(state, varStream, buf, sizeof(buf)), "The variable data was cut short.");
+    TEST_ASSERT_EACH_EQUAL_CHAR_MESSAGE((char)lastKey, buf, sizeof(buf), "The variable data was wrong.");
+    free(varStream);
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBPreErase_should_do_nothing_while_pages_are_free);
+    RUN_TEST(embedDBPreErase_should_move_data_erase_off_insert_path);
+    RUN_TEST(embedDBPreErase_should_erase_index_block);
+    RUN_TEST(embedDBPreErase_should_update_minVarRecordId);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
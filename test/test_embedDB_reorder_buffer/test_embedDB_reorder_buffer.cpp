@@ -0,0 +1,264 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_reorder_buffer.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB reorder buffer for slightly out of order keys.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+#define NUM_RECORDS 2000
+#define REORDER_WINDOW 16
+
+uint64_t keys[NUM_RECORDS];
+
+void setupEmbedDB(uint32_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 8;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->buffer = malloc(state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 1000;
+    state->numIndexPages = 8;
+    state->eraseSizeInPages = 4;
+    state->bitmapSize = 1;
+    state->numSplinePoints = 64;
+    state->reorderWindow = REORDER_WINDOW;
+    state->parameters = parameters;
+
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_PATH;
+    state->dataFile = setupFile(dataPath);
+
+    state->compareKey = int64Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp(void) {
+    setupEmbedDB(EMBEDDB_USE_REORDER_BUFFER | EMBEDDB_RESET_DATA);
+}
+
+void tearDown(void) {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+/* Inserts keys 10, 20, ... with each block of REORDER_WINDOW keys arriving shuffled */
+void insertShuffledRecords() {
+    for (uint32_t i = 0; i < NUM_RECORDS; i++) {
+        keys[i] = (uint64_t)(i + 1) * 10;
+    }
+    for (uint32_t block = 0; block < NUM_RECORDS; block += REORDER_WINDOW) {
+        for (uint32_t i = REORDER_WINDOW - 1; i > 0; i--) {
+            uint32_t j = (block * 31 + i * 2654435761u) % (i + 1);
+            uint64_t temp = keys[block + i];
+            keys[block + i] = keys[block + j];
+            keys[block + j] = temp;
+        }
+    }
+    for (uint32_t i = 0; i < NUM_RECORDS; i++) {
+        uint32_t data = (uint32_t)(keys[i] / 10);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &keys[i], &data), "embedDBPut did not accept a key inside the reorder window.");
+    }
+}
+
+void embedDBPut_should_accept_keys_within_window() {
+    insertShuffledRecords();
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(REORDER_WINDOW, state->reorderCount, "Reorder buffer was not full after the inserts.");
+
+    uint32_t data = 0;
+    for (uint64_t i = 1; i <= NUM_RECORDS; i++) {
+        uint64_t key = i * 10;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data.");
+        key += 5;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was never inserted.");
+    }
+}
+
+void embedDBPut_should_reject_keys_older_than_window() {
+    insertShuffledRecords();
+
+    /* Smallest key still held is the largest minus the window */
+    uint64_t late = (uint64_t)(NUM_RECORDS - REORDER_WINDOW) * 10 - 5;
+    uint64_t held = (uint64_t)(NUM_RECORDS - 2) * 10 + 5;
+    uint64_t duplicate = (uint64_t)(NUM_RECORDS - 1) * 10;
+    uint32_t data = 7;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &late, &data), "embedDBPut accepted a key behind the reorder window.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &duplicate, &data), "embedDBPut accepted a duplicate key in the reorder window.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &held, &data), "embedDBPut rejected a key inside the reorder window.");
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGet(state, &held, &data));
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(7, data, "embedDBGet returned the wrong data for a late key.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &late, &data), "Rejected key was stored.");
+}
+
+void embedDBIterator_should_return_held_records_in_order() {
+    insertShuffledRecords();
+    uint64_t key = 0;
+    uint32_t data = 0, expected = 1;
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected, data, "embedDBNext returned records out of order.");
+        expected++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(NUM_RECORDS + 1, expected, "embedDBNext did not return every record.");
+
+    embedDBInitIteratorReverse(state, &it);
+    while (embedDBPrev(state, &it, &key, &data)) {
+        expected--;
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected, data, "embedDBPrev returned records out of order.");
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, expected, "embedDBPrev did not return every record.");
+
+    /* A range ending before the held records */
+    uint64_t maxKey = (uint64_t)(NUM_RECORDS - REORDER_WINDOW - 3) * 10;
+    it.maxKey = &maxKey;
+    embedDBInitIteratorReverse(state, &it);
+    TEST_ASSERT_TRUE(embedDBPrev(state, &it, &key, &data));
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(maxKey, key, "embedDBPrev did not start at maxKey.");
+    embedDBCloseIterator(&it);
+}
+
+void embedDBGetFloor_should_search_held_records() {
+    insertShuffledRecords();
+    uint64_t foundKey = 0;
+    uint32_t data = 0;
+
+    uint64_t key = (uint64_t)NUM_RECORDS * 10 - 15;
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGetFloor(state, &key, &foundKey, &data));
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(NUM_RECORDS - 2, data, "embedDBGetFloor returned the wrong held record.");
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGetCeiling(state, &key, &foundKey, &data));
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(NUM_RECORDS - 1, data, "embedDBGetCeiling returned the wrong held record.");
+
+    /* Ceiling crosses from the write buffer into the held records */
+    key = (uint64_t)(NUM_RECORDS - REORDER_WINDOW) * 10 + 5;
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGetCeiling(state, &key, &foundKey, &data));
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(NUM_RECORDS - REORDER_WINDOW + 1, data, "embedDBGetCeiling did not continue into the held records.");
+
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGetLatest(state, &foundKey, &data));
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE((uint64_t)NUM_RECORDS * 10, foundKey, "embedDBGetLatest did not return the largest held key.");
+}
+
+void embedDBFlush_should_write_held_records() {
+    insertShuffledRecords();
+    TEST_ASSERT_EQUAL_INT8(0, embedDBFlush(state));
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->reorderCount, "embedDBFlush did not empty the reorder buffer.");
+
+    uint32_t data = 0;
+    for (uint64_t i = 1; i <= NUM_RECORDS; i++) {
+        uint64_t key = i * 10;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a flushed record.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data after flush.");
+    }
+
+    /* Keys before the flushed records are now too late */
+    uint64_t late = (uint64_t)NUM_RECORDS * 10 - 5;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &late, &data), "embedDBPut accepted a key older than a flushed record.");
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBPut_should_accept_keys_within_window);
+    RUN_TEST(embedDBPut_should_reject_keys_older_than_window);
+    RUN_TEST(embedDBIterator_should_return_held_records_in_order);
+    RUN_TEST(embedDBGetFloor_should_search_held_records);
+    RUN_TEST(embedDBFlush_should_write_held_records);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,266 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_reverse_iterator.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB newest-first iteration.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setUp(void) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->numSplinePoints = 16;
+    state->bitmapSize = 1;
+    state->bufferSizeInBlocks = 6;
+    state->buffer = calloc(1, state->pageSize * state->bufferSizeInBlocks);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate EmbedDB buffer.");
+    state->numDataPages = 64;
+    state->numIndexPages = 8;
+    state->numVarPages = 64;
+    state->eraseSizeInPages = 4;
+
+    char dataPath[] = DATA_FILE_PATH, indexPath[] = INDEX_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+    state->varFile = setupFile(varPath);
+
+    state->parameters = EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDown(void) {
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+    state = NULL;
+}
+
+void insertRecords(uint32_t numRecords) {
+    char varData[] = "Record 0000";
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = i * 2;
+        uint32_t data = i + 1000;
+        snprintf(varData, sizeof(varData), "Record %04u", (unsigned int)(i % 10000));
+        int8_t result = embedDBPutVar(state, &key, &data, varData, sizeof(varData));
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPutVar did not correctly insert data.");
+    }
+}
+
+void embedDBPrev_should_return_all_records_newest_first() {
+    insertRecords(1000);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIteratorReverse(state, &it);
+
+    uint32_t key = 0, data = 0, count = 0;
+    while (embedDBPrev(state, &it, &key, &data)) {
+        uint32_t expected = 999 - count;
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected * 2, key, "embedDBPrev returned the wrong key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected + 1000, data, "embedDBPrev returned the wrong data.");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1000, count, "embedDBPrev did not return every record.");
+}
+
+void embedDBPrev_should_seek_to_max_key() {
+    insertRecords(1000);
+    embedDBFlush(state);
+
+    uint32_t minKey = 401, maxKey = 800;
+    embedDBIterator it;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = NULL;
+    it.maxData = NULL;
+
+    embedDBResetStats(state);
+    embedDBInitIteratorReverse(state, &it);
+
+    uint32_t key = 0, data = 0, count = 0;
+    while (embedDBPrev(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(800 - count * 2, key, "embedDBPrev returned the wrong key in the key range.");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(200, count, "embedDBPrev did not return every record in the key range.");
+
+    /* The spline seek should skip the newer pages */
+    uint32_t numPages = state->nextDataPageId - state->minDataPageId;
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(numPages / 2, state->numReads, "embedDBPrev read pages outside the key range.");
+}
+
+void embedDBPrev_should_filter_on_data() {
+    insertRecords(1000);
+
+    uint32_t minData = 1100, maxData = 1150;
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBInitIteratorReverse(state, &it);
+
+    uint32_t key = 0, data = 0, count = 0;
+    while (embedDBPrev(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(1150 - count, data, "embedDBPrev returned the wrong data in the data range.");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(51, count, "embedDBPrev did not return every record in the data range.");
+}
+
+void embedDBPrevVar_should_return_variable_data() {
+    insertRecords(300);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIteratorReverse(state, &it);
+
+    uint32_t key = 0, data = 0, count = 0;
+    char expected[12], actual[12];
+    embedDBVarDataStream *stream = NULL;
+    while (embedDBPrevVar(state, &it, &key, &data, &stream)) {
+        TEST_ASSERT_NOT_NULL_MESSAGE(stream, "embedDBPrevVar did not return a variable data stream.");
+        snprintf(expected, sizeof(expected), "Record %04u", (unsigned int)(key / 2 % 10000));
+        uint32_t bytesRead = embedDBVarDataStreamRead(state, stream, actual, sizeof(actual));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(actual), bytesRead, "Variable data stream returned the wrong length.");
+        TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(expected, actual, sizeof(actual), "Variable data stream returned the wrong data.");
+        free(stream);
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(300, count, "embedDBPrevVar did not return every record.");
+}
+
+void embedDBGetLatest_should_read_write_buffer_without_io() {
+    uint32_t key = 0, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGetLatest(state, &key, &data), "embedDBGetLatest found a record in an empty database.");
+
+    insertRecords(1000);
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGetLatest(state, &key, &data));
+    TEST_ASSERT_EQUAL_UINT32(1998, key);
+    TEST_ASSERT_EQUAL_UINT32(1999, data);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numReads, "embedDBGetLatest read from storage when the record was buffered.");
+
+    embedDBFlush(state);
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGetLatest(state, &key, &data));
+    TEST_ASSERT_EQUAL_UINT32(1998, key);
+    TEST_ASSERT_EQUAL_UINT32(1999, data);
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBPrev_should_return_all_records_newest_first);
+    RUN_TEST(embedDBPrev_should_seek_to_max_key);
+    RUN_TEST(embedDBPrev_should_filter_on_data);
+    RUN_TEST(embedDBPrevVar_should_return_variable_data);
+    RUN_TEST(embedDBGetLatest_should_read_write_buffer_without_io);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
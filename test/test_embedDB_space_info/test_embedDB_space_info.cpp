@@ -0,0 +1,400 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_space_info.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test space accounting and rebalancing of the data and variable data regions.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void initState(uint32_t numDataPages, uint32_t numVarPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 6;
+    state->numSplinePoints = 8;
+    state->buffer = calloc(state->bufferSizeInBlocks, state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 48;
+    state->numVarPages = numVarPages;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_FILE_PATH, indexPath[] = INDEX_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+    state->varFile = setupFile(varPath);
+    state->parameters = EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA;
+    state->bitmapSize = 1;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+}
+
+void freeState() {
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {
+    initState(64, 16);
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDown(void) {
+    embedDBClose(state);
+    freeState();
+}
+
+void insertVarRecords(uint32_t from, uint32_t to, uint32_t length) {
+    char varData[200];
+    for (uint32_t key = from; key < to; key++) {
+        memset(varData, 'a' + key % 26, length);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, varData, length), "embedDBPutVar did not insert the record");
+    }
+}
+
+int8_t checkVarRecord(uint32_t key, uint32_t length) {
+    char expected[200], actual[200];
+    uint32_t data = 0;
+    embedDBVarDataStream stream;
+    if (embedDBGetVarInto(state, &key, &data, &stream) != 0 || data != key || stream.totalBytes != length)
+        return -1;
+    memset(expected, 'a' + key % 26, length);
+    if (embedDBVarDataStreamRead(state, &stream, actual, sizeof(actual)) != length)
+        return -1;
+    return memcmp(expected, actual, length) == 0 ? 0 : -1;
+}
+
+void embedDBGetSpaceInfo_should_report_empty_regions(void) {
+    embedDBRegionInfo data, var;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetSpaceInfo(state, &data, &var), "embedDBGetSpaceInfo failed");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, data.hasKeys, "An empty data region should not have keys");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(64, data.numPages, "Wrong number of data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(64, data.freePages, "Every data page should be free");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(65 * state->maxRecordsPerPage, data.recordsUntilOverwrite, "Wrong number of records until the data region is overwritten");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(data.recordsUntilOverwrite * state->recordSize, data.freeBytes, "Wrong number of free data bytes");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, var.hasKeys, "An empty variable data region should not have keys");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(16, var.numPages, "Wrong number of variable data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(UINT32_MAX, var.recordsUntilOverwrite, "Nothing to predict from without variable data");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(17 * (state->pageSize - state->variableDataHeaderSize) - 1, var.freeBytes, "Wrong number of free variable data bytes");
+}
+
+void embedDBGetSpaceInfo_should_report_stored_keys(void) {
+    insertVarRecords(0, 100, 50);
+    embedDBRegionInfo data, var;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetSpaceInfo(state, &data, &var), "embedDBGetSpaceInfo failed");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, data.hasKeys, "The data region should have keys");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(0, data.minKey, "Wrong smallest data key");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(99, data.maxKey, "Wrong largest data key");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(64 - state->nextDataPageId, data.freePages, "Wrong number of free data pages");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, var.hasKeys, "The variable data region should have keys");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(0, var.minKey, "Wrong smallest variable data key");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(99, var.maxKey, "Wrong largest variable data key");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(16 - state->nextVarPageId, var.freePages, "Wrong number of free variable data pages");
+
+    /* The same answers once the write buffers are on storage */
+    embedDBFlush(state);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetSpaceInfo(state, &data, NULL), "embedDBGetSpaceInfo failed after a flush");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(0, data.minKey, "Wrong smallest data key after a flush");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(99, data.maxKey, "Wrong largest data key after a flush");
+}
+
+void embedDBGetSpaceInfo_should_predict_data_overwrite(void) {
+    uint32_t key = 0;
+    for (; key < 1000; key++)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &key), "embedDBPut did not insert the record");
+    embedDBRegionInfo data;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetSpaceInfo(state, &data, NULL), "embedDBGetSpaceInfo failed");
+    uint32_t end = key + data.recordsUntilOverwrite;
+    for (; key < end; key++)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &key), "embedDBPut did not insert the record");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->minDataPageId, "The data region was overwritten before the predicted record");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetSpaceInfo(state, &data, NULL), "embedDBGetSpaceInfo failed");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, data.recordsUntilOverwrite, "No record should be left before the overwrite");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &key), "embedDBPut did not insert the record");
+    TEST_ASSERT_NOT_EQUAL_MESSAGE(0, state->minDataPageId, "The data region should have been overwritten");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetSpaceInfo(state, &data, NULL), "embedDBGetSpaceInfo failed");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(state->eraseSizeInPages * state->maxRecordsPerPage, data.minKey, "The smallest key should be the first one after the erased block");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(key, data.maxKey, "Wrong largest data key");
+}
+
+void embedDBGetSpaceInfo_should_predict_var_overwrite(void) {
+    tearDown();
+    initState(64, 64);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+    /* Long enough for variable data pages to be written early when data pages fill */
+    insertVarRecords(0, 100, 100);
+    embedDBRegionInfo data, var;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetSpaceInfo(state, &data, &var), "embedDBGetSpaceInfo failed");
+    uint32_t predicted = var.recordsUntilOverwrite;
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(100, predicted, "Wrong prediction for the variable data region");
+    insertVarRecords(100, 100 + predicted * 9 / 10, 100);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(state->numVarPages, state->nextVarPageId + state->numAvailVarPages, "The variable data region was overwritten well before the predicted record");
+    insertVarRecords(100 + predicted * 9 / 10, 100 + predicted * 11 / 10, 100);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetSpaceInfo(state, &data, &var), "embedDBGetSpaceInfo failed");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, (uint32_t)var.minKey, "The variable data region should have been overwritten soon after the predicted record");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(0, data.minKey, "The data region should keep its records");
+}
+
+void embedDBRebalance_should_move_pages_between_regions(void) {
+    insertVarRecords(0, 40, 100);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRebalance(state, 16), "embedDBRebalance did not move pages to the variable data region");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(48, state->numDataPages, "Wrong number of data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(32, state->numVarPages, "Wrong number of variable data pages");
+
+    /* More than the variable data region held before */
+    insertVarRecords(40, 110, 100);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(32, state->nextVarPageId + state->numAvailVarPages, "The variable data region was overwritten after growing");
+    for (uint32_t key = 0; key < 110; key++)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, checkVarRecord(key, 100), "Record did not return its variable data after rebalancing");
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRebalance(state, -4), "embedDBRebalance did not move pages back to the data region");
+    embedDBRegionInfo data, var;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetSpaceInfo(state, &data, &var), "embedDBGetSpaceInfo failed");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(52, data.numPages, "Wrong number of data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(28, var.numPages, "Wrong number of variable data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(52 - state->nextDataPageId, data.freePages, "Wrong number of free data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(28 - state->nextVarPageId, var.freePages, "Wrong number of free variable data pages");
+    for (uint32_t key = 0; key < 110; key += 7)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, checkVarRecord(key, 100), "Record did not return its variable data after moving pages back");
+}
+
+void embedDBRebalance_should_refuse_invalid_moves(void) {
+    insertVarRecords(0, 60, 100);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRebalance(state, 3), "Moved pages that are not a multiple of the erase size");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRebalance(state, 52), "Left the data region below its minimum");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRebalance(state, -12), "Shrank the variable data region below the pages it has written");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(64, state->numDataPages, "A refused move changed the data region");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(16, state->numVarPages, "A refused move changed the variable data region");
+
+    /* Once the variable data wraps its page ids no longer match their slots */
+    insertVarRecords(60, 200, 100);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRebalance(state, 8), "Rebalanced a region that has wrapped");
+}
+
+uint32_t insertVarRecordsUntilPage(uint32_t key, pgid_t pageId) {
+    while (state->nextVarPageId < pageId)
+        insertVarRecords(key, key + 1, 100), key++;
+    return key;
+}
+
+void checkVarRecordsFrom(uint32_t end, const char *message) {
+    for (uint32_t key = (uint32_t)state->minVarRecordId; key < end; key++)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, checkVarRecord(key, 100), message);
+}
+
+void embedDBRebalance_should_grow_wrapped_var_region_at_pass_boundary(void) {
+    /* Pages 16 to 31 are on storage, but 16 is not a multiple of 32 */
+    uint32_t key = insertVarRecordsUntilPage(0, 31);
+    embedDBFlush(state);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRebalance(state, 16), "Grew the variable data region where its page ids would move");
+
+    /* Pages 32 to 47 keep their slots with 32 pages, but data is buffered for page 48 */
+    key = insertVarRecordsUntilPage(key, 48);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRebalance(state, 16), "Grew the variable data region with variable data buffered");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRebalance(state, -4), "Shrank a variable data region that has wrapped");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(16, state->numVarPages, "A refused move changed the variable data region");
+
+    tearDown();
+    setUp();
+    key = insertVarRecordsUntilPage(0, 47);
+    embedDBFlush(state);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(48, state->nextVarPageId, "The flush did not write the last variable data page");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRebalance(state, 16), "embedDBRebalance did not grow the wrapped variable data region");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(48, state->numDataPages, "Wrong number of data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(32, state->numVarPages, "Wrong number of variable data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(16, state->numAvailVarPages, "The new variable data pages should be free");
+    checkVarRecordsFrom(key, "Record did not return its variable data after growing");
+
+    /* The new pages are used before the region wraps again */
+    uint64_t minVarRecordId = state->minVarRecordId;
+    uint32_t end = insertVarRecordsUntilPage(key, 64);
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(minVarRecordId, state->minVarRecordId, "Variable data was erased before the new pages were used");
+    checkVarRecordsFrom(end, "Record did not return its variable data after filling the new pages");
+    end = insertVarRecordsUntilPage(end, 90);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(key, (uint32_t)state->minVarRecordId, "The grown variable data region should have wrapped");
+    checkVarRecordsFrom(end, "Record did not return its variable data after wrapping the grown region");
+}
+
+uint32_t insertRecordsUntilPage(uint32_t key, pgid_t pageId) {
+    while (state->nextDataPageId < pageId) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &key), "embedDBPut did not insert the record");
+        key++;
+    }
+    return key;
+}
+
+void checkRecordsFrom(uint32_t end, const char *message) {
+    uint32_t data = 0;
+    for (uint32_t key = state->minDataPageId * state->maxRecordsPerPage; key < end; key++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key, data, message);
+    }
+}
+
+void reopenEmbedDB(uint32_t numDataPages, uint32_t numVarPages) {
+    embedDBClose(state);
+    freeState();
+    initState(numDataPages, numVarPages);
+    state->parameters &= ~EMBEDDB_RESET_DATA;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not reopen with the new page counts.");
+}
+
+void embedDBRebalance_should_shrink_wrapped_data_region(void) {
+    /* With 64 pages, 32 pages keep their slots when the next page is 96 */
+    uint32_t key = insertRecordsUntilPage(0, 95);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRebalance(state, 32), "Shrank the data region where its page ids would move");
+    key = insertRecordsUntilPage(key, 96);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRebalance(state, 32), "embedDBRebalance did not shrink the wrapped data region");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(32, state->numDataPages, "Wrong number of data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(48, state->numVarPages, "Wrong number of variable data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(64, state->minDataPageId, "The pages that no longer fit were not dropped");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numAvailDataPages, "The kept pages should fill the data region");
+    checkRecordsFrom(key, "Record was not found after shrinking the data region");
+    uint32_t data = 0, oldKey = 10;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &oldKey, &data), "A dropped record was found");
+
+    /* The smaller region wraps over the kept pages */
+    key = insertRecordsUntilPage(key, 150);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(100, state->minDataPageId, "The shrunk data region did not wrap");
+    checkRecordsFrom(key, "Record was not found after wrapping the shrunk data region");
+
+    embedDBFlush(state);
+    reopenEmbedDB(32, 48);
+    checkRecordsFrom(key, "Record was not recovered after shrinking the data region");
+}
+
+void embedDBRebalance_should_grow_wrapped_data_region_at_pass_boundary(void) {
+    tearDown();
+    initState(64, 48);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+    /* Pages 192 to 255 keep their slots with 96 pages once page 255 is written */
+    uint32_t key = insertRecordsUntilPage(0, 192);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRebalance(state, -32), "Grew the data region where its page ids would move");
+    key = insertRecordsUntilPage(key, 256);
+    uint32_t numAvailDataPages = state->numAvailDataPages;
+    pgid_t minDataPageId = state->minDataPageId;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRebalance(state, -32), "embedDBRebalance did not grow the wrapped data region");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(96, state->numDataPages, "Wrong number of data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(16, state->numVarPages, "Wrong number of variable data pages");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numAvailDataPages + 32, state->numAvailDataPages, "The new data pages should be free");
+    checkRecordsFrom(key, "Record was not found after growing the data region");
+
+    /* The new pages are used before the region wraps again */
+    key = insertRecordsUntilPage(key, 256 + 32);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(minDataPageId, state->minDataPageId, "Data was erased before the new pages were used");
+    key = insertRecordsUntilPage(key, 400);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(300, state->minDataPageId, "The grown data region did not wrap");
+    checkRecordsFrom(key, "Record was not found after wrapping the grown data region");
+
+    embedDBFlush(state);
+    reopenEmbedDB(96, 16);
+    checkRecordsFrom(key, "Record was not recovered after growing the data region");
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBGetSpaceInfo_should_report_empty_regions);
+    RUN_TEST(embedDBGetSpaceInfo_should_report_stored_keys);
+    RUN_TEST(embedDBGetSpaceInfo_should_predict_data_overwrite);
+    RUN_TEST(embedDBGetSpaceInfo_should_predict_var_overwrite);
+    RUN_TEST(embedDBRebalance_should_move_pages_between_regions);
+    RUN_TEST(embedDBRebalance_should_refuse_invalid_moves);
+    RUN_TEST(embedDBRebalance_should_grow_wrapped_var_region_at_pass_boundary);
+    RUN_TEST(embedDBRebalance_should_shrink_wrapped_data_region);
+    RUN_TEST(embedDBRebalance_should_grow_wrapped_data_region_at_pass_boundary);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,281 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_superblock.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test reopening EmbedDB from the superblock.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#define SUPERBLOCK_FILE_PATH "superFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#define SUPERBLOCK_FILE_PATH "build/artifacts/superFile.bin"
+#endif
+
+#include "unity.h"
+
+#define SUPERBLOCK_PARAMETERS (EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_USE_SUPERBLOCK)
+
+embedDBState *state;
+embedDBFileInterface *fileInterface;
+uint32_t numDataReads = 0;
+
+bool countingRead(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    if (file == state->dataFile)
+        numDataReads++;
+    return fileInterface->read(buffer, pageNum, pageSize, file);
+}
+
+int8_t setupEmbedDB(uint32_t parameters, int8_t dataSize) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = dataSize;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 6;
+    state->numSplinePoints = 16;
+    state->buffer = calloc(1, state->pageSize * state->bufferSizeInBlocks);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate EmbedDB buffer.");
+    state->numDataPages = 32;
+    state->numIndexPages = 8;
+    state->numVarPages = 16;
+    state->eraseSizeInPages = 4;
+    state->bitmapSize = 1;
+    state->parameters = parameters;
+
+    /* Count data file reads on a copy of the file interface */
+    fileInterface = getFileInterface();
+    state->fileInterface = (embedDBFileInterface *)malloc(sizeof(embedDBFileInterface));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->fileInterface, "Failed to allocate file interface.");
+    memcpy(state->fileInterface, fileInterface, sizeof(embedDBFileInterface));
+    state->fileInterface->read = countingRead;
+
+    char dataPath[] = DATA_FILE_PATH, indexPath[] = INDEX_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
+    char superblockPath[] = SUPERBLOCK_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+    state->varFile = setupFile(varPath);
+    state->superblockFile = setupFile(superblockPath);
+
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    numDataReads = 0;
+    return embedDBInit(state, 1);
+}
+
+void closeEmbedDB() {
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    tearDownFile(state->superblockFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(fileInterface);
+    free(state);
+}
+
+void reopenEmbedDB() {
+    closeEmbedDB();
+    int8_t result = setupEmbedDB(SUPERBLOCK_PARAMETERS, 4);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not reopen correctly.");
+}
+
+void setUp(void) {
+    int8_t result = setupEmbedDB(SUPERBLOCK_PARAMETERS | EMBEDDB_RESET_DATA, 4);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDown(void) {
+    closeEmbedDB();
+}
+
+void insertRecords(uint32_t first, uint32_t count) {
+    char varData[20];
+    for (uint32_t key = first; key < first + count; key++) {
+        uint32_t data = key % 100;
+        snprintf(varData, sizeof(varData), "Testing %03u...", (unsigned int)(key % 1000));
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, varData, 15), "embedDBPutVar did not insert the record.");
+    }
+}
+
+void assertRecordsFound(uint32_t first, uint32_t count) {
+    char expected[20], varData[20];
+    for (uint32_t key = first; key < first + count; key++) {
+        uint32_t data = 0;
+        embedDBVarDataStream *varStream = NULL;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &data, &varStream), "embedDBGetVar did not find an inserted record.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGetVar returned the wrong fixed data.");
+        TEST_ASSERT_NOT_NULL_MESSAGE(varStream, "embedDBGetVar did not return variable data.");
+        snprintf(expected, sizeof(expected), "Testing %03u...", (unsigned int)(key % 1000));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(15, embedDBVarDataStreamRead(state, varStream, varData, 20), "Variable data was not the right length.");
+        TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(expected, varData, 15, "embedDBGetVar returned the wrong variable data.");
+        free(varStream);
+    }
+}
+
+void superblock_should_reopen_without_scanning_the_data_file() {
+    uint32_t numRecords = state->maxRecordsPerPage * 6;
+    insertRecords(1, numRecords);
+    embedDBFlush(state);
+    pgid_t nextDataPageId = state->nextDataPageId;
+    pgid_t nextIdxPageId = state->nextIdxPageId;
+    pgid_t nextVarPageId = state->nextVarPageId;
+    uint64_t minVarRecordId = state->minVarRecordId;
+
+    reopenEmbedDB();
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(3, numDataReads, "Opening from the superblock read more than the first, next and last data pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextDataPageId, state->nextDataPageId, "nextDataPageId was not restored.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextIdxPageId, state->nextIdxPageId, "nextIdxPageId was not restored.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextVarPageId, state->nextVarPageId, "nextVarPageId was not restored.");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(minVarRecordId, state->minVarRecordId, "minVarRecordId was not restored.");
+    assertRecordsFound(1, numRecords);
+}
+
+void superblock_should_find_pages_written_after_it() {
+    insertRecords(1, state->maxRecordsPerPage * 2);
+    embedDBFlush(state);
+
+    /* Full pages reach storage without another superblock */
+    insertRecords(state->maxRecordsPerPage * 2 + 1, state->maxRecordsPerPage * 3);
+    pgid_t nextDataPageId = state->nextDataPageId;
+    pgid_t nextVarPageId = state->nextVarPageId;
+
+    reopenEmbedDB();
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextDataPageId, state->nextDataPageId, "Data pages written after the superblock were not found.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextVarPageId, state->nextVarPageId, "Variable data pages written after the superblock were not found.");
+    assertRecordsFound(1, state->maxRecordsPerPage * 4);
+}
+
+void superblock_should_fall_back_to_scanning_after_the_data_wraps() {
+    insertRecords(1, state->maxRecordsPerPage);
+    embedDBFlush(state);
+
+    uint32_t numRecords = state->maxRecordsPerPage * (state->numDataPages + 8);
+    for (uint32_t key = state->maxRecordsPerPage + 1; key <= numRecords; key++) {
+        uint32_t data = key % 100;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert the record.");
+    }
+    pgid_t nextDataPageId = state->nextDataPageId;
+    pgid_t minDataPageId = state->minDataPageId;
+
+    reopenEmbedDB();
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextDataPageId, state->nextDataPageId, "nextDataPageId was not recovered after the data wrapped.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(minDataPageId, state->minDataPageId, "minDataPageId was not recovered after the data wrapped.");
+    uint32_t key = numRecords - state->maxRecordsPerPage, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record written after the data wrapped.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGet returned the wrong data.");
+}
+
+void superblock_should_reject_a_different_configuration() {
+    insertRecords(1, state->maxRecordsPerPage * 2);
+    embedDBFlush(state);
+    closeEmbedDB();
+
+    int8_t result = setupEmbedDB(SUPERBLOCK_PARAMETERS, 8);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, result, "EmbedDB opened files written with a different data size.");
+
+    /* Only the superblock file was opened */
+    state->fileInterface->close(state->superblockFile);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    tearDownFile(state->superblockFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(fileInterface);
+    free(state);
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(SUPERBLOCK_PARAMETERS, 4), "EmbedDB did not reopen with the original configuration.");
+    assertRecordsFound(1, state->maxRecordsPerPage * 2);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(superblock_should_reopen_without_scanning_the_data_file);
+    RUN_TEST(superblock_should_find_pages_written_after_it);
+    RUN_TEST(superblock_should_fall_back_to_scanning_after_the_data_wraps);
+    RUN_TEST(superblock_should_reject_a_different_configuration);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
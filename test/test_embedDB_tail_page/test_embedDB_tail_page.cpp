@@ -0,0 +1,281 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_tail_page.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB flushes that keep filling the tail page.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+#define FLUSH_EVERY 7
+
+void setupEmbedDB(uint32_t parameters, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->buffer = malloc(state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 8;
+    state->eraseSizeInPages = 4;
+    state->bitmapSize = 1;
+    state->numSplinePoints = 64;
+    state->parameters = parameters;
+
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_PATH, indexPath[] = INDEX_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp(void) {
+    setupEmbedDB(EMBEDDB_RESUME_TAIL_PAGE | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP | EMBEDDB_RESET_DATA, 1000);
+}
+
+void tearDown(void) {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+/* Inserts keys first..first+count-1 with data key % 100, flushing every FLUSH_EVERY records */
+void insertRecordsWithFlushes(uint32_t first, uint32_t count) {
+    for (uint32_t key = first; key < first + count; key++) {
+        uint32_t data = key % 100;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert the record.");
+        if ((key - first) % FLUSH_EVERY == FLUSH_EVERY - 1) {
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush did not write the tail page.");
+        }
+    }
+}
+
+void checkRecords(uint32_t first, uint32_t count) {
+    uint32_t data = 0;
+    for (uint32_t key = first; key < first + count; key++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a flushed record.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGet returned the wrong data.");
+    }
+}
+
+void embedDBFlush_should_keep_filling_the_tail_page() {
+    uint32_t numRecords = state->maxRecordsPerPage * 3 + 10;
+    insertRecordsWithFlushes(1, numRecords);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, state->nextDataPageId, "Flushes started new data pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(10, EMBEDDB_GET_COUNT(state->buffer), "The write buffer did not keep the tail records.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(state->numDataPages - 4, state->numAvailDataPages, "The tail page slot was not counted as used.");
+    checkRecords(1, numRecords);
+}
+
+void embedDBFlush_should_keep_filling_the_index_page() {
+    insertRecordsWithFlushes(1, state->maxRecordsPerPage * 5);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+
+    void *indexBuffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_WRITE_BUFFER;
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->nextIdxPageId, "Flushes started new index pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, EMBEDDB_GET_COUNT(indexBuffer), "The index page did not keep one entry per data page.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(state->numIndexPages - 1, state->numAvailIndexPages, "The index tail slot was not counted as used.");
+}
+
+void embedDBIterator_should_return_records_across_flushes() {
+    uint32_t numRecords = state->maxRecordsPerPage * 4 + 20;
+    insertRecordsWithFlushes(1, numRecords);
+
+    embedDBIterator it;
+    uint32_t minData = 10, maxData = 19;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBInitIterator(state, &it);
+
+    uint32_t key = 0, data = 0, count = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBNext returned the wrong data.");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+
+    uint32_t expected = 0;
+    for (uint32_t i = 1; i <= numRecords; i++) {
+        if (i % 100 >= minData && i % 100 <= maxData)
+            expected++;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected, count, "embedDBNext did not return every matching record.");
+}
+
+void embedDB_should_resume_tail_pages_after_reload() {
+    uint32_t numRecords = state->maxRecordsPerPage * 2 + 15;
+    insertRecordsWithFlushes(1, numRecords);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+    tearDown();
+    setupEmbedDB(EMBEDDB_RESUME_TAIL_PAGE | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP, 1000);
+
+    void *indexBuffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_WRITE_BUFFER;
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, state->nextDataPageId, "Reload did not resume the tail data page.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(15, EMBEDDB_GET_COUNT(state->buffer), "Reload did not restore the tail records.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->nextIdxPageId, "Reload did not resume the tail index page.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, EMBEDDB_GET_COUNT(indexBuffer), "Reload did not restore the index entries.");
+    checkRecords(1, numRecords);
+
+    /* New records fill the resumed page and start the next one */
+    insertRecordsWithFlushes(numRecords + 1, state->maxRecordsPerPage - 14);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, state->nextDataPageId, "The resumed page was not completed.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, EMBEDDB_GET_COUNT(state->buffer), "The record after the resumed page was not kept.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(state->numDataPages - 4, state->numAvailDataPages, "Completing the resumed page used another slot.");
+    checkRecords(1, state->maxRecordsPerPage * 3 + 1);
+}
+
+void embedDBFlush_should_keep_tail_page_when_wrapping() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RESUME_TAIL_PAGE | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP | EMBEDDB_RESET_DATA, 16);
+    uint32_t numRecords = state->maxRecordsPerPage * 40 + 3;
+    insertRecordsWithFlushes(1, numRecords);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(40, state->nextDataPageId, "Flushes started new data pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(state->nextDataPageId + 1, state->minDataPageId + state->numDataPages - state->numAvailDataPages, "Available pages do not match the stored range.");
+    checkRecords(state->minDataPageId * state->maxRecordsPerPage + 1, numRecords - state->minDataPageId * state->maxRecordsPerPage);
+}
+
+void embedDBFlush_should_not_keep_a_page_model_in_the_tail_page() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RESUME_TAIL_PAGE | EMBEDDB_USE_PAGE_MODEL | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP | EMBEDDB_RESET_DATA, 1000);
+    uint32_t data = 0;
+    for (uint32_t key = 1; key <= 20; key++) {
+        data = key % 100;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert the record.");
+    }
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+
+    /* Keys far past the fitted line must still be found in the write buffer */
+    for (uint32_t key = 100000; key <= 2000000; key += 100000) {
+        data = key % 100;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert the record.");
+    }
+    checkRecords(1, 20);
+    for (uint32_t key = 100000; key <= 2000000; key += 100000) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record added after the flush.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGet returned the wrong data.");
+    }
+
+    /* The same holds for a tail page restored on reload */
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+    tearDown();
+    setupEmbedDB(EMBEDDB_RESUME_TAIL_PAGE | EMBEDDB_USE_PAGE_MODEL | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP, 1000);
+    for (uint32_t key = 3000000; key <= 60000000; key += 3000000) {
+        data = key % 100;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert the record.");
+    }
+    for (uint32_t key = 3000000; key <= 60000000; key += 3000000) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record added after the reload.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGet returned the wrong data.");
+    }
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBFlush_should_keep_filling_the_tail_page);
+    RUN_TEST(embedDBFlush_should_keep_filling_the_index_page);
+    RUN_TEST(embedDBIterator_should_return_records_across_flushes);
+    RUN_TEST(embedDB_should_resume_tail_pages_after_reload);
+    RUN_TEST(embedDBFlush_should_keep_tail_page_when_wrapping);
+    RUN_TEST(embedDBFlush_should_not_keep_a_page_model_in_the_tail_page);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
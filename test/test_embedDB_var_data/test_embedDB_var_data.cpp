@@ -256,6 +256,181 @@ void embedDBFlushVar_should_not_write_when_no_data_in_buffer() {
     TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->nextVarPageId, "embedDBFlushVar should not change nextVarPageId when flushing an empty variable data page.");
 }
 
+void embedDBGetVar_should_read_buffered_data_without_writing() {
+    initState(8);
+    embedDBInit(state, 0);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, insertRecords(5), "embedDBPutVar was not successful when inserting records");
+
+    /* Data that spans from a full page on storage into the write buffer */
+    char longData[700];
+    for (uint32_t j = 0; j < sizeof(longData); j++)
+        longData[j] = (char)('a' + j % 26);
+    uint64_t key = 5, data = 5;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, longData, sizeof(longData)), "embedDBPutVar did not insert the long record");
+    inserted++;
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->nextVarPageId, "The long record should have filled one variable data page");
+
+    uint32_t numWrites = state->numWrites;
+    pgid_t currentVarLoc = state->currentVarLoc;
+    char buf[700];
+    embedDBVarDataStream *varStream = NULL;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &data, &varStream), "embedDBGetVar did not find the long record");
+    TEST_ASSERT_NOT_NULL_MESSAGE(varStream, "embedDBGetVar did not return vardata");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(longData), embedDBVarDataStreamRead(state, varStream, buf, sizeof(buf)), "Returned vardata was not the right length");
+    TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(longData, buf, sizeof(longData), "embedDBGetVar did not return the correct vardata");
+    free(varStream);
+    varStream = NULL;
+
+    uint32_t shortKey = 3;
+    char expected[] = "Testing 003...";
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &shortKey, &data, &varStream), "embedDBGetVar did not find a buffered record");
+    TEST_ASSERT_NOT_NULL_MESSAGE(varStream, "embedDBGetVar did not return vardata");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(15, embedDBVarDataStreamRead(state, varStream, buf, 20), "Returned vardata was not the right length");
+    TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(expected, buf, 15, "embedDBGetVar did not return the correct vardata");
+    free(varStream);
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numWrites, state->numWrites, "Reading buffered variable data should not write a page");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(currentVarLoc, state->currentVarLoc, "Reading buffered variable data should not start a new page");
+    resetState();
+}
+
+void embedDBNextVarInto_should_reuse_caller_stream() {
+    initState(8);
+    embedDBInit(state, 0);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, insertRecords(200), "embedDBPutVar was not successful when inserting records");
+    uint64_t noVarKey = 200, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &noVarKey, &data, NULL, 0), "embedDBPutVar did not insert a record without vardata");
+
+    embedDBVarDataStream varStream;
+    char buf[20], expected[] = "Testing 000...";
+    uint32_t key = 0;
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t count = 0;
+    while (embedDBNextVarInto(state, &it, &key, &data, &varStream)) {
+        if (key == noVarKey) {
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, varStream.totalBytes, "Record without vardata should have an empty stream");
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, embedDBVarDataStreamRead(state, &varStream, buf, sizeof(buf)), "Empty stream should not return data");
+            continue;
+        }
+        expected[10] = (char)(key % 10) + '0';
+        expected[9] = (char)((key / 10) % 10) + '0';
+        expected[8] = (char)((key / 100) % 10) + '0';
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(15, embedDBVarDataStreamRead(state, &varStream, buf, sizeof(buf)), "Returned vardata was not the right length");
+        TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(expected, buf, 15, "embedDBNextVarInto did not return the correct vardata");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(200, count, "embedDBNextVarInto did not return every record with vardata");
+
+    key = 150;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &varStream), "embedDBGetVarInto did not find the record");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(15, embedDBVarDataStreamRead(state, &varStream, buf, sizeof(buf)), "Returned vardata was not the right length");
+    TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE("Testing 150...", buf, 15, "embedDBGetVarInto did not return the correct vardata");
+    key = 500;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGetVarInto(state, &key, &data, &varStream), "embedDBGetVarInto did not return -1 when the key was not found");
+    resetState();
+}
+
+void embedDBGetVar_should_take_streams_from_pool() {
+    initState(8);
+    embedDBVarDataStream pool[2];
+    state->parameters |= EMBEDDB_USE_VAR_STREAM_POOL;
+    state->varStreamPool = pool;
+    state->varStreamPoolSize = 2;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 0), "embedDBInit did not accept the stream pool");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, insertRecords(50), "embedDBPutVar was not successful when inserting records");
+
+    uint32_t key = 10;
+    uint64_t data = 0;
+    embedDBVarDataStream *first = NULL, *second = NULL, *third = NULL;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &data, &first), "embedDBGetVar did not find the first record");
+    key = 20;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &data, &second), "embedDBGetVar did not find the second record");
+    TEST_ASSERT_TRUE_MESSAGE(first >= pool && first < pool + 2, "The first stream did not come from the pool");
+    TEST_ASSERT_TRUE_MESSAGE(second >= pool && second < pool + 2 && second != first, "The second stream did not come from the pool");
+    key = 30;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGetVar(state, &key, &data, &third), "embedDBGetVar should fail when the pool is empty");
+    TEST_ASSERT_NULL_MESSAGE(third, "No stream should be returned when the pool is empty");
+
+    embedDBFreeVarDataStream(state, first);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &data, &third), "embedDBGetVar did not reuse the freed stream");
+    TEST_ASSERT_TRUE_MESSAGE(first == third, "The freed stream was not reused");
+    char buf[20];
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(15, embedDBVarDataStreamRead(state, third, buf, sizeof(buf)), "Returned vardata was not the right length");
+    TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE("Testing 030...", buf, 15, "Pooled stream did not return the correct vardata");
+    embedDBFreeVarDataStream(state, second);
+    embedDBFreeVarDataStream(state, third);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->varStreamPoolInUse, "Freed streams were not returned to the pool");
+    resetState();
+}
+
+void embedDBVarDataStreamRead_should_read_whole_pages_into_buffer() {
+    initState(8);
+    embedDBInit(state, 0);
+    char blob[3000];
+    for (uint32_t j = 0; j < sizeof(blob); j++)
+        blob[j] = (char)(j * 7 % 251);
+    uint64_t key = 0, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, blob, sizeof(blob)), "embedDBPutVar did not insert the blob");
+    inserted++;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, insertRecords(5), "embedDBPutVar was not successful when inserting records");
+
+    /* One read of the whole blob, using readPages */
+    embedDBVarDataStream varStream;
+    char buf[3000];
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &varStream), "embedDBGetVarInto did not find the blob");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(blob), embedDBVarDataStreamRead(state, &varStream, buf, sizeof(buf)), "Returned blob was not the right length");
+    TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(blob, buf, sizeof(blob), "Blob read with readPages was not correct");
+
+    /* Reads ending on a page boundary, with pages read one at a time */
+    state->fileInterface->readPages = NULL;
+    memset(buf, 0, sizeof(buf));
+    uint32_t firstPageBytes = state->pageSize - state->variableDataHeaderSize - sizeof(uint32_t);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &varStream), "embedDBGetVarInto did not find the blob");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(firstPageBytes, embedDBVarDataStreamRead(state, &varStream, buf, firstPageBytes), "First read did not fill the buffer");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(blob) - firstPageBytes, embedDBVarDataStreamRead(state, &varStream, buf + firstPageBytes, sizeof(buf) - firstPageBytes), "Second read did not return the rest of the blob");
+    TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(blob, buf, sizeof(blob), "Blob read one page at a time was not correct");
+    resetState();
+}
+
+void embedDBVarDataStreamSeek_should_read_from_offset() {
+    initState(8);
+    embedDBInit(state, 0);
+    char blob[3000];
+    for (uint32_t j = 0; j < sizeof(blob); j++)
+        blob[j] = (char)(j * 7 % 251);
+    uint64_t key = 0, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, blob, sizeof(blob)), "embedDBPutVar did not insert the blob");
+    inserted++;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, insertRecords(5), "embedDBPutVar was not successful when inserting records");
+
+    embedDBVarDataStream varStream;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &varStream), "embedDBGetVarInto did not find the blob");
+    uint32_t firstPageBytes = state->pageSize - state->variableDataHeaderSize - sizeof(uint32_t);
+    uint32_t offsets[] = {2500, 0, 10, firstPageBytes - 1, firstPageBytes, 1700, 2950};
+    char buf[100];
+    for (uint32_t j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBVarDataStreamSeek(state, &varStream, offsets[j]), "embedDBVarDataStreamSeek did not seek in the blob");
+        uint32_t expectedLength = sizeof(blob) - offsets[j] < sizeof(buf) ? sizeof(blob) - offsets[j] : sizeof(buf);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedLength, embedDBVarDataStreamRead(state, &varStream, buf, sizeof(buf)), "Read after seeking was not the right length");
+        TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(blob + offsets[j], buf, expectedLength, "Read after seeking did not return the data at the offset");
+    }
+
+    uint32_t numReads = state->numReads;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBVarDataStreamSeek(state, &varStream, 1200), "embedDBVarDataStreamSeek did not seek in the blob");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, embedDBVarDataStreamRead(state, &varStream, buf, 1), "Read after seeking was not the right length");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numReads + 1, state->numReads, "Reading after a seek should read one page");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBVarDataStreamSeek(state, &varStream, sizeof(blob)), "embedDBVarDataStreamSeek did not seek to the end");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, embedDBVarDataStreamRead(state, &varStream, buf, sizeof(buf)), "Read at the end should return no data");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBVarDataStreamSeek(state, &varStream, sizeof(blob) + 1), "embedDBVarDataStreamSeek should not seek past the end");
+    resetState();
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
 
@@ -283,6 +458,11 @@ int runUnityTests() {
     }
 
     RUN_TEST(embedDBFlushVar_should_not_write_when_no_data_in_buffer);
+    RUN_TEST(embedDBGetVar_should_read_buffered_data_without_writing);
+    RUN_TEST(embedDBNextVarInto_should_reuse_caller_stream);
+    RUN_TEST(embedDBGetVar_should_take_streams_from_pool);
+    RUN_TEST(embedDBVarDataStreamRead_should_read_whole_pages_into_buffer);
+    RUN_TEST(embedDBVarDataStreamSeek_should_read_from_offset);
 
     return UNITY_END();
 }
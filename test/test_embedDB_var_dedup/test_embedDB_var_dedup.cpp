@@ -0,0 +1,337 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_var_dedup.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test storing repeated variable data once.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+/* Blob i of a small set, so records can repeat them */
+void makeBlob(uint8_t *blob, uint32_t id, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++)
+        blob[i] = (uint8_t)(id * 131 + i * 7 + (i >> 8));
+}
+
+void initState(uint32_t parameters, uint32_t numVarPages, count_t varDedupSlots) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 7;
+    state->numSplinePoints = 8;
+    state->buffer = calloc(state->bufferSizeInBlocks, state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 1000;
+    state->numIndexPages = 48;
+    state->numVarPages = numVarPages;
+    state->eraseSizeInPages = 4;
+    state->varDedupSlots = varDedupSlots;
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_FILE_PATH, indexPath[] = INDEX_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+    state->varFile = setupFile(varPath);
+    state->parameters = EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_DEDUP_VDATA | EMBEDDB_RESET_DATA | parameters;
+    state->bitmapSize = 1;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+}
+
+void freeState() {
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+void reinitState(uint32_t parameters, uint32_t numVarPages, count_t varDedupSlots) {
+    embedDBClose(state);
+    freeState();
+    initState(parameters, numVarPages, varDedupSlots);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+}
+
+void setUp(void) {
+    initState(0, 1000, 16);
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDown(void) {
+    embedDBClose(state);
+    freeState();
+}
+
+/* Returns 0 if the record's variable data matches blob id, 1 if it was erased and -1 otherwise */
+int8_t checkBlob(uint32_t key, uint32_t id, uint32_t length) {
+    static uint8_t expected[1500], actual[1500];
+    uint32_t data = 0;
+    embedDBVarDataStream stream;
+    int8_t result = embedDBGetVarInto(state, &key, &data, &stream);
+    if (result == 1)
+        return 1;
+    if (result != 0 || data != key || stream.totalBytes != length)
+        return -1;
+    makeBlob(expected, id, length);
+    if (embedDBVarDataStreamRead(state, &stream, actual, sizeof(actual)) != length)
+        return -1;
+    return memcmp(expected, actual, length) == 0 ? 0 : -1;
+}
+
+/* A reference is its length, the address of the copy and the page id of the copy. Allow twice
+   the pages the copies and references fill, as data page writes also write partial pages. */
+uint32_t maxPagesForCopies(uint32_t copyBytes, uint32_t numReferences) {
+    uint32_t bytes = copyBytes + numReferences * (sizeof(uint32_t) + sizeof(varaddr_t) + sizeof(pgid_t));
+    uint32_t bytesPerPage = state->pageSize - state->variableDataHeaderSize;
+    return 2 * ((bytes + bytesPerPage - 1) / bytesPerPage);
+}
+
+void embedDBPutVar_should_store_repeated_data_once(void) {
+    uint8_t blob[1000];
+    makeBlob(blob, 1, sizeof(blob));
+    for (uint32_t key = 0; key < 200; key++)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, blob, sizeof(blob)), "embedDBPutVar did not insert the record");
+    /* 200 full copies would need about 400 pages */
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(maxPagesForCopies(sizeof(blob) + 4, 199), state->nextVarPageId, "Repeated data was stored more than once");
+    for (uint32_t key = 0; key < 200; key++)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, checkBlob(key, 1, sizeof(blob)), "Deduplicated record did not return its data");
+    embedDBFlush(state);
+    for (uint32_t key = 0; key < 200; key += 13)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, checkBlob(key, 1, sizeof(blob)), "Deduplicated record did not return its data after a flush");
+}
+
+void embedDBPutVar_should_keep_distinct_data_apart(void) {
+    uint8_t blob[300];
+    /* Blobs 0 to 2 repeat and every fifth record is new, all the same length */
+    for (uint32_t key = 0; key < 300; key++) {
+        uint32_t id = key % 5 == 4 ? 100 + key : key % 3;
+        makeBlob(blob, id, sizeof(blob));
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, blob, sizeof(blob)), "embedDBPutVar did not insert the record");
+    }
+    embedDBFlush(state);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key = 0, data = 0, count = 0;
+    uint8_t expected[300], actual[300];
+    embedDBVarDataStream stream;
+    while (embedDBNextVarInto(state, &it, &key, &data, &stream)) {
+        makeBlob(expected, key % 5 == 4 ? 100 + key : key % 3, sizeof(expected));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(actual), embedDBVarDataStreamRead(state, &stream, actual, sizeof(actual)), "Iterator did not return all of the variable data");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, actual, sizeof(expected), "Iterator returned another record's variable data");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(300, count, "Iterator did not return every record");
+}
+
+void embedDBPutVar_should_not_match_data_sharing_a_slot(void) {
+    reinitState(0, 1000, 1);
+    uint8_t blob[100];
+    for (uint32_t key = 0; key < 100; key++) {
+        makeBlob(blob, key % 4, sizeof(blob));
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, blob, sizeof(blob)), "embedDBPutVar did not insert the record");
+    }
+    for (uint32_t key = 0; key < 100; key++)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, checkBlob(key, key % 4, sizeof(blob)), "Record returned data from another record in its slot");
+}
+
+void embedDBGetVar_should_not_follow_erased_copies(void) {
+    reinitState(0, 16, 16);
+    uint8_t shared[200], unique[700];
+    makeBlob(shared, 1, sizeof(shared));
+    /* Every other record repeats the shared blob while the unique ones wrap the file */
+    for (uint32_t key = 0; key < 200; key++) {
+        if (key % 2 == 0) {
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, shared, sizeof(shared)), "embedDBPutVar did not insert the shared record");
+        } else {
+            makeBlob(unique, 1000 + key, sizeof(unique));
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, unique, sizeof(unique)), "embedDBPutVar did not insert the unique record");
+        }
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(state->numVarPages * 3, state->nextVarPageId, "The variable data file should have wrapped several times");
+
+    uint32_t erased = 0;
+    for (uint32_t key = 0; key < 200; key++) {
+        int8_t result = checkBlob(key, key % 2 == 0 ? 1 : 1000 + key, key % 2 == 0 ? sizeof(shared) : sizeof(unique));
+        TEST_ASSERT_NOT_EQUAL_INT8_MESSAGE(-1, result, "Record returned the wrong variable data");
+        if (result == 1)
+            erased++;
+        /* The newest records must all still have their data */
+        if (key >= 190)
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "Newest record lost its variable data");
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(100, erased, "Most of the old records should have lost their data");
+}
+
+/* Inserts records from start to end, every third repeating one blob, and checks that every record from minVarRecordId on has its data */
+void insertSharedAndCheck(uint32_t start, uint32_t end) {
+    uint8_t shared[200], unique[300];
+    makeBlob(shared, 1, sizeof(shared));
+    for (uint32_t key = start; key < end; key++) {
+        if (key % 3 == 0) {
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, shared, sizeof(shared)), "embedDBPutVar did not insert the shared record");
+        } else {
+            makeBlob(unique, 1000 + key, sizeof(unique));
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, unique, sizeof(unique)), "embedDBPutVar did not insert the unique record");
+        }
+
+        /* Every record from minVarRecordId on must still have its data */
+        if (key % 20 == 19) {
+            for (uint32_t k = 0; k <= key; k++) {
+                int8_t result = checkBlob(k, k % 3 == 0 ? 1 : 1000 + k, k % 3 == 0 ? sizeof(shared) : sizeof(unique));
+                if (k >= state->minVarRecordId)
+                    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "Record at or above minVarRecordId lost its variable data");
+                else
+                    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, result, "Record below minVarRecordId returned variable data");
+            }
+        }
+    }
+}
+
+void embedDBGetVar_should_keep_references_above_minVarRecordId(void) {
+    reinitState(0, 16, 16);
+    insertSharedAndCheck(0, 300);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(state->numVarPages * 3, state->nextVarPageId, "The variable data file should have wrapped several times");
+}
+
+void embedDBGetVar_should_keep_references_above_minVarRecordId_after_reopen(void) {
+    reinitState(0, 16, 16);
+    insertSharedAndCheck(0, 100);
+    embedDBFlush(state);
+    embedDBClose(state);
+    freeState();
+
+    /* References written before the reopen are not in the dedup table */
+    initState(0, 16, 16);
+    state->parameters &= ~EMBEDDB_RESET_DATA;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not reopen correctly.");
+    insertSharedAndCheck(100, 300);
+}
+
+void embedDBPutVar_should_deduplicate_compressed_data(void) {
+    reinitState(EMBEDDB_COMPRESS_VDATA, 1000, 16);
+    uint8_t blob[1200];
+    for (uint32_t key = 0; key < 50; key++) {
+        makeBlob(blob, key % 2, sizeof(blob));
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, blob, sizeof(blob)), "embedDBPutVar did not insert the record");
+    }
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(maxPagesForCopies(2 * (sizeof(blob) + 4), 48), state->nextVarPageId, "Repeated data was stored more than once");
+    for (uint32_t key = 0; key < 50; key++)
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, checkBlob(key, key % 2, sizeof(blob)), "Deduplicated compressed record did not return its data");
+}
+
+void embedDBInit_should_require_dedup_slots(void) {
+    tearDown();
+    initState(0, 1000, 0);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "embedDBInit should need at least one dedup slot");
+    freeState();
+    setUp();
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBPutVar_should_store_repeated_data_once);
+    RUN_TEST(embedDBPutVar_should_keep_distinct_data_apart);
+    RUN_TEST(embedDBPutVar_should_not_match_data_sharing_a_slot);
+    RUN_TEST(embedDBGetVar_should_not_follow_erased_copies);
+    RUN_TEST(embedDBGetVar_should_keep_references_above_minVarRecordId);
+    RUN_TEST(embedDBGetVar_should_keep_references_above_minVarRecordId_after_reopen);
+    RUN_TEST(embedDBPutVar_should_deduplicate_compressed_data);
+    RUN_TEST(embedDBInit_should_require_dedup_slots);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,339 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_var_read_ahead.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the variable data read-ahead window and embedDBScanVar.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+#define NUM_RECORDS 400
+
+embedDBState *state;
+uint32_t varReads = 0, varMultiPageReads = 0;
+bool (*fileRead)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+bool (*fileReadPages)(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file);
+
+bool countingRead(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    if (file == state->varFile)
+        varReads++;
+    return fileRead(buffer, pageNum, pageSize, file);
+}
+
+bool countingReadPages(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+    if (file == state->varFile)
+        varMultiPageReads++;
+    return fileReadPages(buffer, pageNum, numPages, pageSize, file);
+}
+
+/* Record i has i * 37 % 300 bytes of variable data, and none when that is 0 */
+uint32_t varLength(uint32_t key) {
+    return key * 37 % 300;
+}
+
+uint8_t varByte(uint32_t key, uint32_t offset) {
+    return (uint8_t)(key * 31 + offset);
+}
+
+void initState(count_t varReadAheadPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 6;
+    state->numSplinePoints = 8;
+    state->buffer = calloc(state->bufferSizeInBlocks, state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 1000;
+    state->numIndexPages = 48;
+    state->numVarPages = 128;
+    state->eraseSizeInPages = 4;
+    state->varReadAheadPages = varReadAheadPages;
+    state->fileInterface = getFileInterface();
+    fileRead = state->fileInterface->read;
+    fileReadPages = state->fileInterface->readPages;
+    state->fileInterface->read = countingRead;
+    state->fileInterface->readPages = countingReadPages;
+    char dataPath[] = DATA_FILE_PATH, indexPath[] = INDEX_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+    state->varFile = setupFile(varPath);
+    state->parameters = EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_VAR_READ_AHEAD | EMBEDDB_RESET_DATA;
+    state->bitmapSize = 1;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+}
+
+void freeState() {
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+void insertRecords(uint32_t from, uint32_t to) {
+    uint8_t varData[300];
+    for (uint32_t key = from; key < to; key++) {
+        uint32_t length = varLength(key);
+        for (uint32_t i = 0; i < length; i++)
+            varData[i] = varByte(key, i);
+        int8_t result = embedDBPutVar(state, &key, &key, length == 0 ? NULL : varData, length);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPutVar did not insert the record");
+    }
+    embedDBFlush(state);
+}
+
+void setUp(void) {
+    initState(8);
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+    insertRecords(0, NUM_RECORDS);
+}
+
+void tearDown(void) {
+    embedDBClose(state);
+    freeState();
+}
+
+typedef struct {
+    uint32_t nextKey;
+    uint32_t nextOffset;
+    uint32_t recordsWithData;
+    uint32_t recordsOverwritten;
+    uint32_t stopAfter;
+    uint32_t numRecords;
+} scanCheck;
+
+int8_t checkChunk(void *context, void *key, void *data, void *chunk, uint32_t offset, uint32_t length, uint32_t totalBytes, int8_t varStatus) {
+    scanCheck *check = (scanCheck *)context;
+    uint32_t k = *(uint32_t *)key;
+    if (offset == 0) {
+        if (k < check->nextKey)
+            TEST_FAIL_MESSAGE("embedDBScanVar returned a key out of order");
+        check->nextKey = k + 1;
+        check->numRecords++;
+        if (totalBytes > 0)
+            check->recordsWithData++;
+        if (varStatus == 1)
+            check->recordsOverwritten++;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(k, *(uint32_t *)data, "embedDBScanVar returned the wrong data");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(check->nextOffset, offset, "Chunks were not contiguous");
+    /* Records whose data was overwritten have none */
+    if (varStatus == 0)
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(varLength(k), totalBytes, "Variable data was not the right length");
+    else
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, totalBytes, "Overwritten variable data was returned");
+    for (uint32_t i = 0; i < length; i++) {
+        if (((uint8_t *)chunk)[i] != varByte(k, offset + i))
+            TEST_FAIL_MESSAGE("Variable data chunk did not match the inserted data");
+    }
+    check->nextOffset = offset + length >= totalBytes ? 0 : offset + length;
+    return check->numRecords == check->stopAfter && check->nextOffset == 0;
+}
+
+void embedDBScanVar_should_return_every_record(void) {
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key, data;
+    uint8_t chunk[100];
+    scanCheck check = {0, 0, 0, 0, 0, 0};
+    int32_t numRecords = embedDBScanVar(state, &it, &key, &data, chunk, sizeof(chunk), checkChunk, &check);
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(NUM_RECORDS, numRecords, "embedDBScanVar did not return every record");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(NUM_RECORDS, check.numRecords, "The callback did not see every record");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(NUM_RECORDS / 2, check.recordsWithData, "Most records should still have their variable data");
+}
+
+void embedDBScanVar_should_read_var_pages_in_windows(void) {
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key, data;
+    uint8_t chunk[100];
+    scanCheck check = {0, 0, 0, 0, 0, 0};
+    varReads = 0;
+    varMultiPageReads = 0;
+    embedDBScanVar(state, &it, &key, &data, chunk, sizeof(chunk), checkChunk, &check);
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, varMultiPageReads, "The scan did not read ahead");
+    /* Without the window every one of the variable pages is read on its own */
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(state->numVarPages / 4, varReads + varMultiPageReads, "The scan made too many variable data reads");
+}
+
+void embedDBScanVar_should_stop_when_callback_returns_non_zero(void) {
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key, data;
+    uint8_t chunk[600];
+    scanCheck check = {0, 0, 0, 0, 10, 0};
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(10, embedDBScanVar(state, &it, &key, &data, chunk, sizeof(chunk), checkChunk, &check), "embedDBScanVar did not stop after the callback asked it to");
+
+    /* The iterator carries on after the last record scanned */
+    embedDBVarDataStream stream;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBNextVarInto(state, &it, &key, &data, &stream), "The iterator did not continue after the scan");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(check.nextKey, key, "The iterator did not continue from the record after the scan");
+    embedDBCloseIterator(&it);
+}
+
+void embedDBPrevVarInto_should_read_backwards_with_read_ahead(void) {
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIteratorReverse(state, &it);
+    uint32_t key, data, expectedKey = NUM_RECORDS - 1;
+    uint8_t buf[300];
+    embedDBVarDataStream stream;
+    for (uint32_t i = 0; i < 100; i++, expectedKey--) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPrevVarInto(state, &it, &key, &data, &stream), "embedDBPrevVarInto did not return a record");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKey, key, "embedDBPrevVarInto returned the wrong key");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(varLength(key), stream.totalBytes, "Variable data was not the right length");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(stream.totalBytes, embedDBVarDataStreamRead(state, &stream, buf, sizeof(buf)), "Variable data was not read");
+        for (uint32_t j = 0; j < stream.totalBytes; j++) {
+            if (buf[j] != varByte(key, j))
+                TEST_FAIL_MESSAGE("Variable data did not match the inserted data");
+        }
+    }
+    embedDBCloseIterator(&it);
+}
+
+void embedDBScanVar_should_see_pages_written_after_read_ahead(void) {
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    uint32_t key, data;
+    uint8_t chunk[100];
+    scanCheck check = {0, 0, 0, 0, 0, 0};
+    embedDBInitIterator(state, &it);
+    embedDBScanVar(state, &it, &key, &data, chunk, sizeof(chunk), checkChunk, &check);
+    embedDBCloseIterator(&it);
+
+    /* Wrap the variable data file over the pages held in the window */
+    insertRecords(NUM_RECORDS, NUM_RECORDS * 2);
+    scanCheck secondCheck = {0, 0, 0, 0, 0, 0};
+    embedDBInitIterator(state, &it);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(NUM_RECORDS * 2, embedDBScanVar(state, &it, &key, &data, chunk, sizeof(chunk), checkChunk, &secondCheck), "embedDBScanVar did not return every record");
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, secondCheck.recordsOverwritten, "The callback was not told which variable data was overwritten");
+}
+
+void embedDBInit_should_reject_small_read_ahead_window(void) {
+    tearDown();
+    initState(1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "embedDBInit should need at least two read-ahead pages");
+    freeState();
+    setUp();
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBScanVar_should_return_every_record);
+    RUN_TEST(embedDBScanVar_should_read_var_pages_in_windows);
+    RUN_TEST(embedDBScanVar_should_stop_when_callback_returns_non_zero);
+    RUN_TEST(embedDBPrevVarInto_should_read_backwards_with_read_ahead);
+    RUN_TEST(embedDBScanVar_should_see_pages_written_after_read_ahead);
+    RUN_TEST(embedDBInit_should_reject_small_read_ahead_window);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,292 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_wide_records.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test records wider than 127 bytes and pages of 4 KB to 64 KB.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state = NULL;
+
+void initState(uint32_t pageSize, uint16_t dataSize, uint32_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = dataSize;
+    state->pageSize = pageSize;
+    state->bufferSizeInBlocks = (parameters & EMBEDDB_COMPRESS_VDATA) ? 7 : 6;
+    state->numSplinePoints = 8;
+    state->buffer = calloc(state->bufferSizeInBlocks, state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 32;
+    state->numIndexPages = 8;
+    state->numVarPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_FILE_PATH, indexPath[] = INDEX_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+    state->varFile = setupFile(varPath);
+    state->parameters = EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | parameters;
+    state->bitmapSize = 1;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+}
+
+void freeState() {
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+    state = NULL;
+}
+
+/* Closes the database and opens it again from its files */
+void reopenState(uint32_t parameters) {
+    uint32_t pageSize = state->pageSize;
+    uint16_t dataSize = state->dataSize;
+    embedDBClose(state);
+    freeState();
+    initState(pageSize, dataSize, parameters);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not reopen correctly.");
+}
+
+void setUp(void) {
+    state = NULL;
+}
+
+void tearDown(void) {
+    if (state != NULL) {
+        embedDBClose(state);
+        freeState();
+    }
+}
+
+/* The data of a wide record starts with its key and is filled from it */
+void makeRow(uint8_t *row, uint32_t key, uint16_t dataSize) {
+    memcpy(row, &key, sizeof(key));
+    for (uint16_t i = sizeof(key); i < dataSize; i++)
+        row[i] = (uint8_t)(key * 31 + i);
+}
+
+void checkWideRows(uint32_t numRecords) {
+    static uint8_t expected[1024], actual[1024];
+    for (uint32_t key = 0; key < numRecords; key++) {
+        makeRow(expected, key, state->dataSize);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, actual), "embedDBGet did not find a wide record");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, actual, state->dataSize, "embedDBGet returned the wrong data for a wide record");
+    }
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key = 0, count = 0;
+    while (embedDBNext(state, &it, &key, actual)) {
+        makeRow(expected, key, state->dataSize);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(count, key, "Iterator returned the wrong key");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, actual, state->dataSize, "Iterator returned the wrong data for a wide record");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords, count, "Iterator did not return every wide record");
+}
+
+void wide_records_should_be_stored_inline_for_each_page_size(void) {
+    uint32_t pageSizes[] = {4096, 16384, 65536};
+    uint8_t row[1024];
+    for (uint8_t i = 0; i < sizeof(pageSizes) / sizeof(pageSizes[0]); i++) {
+        initState(pageSizes[i], 600, EMBEDDB_RESET_DATA);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+        TEST_ASSERT_EQUAL_UINT16_MESSAGE(604 + sizeof(varaddr_t), state->recordSize, "Wrong record size for a wide record");
+        uint32_t numRecords = state->maxRecordsPerPage * 3 + 5;
+        for (uint32_t key = 0; key < numRecords; key++) {
+            makeRow(row, key, state->dataSize);
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, row), "embedDBPut did not insert a wide record");
+        }
+        checkWideRows(numRecords);
+
+        embedDBFlush(state);
+        reopenState(0);
+        checkWideRows(numRecords);
+        embedDBClose(state);
+        freeState();
+    }
+}
+
+void records_past_the_first_127_of_a_page_should_be_found(void) {
+    initState(4096, 4, EMBEDDB_RESET_DATA);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(127, state->maxRecordsPerPage, "A 4 KB page should hold more than 127 small records");
+    uint32_t numRecords = state->maxRecordsPerPage * 2 + 200;
+    char varData[16];
+    for (uint32_t key = 0; key < numRecords; key++) {
+        snprintf(varData, sizeof(varData), "row %lu", (unsigned long)key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, varData, strlen(varData) + 1), "embedDBPutVar did not insert the record");
+    }
+
+    /* The last key of each page and keys in the write buffer */
+    uint32_t keys[] = {200, (uint32_t)state->maxRecordsPerPage - 1, (uint32_t)state->maxRecordsPerPage + 300, numRecords - 1};
+    for (uint8_t j = 0; j < 2; j++) {
+        for (uint8_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+            uint32_t key = keys[i], data = 0;
+            char expected[16], actual[16];
+            embedDBVarDataStream stream;
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &stream), "embedDBGetVarInto did not find the record");
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(key, data, "embedDBGetVarInto returned the wrong data");
+            snprintf(expected, sizeof(expected), "row %lu", (unsigned long)key);
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(strlen(expected) + 1, embedDBVarDataStreamRead(state, &stream, actual, sizeof(actual)), "Wrong variable data length");
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(expected, actual, "embedDBGetVarInto returned another record's variable data");
+        }
+        /* Recovery must count the records on full pages */
+        embedDBFlush(state);
+        pgid_t nextDataPageId = state->nextDataPageId;
+        reopenState(0);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextDataPageId, state->nextDataPageId, "Recovery did not find every data page");
+    }
+}
+
+void compressed_var_data_should_use_codec_sized_blocks(void) {
+    initState(65536, 4, EMBEDDB_RESET_DATA | EMBEDDB_COMPRESS_VDATA);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+    static uint8_t blob[100000], actual[100000];
+    for (uint32_t i = 0; i < sizeof(blob); i++)
+        blob[i] = (uint8_t)(i / 64 + (i % 7 == 0 ? i : 0));
+    uint32_t key = 1;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, blob, sizeof(blob)), "embedDBPutVar did not insert the record");
+    embedDBFlush(state);
+
+    uint32_t data = 0;
+    embedDBVarDataStream stream;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &stream), "embedDBGetVarInto did not find the record");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(blob), stream.totalBytes, "Wrong variable data length");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(blob), embedDBVarDataStreamRead(state, &stream, actual, sizeof(actual)), "Did not read all of the compressed data");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(blob, actual, sizeof(blob), "Compressed data did not round trip");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBVarDataStreamSeek(state, &stream, 70000), "Could not seek into the third block");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1000, embedDBVarDataStreamRead(state, &stream, actual, 1000), "Did not read after the seek");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(blob + 70000, actual, 1000, "Wrong data after the seek");
+}
+
+void embedDBInit_should_reject_unsupported_page_sizes(void) {
+    initState(131072, 4, EMBEDDB_RESET_DATA);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "Pages over 64 KB should be rejected");
+    freeState();
+    initState(512, 600, EMBEDDB_RESET_DATA);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "A record larger than a page should be rejected");
+    freeState();
+#if !defined(EMBEDDB_64BIT_PAGE_IDS)
+    initState(65536, 4, EMBEDDB_RESET_DATA);
+    state->numVarPages = 65536;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "A variable data file of 4 GB should be rejected");
+    freeState();
+#endif
+}
+
+void embedDBInit_should_reject_sizes_that_overflow_16_bits(void) {
+    initState(512, 65534, EMBEDDB_RESET_DATA);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "A record size over 65535 bytes should be rejected");
+    freeState();
+    /* The max and min values take twice the key and data size in the header */
+    initState(65536, 32760, EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "A header size over 65535 bytes should be rejected");
+    freeState();
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(wide_records_should_be_stored_inline_for_each_page_size);
+    RUN_TEST(records_past_the_first_127_of_a_page_should_be_found);
+    RUN_TEST(compressed_var_data_should_use_codec_sized_blocks);
+    RUN_TEST(embedDBInit_should_reject_unsupported_page_sizes);
+    RUN_TEST(embedDBInit_should_reject_sizes_that_overflow_16_bits);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,301 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_write_batch.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB writing data pages in erase block sized batches.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+
+embedDBState *state;
+embedDBFileInterface *fileInterface;
+uint32_t numPageWrites = 0;
+uint32_t numBatchWrites = 0;
+uint32_t numBatchPages = 0;
+
+bool countingWrite(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    numPageWrites++;
+    return fileInterface->write(buffer, pageNum, pageSize, file);
+}
+
+bool countingWritePages(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+    numBatchWrites++;
+    numBatchPages += numPages;
+    return fileInterface->writePages(buffer, pageNum, numPages, pageSize, file);
+}
+
+int8_t setupEmbedDB(uint32_t parameters, count_t writeBatchPages, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->buffer = malloc(state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->eraseSizeInPages = 4;
+    state->numSplinePoints = 64;
+    state->writeBatchPages = writeBatchPages;
+    state->parameters = parameters;
+
+    /* Count writes on a copy of the file interface */
+    fileInterface = getFileInterface();
+    state->fileInterface = (embedDBFileInterface *)malloc(sizeof(embedDBFileInterface));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->fileInterface, "Failed to allocate file interface.");
+    memcpy(state->fileInterface, fileInterface, sizeof(embedDBFileInterface));
+    state->fileInterface->write = countingWrite;
+    state->fileInterface->writePages = countingWritePages;
+
+    char dataPath[] = DATA_PATH;
+    state->dataFile = setupFile(dataPath);
+
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    numPageWrites = 0;
+    numBatchWrites = 0;
+    numBatchPages = 0;
+    return embedDBInit(state, 1);
+}
+
+void setUp(void) {
+    int8_t result = setupEmbedDB(EMBEDDB_BATCH_WRITES | EMBEDDB_RESET_DATA, 4, 1000);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDown(void) {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(fileInterface);
+    free(state);
+}
+
+void insertRecords(uint32_t first, uint32_t count) {
+    for (uint32_t key = first; key < first + count; key++) {
+        uint32_t data = key % 100;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert the record.");
+    }
+}
+
+void checkRecords(uint32_t first, uint32_t count) {
+    uint32_t data = 0;
+    for (uint32_t key = first; key < first + count; key++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGet returned the wrong data.");
+    }
+}
+
+void embedDBInit_should_reject_batch_not_dividing_erase_size() {
+    tearDown();
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, setupEmbedDB(EMBEDDB_BATCH_WRITES | EMBEDDB_RESET_DATA, 3, 1000), "embedDBInit accepted a batch of 3 pages with 4 page erase blocks.");
+    free(state->buffer);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(fileInterface);
+    free(state);
+    setupEmbedDB(EMBEDDB_BATCH_WRITES | EMBEDDB_RESET_DATA, 4, 1000);
+}
+
+void embedDBGet_should_find_records_in_write_batch() {
+    /* Three full pages sit in the batch and one partial page in the write buffer */
+    uint32_t numRecords = state->maxRecordsPerPage * 3 + 5;
+    insertRecords(1, numRecords);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, numPageWrites + numBatchWrites, "Data pages were written before the batch filled.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, state->writeBatchCount, "The batch did not hold the full pages.");
+    checkRecords(1, numRecords);
+
+    embedDBIterator it;
+    uint32_t minKey = 10, key = 0, data = 0, count = 0;
+    it.minKey = &minKey;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(minKey + count, key, "embedDBNext returned the wrong key.");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords - minKey + 1, count, "embedDBNext did not return every record.");
+}
+
+void embedDBPut_should_write_full_batch_at_once() {
+    insertRecords(1, state->maxRecordsPerPage * 8 + 1);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, numPageWrites, "Data pages were written one at a time.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, numBatchWrites, "The batches were not written with one write each.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(8, numBatchPages, "The batches did not hold four pages each.");
+    checkRecords(1, state->maxRecordsPerPage * 8 + 1);
+}
+
+void embedDBPut_should_write_smaller_batches() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_BATCH_WRITES | EMBEDDB_RESET_DATA, 2, 1000);
+    insertRecords(1, state->maxRecordsPerPage * 8 + 1);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, numBatchWrites, "Two page batches were not written with one write each.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(8, numBatchPages, "The batches did not hold two pages each.");
+}
+
+void embedDBFlush_should_write_partial_batch() {
+    uint32_t numRecords = state->maxRecordsPerPage * 2 + 7;
+    insertRecords(1, numRecords);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, numBatchWrites, "embedDBFlush did not write the batch with one write.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, numBatchPages, "embedDBFlush did not write the partial page with the batch.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->writeBatchCount, "embedDBFlush did not empty the batch.");
+
+    /* Pages after the flush still end on batch boundaries */
+    insertRecords(numRecords + 1, state->maxRecordsPerPage * 2);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, numBatchWrites, "The batch after the flush was not written at the batch boundary.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, numBatchPages, "The batch after the flush did not end at the batch boundary.");
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed.");
+    tearDown();
+    setupEmbedDB(EMBEDDB_BATCH_WRITES, 4, 1000);
+    checkRecords(1, numRecords + state->maxRecordsPerPage * 2);
+}
+
+void embedDBPut_should_write_pages_singly_without_writePages() {
+    state->fileInterface->writePages = NULL;
+    insertRecords(1, state->maxRecordsPerPage * 4 + 1);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, numPageWrites, "The batch was not written page by page.");
+    checkRecords(1, state->maxRecordsPerPage * 4 + 1);
+}
+
+void embedDBPut_should_batch_when_wrapping() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_BATCH_WRITES | EMBEDDB_RESET_DATA, 4, 16);
+    uint32_t numRecords = state->maxRecordsPerPage * 42 + 3;
+    insertRecords(1, numRecords);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, numPageWrites, "Data pages were written one at a time.");
+    uint32_t firstKey = state->minDataPageId * state->maxRecordsPerPage + 1;
+    checkRecords(firstKey, numRecords - firstKey + 1);
+}
+
+void embedDBClose_should_write_partial_batch() {
+    insertRecords(1, state->maxRecordsPerPage * 3 + 1);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, numBatchWrites, "The batch was written before it filled.");
+    tearDown();
+    setupEmbedDB(EMBEDDB_BATCH_WRITES, 4, 1000);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, state->nextDataPageId, "embedDBClose did not write the pages in the batch.");
+    checkRecords(1, state->maxRecordsPerPage * 3);
+}
+
+typedef struct {
+    uint32_t next;
+    uint32_t last;
+} keyCounter;
+
+int8_t readKeys(void *context, void *key, void *data) {
+    keyCounter *counter = (keyCounter *)context;
+    if (counter->next > counter->last)
+        return 0;
+    uint32_t value = counter->next % 100;
+    memcpy(key, &counter->next, sizeof(uint32_t));
+    memcpy(data, &value, sizeof(uint32_t));
+    counter->next++;
+    return 1;
+}
+
+void embedDBBulkLoad_should_use_write_batch() {
+    insertRecords(1, state->maxRecordsPerPage * 2);
+    keyCounter counter = {state->maxRecordsPerPage * 2u + 1, state->maxRecordsPerPage * 11u};
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBBulkLoad(state, readKeys, &counter), "embedDBBulkLoad failed.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, numPageWrites, "Data pages were written one at a time.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, numBatchWrites, "The loaded pages did not go through the write batch.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, state->writeBatchCount, "The last loaded pages were not left in the batch.");
+    checkRecords(1, state->maxRecordsPerPage * 11);
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBInit_should_reject_batch_not_dividing_erase_size);
+    RUN_TEST(embedDBGet_should_find_records_in_write_batch);
+    RUN_TEST(embedDBPut_should_write_full_batch_at_once);
+    RUN_TEST(embedDBPut_should_write_smaller_batches);
+    RUN_TEST(embedDBFlush_should_write_partial_batch);
+    RUN_TEST(embedDBPut_should_write_pages_singly_without_writePages);
+    RUN_TEST(embedDBPut_should_batch_when_wrapping);
+    RUN_TEST(embedDBClose_should_write_partial_batch);
+    RUN_TEST(embedDBBulkLoad_should_use_write_batch);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
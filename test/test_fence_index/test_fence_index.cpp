@@ -0,0 +1,276 @@
+/******************************************************************************/
+/**
+ * @file        test_fence_index.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the exact fence index over data page min keys.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setupEmbedDB(uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 2;
+    state->buffer = malloc(state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->eraseSizeInPages = 4;
+    state->parameters = EMBEDDB_USE_FENCE_INDEX | EMBEDDB_RESET_DATA;
+
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_PATH;
+    state->dataFile = setupFile(dataPath);
+
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp(void) {
+    setupEmbedDB(1000);
+}
+
+void tearDown(void) {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void insertRecords(uint32_t numRecords, uint32_t keyStep) {
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = i * keyStep;
+        int8_t result = embedDBPut(state, &key, &i);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data (returned non-zero code)");
+    }
+}
+
+void fenceIndexFind_should_return_last_page_starting_at_or_before_key() {
+    fenceIndex fence;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, fenceIndexInit(&fence, 1000, 8), "fenceIndexInit failed.");
+
+    /* Page min keys with a mix of regular and irregular gaps */
+    uint64_t keys[1000];
+    uint64_t key = 1000;
+    for (pgid_t i = 0; i < 1000; i++) {
+        key += (i % 10 == 0) ? 100000 + i * 7 : 100;
+        keys[i] = key;
+        fenceIndexAdd(&fence, &key, i);
+    }
+
+    pgid_t pageId = 0;
+    for (pgid_t i = 0; i < 1000; i++) {
+        TEST_ASSERT_EQUAL_INT8(0, fenceIndexFind(&fence, &keys[i], &pageId));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, pageId, "fenceIndexFind did not return the page starting with the key.");
+        key = keys[i] + 1;
+        TEST_ASSERT_EQUAL_INT8(0, fenceIndexFind(&fence, &key, &pageId));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, pageId, "fenceIndexFind did not return the page containing the key.");
+    }
+
+    key = 999;
+    TEST_ASSERT_NOT_EQUAL_INT8_MESSAGE(0, fenceIndexFind(&fence, &key, &pageId), "fenceIndexFind found a key smaller than every page.");
+    fenceIndexClose(&fence);
+}
+
+void fenceIndex_should_compress_regular_keys() {
+    fenceIndex fence;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, fenceIndexInit(&fence, 10000, 8), "fenceIndexInit failed.");
+    for (pgid_t i = 0; i < 10000; i++) {
+        uint64_t key = 1700000000000 + (uint64_t)i * 63000 + i % 3;
+        fenceIndexAdd(&fence, &key, i);
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(10000, fence.count, "Fence index dropped pages while under its memory budget.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(2000000, fenceIndexBytesPerMillionPages(&fence), "Fence index used more than two bytes per page for regular keys.");
+    fenceIndexClose(&fence);
+}
+
+void fenceIndexTrim_should_drop_whole_blocks_before_min_page() {
+    fenceIndex fence;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, fenceIndexInit(&fence, 1000, 4), "fenceIndexInit failed.");
+    for (uint32_t i = 0; i < 1000; i++) {
+        uint32_t key = i * 50;
+        fenceIndexAdd(&fence, &key, i);
+    }
+    fenceIndexTrim(&fence, 100);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(96, fenceIndexFirstPage(&fence), "fenceIndexTrim did not drop the blocks before the min page.");
+
+    pgid_t pageId = 0;
+    uint32_t key = 4799;
+    TEST_ASSERT_NOT_EQUAL_INT8_MESSAGE(0, fenceIndexFind(&fence, &key, &pageId), "fenceIndexFind returned a trimmed page.");
+    key = 4800;
+    TEST_ASSERT_EQUAL_INT8(0, fenceIndexFind(&fence, &key, &pageId));
+    TEST_ASSERT_EQUAL_UINT32(96, pageId);
+    fenceIndexClose(&fence);
+}
+
+void embedDBGet_should_read_one_page_per_query() {
+    uint32_t numRecords = 20000;
+    insertRecords(numRecords, 10);
+    embedDBResetStats(state);
+
+    uint32_t data = 0, numQueries = 0;
+    for (uint32_t i = 0; i < numRecords; i += 97) {
+        uint32_t key = i * 10;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data.");
+        numQueries++;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(numQueries, state->numReads, "embedDBGet read more than one page per query.");
+
+    uint32_t key = 15;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was never inserted.");
+}
+
+void embedDBGet_should_find_records_after_data_wraps() {
+    tearDown();
+    setupEmbedDB(64);
+    uint32_t numRecords = 10000;
+    insertRecords(numRecords, 3);
+    embedDBFlush(state);
+
+    uint32_t data = 0;
+    uint32_t minKey = (state->minDataPageId * state->maxRecordsPerPage) * 3;
+    for (uint32_t key = minKey; key < numRecords * 3; key += 3) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a key after the data wrapped.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key / 3, data, "embedDBGet returned the wrong data.");
+    }
+
+    uint32_t key = minKey - 3;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was overwritten.");
+}
+
+void embedDBGet_should_fall_back_when_pages_are_not_indexed() {
+    /* Erratic key gaps do not compress, so the oldest pages are dropped from the index */
+    uint32_t key = 0, data = 0;
+    for (uint32_t i = 0; i < 40000; i++) {
+        key += 1 + (i * 2654435761u) % 100000 / 1000;
+        key += (i % 63 == 0) ? (i * 2654435761u) % 8000000 : 0;
+        embedDBPut(state, &key, &i);
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(state->minDataPageId, fenceIndexFirstPage(state->fence), "Fence index did not overflow its memory budget.");
+
+    key = 0;
+    for (uint32_t i = 0; i < 40000; i++) {
+        key += 1 + (i * 2654435761u) % 100000 / 1000;
+        key += (i % 63 == 0) ? (i * 2654435761u) % 8000000 : 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data.");
+    }
+}
+
+void embedDBIterator_should_start_on_page_with_min_key() {
+    insertRecords(20000, 10);
+
+    embedDBIterator it;
+    uint32_t minKey = 150005, maxKey = 150100;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(150010 / 10 / state->maxRecordsPerPage, it.nextDataPage, "embedDBInitIterator did not start on the page containing the min key.");
+
+    uint32_t key = 0, data = 0, expectedKey = 150010;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKey, key, "embedDBNext returned the wrong key.");
+        expectedKey += 10;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(150110, expectedKey, "embedDBNext did not return all keys in the range.");
+    embedDBCloseIterator(&it);
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(fenceIndexFind_should_return_last_page_starting_at_or_before_key);
+    RUN_TEST(fenceIndex_should_compress_regular_keys);
+    RUN_TEST(fenceIndexTrim_should_drop_whole_blocks_before_min_page);
+    RUN_TEST(embedDBGet_should_read_one_page_per_query);
+    RUN_TEST(embedDBGet_should_find_records_after_data_wraps);
+    RUN_TEST(embedDBGet_should_fall_back_when_pages_are_not_indexed);
+    RUN_TEST(embedDBIterator_should_start_on_page_with_min_key);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,327 @@
+/******************************************************************************/
+/**
+ * @file        test_log_file.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test storing all EmbedDB files in a single circular log.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#include "log-file/logFile.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define LOG_FILE_PATH "logFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define LOG_FILE_PATH "build/artifacts/logFile.bin"
+#endif
+
+#include "unity.h"
+
+#define NUM_SLOTS 96
+
+embedDBState *state;
+logFile logState;
+void *logBase;
+embedDBFileInterface *fileInterface;
+embedDBFileInterface *baseInterface;
+uint32_t numSlotWrites = 0;
+uint32_t numTagWrites = 0;
+uint32_t lastSlot = 0;
+uint32_t lastPage = 0;
+bool slotsInOrder = true;
+bool wholePages = true;
+
+/* Slots are grouped with a tag page after each group */
+bool isTagPage(uint32_t pageNum) {
+    uint32_t groupPages = logState.slotsPerGroup + 1;
+    return pageNum % groupPages == logState.slotsPerGroup || pageNum == NUM_SLOTS + (NUM_SLOTS - 1) / logState.slotsPerGroup;
+}
+
+bool countingWrite(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    if (pageSize != logState.pageSize)
+        wholePages = false;
+    lastPage = pageNum;
+    if (isTagPage(pageNum)) {
+        numTagWrites++;
+    } else {
+        uint32_t slot = pageNum - pageNum / (logState.slotsPerGroup + 1);
+        if (numSlotWrites > 0 && slot != (lastSlot + 1) % NUM_SLOTS)
+            slotsInOrder = false;
+        numSlotWrites++;
+        lastSlot = slot;
+    }
+    return fileInterface->write(buffer, pageNum, pageSize, file);
+}
+
+void setupEmbedDBWithPages(uint32_t parameters, uint32_t numDataPages, uint32_t numVarPages) {
+    /* The log is sized for the most pages each stream may have after rebalancing */
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, logFileInit(&logState, baseInterface, logBase, 512, 32, 8, 16, NUM_SLOTS), "logFileInit failed.");
+
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 6;
+    state->numSplinePoints = 16;
+    state->buffer = calloc(1, state->pageSize * state->bufferSizeInBlocks);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate EmbedDB buffer.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 8;
+    state->numVarPages = numVarPages;
+    state->eraseSizeInPages = 4;
+    state->bitmapSize = 1;
+    state->parameters = parameters;
+
+    /* All three files are streams of the same log */
+    state->fileInterface = getLogFileInterface();
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->fileInterface, "Failed to allocate file interface.");
+    state->dataFile = logFileGetStream(&logState, LOG_FILE_DATA);
+    state->indexFile = logFileGetStream(&logState, LOG_FILE_INDEX);
+    state->varFile = logFileGetStream(&logState, LOG_FILE_VAR);
+
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setupEmbedDB(uint32_t parameters) {
+    setupEmbedDBWithPages(parameters, 16, 8);
+}
+
+void closeEmbedDB() {
+    embedDBClose(state);
+    logFileClose(&logState);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+void reopenEmbedDB(uint32_t parameters) {
+    closeEmbedDB();
+    setupEmbedDB(parameters);
+}
+
+void setUp(void) {
+    char logPath[] = LOG_FILE_PATH;
+    logBase = setupFile(logPath);
+
+    /* Count writes to the file holding the log */
+    fileInterface = getFileInterface();
+    baseInterface = (embedDBFileInterface *)malloc(sizeof(embedDBFileInterface));
+    TEST_ASSERT_NOT_NULL_MESSAGE(baseInterface, "Failed to allocate file interface.");
+    memcpy(baseInterface, fileInterface, sizeof(embedDBFileInterface));
+    baseInterface->write = countingWrite;
+    numSlotWrites = 0;
+    numTagWrites = 0;
+    slotsInOrder = true;
+    wholePages = true;
+
+    setupEmbedDB(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA);
+}
+
+void tearDown(void) {
+    closeEmbedDB();
+    tearDownFile(logBase);
+    free(baseInterface);
+    free(fileInterface);
+}
+
+void insertRecords(uint32_t first, uint32_t count) {
+    char varData[20];
+    for (uint32_t key = first; key < first + count; key++) {
+        uint32_t data = key % 100;
+        snprintf(varData, sizeof(varData), "Testing %03u...", (unsigned int)(key % 1000));
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, varData, 15), "embedDBPutVar did not insert the record.");
+    }
+}
+
+void assertRecordsFound(uint32_t first, uint32_t count) {
+    char expected[20], varData[20];
+    for (uint32_t key = first; key < first + count; key++) {
+        uint32_t data = 0;
+        embedDBVarDataStream *varStream = NULL;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &data, &varStream), "embedDBGetVar did not find an inserted record.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGetVar returned the wrong fixed data.");
+        TEST_ASSERT_NOT_NULL_MESSAGE(varStream, "embedDBGetVar did not return variable data.");
+        snprintf(expected, sizeof(expected), "Testing %03u...", (unsigned int)(key % 1000));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(15, embedDBVarDataStreamRead(state, varStream, varData, 20), "Variable data was not the right length.");
+        TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(expected, varData, 15, "embedDBGetVar returned the wrong variable data.");
+        free(varStream);
+    }
+}
+
+void logFile_should_append_pages_of_all_streams_in_order() {
+    uint32_t numRecords = state->maxRecordsPerPage * 4;
+    insertRecords(1, numRecords);
+    embedDBFlush(state);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, logState.streamLength[LOG_FILE_DATA], "No data pages were written to the log.");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, logState.streamLength[LOG_FILE_INDEX], "No index pages were written to the log.");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, logState.streamLength[LOG_FILE_VAR], "No variable data pages were written to the log.");
+    TEST_ASSERT_TRUE_MESSAGE(slotsInOrder, "Pages were not appended to consecutive slots.");
+    TEST_ASSERT_TRUE_MESSAGE(wholePages, "The log wrote something other than whole pages.");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, numTagWrites, "No tag pages were written.");
+    assertRecordsFound(1, numRecords);
+}
+
+void logFile_should_recover_all_streams_after_reopen() {
+    uint32_t numRecords = state->maxRecordsPerPage * 2;
+    insertRecords(1, numRecords);
+    embedDBFlush(state);
+    reopenEmbedDB(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA);
+    assertRecordsFound(1, numRecords);
+    insertRecords(numRecords + 1, state->maxRecordsPerPage);
+    embedDBFlush(state);
+    assertRecordsFound(1, numRecords + state->maxRecordsPerPage);
+}
+
+void logFile_should_reuse_slots_when_the_log_wraps() {
+    uint32_t numRecords = state->maxRecordsPerPage * state->numDataPages * 7;
+    for (uint32_t key = 1; key <= numRecords; key++) {
+        uint32_t data = key % 100;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert the record.");
+    }
+    embedDBFlush(state);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(NUM_SLOTS, numSlotWrites, "The log did not wrap.");
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(NUM_SLOTS, lastSlot, "A page was written past the end of the log.");
+    TEST_ASSERT_TRUE_MESSAGE(wholePages, "The log wrote something other than whole pages.");
+
+    uint32_t key = numRecords - 1, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a recent record.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGet returned the wrong data.");
+
+    reopenEmbedDB(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA);
+    data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a recent record after reopening.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(key % 100, data, "embedDBGet returned the wrong data after reopening.");
+}
+
+void logFile_should_not_recover_pages_from_before_a_reset() {
+    uint32_t numRecords = state->maxRecordsPerPage * 4;
+    insertRecords(1, numRecords);
+    embedDBFlush(state);
+    reopenEmbedDB(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA);
+    insertRecords(1, state->maxRecordsPerPage + 1);
+    embedDBFlush(state);
+    reopenEmbedDB(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA);
+
+    assertRecordsFound(1, state->maxRecordsPerPage);
+    uint32_t key = numRecords - 1, data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "A record from before the reset was recovered.");
+}
+
+void logFile_should_reject_other_page_sizes() {
+    int8_t page[1024];
+    memset(page, 0, sizeof(page));
+    uint32_t writes = numSlotWrites;
+    TEST_ASSERT_FALSE_MESSAGE(state->fileInterface->write(page, 0, 1024, state->dataFile), "A page larger than the log's pages was written.");
+    TEST_ASSERT_FALSE_MESSAGE(state->fileInterface->write(page, 0, 256, state->dataFile), "A page smaller than the log's pages was written.");
+    TEST_ASSERT_FALSE_MESSAGE(state->fileInterface->erase(0, 4, 256, state->dataFile), "An erase with another page size was accepted.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(writes, numSlotWrites, "A rejected page reached the log.");
+}
+
+void logFile_should_share_slots_between_streams() {
+    closeEmbedDB();
+    setupEmbedDBWithPages(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA, 32, 8);
+    insertRecords(1, state->maxRecordsPerPage);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRebalance(state, 8), "embedDBRebalance did not move pages to the var stream.");
+
+    /* Fill more var pages than the stream started with */
+    uint32_t numRecords = state->maxRecordsPerPage;
+    while (state->nextVarPageId < 12) {
+        insertRecords(numRecords + 1, 10);
+        numRecords += 10;
+    }
+    embedDBFlush(state);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(8, logState.streamLength[LOG_FILE_VAR], "The var stream did not grow past its first size.");
+    assertRecordsFound(1, numRecords);
+
+    closeEmbedDB();
+    setupEmbedDBWithPages(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA, 24, 16);
+    assertRecordsFound(1, numRecords);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(logFile_should_append_pages_of_all_streams_in_order);
+    RUN_TEST(logFile_should_recover_all_streams_after_reopen);
+    RUN_TEST(logFile_should_reuse_slots_when_the_log_wraps);
+    RUN_TEST(logFile_should_not_recover_pages_from_before_a_reset);
+    RUN_TEST(logFile_should_reject_other_page_sizes);
+    RUN_TEST(logFile_should_share_slots_between_streams);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,273 @@
+/******************************************************************************/
+/**
+ * @file        test_lz_codec.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the LZ codec and compressed variable data.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+typedef struct {
+    const uint8_t *data;
+    uint16_t position;
+} memorySource;
+
+bool readMemoryByte(void *source, uint8_t *byte) {
+    memorySource *memory = (memorySource *)source;
+    *byte = memory->data[memory->position++];
+    return true;
+}
+
+/* A JSON diagnostic line like the ones stored as variable data */
+uint32_t makeLogLine(char *line, uint32_t key) {
+    return (uint32_t)sprintf(line, "{\"id\":%lu,\"sensor\":\"temperature\",\"status\":\"ok\",\"value\":%lu,\"unit\":\"C\"}\n",
+                             (unsigned long)key, (unsigned long)(key * 37 % 1000));
+}
+
+void initState(int8_t bufferSizeInBlocks) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = bufferSizeInBlocks;
+    state->numSplinePoints = 8;
+    state->buffer = calloc(state->bufferSizeInBlocks, state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 1000;
+    state->numIndexPages = 48;
+    state->numVarPages = 1000;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_FILE_PATH, indexPath[] = INDEX_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->indexFile = setupFile(indexPath);
+    state->varFile = setupFile(varPath);
+    state->parameters = EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_COMPRESS_VDATA | EMBEDDB_RESET_DATA;
+    state->bitmapSize = 1;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+}
+
+void freeState() {
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {
+    initState(7);
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDown(void) {
+    embedDBClose(state);
+    freeState();
+}
+
+void lzCompress_should_round_trip_repetitive_data(void) {
+    char text[512];
+    uint16_t length = 0;
+    for (uint32_t i = 0; length + 100u < sizeof(text); i++)
+        length += makeLogLine(text + length, i);
+
+    uint8_t compressed[512], decompressed[512];
+    uint16_t compressedLength = lzCompress((uint8_t *)text, length, compressed, length - 1);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, compressedLength, "lzCompress did not compress repetitive data");
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(length / 2, compressedLength, "lzCompress did not halve repetitive data");
+
+    memorySource source = {compressed, 0};
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(length, lzDecompress(readMemoryByte, &source, compressedLength, decompressed, sizeof(decompressed)), "lzDecompress did not return the original length");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(text, decompressed, length, "lzDecompress did not return the original data");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(compressedLength, source.position, "lzDecompress did not read all of the compressed data");
+}
+
+void lzCompress_should_fail_when_data_does_not_shrink(void) {
+    uint8_t noise[256], compressed[256];
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < sizeof(noise); i++) {
+        seed = seed * 1103515245 + 12345;
+        noise[i] = (uint8_t)(seed >> 16);
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, lzCompress(noise, sizeof(noise), compressed, sizeof(noise) - 1), "lzCompress should not fit random data in fewer bytes");
+}
+
+void embedDBGetVar_should_return_compressed_data(void) {
+    char line[128], buf[128];
+    for (uint32_t key = 0; key < 500; key++) {
+        uint32_t length = makeLogLine(line, key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &key, line, length), "embedDBPutVar did not insert a compressed record");
+    }
+    /* Short lines barely compress, so every record is read back through the codec path */
+    embedDBVarDataStream varStream;
+    for (uint32_t key = 0; key < 500; key += 7) {
+        uint32_t length = makeLogLine(line, key), data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &varStream), "embedDBGetVarInto did not find the record");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(length, varStream.totalBytes, "Stream length was not the uncompressed length");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(length, embedDBVarDataStreamRead(state, &varStream, buf, sizeof(buf)), "Returned vardata was not the right length");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(line, buf, length, "Returned vardata was not the original data");
+    }
+}
+
+void embedDBPutVar_should_use_fewer_pages_for_compressible_data(void) {
+    static char blob[4000], buf[4000];
+    uint32_t length = 0;
+    for (uint32_t i = 0; length + 100 < sizeof(blob); i++)
+        length += makeLogLine(blob + length, i);
+    uint32_t key = 1, data = 1;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, blob, length), "embedDBPutVar did not insert the blob");
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(length / state->pageSize / 2, state->nextVarPageId, "Compressed blob should fill less than half as many pages");
+
+    /* Read in uneven chunks across block boundaries */
+    embedDBVarDataStream varStream;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &varStream), "embedDBGetVarInto did not find the blob");
+    uint32_t amtRead = 0, bytesRead = 0;
+    while ((bytesRead = embedDBVarDataStreamRead(state, &varStream, buf + amtRead, 333)) > 0)
+        amtRead += bytesRead;
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(length, amtRead, "Returned blob was not the right length");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(blob, buf, length, "Returned blob was not the original data");
+
+    /* Seek within and across blocks */
+    uint32_t offsets[] = {3000, 10, 511, 512, 1500, length - 5};
+    for (uint32_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBVarDataStreamSeek(state, &varStream, offsets[i]), "embedDBVarDataStreamSeek did not seek in the compressed blob");
+        uint32_t expectedLength = length - offsets[i] < 100 ? length - offsets[i] : 100;
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedLength, embedDBVarDataStreamRead(state, &varStream, buf, 100), "Read after seeking was not the right length");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(blob + offsets[i], buf, expectedLength, "Read after seeking did not return the data at the offset");
+    }
+}
+
+void embedDBVarDataStreamRead_should_interleave_compressed_streams(void) {
+    static char first[2000], second[2000];
+    uint32_t firstLength = 0, secondLength = 0;
+    for (uint32_t i = 0; firstLength + 100 < sizeof(first); i++)
+        firstLength += makeLogLine(first + firstLength, i);
+    for (uint32_t i = 1000; secondLength + 100 < sizeof(second); i++)
+        secondLength += makeLogLine(second + secondLength, i);
+    uint32_t key = 1, data = 1;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, first, firstLength), "embedDBPutVar did not insert the first blob");
+    key = 2;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, second, secondLength), "embedDBPutVar did not insert the second blob");
+
+    embedDBVarDataStream firstStream, secondStream;
+    key = 1;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &firstStream), "embedDBGetVarInto did not find the first blob");
+    key = 2;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVarInto(state, &key, &data, &secondStream), "embedDBGetVarInto did not find the second blob");
+    char buf[300];
+    for (uint32_t offset = 0; offset + sizeof(buf) <= firstLength && offset + sizeof(buf) <= secondLength; offset += sizeof(buf)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(buf), embedDBVarDataStreamRead(state, &firstStream, buf, sizeof(buf)), "First stream did not return a full buffer");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(first + offset, buf, sizeof(buf), "First stream did not return the right data");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(buf), embedDBVarDataStreamRead(state, &secondStream, buf, sizeof(buf)), "Second stream did not return a full buffer");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(second + offset, buf, sizeof(buf), "Second stream did not return the right data");
+    }
+}
+
+void embedDBInit_should_require_codec_buffer(void) {
+    tearDown();
+    initState(6);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "embedDBInit should need a page buffer for the codec");
+    freeState();
+    setUp();
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(lzCompress_should_round_trip_repetitive_data);
+    RUN_TEST(lzCompress_should_fail_when_data_does_not_shrink);
+    RUN_TEST(embedDBGetVar_should_return_compressed_data);
+    RUN_TEST(embedDBPutVar_should_use_fewer_pages_for_compressible_data);
+    RUN_TEST(embedDBVarDataStreamRead_should_interleave_compressed_streams);
+    RUN_TEST(embedDBInit_should_require_codec_buffer);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,275 @@
+/******************************************************************************/
+/**
+ * @file        test_page_model.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the learned model stored in each data page header.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+uint32_t numComparisons = 0;
+
+int8_t countingInt64Comparator(void *a, void *b) {
+    numComparisons++;
+    return int64Comparator(a, b);
+}
+
+void setupEmbedDB(uint32_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 8;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->buffer = malloc(state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 1000;
+    state->numIndexPages = 8;
+    state->eraseSizeInPages = 4;
+    state->bitmapSize = 1;
+    state->numSplinePoints = 64;
+    state->parameters = parameters;
+
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_PATH;
+    state->dataFile = setupFile(dataPath);
+    if (EMBEDDB_USING_INDEX(parameters)) {
+        char indexPath[] = "build/artifacts/indexFile.bin";
+        state->indexFile = setupFile(indexPath);
+    }
+
+    state->compareKey = countingInt64Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp(void) {
+    setupEmbedDB(EMBEDDB_USE_PAGE_MODEL | EMBEDDB_RESET_DATA);
+}
+
+void tearDown(void) {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+uint64_t irregularKey(uint32_t i) {
+    /* Timestamps with jitter and an occasional long gap */
+    return 1700000000000 + (uint64_t)i * 1000 + (i * 2654435761u) % 300 + (i / 500) * 250000;
+}
+
+void embedDBGet_should_find_every_record_using_page_model() {
+    for (uint32_t i = 0; i < 10000; i++) {
+        uint64_t key = irregularKey(i);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &i), "embedDBPut did not correctly insert data.");
+    }
+
+    uint32_t data = 0;
+    for (uint32_t i = 0; i < 10000; i++) {
+        uint64_t key = irregularKey(i);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data.");
+        key++;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was never inserted.");
+    }
+}
+
+void embedDBPut_should_store_page_model_with_small_error() {
+    for (uint32_t i = 0; i < 2000; i++) {
+        uint64_t key = 5000 + (uint64_t)i * 10 + i % 2;
+        embedDBPut(state, &key, &i);
+    }
+
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, readPage(state, 3), "Unable to read data page.");
+    float slope = 0;
+    uint16_t maxError = 0;
+    memcpy(&slope, EMBEDDB_GET_PAGE_MODEL(buffer, state), sizeof(float));
+    memcpy(&maxError, (int8_t *)EMBEDDB_GET_PAGE_MODEL(buffer, state) + 2 * sizeof(float), sizeof(uint16_t));
+    TEST_ASSERT_TRUE_MESSAGE(slope > 0.09 && slope < 0.11, "Page model slope does not match the key spacing.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(1, maxError, "Page model error is too large for evenly spaced keys.");
+}
+
+void embedDBGet_should_probe_few_records_on_page() {
+    /* The fence index locates pages without comparing keys, so only in-page comparisons are counted */
+    tearDown();
+    setupEmbedDB(EMBEDDB_USE_PAGE_MODEL | EMBEDDB_USE_FENCE_INDEX | EMBEDDB_RESET_DATA);
+
+    /* Keys that grow quadratically are not evenly spaced within a page */
+    for (uint32_t i = 0; i < 5000; i++) {
+        uint64_t key = (uint64_t)i * i / 3 + i;
+        embedDBPut(state, &key, &i);
+    }
+
+    uint32_t data = 0, numQueries = 0;
+    numComparisons = 0;
+    for (uint32_t i = 0; i < 4900; i++) {
+        uint64_t key = (uint64_t)i * i / 3 + i;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data.");
+        numQueries++;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(3 * numQueries, numComparisons, "Page model search used too many comparisons.");
+}
+
+void embedDBGet_should_use_page_model_with_bitmap_and_max_min() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_USE_PAGE_MODEL | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_MAX_MIN | EMBEDDB_RESET_DATA);
+    for (uint32_t i = 0; i < 3000; i++) {
+        uint64_t key = irregularKey(i);
+        embedDBPut(state, &key, &i);
+    }
+
+    uint32_t data = 0;
+    for (uint32_t i = 0; i < 3000; i++) {
+        uint64_t key = irregularKey(i);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data.");
+    }
+}
+
+void embedDBGet_should_use_page_model_after_recovery() {
+    for (uint32_t i = 0; i < 3000; i++) {
+        uint64_t key = irregularKey(i);
+        embedDBPut(state, &key, &i);
+    }
+    embedDBFlush(state);
+    tearDown();
+    setupEmbedDB(EMBEDDB_USE_PAGE_MODEL);
+
+    uint32_t data = 0;
+    for (uint32_t i = 0; i < 3000; i++) {
+        uint64_t key = irregularKey(i);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet was unable to find a key after recovery.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, data, "embedDBGet returned the wrong data after recovery.");
+    }
+}
+
+int8_t *recordsStart = NULL, *recordsEnd = NULL;
+
+int8_t boundedInt64Comparator(void *a, void *b) {
+    if ((int8_t *)a >= recordsStart && (int8_t *)a < recordsStart + 512)
+        TEST_ASSERT_TRUE_MESSAGE((int8_t *)a < recordsEnd, "The search compared a key past the records on the page.");
+    return int64Comparator(a, b);
+}
+
+void embedDBGet_should_stay_within_records_with_mismatched_model() {
+    for (uint32_t i = 0; i < 20; i++) {
+        uint64_t key = (uint64_t)i * 10;
+        embedDBPut(state, &key, &i);
+    }
+
+    /* A model from a different set of records estimates far past these ones */
+    float slope = 1000, intercept = 0;
+    uint16_t maxError = 0;
+    int8_t *model = (int8_t *)EMBEDDB_GET_PAGE_MODEL(state->buffer, state);
+    memcpy(model, &slope, sizeof(float));
+    memcpy(model + sizeof(float), &intercept, sizeof(float));
+    memcpy(model + 2 * sizeof(float), &maxError, sizeof(uint16_t));
+    recordsStart = (int8_t *)state->buffer;
+    recordsEnd = (int8_t *)state->buffer + state->headerSize + 20 * state->recordSize;
+    state->compareKey = boundedInt64Comparator;
+
+    uint32_t data = 0;
+    for (uint64_t key = 0; key < 400; key += 5)
+        embedDBGet(state, &key, &data);
+    state->compareKey = countingInt64Comparator;
+}
+
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBGet_should_find_every_record_using_page_model);
+    RUN_TEST(embedDBPut_should_store_page_model_with_small_error);
+    RUN_TEST(embedDBGet_should_probe_few_records_on_page);
+    RUN_TEST(embedDBGet_should_use_page_model_with_bitmap_and_max_min);
+    RUN_TEST(embedDBGet_should_use_page_model_after_recovery);
+    RUN_TEST(embedDBGet_should_stay_within_records_with_mismatched_model);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
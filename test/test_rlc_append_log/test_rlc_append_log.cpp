@@ -0,0 +1,221 @@
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+/* On the desktop platform, there is a file interface which simulates "erasing" by writing out all 1's to the location in the file ot be erased */
+#define MOCK_ERASE_INTERFACE
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+embedDBFileInterface *baseInterface;
+uint32_t numByteWrites = 0, bytesWritten = 0;
+
+bool countingWriteBytes(void *buffer, uint32_t pageNum, uint32_t offset, uint32_t length, uint32_t pageSize, void *file) {
+    numByteWrites++;
+    bytesWritten += length;
+    return baseInterface->writeBytes(buffer, pageNum, offset, length, pageSize, file);
+}
+
+void setupEmbedDB(uint32_t parameters, uint32_t commitRecords) {
+    /* The setup below will result in having 42 records per page and 36 log entries per log page */
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 8;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+
+/* configure EmbedDB storage */
+#ifdef MOCK_ERASE_INTERFACE
+    baseInterface = getMockEraseFileInterface();
+#else
+    baseInterface = getFileInterface();
+#endif
+    state->fileInterface = (embedDBFileInterface *)malloc(sizeof(embedDBFileInterface));
+    *state->fileInterface = *baseInterface;
+    state->fileInterface->writeBytes = countingWriteBytes;
+
+    char dataPath[] = DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+
+    state->numDataPages = 32;
+    state->eraseSizeInPages = 4;
+    state->parameters = parameters | EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_APPEND_LOG;
+    state->rlcCommitRecords = commitRecords;
+    state->rlcCommitIntervalMs = 0;
+    state->compareKey = int32Comparator;
+    state->compareData = int64Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp() {
+    setupEmbedDB(EMBEDDB_RESET_DATA, 0);
+}
+
+void tearDown() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(baseInterface);
+    free(state);
+}
+
+void insertRecords(uint32_t startingKey, uint32_t numRecords) {
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = startingKey + i;
+        uint64_t data = key * 3;
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDBPut did not correctly insert data (returned non-zero code)");
+    }
+}
+
+/* Checks that exactly the keys in [firstKey, lastKey) can be found */
+void checkRecords(uint32_t firstKey, uint32_t lastKey) {
+    uint64_t data = 0;
+    char message[100];
+    for (uint32_t key = firstKey; key < lastKey; key++) {
+        snprintf(message, 100, "embedDBGet was unable to fetch the data for key %u.", key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(key * 3, data, "embedDBGet returned the wrong data.");
+    }
+    uint32_t key = lastKey;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet fetched a record that was never logged.");
+}
+
+void record_log_should_write_one_entry_per_record() {
+    numByteWrites = 0;
+    bytesWritten = 0;
+    insertRecords(100, 30);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(30, numByteWrites, "Record log did not make one write per record.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(EMBEDDB_RLC_LOG_HEADER_SIZE + 30 * 14, bytesWritten, "Record log wrote more than one entry per record.");
+}
+
+void embedDBInit_should_replay_record_log_without_permanent_pages() {
+    insertRecords(100, 40);
+    tearDown();
+    setupEmbedDB(0, 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->nextDataPageId, "Recovery wrote a data page.");
+    checkRecords(100, 140);
+
+    /* Inserts continue after the replayed records */
+    insertRecords(140, 10);
+    tearDown();
+    setupEmbedDB(0, 0);
+    checkRecords(100, 150);
+}
+
+void embedDBInit_should_replay_record_log_after_permanent_pages() {
+    insertRecords(100, 42 * 5 + 40);
+    tearDown();
+    setupEmbedDB(0, 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->nextDataPageId, "Recovery did not find the permanent pages.");
+    checkRecords(100, 100 + 42 * 5 + 40);
+}
+
+void embedDBInit_should_replay_record_log_after_wrapping() {
+    insertRecords(100, 2000);
+    tearDown();
+    setupEmbedDB(0, 0);
+    uint32_t key = 2099;
+    uint64_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "Last record was not recovered after wrapping.");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(key * 3, data, "Last record had the wrong data after wrapping.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2000 % 42, EMBEDDB_GET_COUNT(state->buffer), "Recovery did not replay every logged record.");
+
+    insertRecords(2100, 100);
+    tearDown();
+    setupEmbedDB(0, 0);
+    checkRecords(2000, 2200);
+}
+
+void embedDBInit_should_stop_replay_at_torn_entry() {
+    insertRecords(100, 20);
+
+    /* Overwrite the last entry as a partially programmed write would */
+    uint8_t junk[14];
+    memset(junk, 0x5A, sizeof(junk));
+    uint32_t offset = EMBEDDB_RLC_LOG_HEADER_SIZE + (state->rlcLogSlot - 1) * 14;
+    baseInterface->writeBytes(junk, state->nextRLCPhysicalPageLocation, offset, 6, state->pageSize, state->dataFile);
+
+    tearDown();
+    setupEmbedDB(0, 0);
+    checkRecords(100, 119);
+
+    /* The torn page is not appended to again */
+    insertRecords(119, 5);
+    tearDown();
+    setupEmbedDB(0, 0);
+    checkRecords(100, 124);
+}
+
+void record_log_should_batch_entries_with_group_commit() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA, 8);
+    numByteWrites = 0;
+    insertRecords(100, 40);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(6, numByteWrites, "Group commit did not append each group in one write per log page.");
+    tearDown();
+    setupEmbedDB(EMBEDDB_RLC_GROUP_COMMIT, 8);
+    checkRecords(100, 140);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(record_log_should_write_one_entry_per_record);
+    RUN_TEST(embedDBInit_should_replay_record_log_without_permanent_pages);
+    RUN_TEST(embedDBInit_should_replay_record_log_after_permanent_pages);
+    RUN_TEST(embedDBInit_should_replay_record_log_after_wrapping);
+    RUN_TEST(embedDBInit_should_stop_replay_at_torn_entry);
+    RUN_TEST(record_log_should_batch_entries_with_group_commit);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
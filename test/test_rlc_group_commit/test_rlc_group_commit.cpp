@@ -0,0 +1,227 @@
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+/* On the desktop platform, there is a file interface which simulates "erasing" by writing out all 1's to the location in the file ot be erased */
+#define MOCK_ERASE_INTERFACE
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+uint32_t fakeTimeMs = 0;
+
+uint32_t getFakeTimeMs(void) {
+    return fakeTimeMs;
+}
+
+void setupEmbedDB(uint32_t parameters, uint32_t commitRecords, uint32_t commitIntervalMs) {
+    /* The setup below will result in having 42 records per page */
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 8;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+
+/* configure EmbedDB storage */
+#ifdef MOCK_ERASE_INTERFACE
+    state->fileInterface = getMockEraseFileInterface();
+#else
+    state->fileInterface = getFileInterface();
+#endif
+
+    char dataPath[] = DATA_FILE_PATH;
+
+    state->dataFile = setupFile(dataPath);
+
+    state->numDataPages = 32;
+    state->eraseSizeInPages = 4;
+    state->parameters = parameters;
+    state->rlcCommitRecords = commitRecords;
+    state->rlcCommitIntervalMs = commitIntervalMs;
+    state->getTimeMs = getFakeTimeMs;
+    state->compareKey = int32Comparator;
+    state->compareData = int64Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp() {
+    fakeTimeMs = 0;
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA, 4, 0);
+}
+
+void tearDown() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void insertRecords(uint32_t startingKey, uint32_t numRecords) {
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = startingKey + i;
+        uint64_t data = key * 2;
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDBPut did not correctly insert data (returned non-zero code)");
+    }
+}
+
+/* Closes EmbedDB and recovers it from storage */
+void recover(uint32_t commitRecords, uint32_t commitIntervalMs) {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT, commitRecords, commitIntervalMs);
+}
+
+/* Checks that exactly the keys in [startingKey, startingKey + numRecords) can be found */
+void checkRecovered(uint32_t startingKey, uint32_t numRecords) {
+    uint64_t data = 0;
+    char message[100];
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = startingKey + i;
+        snprintf(message, 100, "embedDBGet was unable to fetch the data for key %u.", key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(key * 2, data, "embedDBGet returned the wrong data.");
+    }
+    uint32_t key = startingKey + numRecords;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet fetched a record that was never committed.");
+}
+
+void group_commit_should_write_one_temporary_page_per_group() {
+    insertRecords(100, 10);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(6, state->nextRLCPhysicalPageLocation, "Group commit did not write one temporary page per four records.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, state->rlcPendingRecords, "Group commit did not count the uncommitted records.");
+
+    /* Uncommitted records are still visible before a reset */
+    checkRecovered(100, 10);
+
+    recover(4, 0);
+    checkRecovered(100, 8);
+}
+
+void embedDBCommit_should_make_pending_records_durable() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA, 0, 0);
+    insertRecords(100, 12);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->nextRLCPhysicalPageLocation, "Records were committed without a call to embedDBCommit.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBCommit(state), "embedDBCommit failed.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->nextRLCPhysicalPageLocation, "embedDBCommit did not write one temporary page.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBCommit(state), "embedDBCommit failed with nothing to commit.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->nextRLCPhysicalPageLocation, "embedDBCommit wrote a page with nothing to commit.");
+
+    recover(0, 0);
+    checkRecovered(100, 12);
+}
+
+void group_commit_should_commit_after_interval() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA, 0, 100);
+    insertRecords(100, 5);
+    fakeTimeMs = 99;
+    insertRecords(105, 1);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->nextRLCPhysicalPageLocation, "Records were committed before the interval passed.");
+    fakeTimeMs = 100;
+    insertRecords(106, 1);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->nextRLCPhysicalPageLocation, "Records were not committed once the interval passed.");
+    fakeTimeMs = 150;
+    insertRecords(107, 1);
+
+    recover(0, 100);
+    checkRecovered(100, 7);
+}
+
+void group_commit_should_keep_records_on_full_pages() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA, 0, 0);
+    insertRecords(100, 50);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->nextDataPageId, "Full data page was not written.");
+
+    recover(0, 0);
+    checkRecovered(100, 42);
+}
+
+void embedDBInit_should_reject_group_commit_without_record_level_consistency() {
+    tearDown();
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    state->keySize = 4;
+    state->dataSize = 8;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->numDataPages = 32;
+    state->eraseSizeInPages = 4;
+    state->parameters = EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA;
+    state->rlcCommitRecords = 4;
+    state->rlcCommitIntervalMs = 0;
+    state->compareKey = int32Comparator;
+    state->compareData = int64Comparator;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "embedDBInit accepted group commit without record-level consistency.");
+    free(state->buffer);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+
+    setUp();
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(group_commit_should_write_one_temporary_page_per_group);
+    RUN_TEST(embedDBCommit_should_make_pending_records_durable);
+    RUN_TEST(group_commit_should_commit_after_interval);
+    RUN_TEST(group_commit_should_keep_records_on_full_pages);
+    RUN_TEST(embedDBInit_should_reject_group_commit_without_record_level_consistency);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif